@@ -0,0 +1,389 @@
+#include "analysis_cache.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <unistd.h>
+
+#include "symbol_table.h"
+
+namespace fs = std::filesystem;
+
+// Longest key a cache header holds: a tag byte plus a build ID (20 bytes
+// for SHA-1 IDs) or a 16-byte content hash.
+static constexpr size_t maxCacheKeySize = 64;
+
+// On-disk layout, all little-endian (native) and 8-byte aligned:
+//   Header | Region[regionCount] | per region: linear records, reachable
+//   records, blocks, edge starts, edge targets, edge kinds |
+//   CachedSymbol[symbolCount] | symbol name bytes
+// Offsets are from the start of the file.
+struct AnalysisCache::Header {
+    char magic[8];         // "DISCACHE"
+    uint32_t version;      // analysisCacheVersion
+    uint32_t keySize;
+    uint8_t key[maxCacheKeySize];
+    uint64_t fileSize;     // Size of the input file the cache describes
+    uint64_t regionCount;
+    uint64_t symbolCount;
+    uint64_t symbolsOffset;
+    uint64_t stringsOffset;
+    uint64_t stringsSize;
+};
+
+struct AnalysisCache::Region {
+    uint64_t address;      // Region identity, checked on open
+    uint64_t offset;
+    uint64_t size;
+    uint64_t linearOffset;
+    uint64_t linearCount;
+    uint64_t reachableOffset;
+    uint64_t reachableCount;
+    uint64_t blocksOffset;
+    uint64_t blockCount;
+    uint64_t edgeStartOffset;    // blockCount + 1 entries
+    uint64_t edgeTargetsOffset;
+    uint64_t edgeCount;
+    uint64_t edgeKindsOffset;
+    uint8_t contentHash[16];     // hashContents() of the region's bytes
+};
+
+struct AnalysisCache::CachedSymbol {
+    uint64_t address;
+    uint64_t size;
+    uint32_t nameOffset;   // Into the name bytes
+    uint32_t nameSize;
+    uint8_t type;
+    uint8_t binding;
+    uint8_t padding[6];
+};
+
+namespace {
+
+constexpr char cacheMagic[8] = {'D', 'I', 'S', 'C', 'A', 'C', 'H', 'E'};
+constexpr uint8_t keyFromBuildId = 'B';
+constexpr uint8_t keyFromHash = 'H';
+
+uint64_t alignUp(uint64_t value) {
+    return (value + 7) & ~uint64_t{7};
+}
+
+uint64_t rotateLeft(uint64_t value, int bits) {
+    return (value << bits) | (value >> (64 - bits));
+}
+
+// Final avalanche of MurmurHash3.
+uint64_t mix(uint64_t value) {
+    value ^= value >> 33;
+    value *= 0xFF51AFD7ED558CCDull;
+    value ^= value >> 33;
+    value *= 0xC4CEB9FE1A85EC53ull;
+    value ^= value >> 33;
+    return value;
+}
+
+// 128-bit content hash: two independent multiply-rotate lanes over 16 bytes
+// per step. Not cryptographic; it only has to tell different builds apart
+// at memory bandwidth.
+void hashContents(std::span<const uint8_t> data, uint8_t out[16]) {
+    constexpr uint64_t k1 = 0x87C37B91114253D5ull;
+    constexpr uint64_t k2 = 0x4CF5AD432745937Full;
+    uint64_t a = 0x9E3779B97F4A7C15ull;
+    uint64_t b = 0xC2B2AE3D27D4EB4Full;
+    size_t n = 0;
+    for (; data.size() - n >= 16; n += 16) {
+        uint64_t w0, w1;
+        std::memcpy(&w0, data.data() + n, 8);
+        std::memcpy(&w1, data.data() + n + 8, 8);
+        a = rotateLeft(a ^ (w0 * k1), 31) * k2;
+        b = rotateLeft(b ^ (w1 * k2), 33) * k1;
+    }
+    uint8_t tail[16] = {};
+    std::memcpy(tail, data.data() + n, data.size() - n);
+    uint64_t w0, w1;
+    std::memcpy(&w0, tail, 8);
+    std::memcpy(&w1, tail + 8, 8);
+    a = mix(a ^ (w0 * k1) ^ data.size());
+    b = mix(b ^ (w1 * k2) ^ a);
+    a = mix(a ^ b);
+    std::memcpy(out, &a, 8);
+    std::memcpy(out + 8, &b, 8);
+}
+
+// Sequential writer that pads every array to 8 bytes, so the offsets
+// computed up front by the same rule match what lands in the file.
+class CacheWriter {
+public:
+    explicit CacheWriter(FILE* stream) : stream_(stream) {}
+
+    bool ok() const { return ok_; }
+
+    void write(const void* data, size_t size) {
+        static constexpr uint8_t zeros[8] = {};
+        if (size != 0 && std::fwrite(data, 1, size, stream_) != size) {
+            ok_ = false;
+        }
+        size_t padding = alignUp(size) - size;
+        if (padding != 0 && std::fwrite(zeros, 1, padding, stream_) != padding) {
+            ok_ = false;
+        }
+    }
+
+    template <typename T>
+    void write(std::span<const T> items) {
+        write(items.data(), items.size_bytes());
+    }
+
+private:
+    FILE* stream_;
+    bool ok_ = true;
+};
+
+} // namespace
+
+std::vector<uint8_t> computeCacheKey(std::span<const uint8_t> file, const ElfSectionTable* sectionTable) {
+    std::vector<uint8_t> key;
+    std::span<const uint8_t> buildId = sectionTable != nullptr ? findBuildId(file, *sectionTable)
+                                                               : std::span<const uint8_t>();
+    if (!buildId.empty() && buildId.size() < maxCacheKeySize) {
+        key.push_back(keyFromBuildId);
+        key.insert(key.end(), buildId.begin(), buildId.end());
+    } else {
+        key.resize(17);
+        key[0] = keyFromHash;
+        hashContents(file, key.data() + 1);
+    }
+    return key;
+}
+
+std::string cachePath(const std::string& directory, std::span<const uint8_t> key) {
+    static constexpr char digits[] = "0123456789abcdef";
+    std::string name;
+    for (uint8_t byte : key) {
+        name += digits[byte >> 4];
+        name += digits[byte & 0x0F];
+    }
+    return (fs::path(directory) / (name + ".dcache")).string();
+}
+
+bool AnalysisCache::write(const std::string& path, std::span<const uint8_t> key, std::span<const uint8_t> file,
+                          std::span<const CodeRegion> regions, std::span<const RegionAnalysis> analyses,
+                          const SymbolTable& symbols) {
+    // Layout pass: place every array.
+    Header header{};
+    std::memcpy(header.magic, cacheMagic, sizeof(cacheMagic));
+    header.version = analysisCacheVersion;
+    header.keySize = static_cast<uint32_t>(key.size());
+    std::memcpy(header.key, key.data(), key.size());
+    header.fileSize = file.size();
+    header.regionCount = regions.size();
+    uint64_t cursor = alignUp(sizeof(Header)) + alignUp(regions.size() * sizeof(Region));
+    auto place = [&cursor](uint64_t bytes) {
+        uint64_t offset = cursor;
+        cursor += alignUp(bytes);
+        return offset;
+    };
+
+    std::vector<Region> table(regions.size());
+    for (size_t k = 0; k < regions.size(); k++) {
+        const RegionAnalysis& analysis = analyses[k];
+        const ControlFlowGraph& graph = analysis.graph;
+        Region& region = table[k];
+        region.address = regions[k].address;
+        region.offset = regions[k].offset;
+        region.size = regions[k].bytes.size();
+        hashContents(regions[k].bytes, region.contentHash);
+        region.linearCount = analysis.linear.size();
+        region.linearOffset = place(analysis.linear.size() * sizeof(DecodedInstruction));
+        region.reachableCount = analysis.reachable.size();
+        region.reachableOffset = place(analysis.reachable.size() * sizeof(DecodedInstruction));
+        region.blockCount = graph.blocks().size();
+        region.blocksOffset = place(graph.blocks().size_bytes());
+        region.edgeStartOffset = place(graph.edgeStart().size_bytes());
+        region.edgeCount = graph.edgeCount();
+        region.edgeTargetsOffset = place(graph.edgeTargets().size_bytes());
+        region.edgeKindsOffset = place(graph.edgeKinds().size_bytes());
+    }
+
+    std::vector<CachedSymbol> cachedSymbols;
+    std::string names;
+    cachedSymbols.reserve(symbols.size());
+    for (const Symbol& symbol : symbols.symbols()) {
+        CachedSymbol cached{};
+        cached.address = symbol.address;
+        cached.size = symbol.size;
+        cached.nameOffset = static_cast<uint32_t>(names.size());
+        cached.nameSize = static_cast<uint32_t>(symbol.name.size());
+        cached.type = symbol.type;
+        cached.binding = symbol.binding;
+        cachedSymbols.push_back(cached);
+        names += symbol.name;
+    }
+    header.symbolCount = cachedSymbols.size();
+    header.symbolsOffset = place(cachedSymbols.size() * sizeof(CachedSymbol));
+    header.stringsSize = names.size();
+    header.stringsOffset = place(names.size());
+
+    // Write pass, in placement order.
+    std::error_code error;
+    fs::create_directories(fs::path(path).parent_path(), error);
+    std::string temporary = path + ".tmp." + std::to_string(getpid());
+    FILE* stream = std::fopen(temporary.c_str(), "wb");
+    if (stream == nullptr) {
+        std::cerr << "Error: cannot create " << temporary << ": " << std::strerror(errno) << '\n';
+        return false;
+    }
+    CacheWriter writer(stream);
+    writer.write(&header, sizeof(header));
+    writer.write(std::span<const Region>(table));
+    for (const RegionAnalysis& analysis : analyses) {
+        writer.write(std::span<const DecodedInstruction>(analysis.linear));
+        writer.write(std::span<const DecodedInstruction>(analysis.reachable));
+        writer.write(analysis.graph.blocks());
+        writer.write(analysis.graph.edgeStart());
+        writer.write(analysis.graph.edgeTargets());
+        writer.write(analysis.graph.edgeKinds());
+    }
+    writer.write(std::span<const CachedSymbol>(cachedSymbols));
+    writer.write(names.data(), names.size());
+    bool written = writer.ok() && std::fclose(stream) == 0;
+    if (!written || (std::rename(temporary.c_str(), path.c_str()) != 0)) {
+        std::cerr << "Error: cannot write " << path << ": " << std::strerror(errno) << '\n';
+        std::remove(temporary.c_str());
+        return false;
+    }
+    return true;
+}
+
+template <typename T>
+std::span<const T> AnalysisCache::array(uint64_t offset, uint64_t count) const {
+    const uint8_t* base = image_.bytes().data();
+    return {reinterpret_cast<const T*>(base + offset), static_cast<size_t>(count)};
+}
+
+bool AnalysisCache::open(const std::string& path, std::span<const uint8_t> key, std::span<const uint8_t> file,
+                         std::span<const CodeRegion> regions) {
+    header_ = nullptr;
+    regions_ = nullptr;
+    std::error_code error;
+    if (!fs::is_regular_file(path, error) || !image_.open(path)) {
+        return false;
+    }
+    std::span<const uint8_t> bytes = image_.bytes();
+    uint64_t size = bytes.size();
+
+    // An array fits if it lies inside the file and is aligned for its type.
+    auto fits = [size](uint64_t offset, uint64_t count, size_t itemSize, size_t alignment) {
+        return offset <= size && count <= (size - offset) / itemSize && offset % alignment == 0;
+    };
+
+    if (size < sizeof(Header)) {
+        return false;
+    }
+    const Header* header = reinterpret_cast<const Header*>(bytes.data());
+    if (std::memcmp(header->magic, cacheMagic, sizeof(cacheMagic)) != 0 ||
+        header->version != analysisCacheVersion || header->keySize != key.size() ||
+        std::memcmp(header->key, key.data(), key.size()) != 0 || header->fileSize != file.size() ||
+        header->regionCount != regions.size() ||
+        !fits(alignUp(sizeof(Header)), header->regionCount, sizeof(Region), alignof(Region)) ||
+        !fits(header->symbolsOffset, header->symbolCount, sizeof(CachedSymbol), alignof(CachedSymbol)) ||
+        !fits(header->stringsOffset, header->stringsSize, 1, 1)) {
+        return false;
+    }
+    const Region* table = reinterpret_cast<const Region*>(bytes.data() + alignUp(sizeof(Header)));
+
+    // The build ID survives binary patching, so the code itself is compared
+    // too: hashing the code regions is cheap next to decoding them.
+    for (size_t k = 0; k < regions.size(); k++) {
+        uint8_t hash[16];
+        hashContents(regions[k].bytes, hash);
+        if (std::memcmp(hash, table[k].contentHash, sizeof(hash)) != 0) {
+            return false;
+        }
+    }
+
+    // Every record must lie inside its region and every block and edge
+    // inside its arrays, so that nothing read from the cache later needs
+    // checking again.
+    for (size_t k = 0; k < regions.size(); k++) {
+        const Region& region = table[k];
+        if (region.address != regions[k].address || region.offset != regions[k].offset ||
+            region.size != regions[k].bytes.size() ||
+            !fits(region.linearOffset, region.linearCount, sizeof(DecodedInstruction), alignof(DecodedInstruction)) ||
+            !fits(region.reachableOffset, region.reachableCount, sizeof(DecodedInstruction), alignof(DecodedInstruction)) ||
+            !fits(region.blocksOffset, region.blockCount, sizeof(BasicBlock), alignof(BasicBlock)) ||
+            region.blockCount == UINT64_MAX ||
+            !fits(region.edgeStartOffset, region.blockCount + 1, sizeof(uint32_t), alignof(uint32_t)) ||
+            !fits(region.edgeTargetsOffset, region.edgeCount, sizeof(uint32_t), alignof(uint32_t)) ||
+            !fits(region.edgeKindsOffset, region.edgeCount, sizeof(EdgeKind), alignof(EdgeKind))) {
+            return false;
+        }
+        for (auto records : {array<DecodedInstruction>(region.linearOffset, region.linearCount),
+                             array<DecodedInstruction>(region.reachableOffset, region.reachableCount)}) {
+            for (const DecodedInstruction& insn : records) {
+                if (insn.offset >= region.size || insn.length == 0 || insn.length > region.size - insn.offset ||
+                    insn.dispPos > insn.length || insn.immPos > insn.length) {
+                    return false;
+                }
+            }
+        }
+        for (const BasicBlock& block : array<BasicBlock>(region.blocksOffset, region.blockCount)) {
+            if (block.firstInstruction > region.reachableCount ||
+                block.instructionCount > region.reachableCount - block.firstInstruction) {
+                return false;
+            }
+        }
+        std::span<const uint32_t> edgeStart = array<uint32_t>(region.edgeStartOffset, region.blockCount + 1);
+        for (size_t b = 0; b < edgeStart.size(); b++) {
+            if (edgeStart[b] > region.edgeCount || (b != 0 && edgeStart[b] < edgeStart[b - 1])) {
+                return false;
+            }
+        }
+        if (edgeStart.back() != region.edgeCount) {
+            return false;
+        }
+        for (uint32_t target : array<uint32_t>(region.edgeTargetsOffset, region.edgeCount)) {
+            if (target >= region.blockCount) {
+                return false;
+            }
+        }
+    }
+    for (const CachedSymbol& symbol : array<CachedSymbol>(header->symbolsOffset, header->symbolCount)) {
+        if (symbol.nameOffset > header->stringsSize || symbol.nameSize > header->stringsSize - symbol.nameOffset) {
+            return false;
+        }
+    }
+
+    header_ = header;
+    regions_ = table;
+    return true;
+}
+
+std::span<const DecodedInstruction> AnalysisCache::linearInstructions(size_t region) const {
+    return array<DecodedInstruction>(regions_[region].linearOffset, regions_[region].linearCount);
+}
+
+std::span<const DecodedInstruction> AnalysisCache::reachableInstructions(size_t region) const {
+    return array<DecodedInstruction>(regions_[region].reachableOffset, regions_[region].reachableCount);
+}
+
+void AnalysisCache::loadGraph(size_t region, ControlFlowGraph& graph) const {
+    const Region& cached = regions_[region];
+    graph.assign(array<BasicBlock>(cached.blocksOffset, cached.blockCount),
+                 array<uint32_t>(cached.edgeStartOffset, cached.blockCount + 1),
+                 array<uint32_t>(cached.edgeTargetsOffset, cached.edgeCount),
+                 array<EdgeKind>(cached.edgeKindsOffset, cached.edgeCount));
+}
+
+void AnalysisCache::loadSymbols(SymbolTable& symbols) const {
+    const char* names = reinterpret_cast<const char*>(image_.bytes().data() + header_->stringsOffset);
+    std::vector<Symbol> loaded;
+    loaded.reserve(header_->symbolCount);
+    for (const CachedSymbol& cached : array<CachedSymbol>(header_->symbolsOffset, header_->symbolCount)) {
+        loaded.push_back({cached.address, cached.size, std::string_view(names + cached.nameOffset, cached.nameSize),
+                          cached.type, cached.binding});
+    }
+    symbols.assign(std::move(loaded));
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "binary_image.h"
+#include "control_flow_graph.h"
+#include "decoded_instruction.h"
+#include "elf.h"
+
+class SymbolTable;
+
+// Bumped whenever the file layout or the meaning of a cached record changes
+// (for example when the decoder learns new opcodes), so stale caches are
+// rebuilt instead of misread.
+constexpr uint32_t analysisCacheVersion = 7;
+
+// What the analysis modes compute for one code region.
+struct RegionAnalysis {
+    std::vector<DecodedInstruction> linear;     // Linear sweep of the whole region
+    std::vector<DecodedInstruction> reachable;  // Recursive traversal from the entry point and symbols
+    ControlFlowGraph graph;                     // Built over reachable
+};
+
+// Identifies an input file for caching: its NT_GNU_BUILD_ID when it has one
+// (so the key is free to compute), otherwise a 128-bit hash of the whole
+// file. The first byte tags which of the two it is. sectionTable may be
+// nullptr.
+std::vector<uint8_t> computeCacheKey(std::span<const uint8_t> file, const ElfSectionTable* sectionTable);
+
+// "<directory>/<key in hex>.dcache".
+std::string cachePath(const std::string& directory, std::span<const uint8_t> key);
+
+// A cache file mapped read-only. Everything is validated against the file
+// size once in open(); the instruction arrays are then handed out as views
+// straight into the mapping, so a cached listing starts without decoding or
+// copying. Symbol names also point into the mapping, so the cache must
+// outlive any SymbolTable filled by loadSymbols().
+class AnalysisCache {
+public:
+    // Maps the cache at path and checks that it is the current version and
+    // was written for key, for a file of the same size and for the same code
+    // regions with the same bytes (a patched binary keeps its build ID but
+    // must not be served the old records). Returns false, silently, if there
+    // is no such cache or it does not match; the caller then rebuilds it.
+    bool open(const std::string& path, std::span<const uint8_t> key, std::span<const uint8_t> file,
+              std::span<const CodeRegion> regions);
+
+    // Writes analyses (one per region, in the same order) and symbols to a
+    // cache file at path. The file is written under a temporary name and
+    // renamed into place, so concurrent readers never see a partial cache.
+    // Prints a diagnostic to std::cerr and returns false on failure.
+    static bool write(const std::string& path, std::span<const uint8_t> key, std::span<const uint8_t> file,
+                      std::span<const CodeRegion> regions, std::span<const RegionAnalysis> analyses,
+                      const SymbolTable& symbols);
+
+    bool isOpen() const { return header_ != nullptr; }
+
+    std::span<const DecodedInstruction> linearInstructions(size_t region) const;
+    std::span<const DecodedInstruction> reachableInstructions(size_t region) const;
+    void loadGraph(size_t region, ControlFlowGraph& graph) const;
+    void loadSymbols(SymbolTable& symbols) const;
+
+private:
+    struct Header;
+    struct Region;
+    struct CachedSymbol;
+
+    template <typename T>
+    std::span<const T> array(uint64_t offset, uint64_t count) const;
+
+    BinaryImage image_;
+    const Header* header_ = nullptr;
+    const Region* regions_ = nullptr;
+};
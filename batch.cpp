@@ -0,0 +1,291 @@
+#include "batch.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+#include "binary_image.h"
+#include "disassembler.h"
+#include "elf.h"
+#include "output_writer.h"
+#include "parallel_disassembler.h"
+#include "symbol_table.h"
+#include "thread_pool.h"
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// One input binary and where its listing goes.
+struct BatchFile {
+    fs::path input;
+    fs::path output;
+};
+
+// Counters shared by every task of a batch.
+struct BatchStats {
+    std::atomic<size_t> written{0};
+    std::atomic<size_t> skipped{0};
+    std::atomic<size_t> failed{0};
+};
+
+// One executable section (or segment) of a file in flight.
+struct SectionJob {
+    const CodeRegion* region = nullptr;
+    std::vector<DecodeChunk> chunks;          // Set when the section is split further
+    std::vector<DecodedInstruction> records;  // Decoded (and stitched) instructions
+};
+
+// A file in flight. Small files live and die inside one task; large ones are
+// shared by their section and chunk sub-tasks and written by whichever
+// finishes last.
+struct FileJob {
+    BatchFile file;
+    BinaryImage image;
+    std::vector<CodeRegion> regions;
+    SymbolTable symbols;
+    std::string header;  // ELF header and section lines, as main prints them
+    std::vector<SectionJob> sections;
+    std::atomic<size_t> remaining{0};
+};
+
+void reportError(const fs::path& path, std::string_view reason) {
+    // One write per message so lines from different workers do not interleave.
+    std::string message = "Error: " + path.string() + ": " + std::string(reason) + '\n';
+    std::cerr << message;
+}
+
+// Maps an input path to its listing under outputDir. Leading roots and ".."
+// components are dropped so that every listing stays inside outputDir.
+fs::path mirroredPath(const fs::path& input, const fs::path& outputDir) {
+    fs::path result = outputDir;
+    for (const fs::path& part : input.lexically_normal().relative_path()) {
+        if (!part.empty() && part != "." && part != "..") {
+            result /= part;
+        }
+    }
+    result += ".asm";
+    return result;
+}
+
+// Fills files from a directory tree or a list file. Returns false (after
+// printing an error) if the input cannot be read.
+bool collectFiles(const fs::path& input, const fs::path& outputDir, std::vector<BatchFile>& files) {
+    std::error_code error;
+    if (fs::is_directory(input, error)) {
+        fs::recursive_directory_iterator it(input, fs::directory_options::skip_permission_denied, error);
+        for (; !error && it != fs::recursive_directory_iterator(); it.increment(error)) {
+            std::error_code typeError;
+            if (it->is_regular_file(typeError)) {
+                files.push_back({it->path(), mirroredPath(it->path().lexically_relative(input), outputDir)});
+            }
+        }
+        if (error) {
+            reportError(input, error.message());
+            return false;
+        }
+        // Directory order depends on the filesystem; sort so runs are repeatable.
+        std::sort(files.begin(), files.end(), [](const BatchFile& a, const BatchFile& b) {
+            return a.input < b.input;
+        });
+        return true;
+    }
+
+    std::ifstream list(input);
+    if (!list) {
+        reportError(input, "cannot open file list");
+        return false;
+    }
+    std::string line;
+    while (std::getline(list, line)) {
+        // One path per line; blank lines and '#' comments are ignored.
+        while (!line.empty() && (line.back() == '\r' || line.back() == ' ' || line.back() == '\t')) {
+            line.pop_back();
+        }
+        if (line.empty() || line.front() == '#') {
+            continue;
+        }
+        files.push_back({line, mirroredPath(line, outputDir)});
+    }
+    return true;
+}
+
+// Writes the listing of one file: the header text followed by the
+// disassembly of every executable section, exactly as a single-file run
+// prints it.
+bool writeListing(const FileJob& job) {
+    std::error_code error;
+    fs::create_directories(job.file.output.parent_path(), error);
+    FILE* stream = std::fopen(job.file.output.c_str(), "wb");
+    if (stream == nullptr) {
+        reportError(job.file.output, std::strerror(errno));
+        return false;
+    }
+    {
+        OutputWriter out(stream);
+        out << job.header;
+        for (size_t k = 0; k < job.sections.size(); k++) {
+            const SectionJob& section = job.sections[k];
+            const CodeRegion& region = *section.region;
+            out << (k == 0 ? "" : "\n") << "Disassembly of " << region.name << ' ' << region.kind << ":\n";
+            printInstructions(section.region->bytes, section.records, region.address, out, &job.symbols);
+        }
+    }
+    bool ok = std::ferror(stream) == 0;
+    ok = std::fclose(stream) == 0 && ok;
+    if (!ok) {
+        reportError(job.file.output, "write failed");
+    }
+    return ok;
+}
+
+void recordResult(BatchStats& stats, bool written) {
+    (written ? stats.written : stats.failed).fetch_add(1);
+}
+
+// Called by every sub-task of a split file when it is done; the last one to
+// finish stitches the chunked sections and writes the listing.
+void finishSubtask(BatchStats& stats, FileJob& job) {
+    if (job.remaining.fetch_sub(1) != 1) {
+        return;
+    }
+    for (SectionJob& section : job.sections) {
+        if (!section.chunks.empty()) {
+            stitchChunks(section.region->bytes, section.chunks, section.records, section.region->mode);
+            std::vector<DecodeChunk>().swap(section.chunks);
+        }
+    }
+    recordResult(stats, writeListing(job));
+}
+
+// Task body for one input file. Maps it, renders the header and either
+// disassembles it in place or fans it out as section and chunk sub-tasks.
+void processFile(WorkStealingPool& pool, BatchStats& stats, BatchFile file) {
+    auto job = std::make_shared<FileJob>();
+    job->file = std::move(file);
+    if (!job->image.open(job->file.input.string())) {
+        stats.failed.fetch_add(1);
+        return;
+    }
+    std::span<const uint8_t> bytes = job->image.bytes();
+    if (!isELF64(bytes) && !isELF32(bytes)) {
+        // Corpora routinely contain scripts and data files; not an error.
+        stats.skipped.fetch_add(1);
+        return;
+    }
+
+    bool found;
+    {
+        OutputWriter header(job->header, 4096);
+        printELFHeader(bytes, header);
+        // Corrupt samples are common in malware corpora: parse() bounds-checks
+        // every table once, so nothing below can read outside the mapping.
+        ElfView elf;
+        if (!elf.parse(bytes, header)) {
+            reportError(job->file.input, "malformed ELF header");
+            stats.failed.fetch_add(1);
+            return;
+        }
+        ElfSectionTable sectionTable;
+        bool hasSections = sectionTable.load(elf, header);
+        found = findCodeRegions(elf, hasSections ? &sectionTable : nullptr, job->regions, header);
+        if (found) {
+            printCodeRegions(job->regions, header);
+            if (hasSections && job->symbols.load(bytes, sectionTable) != 0) {
+                header << "Found ";
+                header.dec(static_cast<uint64_t>(job->symbols.size()));
+                header << " symbols\n";
+            }
+        }
+    }
+    if (!found) {
+        reportError(job->file.input, "no executable sections or segments");
+        stats.failed.fetch_add(1);
+        return;
+    }
+
+    size_t totalSize = 0;
+    job->sections.resize(job->regions.size());
+    for (size_t k = 0; k < job->regions.size(); k++) {
+        job->sections[k].region = &job->regions[k];
+        totalSize += job->regions[k].bytes.size();
+    }
+
+    if (totalSize < batchSplitSize) {
+        for (SectionJob& section : job->sections) {
+            decodeInstructions(section.region->bytes, section.records, section.region->mode);
+        }
+        recordResult(stats, writeListing(*job));
+        return;
+    }
+
+    // Large file: one sub-task per section, and one per chunk for sections
+    // that are large themselves. They land on this worker's deque, so idle
+    // workers steal them while this one starts on the most recent.
+    size_t taskCount = 0;
+    for (SectionJob& section : job->sections) {
+        if (section.region->bytes.size() >= batchSplitSize) {
+            section.chunks = splitIntoChunks(section.region->bytes.size(), section.region->bytes.size() / minParallelChunkSize);
+            taskCount += section.chunks.size();
+        } else {
+            taskCount++;
+        }
+    }
+    job->remaining.store(taskCount);
+    for (SectionJob& section : job->sections) {
+        if (section.chunks.empty()) {
+            pool.submit([&stats, job, &section] {
+                decodeInstructions(section.region->bytes, section.records, section.region->mode);
+                finishSubtask(stats, *job);
+            });
+            continue;
+        }
+        for (DecodeChunk& chunk : section.chunks) {
+            pool.submit([&stats, job, &section, &chunk] {
+                decodeChunk(section.region->bytes, chunk, section.region->mode);
+                finishSubtask(stats, *job);
+            });
+        }
+    }
+}
+
+} // namespace
+
+bool runBatch(const char* input, const char* outputDir, unsigned threads) {
+    std::vector<BatchFile> files;
+    if (!collectFiles(input, outputDir, files)) {
+        return false;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    BatchStats stats;
+    {
+        WorkStealingPool pool(threads);
+        for (BatchFile& file : files) {
+            pool.submit([&pool, &stats, file = std::move(file)]() mutable {
+                processFile(pool, stats, std::move(file));
+            });
+        }
+        pool.wait();
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    std::cout << "Batch: " << files.size() << " files, "
+              << stats.written.load() << " disassembled, "
+              << stats.skipped.load() << " skipped (not ELF), "
+              << stats.failed.load() << " failed in "
+              << elapsed.count() << " s\n";
+    return stats.failed.load() == 0;
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstddef>
+
+// Files with at least this much executable code are split into one task per
+// executable section, and sections at least this large further into chunk
+// tasks, so one huge binary cannot hold up the tail of a batch.
+constexpr size_t batchSplitSize = 4 << 20;
+
+// Batch corpus mode. input is either a directory, which is walked
+// recursively, or a text file listing one binary path per line. Every file is
+// a task on a work-stealing pool of threads workers (0 = one per hardware
+// thread); large files spawn sub-tasks per executable section and per chunk
+// of large sections, and are written by whichever worker finishes last.
+//
+// Each listing goes to its own file under outputDir, mirroring the input
+// path with ".asm" appended, and is identical to what a single-file run
+// prints. Files that are not ELF32 or ELF64 are skipped. Returns false if
+// any file could not be disassembled or written; a summary is printed to
+// stdout.
+bool runBatch(const char* input, const char* outputDir, unsigned threads);
@@ -0,0 +1,301 @@
+#include "benchmark.h"
+
+#include <bit>
+#include <chrono>
+#include <cstring>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "byte_classifier.h"
+#include "control_flow_graph.h"
+#include "disassembler.h"
+#include "parallel_disassembler.h"
+#include "signature_scanner.h"
+
+namespace {
+
+struct BenchmarkResult {
+    double seconds;        // Wall time of one pass
+    size_t instructions;   // Instructions produced by one pass
+};
+
+// Runs pass repeatedly for at least minimumTime and returns per-pass figures.
+template <typename Pass>
+BenchmarkResult measure(Pass&& pass) {
+    using Clock = std::chrono::steady_clock;
+    constexpr auto minimumTime = std::chrono::milliseconds(500);
+
+    size_t instructions = pass();  // Warm-up: faults the pages in
+    size_t iterations = 0;
+    auto start = Clock::now();
+    auto elapsed = Clock::duration::zero();
+    do {
+        instructions = pass();
+        iterations++;
+        elapsed = Clock::now() - start;
+    } while (elapsed < minimumTime);
+
+    double seconds = std::chrono::duration<double>(elapsed).count() / static_cast<double>(iterations);
+    return {seconds, instructions};
+}
+
+double megabytesPerSecond(const BenchmarkResult& result, size_t bytes) {
+    return static_cast<double>(bytes) / 1e6 / result.seconds;
+}
+
+void report(OutputWriter& out, const char* name, const BenchmarkResult& result, size_t bytes) {
+    double megabytes = megabytesPerSecond(result, bytes);
+    double minstructions = static_cast<double>(result.instructions) / 1e6 / result.seconds;
+    out << name << ": ";
+    out.dec(static_cast<uint64_t>(megabytes));
+    out << " MB/s, ";
+    out.dec(static_cast<uint64_t>(minstructions));
+    out << " M instructions/s\n";
+}
+
+// A loop body of AVX/AVX2/AVX-512 code as compilers emit it: VEX and EVEX
+// arithmetic, masked and broadcast memory operands, opmask moves and BMI.
+constexpr uint8_t vectorLoopBody[] = {
+    0x62, 0xf1, 0x74, 0x58, 0x58, 0x00,        // vaddps zmm0, zmm1, DWORD BCST [rax]
+    0x62, 0xf1, 0x74, 0xc9, 0x58, 0xc2,        // vaddps zmm0{k1}{z}, zmm1, zmm2
+    0x62, 0xe1, 0x7f, 0x4a, 0x6f, 0x46, 0x01,  // vmovdqu8 zmm16{k2}, ZMMWORD PTR [rsi+0x40]
+    0x62, 0x61, 0xfe, 0x49, 0x7f, 0x7f, 0x02,  // vmovdqu64 ZMMWORD PTR [rdi+0x80]{k1}, zmm31
+    0x62, 0xf3, 0x75, 0x4a, 0x3e, 0xca, 0x01,  // vpcmpltub k1{k2}, zmm1, zmm2
+    0x62, 0xf3, 0x75, 0x48, 0x25, 0xc2, 0x96,  // vpternlogd zmm0, zmm1, zmm2, 0x96
+    0xc5, 0xfb, 0x93, 0xc1,                    // kmovd eax, k1
+    0xc5, 0xfe, 0x6f, 0x40, 0x20,              // vmovdqu ymm0, YMMWORD PTR [rax+0x20]
+    0xc5, 0xf1, 0xef, 0xc2,                    // vpxor xmm0, xmm1, xmm2
+    0xc4, 0xe3, 0x75, 0x4a, 0xc2, 0x30,        // vblendvps ymm0, ymm1, ymm2, ymm3
+    0xc4, 0xe3, 0x75, 0x38, 0xc2, 0x01,        // vinserti128 ymm0, ymm1, xmm2, 0x1
+    0xc4, 0xe2, 0x75, 0xb8, 0xc2,              // vfmadd231ps ymm0, ymm1, ymm2
+    0x62, 0xf1, 0x75, 0x48, 0xfe, 0x40, 0x01,  // vpaddd zmm0, zmm1, ZMMWORD PTR [rax+0x40]
+    0x62, 0xf2, 0x7d, 0x48, 0x31, 0x40, 0x01,  // vpmovzxbd zmm0, XMMWORD PTR [rax+0x10]
+    0xc4, 0xe2, 0x71, 0xf7, 0xc3,              // shlx eax, ebx, ecx
+    0xc4, 0xe3, 0xfb, 0xf0, 0xc3, 0x03,        // rorx rax, rbx, 0x3
+    0x48, 0x83, 0xc0, 0x40,                    // add rax, 0x40
+    0x75, 0x9b,                                // jne (the start of the body)
+};
+
+// About a megabyte of vectorLoopBody, repeated.
+std::vector<uint8_t> buildVectorCode() {
+    constexpr size_t targetSize = 1 << 20;
+    std::vector<uint8_t> code;
+    code.reserve(targetSize + sizeof(vectorLoopBody));
+    while (code.size() < targetSize) {
+        code.insert(code.end(), std::begin(vectorLoopBody), std::end(vectorLoopBody));
+    }
+    return code;
+}
+
+// Full decoding versus length-only decoding over code, with a check that
+// the two agree on every boundary. Leaves the full decode in instructions.
+void reportDecodeThroughput(std::span<const uint8_t> code, CpuMode mode, OutputWriter& out,
+                            std::vector<DecodedInstruction>& instructions) {
+    std::vector<uint8_t> lengths;
+
+    BenchmarkResult full = measure([&] {
+        instructions.clear();
+        decodeInstructions(code, instructions, mode);
+        return instructions.size();
+    });
+    BenchmarkResult lengthOnly = measure([&] {
+        lengths.clear();
+        decodeLengths(code, lengths, mode);
+        return lengths.size();
+    });
+
+    out.dec(static_cast<uint64_t>(code.size()));
+    out << " bytes:\n";
+    report(out, "  full decode  ", full, code.size());
+    report(out, "  lengths only ", lengthOnly, code.size());
+
+    // The two decoders must agree on every boundary.
+    bool match = lengths.size() == instructions.size();
+    for (size_t n = 0; match && n < lengths.size(); n++) {
+        match = lengths[n] == instructions[n].length;
+    }
+    out << "  boundaries " << (match ? "match" : "DIFFER") << '\n';
+
+    // Share of VEX/EVEX-encoded records.
+    size_t vex = 0;
+    size_t evex = 0;
+    for (const DecodedInstruction& insn : instructions) {
+        vex += (insn.flags & InsnVex) != 0;
+        evex += (insn.flags & InsnEvex) != 0;
+    }
+    out << "  vector       : ";
+    out.dec(static_cast<uint64_t>(vex));
+    out << " VEX, ";
+    out.dec(static_cast<uint64_t>(evex));
+    out << " EVEX of ";
+    out.dec(static_cast<uint64_t>(instructions.size()));
+    out << " instructions\n";
+}
+
+// Each byte classifier kernel the CPU supports: its own throughput, and both
+// decoders with it driving their loops, against the scalar fallback. The
+// records must not depend on the kernel; they are checked against
+// instructions, the full decode with the default kernel.
+void reportByteClassifiers(std::span<const uint8_t> code, CpuMode mode, OutputWriter& out,
+                           const std::vector<DecodedInstruction>& instructions) {
+    ByteClassifierKernel active = activeByteClassifierKernel();
+    out << "Byte classifier kernels (decode loops use " << byteClassifierKernelName(active) << "):\n";
+
+    std::vector<DecodedInstruction> records;
+    std::vector<uint8_t> lengths;
+    bool identical = true;
+    for (ByteClassifierKernel kernel :
+         {ByteClassifierKernel::Scalar, ByteClassifierKernel::Sse41, ByteClassifierKernel::Avx2}) {
+        if (!setByteClassifierKernel(kernel)) {
+            continue;
+        }
+        ByteClassifier classify = byteClassifier(mode, kernel);
+        BenchmarkResult classified = measure([&] {
+            uint32_t simple = 0;
+            for (size_t n = 0; n + byteClassBlockSize <= code.size(); n += byteClassBlockSize) {
+                simple += static_cast<uint32_t>(std::popcount(classify(code.data() + n)));
+            }
+            return static_cast<size_t>(simple);
+        });
+        BenchmarkResult full = measure([&] {
+            records.clear();
+            decodeInstructions(code, records, mode);
+            return records.size();
+        });
+        BenchmarkResult lengthOnly = measure([&] {
+            lengths.clear();
+            decodeLengths(code, lengths, mode);
+            return lengths.size();
+        });
+        identical = identical && records.size() == instructions.size() &&
+                    std::memcmp(records.data(), instructions.data(),
+                                records.size() * sizeof(DecodedInstruction)) == 0;
+
+        const char* name = byteClassifierKernelName(kernel);
+        out << "  " << name;
+        for (size_t n = std::strlen(name); n < 7; n++) {
+            out << ' ';
+        }
+        out << ": classify ";
+        out.dec(static_cast<uint64_t>(megabytesPerSecond(classified, code.size())));
+        out << " MB/s, full decode ";
+        out.dec(static_cast<uint64_t>(megabytesPerSecond(full, code.size())));
+        out << " MB/s, lengths only ";
+        out.dec(static_cast<uint64_t>(megabytesPerSecond(lengthOnly, code.size())));
+        out << " MB/s\n";
+    }
+    setByteClassifierKernel(active);
+    out << "  kernel records " << (identical ? "match" : "DIFFER") << '\n';
+}
+
+// The signature scanner with each kernel, for a few counts of signatures
+// cut from the code itself: evenly spaced 16-byte windows with a wildcard
+// 32-bit displacement in the middle, so every signature matches at least
+// once. Every kernel must find the same matches.
+void reportSignatureScan(std::span<const uint8_t> code, OutputWriter& out) {
+    constexpr size_t signatureLength = 16;
+    if (code.size() < 1024 * signatureLength) {
+        return;
+    }
+    ByteClassifierKernel active = activeByteClassifierKernel();
+    out << "Signature scan (" << byteClassifierKernelName(active) << " by default):\n";
+
+    bool identical = true;
+    for (size_t count : {16, 128, 1024}) {
+        std::vector<Signature> signatures(count);
+        for (size_t k = 0; k < count; k++) {
+            size_t start = k * (code.size() - signatureLength) / count;
+            signatures[k].name = "s" + std::to_string(k);
+            signatures[k].bytes.assign(code.begin() + start, code.begin() + start + signatureLength);
+            signatures[k].mask.assign(signatureLength, 0xFF);
+            for (size_t n = 6; n < 10; n++) {
+                signatures[k].bytes[n] = 0;
+                signatures[k].mask[n] = 0;
+            }
+        }
+        SignatureScanner scanner;
+        scanner.build(std::move(signatures), code);
+
+        out << "  ";
+        out.dec(static_cast<uint64_t>(count));
+        out << " signatures:";
+        const char* separator = " ";
+        std::vector<SignatureMatch> matches;
+        std::vector<SignatureMatch> expected;
+        for (ByteClassifierKernel kernel :
+             {ByteClassifierKernel::Scalar, ByteClassifierKernel::Sse41, ByteClassifierKernel::Avx2}) {
+            if (!setByteClassifierKernel(kernel)) {
+                continue;
+            }
+            BenchmarkResult result = measure([&] {
+                matches.clear();
+                scanner.scan(code, 0, code.size(), 0, 0, matches);
+                return matches.size();
+            });
+            if (kernel == ByteClassifierKernel::Scalar) {
+                expected = matches;
+            }
+            identical = identical && matches.size() == expected.size() &&
+                        std::memcmp(matches.data(), expected.data(), matches.size() * sizeof(SignatureMatch)) == 0;
+            out << separator << byteClassifierKernelName(kernel) << ' ';
+            out.dec(static_cast<uint64_t>(megabytesPerSecond(result, code.size())));
+            out << " MB/s";
+            separator = ", ";
+        }
+        out << ", ";
+        out.dec(static_cast<uint64_t>(matches.size()));
+        out << " matches\n";
+    }
+    setByteClassifierKernel(active);
+    out << "  kernel matches " << (identical ? "agree" : "DIFFER") << '\n';
+}
+
+} // namespace
+
+void runDecodeBenchmark(std::span<const uint8_t> code, OutputWriter& out, unsigned threads, CpuMode mode) {
+    std::vector<DecodedInstruction> instructions;
+    out << "Benchmark over ";
+    reportDecodeThroughput(code, mode, out, instructions);
+
+    // CFG construction over the linear-sweep records, reusing one graph so
+    // the figure is for the builder rather than the allocator.
+    ControlFlowGraph graph;
+    BenchmarkResult cfg = measure([&] {
+        graph.build(code, instructions);
+        return graph.blocks().size();
+    });
+    out << "  cfg build    : ";
+    out.dec(static_cast<uint64_t>(static_cast<double>(cfg.instructions) / 1e6 / cfg.seconds));
+    out << " M blocks/s, ";
+    out.dec(static_cast<uint64_t>(cfg.instructions));
+    out << " blocks, ";
+    out.dec(static_cast<uint64_t>(graph.edgeCount()));
+    out << " edges, ";
+    out.dec(static_cast<uint64_t>(cfg.instructions == 0 ? 0 : graph.memoryUsage() / cfg.instructions));
+    out << " bytes/block\n";
+
+    if (threads != 1) {
+        std::vector<DecodedInstruction> parallel;
+        BenchmarkResult result = measure([&] {
+            parallel.clear();
+            decodeInstructionsParallel(code, parallel, threads, mode);
+            return parallel.size();
+        });
+        report(out, "  parallel     ", result, code.size());
+        bool identical = parallel.size() == instructions.size() &&
+                         std::memcmp(parallel.data(), instructions.data(),
+                                     parallel.size() * sizeof(DecodedInstruction)) == 0;
+        out << "  parallel records " << (identical ? "match" : "DIFFER") << '\n';
+    }
+
+    reportByteClassifiers(code, mode, out, instructions);
+    reportSignatureScan(code, out);
+
+    // The same over AVX-heavy code, where nearly every instruction takes the
+    // VEX/EVEX path of both decoders.
+    std::vector<uint8_t> vectorCode = buildVectorCode();
+    std::vector<DecodedInstruction> vectorInstructions;
+    out << "AVX-heavy synthetic code, ";
+    reportDecodeThroughput(vectorCode, CpuMode::Bits64, out, vectorInstructions);
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+
+#include "decoded_instruction.h"
+#include "output_writer.h"
+
+// Measures decoder throughput over code, decoded in mode, and writes a small
+// report to out: full decoding into DecodedInstruction records versus
+// length-only decoding, plus control-flow-graph construction (blocks/s and
+// memory per block) and the parallel sweep when threads != 1, the byte
+// classifier kernels against the scalar fallback, the signature scanner with
+// each kernel, then the two decoders again over a synthetic 64-bit
+// AVX/AVX2/AVX-512 buffer. Each pass is repeated until it has run for a
+// measurable amount of time.
+void runDecodeBenchmark(std::span<const uint8_t> code, OutputWriter& out, unsigned threads,
+                        CpuMode mode = CpuMode::Bits64);
@@ -0,0 +1,143 @@
+#include "binary_image.h"
+
+#include <iostream>
+#include <utility>
+
+#if defined(__unix__) || defined(__APPLE__)
+    #include <cerrno>
+    #include <cstring>
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+    #define BINARY_IMAGE_HAS_MMAP 1
+#else
+    #include <fstream>
+    #include <iterator>
+#endif
+
+BinaryImage::~BinaryImage() {
+    close();
+}
+
+BinaryImage::BinaryImage(BinaryImage&& other) noexcept {
+    *this = std::move(other);
+}
+
+BinaryImage& BinaryImage::operator=(BinaryImage&& other) noexcept {
+    if (this != &other) {
+        close();
+        mapped_ = std::exchange(other.mapped_, false);
+        size_ = std::exchange(other.size_, 0);
+        buffer_ = std::move(other.buffer_);
+        // The fallback buffer moved with its storage, so re-point at it.
+        data_ = mapped_ ? std::exchange(other.data_, nullptr) : buffer_.data();
+        other.data_ = nullptr;
+    }
+    return *this;
+}
+
+void BinaryImage::close() {
+#ifdef BINARY_IMAGE_HAS_MMAP
+    if (mapped_ && data_ != nullptr) {
+        munmap(const_cast<uint8_t*>(data_), size_);
+    }
+#endif
+    data_ = nullptr;
+    size_ = 0;
+    mapped_ = false;
+    buffer_.clear();
+    buffer_.shrink_to_fit();
+}
+
+#ifdef BINARY_IMAGE_HAS_MMAP
+
+// Reads everything from a descriptor that cannot be mapped (e.g. a pipe).
+// Uses large read(2) calls instead of iterating the stream byte by byte.
+static bool readAll(int fd, std::vector<uint8_t>& out) {
+    constexpr size_t chunkSize = 1 << 20;
+    size_t used = 0;
+    for (;;) {
+        if (out.size() - used < chunkSize) {
+            out.resize(used + chunkSize);
+        }
+        ssize_t n = ::read(fd, out.data() + used, out.size() - used);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        if (n == 0) {
+            break;
+        }
+        used += static_cast<size_t>(n);
+    }
+    out.resize(used);
+    return true;
+}
+
+bool BinaryImage::open(const std::string& path) {
+    close();
+
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        std::cerr << "Failed to open file: " << path << " (" << std::strerror(errno) << ")" << std::endl;
+        return false;
+    }
+
+    struct stat st {};
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+        size_t fileSize = static_cast<size_t>(st.st_size);
+        void* mapping = mmap(nullptr, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping != MAP_FAILED) {
+            // The decoder walks sections front to back, so ask the kernel for
+            // aggressive read-ahead and early reclaim of pages behind us.
+            madvise(mapping, fileSize, MADV_SEQUENTIAL);
+            ::close(fd);
+            data_ = static_cast<const uint8_t*>(mapping);
+            size_ = fileSize;
+            mapped_ = true;
+            return true;
+        }
+        // Some filesystems refuse mappings; fall through to a plain read.
+    }
+
+    bool ok = readAll(fd, buffer_);
+    int savedErrno = errno;
+    ::close(fd);
+    if (!ok) {
+        std::cerr << "Failed to read file: " << path << " (" << std::strerror(savedErrno) << ")" << std::endl;
+        buffer_.clear();
+        return false;
+    }
+    buffer_.shrink_to_fit();
+    data_ = buffer_.data();
+    size_ = buffer_.size();
+    return true;
+}
+
+#else
+
+bool BinaryImage::open(const std::string& path) {
+    close();
+
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file) {
+        std::cerr << "Failed to open file: " << path << std::endl;
+        return false;
+    }
+    std::streamsize fileSize = file.tellg();
+    file.seekg(0, std::ios::beg);
+    if (fileSize > 0) {
+        buffer_.resize(static_cast<size_t>(fileSize));
+        file.read(reinterpret_cast<char*>(buffer_.data()), fileSize);
+    } else {
+        buffer_.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+    data_ = buffer_.data();
+    size_ = buffer_.size();
+    return true;
+}
+
+#endif
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>  // For fixed-width integer types (uint8_t)
+#include <span>
+#include <string>
+#include <vector>
+
+// A read-only view of a binary file.
+// Regular files are memory-mapped, so loading an image costs a single mmap()
+// call regardless of its size and the bytes are never copied onto the heap:
+// the kernel faults pages in from the page cache as the decoder touches them.
+// Inputs that cannot be mapped (pipes, character devices, /proc files) fall
+// back to reading the whole stream into an owned buffer.
+class BinaryImage {
+public:
+    BinaryImage() = default;
+    ~BinaryImage();
+
+    BinaryImage(const BinaryImage&) = delete;
+    BinaryImage& operator=(const BinaryImage&) = delete;
+    BinaryImage(BinaryImage&& other) noexcept;
+    BinaryImage& operator=(BinaryImage&& other) noexcept;
+
+    // Opens the file at path, replacing any image already held.
+    // Prints a diagnostic to std::cerr and returns false on failure.
+    bool open(const std::string& path);
+
+    // The whole file contents. Valid until the image is closed or destroyed.
+    std::span<const uint8_t> bytes() const { return {data_, size_}; }
+    size_t size() const { return size_; }
+
+    // True when the bytes come from a file mapping rather than the fallback buffer.
+    bool isMapped() const { return mapped_; }
+
+    void close();
+
+private:
+    const uint8_t* data_ = nullptr;
+    size_t size_ = 0;
+    bool mapped_ = false;
+    std::vector<uint8_t> buffer_;  // Only used by the non-mappable fallback
+};
@@ -0,0 +1,149 @@
+#include "byte_classifier.h"
+
+#include <array>
+#include <atomic>
+
+#include "byte_set.h"
+#include "opcode_table.h"
+
+namespace {
+
+// A primary opcode is a simple instruction when its byte is the whole
+// instruction: no ModR/M, no immediate and no group or escape to resolve.
+// Such bytes decode identically wherever they start an instruction. Legacy
+// prefixes and REX have their own handling in the decoders and are never
+// simple.
+constexpr bool isSimpleOpcode(const OpcodeEntry& entry) {
+    return !(entry.flags & (OpKindMask | OpHasModRM)) && entry.immBytes == 0 &&
+           entry.immVariable == 0 && entry.group == GroupNone;
+}
+
+template <CpuMode Mode>
+constexpr std::array<bool, 256> buildSimpleTable() {
+    std::array<bool, 256> table{};
+    for (int op = 0; op < 256; op++) {
+        table[op] = isSimpleOpcode(primaryOpcodeTable<Mode>[op]);
+    }
+    for (int op : {0x26, 0x2E, 0x36, 0x3E, 0x64, 0x65, 0x66, 0x67, 0xF0, 0xF2, 0xF3}) {
+        table[op] = false;
+    }
+    if constexpr (Mode == CpuMode::Bits64) {
+        for (int op = 0x40; op <= 0x4F; op++) {
+            table[op] = false;
+        }
+    }
+    return table;
+}
+
+constexpr ByteSet buildByteSet(const std::array<bool, 256>& members) {
+    ByteSet set;
+    for (int value = 0; value < 256; value++) {
+        if (members[value]) {
+            set.insert(static_cast<uint8_t>(value));
+        }
+    }
+    return set;
+}
+
+template <CpuMode Mode>
+constexpr std::array<bool, 256> simpleTable = buildSimpleTable<Mode>();
+template <CpuMode Mode>
+constexpr ByteSet simpleSet = buildByteSet(simpleTable<Mode>);
+
+template <CpuMode Mode>
+uint32_t classifyScalar(const uint8_t* bytes) {
+    uint32_t simple = 0;
+    for (size_t n = 0; n < byteClassBlockSize; n++) {
+        simple |= static_cast<uint32_t>(simpleTable<Mode>[bytes[n]]) << n;
+    }
+    return simple;
+}
+
+#if BYTE_SET_SIMD
+
+template <CpuMode Mode>
+[[gnu::target("sse4.1")]] uint32_t classifySse41(const uint8_t* bytes) {
+    return matchByteSetSse41(loadByteBlockSse41(bytes), simpleSet<Mode>) |
+           matchByteSetSse41(loadByteBlockSse41(bytes + 16), simpleSet<Mode>) << 16;
+}
+
+template <CpuMode Mode>
+[[gnu::target("avx2")]] uint32_t classifyAvx2(const uint8_t* bytes) {
+    return matchByteSetAvx2(loadByteBlockAvx2(bytes), simpleSet<Mode>);
+}
+
+#endif
+
+bool kernelSupported(ByteClassifierKernel kernel) {
+#if BYTE_SET_SIMD
+    __builtin_cpu_init();
+    switch (kernel) {
+        case ByteClassifierKernel::Avx2: return __builtin_cpu_supports("avx2");
+        case ByteClassifierKernel::Sse41: return __builtin_cpu_supports("sse4.1");
+        default: return true;
+    }
+#else
+    return kernel == ByteClassifierKernel::Scalar;
+#endif
+}
+
+template <CpuMode Mode>
+ByteClassifier classifierFor(ByteClassifierKernel kernel) {
+    switch (kernel) {
+#if BYTE_SET_SIMD
+        case ByteClassifierKernel::Avx2: return classifyAvx2<Mode>;
+        case ByteClassifierKernel::Sse41: return classifySse41<Mode>;
+#endif
+        default: return classifyScalar<Mode>;
+    }
+}
+
+std::atomic<ByteClassifierKernel>& activeKernel() {
+    static std::atomic<ByteClassifierKernel> kernel = bestByteClassifierKernel();
+    return kernel;
+}
+
+} // namespace
+
+ByteClassifierKernel bestByteClassifierKernel() {
+    static const ByteClassifierKernel best = [] {
+        for (ByteClassifierKernel kernel : {ByteClassifierKernel::Avx2, ByteClassifierKernel::Sse41}) {
+            if (kernelSupported(kernel)) {
+                return kernel;
+            }
+        }
+        return ByteClassifierKernel::Scalar;
+    }();
+    return best;
+}
+
+ByteClassifierKernel activeByteClassifierKernel() {
+    return activeKernel().load(std::memory_order_relaxed);
+}
+
+bool setByteClassifierKernel(ByteClassifierKernel kernel) {
+    if (!kernelSupported(kernel)) {
+        return false;
+    }
+    activeKernel().store(kernel, std::memory_order_relaxed);
+    return true;
+}
+
+ByteClassifier byteClassifier(CpuMode mode, ByteClassifierKernel kernel) {
+    if (!kernelSupported(kernel)) {
+        return nullptr;
+    }
+    switch (mode) {
+        case CpuMode::Bits32: return classifierFor<CpuMode::Bits32>(kernel);
+        case CpuMode::Bits16: return classifierFor<CpuMode::Bits16>(kernel);
+        default: return classifierFor<CpuMode::Bits64>(kernel);
+    }
+}
+
+const char* byteClassifierKernelName(ByteClassifierKernel kernel) {
+    switch (kernel) {
+        case ByteClassifierKernel::Avx2: return "avx2";
+        case ByteClassifierKernel::Sse41: return "sse4.1";
+        default: return "scalar";
+    }
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "decoded_instruction.h"
+
+// Finds runs of simple instructions - opcodes that are a complete
+// instruction in one byte, like push rbx, ret, int3 and nop - a block of
+// bytes at a time, so the decode loops can emit a whole run (padding,
+// push/pop sequences) without decoding its bytes one by one. The simple
+// opcodes come from the opcode tables of each CpuMode.
+//
+// There are SSE4.1 and AVX2 kernels (the byte values tested against
+// nibble-indexed bitmaps with pshufb, 16 and 32 bytes per step) and a
+// scalar fallback for other CPUs; the best one the running CPU supports is
+// chosen once, at the first decode.
+
+constexpr size_t byteClassBlockSize = 32;
+
+// Returns a mask in which bit n is set if bytes[n] is a simple opcode. All
+// byteClassBlockSize bytes must be readable.
+using ByteClassifier = uint32_t (*)(const uint8_t* bytes);
+
+enum class ByteClassifierKernel : uint8_t { Scalar, Sse41, Avx2 };
+
+// The fastest kernel this CPU supports.
+ByteClassifierKernel bestByteClassifierKernel();
+
+// The kernel the decode loops use: bestByteClassifierKernel() unless
+// changed by setByteClassifierKernel().
+ByteClassifierKernel activeByteClassifierKernel();
+
+// Switches the decode loops to kernel (to compare kernels in benchmarks).
+// Returns false, leaving the active kernel as it was, if the CPU lacks the
+// instructions kernel needs.
+bool setByteClassifierKernel(ByteClassifierKernel kernel);
+
+// The classifier of kernel for mode, or nullptr if the CPU cannot run it.
+ByteClassifier byteClassifier(CpuMode mode, ByteClassifierKernel kernel);
+
+// "scalar", "sse4.1" or "avx2".
+const char* byteClassifierKernelName(ByteClassifierKernel kernel);
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define BYTE_SET_SIMD 1
+#include <immintrin.h>
+#else
+#define BYTE_SET_SIMD 0
+#endif
+
+// A set of byte values laid out for SIMD membership tests. Indexed by the
+// low nibble of a byte, it holds a bitmap of the high nibbles in the set,
+// split into high nibbles 0-7 (lower) and 8-15 (upper). Testing a block of
+// bytes takes two pshufb lookups of the bitmaps by the low nibbles, a blendv
+// that keeps the one each byte's top bit selects, and a second pshufb that
+// turns each high nibble into the bit 1 << (high & 7) to test in it: any
+// set of the 256 values costs the same handful of instructions.
+struct ByteSet {
+    alignas(16) std::array<uint8_t, 16> lower{};
+    alignas(16) std::array<uint8_t, 16> upper{};
+
+    constexpr void insert(uint8_t value) {
+        auto& half = value >= 0x80 ? upper : lower;
+        half[value & 0x0F] |= static_cast<uint8_t>(1 << ((value >> 4) & 0x07));
+    }
+    constexpr bool contains(uint8_t value) const {
+        const auto& half = value >= 0x80 ? upper : lower;
+        return (half[value & 0x0F] >> ((value >> 4) & 0x07)) & 1;
+    }
+};
+
+#if BYTE_SET_SIMD
+
+// A block of bytes split into the vectors the membership tests take,
+// computed once per block and shared by every set tested against it. The
+// kernels are compiled for their instruction set with target attributes, so
+// the rest of the program needs no special flags; callers check the CPU
+// (__builtin_cpu_supports) before using them.
+
+struct ByteBlockSse41 {
+    __m128i bytes;
+    __m128i lowNibbles;
+    __m128i highBits;  // 1 << (high nibble & 7) per byte
+};
+
+[[gnu::target("sse4.1")]] inline ByteBlockSse41 loadByteBlockSse41(const uint8_t* bytes) {
+    const __m128i nibble = _mm_set1_epi8(0x0F);
+    const __m128i bitOfNibble = _mm_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128);
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes));
+    return {v, _mm_and_si128(v, nibble), _mm_shuffle_epi8(bitOfNibble, _mm_and_si128(_mm_srli_epi16(v, 4), nibble))};
+}
+
+// Bit n is set if byte n of block (16 bytes) is in set.
+[[gnu::target("sse4.1")]] inline uint32_t matchByteSetSse41(const ByteBlockSse41& block, const ByteSet& set) {
+    __m128i lower = _mm_load_si128(reinterpret_cast<const __m128i*>(set.lower.data()));
+    __m128i upper = _mm_load_si128(reinterpret_cast<const __m128i*>(set.upper.data()));
+    __m128i rows = _mm_blendv_epi8(_mm_shuffle_epi8(lower, block.lowNibbles),
+                                   _mm_shuffle_epi8(upper, block.lowNibbles), block.bytes);
+    __m128i hits = _mm_cmpeq_epi8(_mm_and_si128(rows, block.highBits), block.highBits);
+    return static_cast<uint32_t>(_mm_movemask_epi8(hits));
+}
+
+struct ByteBlockAvx2 {
+    __m256i bytes;
+    __m256i lowNibbles;
+    __m256i highBits;  // 1 << (high nibble & 7) per byte
+};
+
+[[gnu::target("avx2")]] inline ByteBlockAvx2 loadByteBlockAvx2(const uint8_t* bytes) {
+    const __m256i nibble = _mm256_set1_epi8(0x0F);
+    const __m256i bitOfNibble = _mm256_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128,
+                                                 1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128);
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(bytes));
+    return {v, _mm256_and_si256(v, nibble),
+            _mm256_shuffle_epi8(bitOfNibble, _mm256_and_si256(_mm256_srli_epi16(v, 4), nibble))};
+}
+
+// Bit n is set if byte n of block (32 bytes) is in set.
+[[gnu::target("avx2")]] inline uint32_t matchByteSetAvx2(const ByteBlockAvx2& block, const ByteSet& set) {
+    __m256i lower = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(set.lower.data())));
+    __m256i upper = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(set.upper.data())));
+    __m256i rows = _mm256_blendv_epi8(_mm256_shuffle_epi8(lower, block.lowNibbles),
+                                      _mm256_shuffle_epi8(upper, block.lowNibbles), block.bytes);
+    __m256i hits = _mm256_cmpeq_epi8(_mm256_and_si256(rows, block.highBits), block.highBits);
+    return static_cast<uint32_t>(_mm256_movemask_epi8(hits));
+}
+
+#endif
@@ -0,0 +1,101 @@
+#include "control_flow.h"
+
+#include <array>
+#include <cstddef>
+
+#include "opcode_table.h"
+
+// Flow kind per opcode id (map << 8 | opcode byte). FF is resolved
+// separately because its kind depends on the ModR/M reg field.
+static constexpr std::array<FlowKind, 0x400> buildFlowTable() {
+    std::array<FlowKind, 0x400> table{};
+    for (int op = 0x70; op <= 0x7F; op++) {
+        table[op] = FlowKind::ConditionalJump;  // jcc rel8
+    }
+    for (int op = 0xE0; op <= 0xE3; op++) {
+        table[op] = FlowKind::ConditionalJump;  // loopne, loope, loop, jrcxz
+    }
+    table[0xE8] = FlowKind::Call;
+    table[0xE9] = FlowKind::Jump;
+    table[0xEB] = FlowKind::Jump;
+    table[0xC2] = FlowKind::Return;
+    table[0xC3] = FlowKind::Return;
+    table[0xCA] = FlowKind::Return;
+    table[0xCB] = FlowKind::Return;
+    table[0xCF] = FlowKind::Return;  // iret
+    // Far call and jump through an immediate segment:offset (invalid, so
+    // never reached, in 64-bit mode). The target is in another segment.
+    table[0x9A] = FlowKind::IndirectCall;
+    table[0xEA] = FlowKind::IndirectJump;
+    table[0xCC] = FlowKind::Stop;    // int3, usually padding after noreturn calls
+    table[0xF4] = FlowKind::Stop;    // hlt
+    for (int op = 0x180; op <= 0x18F; op++) {
+        table[op] = FlowKind::ConditionalJump;  // jcc rel32
+    }
+    table[0x107] = FlowKind::Return;  // sysret
+    table[0x135] = FlowKind::Return;  // sysexit
+    table[0x10B] = FlowKind::Stop;    // ud2
+    table[0x1B9] = FlowKind::Stop;    // ud1
+    table[0x1FF] = FlowKind::Stop;    // ud0
+    return table;
+}
+
+static constexpr std::array<FlowKind, 0x400> flowTable = buildFlowTable();
+
+FlowKind classifyFlow(const DecodedInstruction& insn) {
+    if (insn.flags & InsnInvalid) {
+        return FlowKind::Stop;
+    }
+    // VEX and EVEX opcode ids share the 0F maps' numbering, but no VEX or
+    // EVEX instruction transfers control.
+    if (insn.flags & (InsnVex | InsnEvex)) {
+        return FlowKind::Sequential;
+    }
+    if (insn.opcode == 0xFF) {
+        switch ((insn.modrm >> 3) & 0x07) {
+            case 2: case 3: return FlowKind::IndirectCall;
+            case 4: case 5: return FlowKind::IndirectJump;
+            default: return FlowKind::Sequential;
+        }
+    }
+    return flowTable[insn.opcode & 0x3FF];
+}
+
+uint64_t relativeBranchTarget(const DecodedInstruction& insn, uint64_t address, int64_t rel) {
+    uint64_t target = address + insn.length + rel;
+    CpuMode mode = instructionMode(insn);
+    if (mode == CpuMode::Bits64) {
+        return target;
+    }
+    return operandSizeBits(mode, insn.prefixes, 0, 0) == 16 ? target & 0xFFFF : target & 0xFFFFFFFF;
+}
+
+uint64_t branchTarget(const uint8_t* bytes, const DecodedInstruction& insn, uint64_t address) {
+    // rel8, rel16 (with a 66 prefix) or rel32, sign-extended.
+    size_t size = insn.length - insn.immPos;
+    const uint8_t* field = bytes + insn.immPos;
+    int64_t rel;
+    if (size == 1) {
+        rel = static_cast<int8_t>(field[0]);
+    } else if (size == 2) {
+        rel = static_cast<int16_t>(field[0] | (field[1] << 8));
+    } else {
+        rel = static_cast<int32_t>(static_cast<uint32_t>(field[0]) | (static_cast<uint32_t>(field[1]) << 8) |
+                                   (static_cast<uint32_t>(field[2]) << 16) | (static_cast<uint32_t>(field[3]) << 24));
+    }
+    return relativeBranchTarget(insn, address, rel);
+}
+
+bool ripRelativeTarget(const uint8_t* bytes, const DecodedInstruction& insn, uint64_t address, uint64_t& target) {
+    // mod == 00 and rm == 101 without a SIB byte: [rip + disp32]. Outside
+    // 64-bit mode the same encoding is an absolute address.
+    if ((insn.flags & (InsnInvalid | InsnHasModRM)) != InsnHasModRM || (insn.modrm & 0xC7) != 0x05 ||
+        instructionMode(insn) != CpuMode::Bits64) {
+        return false;
+    }
+    const uint8_t* field = bytes + insn.dispPos;
+    int32_t disp = static_cast<int32_t>(static_cast<uint32_t>(field[0]) | (static_cast<uint32_t>(field[1]) << 8) |
+                                        (static_cast<uint32_t>(field[2]) << 16) | (static_cast<uint32_t>(field[3]) << 24));
+    target = address + insn.length + disp;
+    return true;
+}
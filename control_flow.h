@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdint>
+
+#include "decoded_instruction.h"
+
+// How an instruction passes control on, as far as can be told from its
+// encoding alone.
+enum class FlowKind : uint8_t {
+    Sequential,       // Falls through to the next instruction
+    Call,             // Direct call: branch target and fall-through
+    IndirectCall,     // Call through a register or memory: fall-through only
+    Jump,             // Direct unconditional jump: branch target only
+    ConditionalJump,  // jcc, loop, jrcxz: branch target and fall-through
+    IndirectJump,     // Jump through a register or memory: no known successor
+    Return,           // ret, retf, iret: no successor
+    Stop,             // hlt, int3 and invalid bytes: no successor
+};
+
+// Classifies a decoded record with one table load (plus the ModR/M reg field
+// for the FF group).
+FlowKind classifyFlow(const DecodedInstruction& insn);
+
+// True for the kinds that carry a relative branch target.
+constexpr bool hasBranchTarget(FlowKind kind) {
+    return kind == FlowKind::Call || kind == FlowKind::Jump || kind == FlowKind::ConditionalJump;
+}
+
+// True for the kinds after which execution may continue with the next
+// instruction.
+constexpr bool fallsThrough(FlowKind kind) {
+    return kind == FlowKind::Sequential || kind == FlowKind::Call ||
+           kind == FlowKind::IndirectCall || kind == FlowKind::ConditionalJump;
+}
+
+// Where a relative branch of insn at address lands when its displacement is
+// rel: the end of the instruction plus rel, wrapped to the instruction
+// pointer. That is 64 bits wide in 64-bit mode; elsewhere it is as wide as
+// the operand size (EIP, or IP for rel16 and 16-bit code).
+uint64_t relativeBranchTarget(const DecodedInstruction& insn, uint64_t address, int64_t rel);
+
+// Target of a direct branch (hasBranchTarget(classifyFlow(insn))). bytes is
+// the first byte of the instruction and address its virtual address; the
+// relative field is the last immediate of the instruction.
+uint64_t branchTarget(const uint8_t* bytes, const DecodedInstruction& insn, uint64_t address);
+
+// If insn has a rip-relative memory operand ([rip + disp32]), stores the
+// address it refers to in target and returns true. bytes and address are
+// as for branchTarget().
+bool ripRelativeTarget(const uint8_t* bytes, const DecodedInstruction& insn, uint64_t address, uint64_t& target);
@@ -0,0 +1,173 @@
+#include "control_flow_graph.h"
+
+#include <algorithm>
+
+#include "control_flow.h"
+#include "symbol_table.h"
+
+namespace {
+
+bool startsBefore(const DecodedInstruction& insn, uint64_t offset) {
+    return insn.offset < offset;
+}
+
+// Index of the instruction starting exactly at offset, or npos.
+size_t findInstruction(std::span<const DecodedInstruction> instructions, uint64_t offset) {
+    auto it = std::lower_bound(instructions.begin(), instructions.end(), offset, startsBefore);
+    if (it == instructions.end() || it->offset != offset) {
+        return ControlFlowGraph::npos;
+    }
+    return static_cast<size_t>(it - instructions.begin());
+}
+
+void setBit(std::vector<uint64_t>& bits, size_t index) {
+    bits[index >> 6] |= uint64_t{1} << (index & 63);
+}
+
+bool testBit(const std::vector<uint64_t>& bits, size_t index) {
+    return (bits[index >> 6] >> (index & 63)) & 1;
+}
+
+// Branch targets are computed in offset space: an instruction at offset o
+// is treated as if it were loaded at address o.
+uint64_t targetOffset(std::span<const uint8_t> code, const DecodedInstruction& insn) {
+    return branchTarget(code.data() + insn.offset, insn, insn.offset);
+}
+
+} // namespace
+
+void ControlFlowGraph::build(std::span<const uint8_t> code, std::span<const DecodedInstruction> instructions) {
+    blocks_.clear();
+    edgeStart_.clear();
+    edgeTargets_.clear();
+    edgeKinds_.clear();
+    if (instructions.empty()) {
+        edgeStart_.push_back(0);
+        return;
+    }
+
+    // Pass 1: mark leaders. The first instruction, every branch and call
+    // target, every instruction after a block-ending one and every
+    // instruction after a gap in the array starts a block.
+    size_t count = instructions.size();
+    leaders_.assign((count + 63) / 64, 0);
+    setBit(leaders_, 0);
+    for (size_t i = 0; i < count; i++) {
+        const DecodedInstruction& insn = instructions[i];
+        FlowKind kind = classifyFlow(insn);
+        if (hasBranchTarget(kind)) {
+            size_t target = findInstruction(instructions, targetOffset(code, insn));
+            if (target != npos) {
+                setBit(leaders_, target);
+            }
+        }
+        if (i + 1 < count &&
+            ((kind != FlowKind::Sequential && kind != FlowKind::Call && kind != FlowKind::IndirectCall) ||
+             instructions[i + 1].offset != insn.offset + insn.length)) {
+            setBit(leaders_, i + 1);
+        }
+    }
+
+    // Pass 2: cut the array into blocks at the leaders.
+    for (size_t i = 0; i < count;) {
+        size_t end = i + 1;
+        while (end < count && !testBit(leaders_, end)) {
+            end++;
+        }
+        const DecodedInstruction& last = instructions[end - 1];
+        blocks_.push_back({static_cast<uint32_t>(i), static_cast<uint32_t>(end - i),
+                           instructions[i].offset, last.offset + last.length});
+        i = end;
+    }
+
+    // Pass 3: successor edges, appended block by block so that the CSR row
+    // offsets fall out of the append order.
+    edgeStart_.reserve(blocks_.size() + 1);
+    edgeTargets_.reserve(blocks_.size() * 2);
+    edgeKinds_.reserve(blocks_.size() * 2);
+    for (size_t b = 0; b < blocks_.size(); b++) {
+        edgeStart_.push_back(static_cast<uint32_t>(edgeTargets_.size()));
+        const BasicBlock& block = blocks_[b];
+        const DecodedInstruction& last = instructions[block.firstInstruction + block.instructionCount - 1];
+        FlowKind kind = classifyFlow(last);
+
+        if (kind == FlowKind::Jump || kind == FlowKind::ConditionalJump) {
+            size_t target = findBlock(static_cast<uint32_t>(std::min<uint64_t>(targetOffset(code, last), UINT32_MAX)));
+            if (target != npos) {
+                edgeTargets_.push_back(static_cast<uint32_t>(target));
+                edgeKinds_.push_back(kind == FlowKind::Jump ? EdgeKind::Jump : EdgeKind::Taken);
+            }
+        }
+        bool contiguous = b + 1 < blocks_.size() && blocks_[b + 1].startOffset == block.endOffset;
+        if (fallsThrough(kind) && contiguous) {
+            edgeTargets_.push_back(static_cast<uint32_t>(b + 1));
+            edgeKinds_.push_back(kind == FlowKind::ConditionalJump ? EdgeKind::NotTaken : EdgeKind::FallThrough);
+        }
+    }
+    edgeStart_.push_back(static_cast<uint32_t>(edgeTargets_.size()));
+}
+
+void ControlFlowGraph::assign(std::span<const BasicBlock> blocks, std::span<const uint32_t> edgeStart,
+                              std::span<const uint32_t> edgeTargets, std::span<const EdgeKind> edgeKinds) {
+    blocks_.assign(blocks.begin(), blocks.end());
+    edgeStart_.assign(edgeStart.begin(), edgeStart.end());
+    edgeTargets_.assign(edgeTargets.begin(), edgeTargets.end());
+    edgeKinds_.assign(edgeKinds.begin(), edgeKinds.end());
+}
+
+size_t ControlFlowGraph::findBlock(uint32_t offset) const {
+    auto it = std::lower_bound(blocks_.begin(), blocks_.end(), offset,
+        [](const BasicBlock& block, uint32_t value) { return block.startOffset < value; });
+    if (it == blocks_.end() || it->startOffset != offset) {
+        return npos;
+    }
+    return static_cast<size_t>(it - blocks_.begin());
+}
+
+size_t ControlFlowGraph::memoryUsage() const {
+    return blocks_.capacity() * sizeof(BasicBlock) +
+           edgeStart_.capacity() * sizeof(uint32_t) +
+           edgeTargets_.capacity() * sizeof(uint32_t) +
+           edgeKinds_.capacity() * sizeof(EdgeKind);
+}
+
+static const char* edgeKindName(EdgeKind kind) {
+    switch (kind) {
+        case EdgeKind::FallThrough: return "fallthrough";
+        case EdgeKind::Jump: return "jump";
+        case EdgeKind::Taken: return "taken";
+        case EdgeKind::NotTaken: return "not taken";
+    }
+    return "?";
+}
+
+void printControlFlowGraph(const ControlFlowGraph& graph, uint64_t baseAddress, OutputWriter& out,
+                           const SymbolTable* symbols) {
+    std::span<const BasicBlock> blocks = graph.blocks();
+    int digits = addressDigits(baseAddress + (blocks.empty() ? 0 : blocks.back().endOffset));
+    for (size_t b = 0; b < blocks.size(); b++) {
+        const BasicBlock& block = blocks[b];
+        uint64_t start = baseAddress + block.startOffset;
+        const Symbol* symbol = symbols != nullptr ? symbols->lookup(start) : nullptr;
+        if (symbol != nullptr && symbol->address == start) {
+            out << '\n';
+            out.hex(start, digits);
+            out << " <" << symbol->name << ">:\n";
+        }
+        out.reserveLine();
+        out.hex(start, digits);
+        out << '-';
+        out.hex(baseAddress + block.endOffset, digits);
+        out << ": ";
+        out.dec(block.instructionCount);
+        out << (block.instructionCount == 1 ? " instruction" : " instructions");
+        std::span<const uint32_t> successors = graph.successors(b);
+        std::span<const EdgeKind> kinds = graph.successorKinds(b);
+        for (size_t e = 0; e < successors.size(); e++) {
+            out << (e == 0 ? " -> 0x" : ", 0x");
+            out.hex(baseAddress + blocks[successors[e]].startOffset);
+            out << " (" << edgeKindName(kinds[e]) << ')';
+        }
+        out << '\n';
+    }
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "decoded_instruction.h"
+#include "output_writer.h"
+
+class SymbolTable;
+
+// Why control moves from one block to a successor.
+enum class EdgeKind : uint8_t {
+    FallThrough,  // The next block starts at a branch target, so this one ends
+    Jump,         // Direct unconditional jump
+    Taken,        // Conditional branch taken
+    NotTaken,     // Conditional branch not taken
+};
+
+// A maximal run of instructions entered only at the top and left only at
+// the bottom. Refers into the instruction array the graph was built from.
+struct BasicBlock {
+    uint32_t firstInstruction;  // Index of the first instruction
+    uint32_t instructionCount;
+    uint32_t startOffset;       // Offset of the first byte in code
+    uint32_t endOffset;         // Offset just past the last byte
+};
+
+static_assert(sizeof(BasicBlock) == 16);
+
+// Control-flow graph over a sorted instruction array. Blocks are stored in
+// address order in one array and their successor edges in compressed sparse
+// row form: the successors of block b are edgeTargets_[edgeStart_[b] ..
+// edgeStart_[b + 1]). The whole graph is four flat vectors, with no
+// allocation per block or edge, and rebuilding into the same object reuses
+// their capacity.
+//
+// Calls do not end blocks (the callee is assumed to return) but their
+// targets start new blocks, so function entries are always block leaders.
+// Edges only connect blocks of this graph: branches out of the instruction
+// array, indirect jumps and returns have no successors.
+class ControlFlowGraph {
+public:
+    // Builds the graph of instructions, which must be sorted by offset and
+    // decoded from code (decodeInstructions(), RecursiveDisassembler or a
+    // contiguous slice of either). A jump over a gap in the array (bytes
+    // not decoded) starts a new block without a fall-through edge.
+    void build(std::span<const uint8_t> code, std::span<const DecodedInstruction> instructions);
+
+    // Replaces the graph with previously built arrays, as returned by the
+    // accessors below (used to restore a graph from the analysis cache).
+    void assign(std::span<const BasicBlock> blocks, std::span<const uint32_t> edgeStart,
+                std::span<const uint32_t> edgeTargets, std::span<const EdgeKind> edgeKinds);
+
+    std::span<const BasicBlock> blocks() const { return blocks_; }
+    size_t edgeCount() const { return edgeTargets_.size(); }
+
+    // The raw CSR arrays.
+    std::span<const uint32_t> edgeStart() const { return edgeStart_; }
+    std::span<const uint32_t> edgeTargets() const { return edgeTargets_; }
+    std::span<const EdgeKind> edgeKinds() const { return edgeKinds_; }
+
+    // Successor block indices of block, and the matching edge kinds.
+    std::span<const uint32_t> successors(size_t block) const {
+        return std::span<const uint32_t>(edgeTargets_).subspan(edgeStart_[block], edgeStart_[block + 1] - edgeStart_[block]);
+    }
+    std::span<const EdgeKind> successorKinds(size_t block) const {
+        return std::span<const EdgeKind>(edgeKinds_).subspan(edgeStart_[block], edgeStart_[block + 1] - edgeStart_[block]);
+    }
+
+    // Index of the block whose first byte is at offset, or npos.
+    size_t findBlock(uint32_t offset) const;
+
+    // Bytes held by the graph's arrays.
+    size_t memoryUsage() const;
+
+    static constexpr size_t npos = static_cast<size_t>(-1);
+
+private:
+    std::vector<BasicBlock> blocks_;
+    std::vector<uint32_t> edgeStart_;    // blocks_.size() + 1 row offsets
+    std::vector<uint32_t> edgeTargets_;  // Successor block indices
+    std::vector<EdgeKind> edgeKinds_;
+    std::vector<uint64_t> leaders_;      // Scratch: one bit per instruction
+};
+
+// Writes one line per block: its address range, instruction count and
+// successors, with symbol names where symbols are given.
+void printControlFlowGraph(const ControlFlowGraph& graph, uint64_t baseAddress, OutputWriter& out,
+                           const SymbolTable* symbols = nullptr);
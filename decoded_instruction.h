@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstdint>  // For fixed-width integer types (uint8_t, uint32_t)
+#include <type_traits>
+
+// Legacy prefixes seen in front of an instruction, packed into one byte.
+// The low five bits are flags; the top three hold the segment override.
+enum PrefixFlags : uint8_t {
+    PrefixOperandSize = 1 << 0,  // 0x66
+    PrefixAddressSize = 1 << 1,  // 0x67
+    PrefixLock        = 1 << 2,  // 0xF0
+    PrefixRepne       = 1 << 3,  // 0xF2
+    PrefixRep         = 1 << 4,  // 0xF3
+    PrefixSegmentShift = 5,      // Segment override: 0 = none, 1..6 = es, cs, ss, ds, fs, gs
+    PrefixSegmentMask = 7 << PrefixSegmentShift,
+};
+
+// Processor operating mode a buffer of code is decoded in. It is fixed for a
+// whole buffer (ELF64 code is 64-bit, i386 ELF32 code 32-bit), so the
+// decoder is instantiated once per mode rather than testing it per
+// instruction. Bits64 is zero so that zero-initialised records are 64-bit.
+enum class CpuMode : uint8_t {
+    Bits64,
+    Bits32,
+    Bits16,
+};
+
+// Per-record flags describing which optional fields are present.
+enum InstructionFlags : uint8_t {
+    InsnInvalid   = 1 << 0,  // Not a valid instruction: a single "db" byte
+    InsnHasModRM  = 1 << 1,
+    InsnHasSib    = 1 << 2,
+    InsnModeShift = 3,       // CpuMode the record was decoded in, so readers
+    InsnModeMask  = 3 << 3,  // interpret operand and address sizes the same way
+    InsnVex       = 1 << 5,  // VEX-encoded (C4/C5): see the vex field
+    InsnEvex      = 1 << 6,  // EVEX-encoded (62): see the vex and evex fields
+};
+
+// Fields of a VEX or EVEX prefix that have no legacy equivalent. The rest
+// is stored where the legacy encoding keeps it: R, X, B and W in rex, the
+// implied 66/F3/F2 (pp) in prefixes and the opcode map in the opcode id, so
+// VEX records resolve through the same mandatory-prefix columns.
+enum VexFields : uint8_t {
+    VexRegisterMask   = 0x0F,    // vex: the extra source register vvvv (un-inverted)
+    VexLengthShift    = 4,       // vex: vector length, 0/1/2 = 128/256/512 bits
+    VexLengthMask     = 3 << 4,
+    EvexMaskRegister  = 0x07,    // evex: opmask register k1-k7, 0 = unmasked
+    EvexZeroing       = 1 << 3,  // evex: masked-off elements are zeroed ({z})
+    EvexBroadcast     = 1 << 4,  // evex: b, memory broadcast or register rounding
+    EvexHighVvvv      = 1 << 5,  // evex: V', bit 4 of vvvv
+    EvexHighReg       = 1 << 6,  // evex: R', bit 4 of the ModR/M reg register
+};
+
+// One decoded instruction. Decoding fills a contiguous array of these
+// records without producing any text, so analysis passes can walk the
+// instruction stream at decoder speed and formatting can be done later,
+// in batches, or not at all.
+//
+// Operand descriptors are kept in their encoded form (REX, ModR/M, SIB) and
+// combined with the static operand specs of the opcode table entry when the
+// operands are needed. Displacements and immediates are not copied; their
+// byte positions within the instruction are recorded instead, and readers
+// fetch them from the code buffer at offset + position.
+struct DecodedInstruction {
+    uint32_t offset;        // Offset of the first byte from the start of the decoded buffer
+    uint16_t opcode;        // Opcode id: map << 8 | last opcode byte (see OpcodeMap, resolveOpcodeEntry())
+    uint8_t length;         // Encoded length in bytes (1..15)
+    uint8_t flags;          // InstructionFlags
+    uint8_t prefixes;       // PrefixFlags
+    uint8_t rex;            // REX byte, or 0 when absent
+    uint8_t modrm;          // ModR/M byte (valid with InsnHasModRM)
+    uint8_t sib;            // SIB byte (valid with InsnHasSib)
+    uint8_t dispPos;        // Position of the displacement within the instruction
+    uint8_t immPos;         // Position of the first immediate within the instruction
+    uint8_t vex;            // VexFields of a VEX/EVEX record, 0 otherwise
+    uint8_t evex;           // VexFields of an EVEX record, 0 otherwise
+};
+
+static_assert(sizeof(DecodedInstruction) <= 16, "DecodedInstruction must stay cache-friendly");
+static_assert(std::is_trivially_copyable_v<DecodedInstruction>);
+
+// Operating mode a record was decoded in.
+constexpr CpuMode instructionMode(const DecodedInstruction& insn) {
+    return static_cast<CpuMode>((insn.flags & InsnModeMask) >> InsnModeShift);
+}
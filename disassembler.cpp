@@ -0,0 +1,508 @@
+#include "disassembler.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstring>
+#include <iostream>
+
+#include "byte_classifier.h"
+#include "opcode_table.h"
+
+uint32_t read32(std::span<const uint8_t> code, size_t index) {
+    return  static_cast<uint32_t>(code[index])                  | // Byte 0: least significant
+            (static_cast<uint32_t>(code[index+1]) << 8)         | // Byte 1
+            (static_cast<uint32_t>(code[index+2]) << 16)        | // Byte 2
+            (static_cast<uint32_t>(code[index+3]) << 24);         // Byte 3: most significant
+}
+
+// Legacy prefix bytes and the PrefixFlags they contribute. Zero means the
+// byte is not a legacy prefix.
+static constexpr std::array<uint8_t, 256> buildLegacyPrefixTable() {
+    std::array<uint8_t, 256> table{};
+    table[0x26] = 1 << PrefixSegmentShift;  // es
+    table[0x2E] = 2 << PrefixSegmentShift;  // cs
+    table[0x36] = 3 << PrefixSegmentShift;  // ss
+    table[0x3E] = 4 << PrefixSegmentShift;  // ds
+    table[0x64] = 5 << PrefixSegmentShift;  // fs
+    table[0x65] = 6 << PrefixSegmentShift;  // gs
+    table[0x66] = PrefixOperandSize;
+    table[0x67] = PrefixAddressSize;
+    table[0xF0] = PrefixLock;
+    table[0xF2] = PrefixRepne;
+    table[0xF3] = PrefixRep;
+    return table;
+}
+
+static constexpr std::array<uint8_t, 256> legacyPrefixTable = buildLegacyPrefixTable();
+
+// Decodes the ModR/M byte at bytes[pos] and the SIB byte and displacement
+// that follow it. Returns the position just past the displacement.
+template <CpuMode Mode>
+static size_t decodeModRM(const uint8_t* bytes, size_t pos, DecodedInstruction& out) {
+    uint8_t modrm = bytes[pos++];
+    out.modrm = modrm;
+    out.flags |= InsnHasModRM;
+
+    uint8_t mod = modrm >> 6;
+    uint8_t rm = modrm & 0x07;
+    if (mod == 3) {
+        return pos;
+    }
+
+    // 16-bit addressing ([bx+si], [bp+di], ...) has no SIB byte and 16-bit
+    // displacements. It is the default in 16-bit mode and selected by 0x67
+    // in 32-bit mode; 64-bit mode has no 16-bit addressing at all.
+    if constexpr (Mode != CpuMode::Bits64) {
+        if (addressSizeBits(Mode, out.prefixes) == 16) {
+            out.dispPos = static_cast<uint8_t>(pos);
+            if (mod == 1) {
+                return pos + 1;
+            }
+            return (mod == 2 || rm == 6) ? pos + 2 : pos;
+        }
+    }
+
+    uint8_t base = rm;
+    if (rm == 4) {
+        out.sib = bytes[pos++];
+        out.flags |= InsnHasSib;
+        base = out.sib & 0x07;
+    }
+
+    out.dispPos = static_cast<uint8_t>(pos);
+    if (mod == 1) {
+        return pos + 1;
+    }
+    // mod == 0 with r/m (or SIB base) 101 means disp32 without a base
+    // register: rip-relative without SIB in 64-bit mode, absolute otherwise.
+    if (mod == 2 || base == 5) {
+        return pos + 4;
+    }
+    return pos;
+}
+
+// Total size in bytes of the immediates and other trailing fields that the
+// operand specs of entry call for.
+template <CpuMode Mode>
+static size_t immediateSize(const OpcodeEntry& entry, const DecodedInstruction& insn) {
+    size_t size = entry.immBytes;
+    if (entry.immVariable != 0) {
+        int operandBits = operandSizeBits(Mode, insn.prefixes, insn.rex, entry.flags);
+        if (entry.immVariable & ImmZ) {
+            size += operandBits == 16 ? 2 : 4;
+        }
+        if (entry.immVariable & ImmV) {
+            size += operandBits / 8;
+        }
+        if (entry.immVariable & ImmMoffs) {
+            size += addressSizeBits(Mode, insn.prefixes) / 8;
+        }
+        if (entry.immVariable & ImmJz) {
+            size += relativeSizeZ(Mode, operandBits);
+        }
+    }
+    return size;
+}
+
+// Decodes the ModR/M-dependent fields and immediates of entry, whose opcode
+// byte has already been consumed (pos points just past it).
+template <CpuMode Mode>
+static size_t decodeTail(size_t pos, const OpcodeEntry& entry, DecodedInstruction& out) {
+    if ((entry.flags & OpMemoryOnly) && (out.modrm >> 6) == 3) {
+        return 0;
+    }
+    if ((entry.flags & OpRegisterOnly) && (out.modrm >> 6) != 3) {
+        return 0;
+    }
+    if ((entry.flags & OpModRMF8) && out.modrm != 0xF8) {
+        return 0;
+    }
+    out.immPos = static_cast<uint8_t>(pos);
+    return pos + immediateSize<Mode>(entry, out);
+}
+
+size_t decodeInvalid(const uint8_t*, size_t, const OpcodeEntry&, DecodedInstruction&) {
+    return 0;
+}
+
+// Instructions that are just their opcode byte (e.g. nop, ret, hlt).
+size_t decodeNoOperands(const uint8_t*, size_t pos, const OpcodeEntry&, DecodedInstruction&) {
+    return pos + 1;
+}
+
+// Instructions whose operands are fully described by the table entry.
+template <CpuMode Mode>
+size_t decodeOperands(const uint8_t* bytes, size_t pos, const OpcodeEntry& entry, DecodedInstruction& out) {
+    pos++;
+    if (entry.flags & OpModRMRegister) {
+        // Recorded as the register form it is, so no reader of the record
+        // mistakes it for a memory operand.
+        out.modrm = static_cast<uint8_t>(bytes[pos++] | 0xC0);
+        out.flags |= InsnHasModRM;
+    } else if (entry.flags & OpHasModRM) {
+        pos = decodeModRM<Mode>(bytes, pos, out);
+    }
+    return decodeTail<Mode>(pos, entry, out);
+}
+
+// Opcode groups: the ModR/M reg field selects the instruction, which in turn
+// decides whether an immediate follows (e.g. F6 /0 test has one, F6 /2 not).
+template <CpuMode Mode>
+size_t decodeGroup(const uint8_t* bytes, size_t pos, const OpcodeEntry& entry, DecodedInstruction& out) {
+    pos = decodeModRM<Mode>(bytes, pos + 1, out);
+    // Special register forms (0F 01 D0 xgetbv, 0F AE F0 mfence, ...) have
+    // no immediates; like x87 register forms, they are named when printed.
+    if ((entry.flags & OpModRMSpecial) && (out.modrm >> 6) == 3) {
+        return pos;
+    }
+    const OpcodeEntry& member = groupOpcodeTable[entry.group][(out.modrm >> 3) & 0x07];
+    if (member.mnemonic == nullptr) {
+        return 0;
+    }
+    return decodeTail<Mode>(pos, member, out);
+}
+
+// 0F, 0F 38 and 0F 3A: one more indexed load, by the next opcode byte and
+// the mandatory prefix, then the handler of the entry found there.
+template <CpuMode Mode, OpcodeMap Map>
+size_t decodeEscape(const uint8_t* bytes, size_t pos, const OpcodeEntry&, DecodedInstruction& out) {
+    pos++;
+    out.opcode = static_cast<uint16_t>(Map << 8 | bytes[pos]);
+    const OpcodeEntry& entry = escapeOpcodeTable<Mode>[Map - Map0F][bytes[pos]][mandatoryPrefix(out.prefixes)];
+    return entry.handler(bytes, pos, entry, out);
+}
+
+// The mandatory prefix a VEX/EVEX pp field implies.
+static constexpr uint8_t vexImpliedPrefix[] = {0, PrefixOperandSize, PrefixRep, PrefixRepne};
+
+// C5 (two-byte VEX), C4 (three-byte VEX) and 62 (EVEX). The prefix packs
+// REX, the mandatory prefix, the opcode map and the new fields into two to
+// four bytes (its register bits stored inverted); it is unpacked into the
+// record so that the entry of the VEX or EVEX map is found, and its
+// operands decoded, exactly like a legacy escape-map instruction.
+template <CpuMode Mode, uint8_t Prefix>
+size_t decodeVex(const uint8_t* bytes, size_t pos, const OpcodeEntry& entry, DecodedInstruction& out) {
+    // Outside 64-bit mode these bytes are les, lds and bound unless the
+    // next byte has mod == 3, which those memory-only instructions cannot
+    // encode (and which VEX, by then, forces through its inverted R/X bits).
+    if constexpr (Mode != CpuMode::Bits64) {
+        if ((bytes[pos + 1] >> 6) != 3) {
+            return decodeOperands<Mode>(bytes, pos, entry, out);
+        }
+    }
+    // 66, F2, F3, lock or REX in front of VEX/EVEX are undefined.
+    if ((out.prefixes & (PrefixOperandSize | PrefixLock | PrefixRep | PrefixRepne)) || out.rex != 0) {
+        return 0;
+    }
+    uint8_t p0 = bytes[pos + 1];
+    unsigned map = Map0F;
+    unsigned rxb = (~p0 >> 5) & 0x04;  // R only, for C5
+    unsigned w = 0;
+    unsigned vvvv;
+    unsigned length;
+    unsigned pp;
+    uint8_t evex = 0;
+    if constexpr (Prefix == 0xC5) {
+        vvvv = (~p0 >> 3) & 0x0F;
+        length = (p0 >> 2) & 0x01;
+        pp = p0 & 0x03;
+        pos += 2;
+    } else {
+        uint8_t p1 = bytes[pos + 2];
+        rxb = (~p0 >> 5) & 0x07;
+        w = p1 >> 7;
+        vvvv = (~p1 >> 3) & 0x0F;
+        pp = p1 & 0x03;
+        if constexpr (Prefix == 0xC4) {
+            map = p0 & 0x1F;
+            length = (p1 >> 2) & 0x01;
+            pos += 3;
+        } else {
+            // EVEX: P0 bits 3-2 are zero and P1 bit 2 is one.
+            if ((p0 & 0x0C) != 0 || (p1 & 0x04) == 0) {
+                return 0;
+            }
+            uint8_t p2 = bytes[pos + 3];
+            map = p0 & 0x03;
+            length = (p2 >> 5) & 0x03;
+            evex = static_cast<uint8_t>((p2 & EvexMaskRegister) | ((p2 >> 7) << 3) | (p2 & EvexBroadcast) |
+                                        (((~p2 >> 3) & 0x01) << 5) | (((~p0 >> 4) & 0x01) << 6));
+            pos += 4;
+        }
+        if (map < Map0F || map > Map0F3A) {
+            return 0;
+        }
+    }
+    // Outside 64-bit mode only eight registers exist.
+    if constexpr (Mode != CpuMode::Bits64) {
+        rxb = 0;
+        vvvv &= 0x07;
+        evex &= ~(EvexHighVvvv | EvexHighReg);
+    }
+
+    out.rex = static_cast<uint8_t>(0x40 | w << 3 | rxb);
+    out.prefixes |= vexImpliedPrefix[pp];
+    out.vex = static_cast<uint8_t>(vvvv | length << VexLengthShift);
+    out.evex = evex;
+    out.flags |= Prefix == 0x62 ? InsnEvex : InsnVex;
+    out.opcode = static_cast<uint16_t>(map << 8 | bytes[pos]);
+    const auto& tables = Prefix == 0x62 ? evexOpcodeTable<Mode> : vexOpcodeTable<Mode>;
+    const OpcodeEntry& vexEntry = tables[map - Map0F][bytes[pos]][pp];
+    return vexEntry.handler(bytes, pos, vexEntry, out);
+}
+
+template size_t decodeOperands<CpuMode::Bits64>(const uint8_t*, size_t, const OpcodeEntry&, DecodedInstruction&);
+template size_t decodeOperands<CpuMode::Bits32>(const uint8_t*, size_t, const OpcodeEntry&, DecodedInstruction&);
+template size_t decodeOperands<CpuMode::Bits16>(const uint8_t*, size_t, const OpcodeEntry&, DecodedInstruction&);
+template size_t decodeGroup<CpuMode::Bits64>(const uint8_t*, size_t, const OpcodeEntry&, DecodedInstruction&);
+template size_t decodeGroup<CpuMode::Bits32>(const uint8_t*, size_t, const OpcodeEntry&, DecodedInstruction&);
+template size_t decodeGroup<CpuMode::Bits16>(const uint8_t*, size_t, const OpcodeEntry&, DecodedInstruction&);
+template size_t decodeEscape<CpuMode::Bits64, Map0F>(const uint8_t*, size_t, const OpcodeEntry&, DecodedInstruction&);
+template size_t decodeEscape<CpuMode::Bits64, Map0F38>(const uint8_t*, size_t, const OpcodeEntry&, DecodedInstruction&);
+template size_t decodeEscape<CpuMode::Bits64, Map0F3A>(const uint8_t*, size_t, const OpcodeEntry&, DecodedInstruction&);
+template size_t decodeEscape<CpuMode::Bits32, Map0F>(const uint8_t*, size_t, const OpcodeEntry&, DecodedInstruction&);
+template size_t decodeEscape<CpuMode::Bits32, Map0F38>(const uint8_t*, size_t, const OpcodeEntry&, DecodedInstruction&);
+template size_t decodeEscape<CpuMode::Bits32, Map0F3A>(const uint8_t*, size_t, const OpcodeEntry&, DecodedInstruction&);
+template size_t decodeEscape<CpuMode::Bits16, Map0F>(const uint8_t*, size_t, const OpcodeEntry&, DecodedInstruction&);
+template size_t decodeEscape<CpuMode::Bits16, Map0F38>(const uint8_t*, size_t, const OpcodeEntry&, DecodedInstruction&);
+template size_t decodeEscape<CpuMode::Bits16, Map0F3A>(const uint8_t*, size_t, const OpcodeEntry&, DecodedInstruction&);
+template size_t decodeVex<CpuMode::Bits64, 0x62>(const uint8_t*, size_t, const OpcodeEntry&, DecodedInstruction&);
+template size_t decodeVex<CpuMode::Bits64, 0xC4>(const uint8_t*, size_t, const OpcodeEntry&, DecodedInstruction&);
+template size_t decodeVex<CpuMode::Bits64, 0xC5>(const uint8_t*, size_t, const OpcodeEntry&, DecodedInstruction&);
+template size_t decodeVex<CpuMode::Bits32, 0x62>(const uint8_t*, size_t, const OpcodeEntry&, DecodedInstruction&);
+template size_t decodeVex<CpuMode::Bits32, 0xC4>(const uint8_t*, size_t, const OpcodeEntry&, DecodedInstruction&);
+template size_t decodeVex<CpuMode::Bits32, 0xC5>(const uint8_t*, size_t, const OpcodeEntry&, DecodedInstruction&);
+template size_t decodeVex<CpuMode::Bits16, 0x62>(const uint8_t*, size_t, const OpcodeEntry&, DecodedInstruction&);
+template size_t decodeVex<CpuMode::Bits16, 0xC4>(const uint8_t*, size_t, const OpcodeEntry&, DecodedInstruction&);
+template size_t decodeVex<CpuMode::Bits16, 0xC5>(const uint8_t*, size_t, const OpcodeEntry&, DecodedInstruction&);
+
+const OpcodeEntry& resolveOpcodeEntry(const DecodedInstruction& insn) {
+    // The 16- and 32-bit tables differ only in their handlers, so either
+    // describes a record of both modes.
+    bool is64 = instructionMode(insn) == CpuMode::Bits64;
+    uint8_t map = insn.opcode >> 8;
+    MandatoryPrefix prefix = mandatoryPrefix(insn.prefixes);
+    const std::array<EscapeOpcodeTable, 3>& escapeTables =
+        (insn.flags & InsnEvex) ? (is64 ? evexOpcodeTable<CpuMode::Bits64> : evexOpcodeTable<CpuMode::Bits32>)
+        : (insn.flags & InsnVex) ? (is64 ? vexOpcodeTable<CpuMode::Bits64> : vexOpcodeTable<CpuMode::Bits32>)
+        : (is64 ? escapeOpcodeTable<CpuMode::Bits64> : escapeOpcodeTable<CpuMode::Bits32>);
+    const OpcodeEntry& entry = map == MapPrimary
+        ? (is64 ? primaryOpcodeTable<CpuMode::Bits64> : primaryOpcodeTable<CpuMode::Bits32>)[insn.opcode]
+        : escapeTables[map - Map0F][insn.opcode & 0xFF][prefix];
+    uint8_t reg = (insn.modrm >> 3) & 0x07;
+    if ((entry.flags & OpModRMSpecial) && (insn.modrm >> 6) == 3) {
+        for (const EscapeSpecialEntry& special : escapeSpecialTable) {
+            if (special.opcode == insn.opcode && special.prefix == prefix && special.modrm == insn.modrm) {
+                return special.entry;
+            }
+        }
+    }
+    if (entry.group != GroupNone) {
+        const OpcodeEntry& member = groupOpcodeTable[entry.group][reg];
+        // The decoder accepted this register form because it might have
+        // been special; it was not.
+        if ((entry.flags & OpModRMSpecial) && (insn.modrm >> 6) == 3 && (member.flags & OpMemoryOnly)) {
+            return opcode_table_detail::invalidEntry;
+        }
+        return member;
+    }
+    if (entry.flags & OpX87) {
+        int row = (insn.opcode & 0xFF) - 0xD8;
+        if ((insn.modrm >> 6) != 3) {
+            return x87MemoryTable[row][reg];
+        }
+        for (const X87SpecialEntry& special : x87SpecialTable) {
+            if (special.opcode == insn.opcode && special.modrm == insn.modrm) {
+                return special.entry;
+            }
+        }
+        return x87RegisterTable[row][reg];
+    }
+    return entry;
+}
+
+// Decodes one instruction from bytes, which must have at least
+// maxInstructionLength readable bytes. Returns the instruction length, or 0
+// for an invalid encoding.
+template <CpuMode Mode>
+static size_t decodeOne(const uint8_t* bytes, DecodedInstruction& insn) {
+    // Prefix state machine: any number of legacy prefixes, then (in 64-bit
+    // mode) an optional REX byte that only counts if it immediately precedes
+    // the opcode. Elsewhere 40-4F are inc/dec and end the prefixes.
+    size_t pos = 0;
+    uint8_t prefixes = 0;
+    uint8_t rex = 0;
+    for (;;) {
+        uint8_t byte = bytes[pos];
+        uint8_t prefix = legacyPrefixTable[byte];
+        if (prefix != 0) {
+            if (prefix & PrefixSegmentMask) {
+                prefixes &= ~PrefixSegmentMask;
+            } else if (prefix & (PrefixRep | PrefixRepne)) {
+                prefixes &= ~(PrefixRep | PrefixRepne);  // The last of F2/F3 wins
+            }
+            prefixes |= prefix;
+            rex = 0;
+        } else if (Mode == CpuMode::Bits64 && (byte & 0xF0) == 0x40) {
+            rex = byte;
+        } else {
+            break;
+        }
+        if (++pos == maxInstructionLength) {
+            return 0;
+        }
+    }
+
+    insn.prefixes = prefixes;
+    insn.rex = rex;
+    insn.opcode = bytes[pos];
+
+    // One indexed load replaces a chain of opcode comparisons, so the cost
+    // per instruction does not grow as more opcodes are added.
+    const OpcodeEntry& entry = primaryOpcodeTable<Mode>[bytes[pos]];
+    size_t length = entry.handler(bytes, pos, entry, insn);
+    return length <= maxInstructionLength ? length : 0;
+}
+
+// Decodes the instruction at code[index] into insn. Undecodable bytes become
+// one-byte invalid records. Returns the length.
+template <CpuMode Mode>
+static size_t decodeRecord(const uint8_t* bytes, size_t index, size_t remaining, DecodedInstruction& insn) {
+    constexpr uint8_t modeFlags = static_cast<uint8_t>(Mode) << InsnModeShift;
+    insn = {};
+    insn.offset = static_cast<uint32_t>(index);
+    size_t length = decodeOne<Mode>(bytes, insn);
+    if (length == 0 || length > remaining) {
+        insn = {};
+        insn.offset = static_cast<uint32_t>(index);
+        insn.opcode = bytes[0];
+        insn.flags = InsnInvalid;
+        length = 1;
+    }
+    insn.flags |= modeFlags;
+    insn.length = static_cast<uint8_t>(length);
+    return length;
+}
+
+// Decodes the instruction at code[index] and appends its record to out.
+template <CpuMode Mode>
+static size_t decodeAt(const uint8_t* bytes, size_t index, size_t remaining, std::vector<DecodedInstruction>& out) {
+    DecodedInstruction insn;
+    size_t length = decodeRecord<Mode>(bytes, index, remaining, insn);
+    out.push_back(insn);
+    return length;
+}
+
+template <CpuMode Mode>
+static size_t decodeInstructionAtIn(std::span<const uint8_t> code, size_t offset, DecodedInstruction& insn) {
+    size_t remaining = code.size() - offset;
+    if (remaining >= maxInstructionLength) {
+        return decodeRecord<Mode>(code.data() + offset, offset, remaining, insn);
+    }
+    uint8_t window[maxInstructionLength] = {};
+    std::memcpy(window, code.data() + offset, remaining);
+    return decodeRecord<Mode>(window, offset, remaining, insn);
+}
+
+size_t decodeInstructionAt(std::span<const uint8_t> code, size_t offset, DecodedInstruction& insn, CpuMode mode) {
+    switch (mode) {
+        case CpuMode::Bits32: return decodeInstructionAtIn<CpuMode::Bits32>(code, offset, insn);
+        case CpuMode::Bits16: return decodeInstructionAtIn<CpuMode::Bits16>(code, offset, insn);
+        default: return decodeInstructionAtIn<CpuMode::Bits64>(code, offset, insn);
+    }
+}
+
+// Records of the one-byte instructions the byte classifier reports as
+// simple, decoded once per mode so they are copied rather than decoded;
+// only the offset differs from one copy to the next. The records of other
+// bytes are left empty (length 0).
+template <CpuMode Mode>
+static const std::array<DecodedInstruction, 256>& simpleInstructionRecords() {
+    static const std::array<DecodedInstruction, 256> records = [] {
+        ByteClassifier classify = byteClassifier(Mode, ByteClassifierKernel::Scalar);
+        std::array<DecodedInstruction, 256> table{};
+        for (int op = 0; op < 256; op++) {
+            uint8_t bytes[byteClassBlockSize];
+            std::memset(bytes, op, sizeof(bytes));
+            if (classify(bytes) & 1) {
+                decodeRecord<Mode>(bytes, 0, maxInstructionLength, table[op]);
+            }
+        }
+        return table;
+    }();
+    return records;
+}
+
+// The linear sweep loop, compiled separately for each mode.
+template <CpuMode Mode>
+static size_t decodeRangeIn(std::span<const uint8_t> code, size_t begin, size_t end,
+                            std::vector<DecodedInstruction>& out) {
+    // Most x86 instructions are 2-5 bytes long; reserving up front keeps the
+    // loop free of reallocations for typical code.
+    out.reserve(out.size() + (end - begin) / 3 + 1);
+
+    const uint8_t* data = code.data();
+    size_t size = code.size();
+    size_t i = begin;
+
+    // Fast path: with at least maxInstructionLength bytes left, no field of
+    // the next instruction can run past the buffer, so it is decoded in place.
+    // Simple one-byte instructions are copied from their precomputed records;
+    // where two of them follow each other, the byte classifier finds the end
+    // of the run (int3/nop padding, push/pop sequences) a block at a time.
+    ByteClassifier classify = byteClassifier(Mode, activeByteClassifierKernel());
+    const auto& simpleRecords = simpleInstructionRecords<Mode>();
+    while (i < end && size - i >= maxInstructionLength) {
+        if (simpleRecords[data[i]].length != 0) {
+            size_t run = 1;
+            if (simpleRecords[data[i + 1]].length != 0 && size - i >= byteClassBlockSize) {
+                run = std::min(static_cast<size_t>(std::countr_one(classify(data + i))), end - i);
+            }
+            for (size_t n = 0; n < run; n++, i++) {
+                DecodedInstruction insn = simpleRecords[data[i]];
+                insn.offset = static_cast<uint32_t>(i);
+                out.push_back(insn);
+            }
+            continue;
+        }
+        i += decodeAt<Mode>(data + i, i, size - i, out);
+    }
+
+    // Tail: decode from a zero-padded copy and reject instructions that would
+    // need bytes beyond the end of the buffer.
+    while (i < end && i < size) {
+        uint8_t window[maxInstructionLength] = {};
+        std::memcpy(window, data + i, size - i);
+        i += decodeAt<Mode>(window, i, size - i, out);
+    }
+    return i;
+}
+
+size_t decodeRange(std::span<const uint8_t> code, size_t begin, size_t end,
+                   std::vector<DecodedInstruction>& out, CpuMode mode) {
+    // The only mode test: once per call, not once per instruction.
+    switch (mode) {
+        case CpuMode::Bits32: return decodeRangeIn<CpuMode::Bits32>(code, begin, end, out);
+        case CpuMode::Bits16: return decodeRangeIn<CpuMode::Bits16>(code, begin, end, out);
+        default: return decodeRangeIn<CpuMode::Bits64>(code, begin, end, out);
+    }
+}
+
+void decodeInstructions(std::span<const uint8_t> code, std::vector<DecodedInstruction>& out, CpuMode mode) {
+    decodeRange(code, 0, code.size(), out, mode);
+}
+
+void disassemble(std::span<const uint8_t> code, uint64_t baseAddress, OutputWriter& out,
+                 const SymbolTable* symbols, CpuMode mode) {
+    std::vector<DecodedInstruction> instructions;
+    decodeInstructions(code, instructions, mode);
+    printInstructions(code, instructions, baseAddress, out, symbols);
+}
+
+void disassembleRange(std::span<const uint8_t> code, size_t begin, size_t end, uint64_t baseAddress,
+                      OutputWriter& out, const SymbolTable* symbols, CpuMode mode) {
+    std::vector<DecodedInstruction> instructions;
+    decodeRange(code, begin, std::min(end, code.size()), instructions, mode);
+    printInstructions(code, instructions, baseAddress, out, symbols);
+}
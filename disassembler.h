@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>  // For fixed-width integer types (uint8_t, uint32_t)
+#include <span>
+#include <vector>
+
+#include "decoded_instruction.h"
+#include "output_writer.h"
+
+class SymbolTable;
+
+// A helper function to read a 32-bit little-endian integer from a byte span.
+// We assume that the code span has enough bytes starting at index.
+uint32_t read32(std::span<const uint8_t> code, size_t index);
+
+// Decode phase: decodes code with linear sweep and appends one record per
+// instruction to out. No text is produced. Bytes that do not start a valid
+// instruction (including one truncated by the end of the buffer) become
+// one-byte invalid records, so the records always cover all of code.
+// Offsets are 32-bit, so code must be smaller than 4 GiB. mode is the
+// processor mode the code runs in; every record remembers it.
+void decodeInstructions(std::span<const uint8_t> code, std::vector<DecodedInstruction>& out,
+                        CpuMode mode = CpuMode::Bits64);
+
+// Decodes the instructions that start in [begin, end) of code, beginning with
+// one at begin, and appends their records (offsets relative to code) to out.
+// The last instruction may extend past end; bytes up to code.size() are used
+// exactly as decodeInstructions() would. Returns the offset just past the
+// last decoded instruction.
+size_t decodeRange(std::span<const uint8_t> code, size_t begin, size_t end,
+                   std::vector<DecodedInstruction>& out, CpuMode mode = CpuMode::Bits64);
+
+// Decodes the single instruction at code[offset] (offset < code.size())
+// into insn, exactly as decodeInstructions() would at that offset. Returns
+// its length. For analyses that hop between addresses, such as recursive
+// traversal.
+size_t decodeInstructionAt(std::span<const uint8_t> code, size_t offset, DecodedInstruction& insn,
+                           CpuMode mode = CpuMode::Bits64);
+
+// Formatting phase: writes the given records to out, one instruction per line.
+// code must be the same buffer the records were decoded from. With symbols,
+// a "<name>:" label precedes every instruction a symbol starts at, and
+// branch and rip-relative targets are followed by "<func+0x1f>". Register
+// and address sizes follow the mode each record was decoded in.
+void printInstructions(std::span<const uint8_t> code,
+                       std::span<const DecodedInstruction> instructions,
+                       uint64_t baseAddress,
+                       OutputWriter& out,
+                       const SymbolTable* symbols = nullptr);
+
+// Disassembles a buffer of code bytes: decodes the whole buffer, then prints
+// it. Bytes without a decoder are printed as "db" directives.
+void disassemble(std::span<const uint8_t> code, uint64_t baseAddress, OutputWriter& out,
+                 const SymbolTable* symbols = nullptr, CpuMode mode = CpuMode::Bits64);
+
+// Disassembles only the instructions that start in [begin, end) of code,
+// decoding from begin as if it were an instruction boundary. The rest of
+// the buffer is never touched, so looking at one function of a huge
+// section costs as much as that function. Addresses are still
+// baseAddress + offset into code.
+void disassembleRange(std::span<const uint8_t> code, size_t begin, size_t end, uint64_t baseAddress,
+                      OutputWriter& out, const SymbolTable* symbols = nullptr, CpuMode mode = CpuMode::Bits64);
+
+// Length-only decode: appends the length of each instruction in code to
+// lengths, using compact class tables instead of the full decoder. The
+// boundaries match decodeInstructions() exactly (invalid bytes have length
+// 1) but no operands or records are produced, which makes it the fast path
+// for hashing, gadget search and block splitting.
+void decodeLengths(std::span<const uint8_t> code, std::vector<uint8_t>& lengths, CpuMode mode = CpuMode::Bits64);
+
+// Writes one "address: length" line per instruction.
+void printLengths(std::span<const uint8_t> lengths, uint64_t baseAddress, OutputWriter& out);
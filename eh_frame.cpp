@@ -0,0 +1,218 @@
+#include "eh_frame.h"
+
+#include <cstddef>
+#include <unordered_map>
+
+namespace {
+
+// Sequential little-endian reader over a byte range that fails (instead of
+// reading past the end) once any read does not fit.
+class ByteReader {
+public:
+    // pointerSize is the width of an absolute (DW_EH_PE_absptr) pointer.
+    ByteReader(std::span<const uint8_t> data, size_t pos, size_t end, size_t pointerSize = 8)
+        : data_(data), pos_(pos), end_(end), pointerSize_(pointerSize) {}
+
+    bool ok() const { return ok_; }
+    size_t position() const { return pos_; }
+    void seek(size_t pos) {
+        ok_ = ok_ && pos <= end_;
+        pos_ = pos;
+    }
+
+    uint64_t fixed(size_t size) {
+        if (!ok_ || end_ - pos_ < size) {
+            ok_ = false;
+            return 0;
+        }
+        uint64_t value = 0;
+        for (size_t n = 0; n < size; n++) {
+            value |= static_cast<uint64_t>(data_[pos_ + n]) << (8 * n);
+        }
+        pos_ += size;
+        return value;
+    }
+
+    uint64_t uleb128() {
+        uint64_t value = 0;
+        for (int shift = 0; ok_; shift += 7) {
+            if (pos_ >= end_ || shift > 63) {
+                ok_ = false;
+                break;
+            }
+            uint8_t byte = data_[pos_++];
+            value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+            if ((byte & 0x80) == 0) {
+                break;
+            }
+        }
+        return value;
+    }
+
+    int64_t sleb128() {
+        int64_t value = 0;
+        int shift = 0;
+        uint8_t byte = 0;
+        do {
+            if (!ok_ || pos_ >= end_ || shift > 63) {
+                ok_ = false;
+                return 0;
+            }
+            byte = data_[pos_++];
+            value |= static_cast<int64_t>(byte & 0x7F) << shift;
+            shift += 7;
+        } while (byte & 0x80);
+        if (shift < 64 && (byte & 0x40)) {
+            value |= -(int64_t{1} << shift);
+        }
+        return value;
+    }
+
+    // A NUL-terminated string; returns its start.
+    const char* string() {
+        const char* start = reinterpret_cast<const char*>(data_.data() + pos_);
+        while (ok_ && pos_ < end_ && data_[pos_] != 0) {
+            pos_++;
+        }
+        if (pos_ >= end_) {
+            ok_ = false;
+            return "";
+        }
+        pos_++;
+        return start;
+    }
+
+    // A pointer in the given DW_EH_PE encoding. sectionAddress turns the
+    // field position into an address for pc-relative values.
+    uint64_t pointer(uint8_t encoding, uint64_t sectionAddress) {
+        uint64_t fieldAddress = sectionAddress + pos_;
+        uint64_t value;
+        switch (encoding & PeFormatMask) {
+            case PeAbsolute: value = fixed(pointerSize_); break;
+            case PeUleb128: value = uleb128(); break;
+            case PeUdata2: value = fixed(2); break;
+            case PeUdata4: value = fixed(4); break;
+            case PeUdata8: value = fixed(8); break;
+            case PeSleb128: value = static_cast<uint64_t>(sleb128()); break;
+            case PeSdata2: value = static_cast<uint64_t>(static_cast<int16_t>(fixed(2))); break;
+            case PeSdata4: value = static_cast<uint64_t>(static_cast<int32_t>(fixed(4))); break;
+            case PeSdata8: value = fixed(8); break;
+            default: ok_ = false; return 0;
+        }
+        if ((encoding & PeApplicationMask) == PePcRelative) {
+            value += fieldAddress;
+        }
+        return value;
+    }
+
+private:
+    std::span<const uint8_t> data_;
+    size_t pos_;
+    size_t end_;
+    size_t pointerSize_;
+    bool ok_ = true;
+};
+
+// What an FDE needs from its CIE.
+struct CieInfo {
+    uint8_t fdeEncoding = PeAbsolute;
+    bool hasAugmentationData = false;
+};
+
+// Parses the CIE whose body (after the length and id fields) is reader's
+// range. Returns false for unsupported or malformed CIEs.
+bool parseCie(ByteReader& reader, uint64_t sectionAddress, CieInfo& cie) {
+    uint8_t version = static_cast<uint8_t>(reader.fixed(1));
+    const char* augmentation = reader.string();
+    if (!reader.ok() || (version != 1 && version != 3)) {
+        return false;
+    }
+    if (augmentation[0] == 'e' && augmentation[1] == 'h') {
+        return false;  // Pre-GCC 3.0 "eh" augmentation; not seen on x86-64
+    }
+    reader.uleb128();  // Code alignment factor
+    reader.sleb128();  // Data alignment factor
+    if (version == 1) {
+        reader.fixed(1);  // Return address register
+    } else {
+        reader.uleb128();
+    }
+    if (augmentation[0] != 'z') {
+        return reader.ok();
+    }
+    cie.hasAugmentationData = true;
+    uint64_t length = reader.uleb128();
+    size_t end = reader.position() + length;
+    for (const char* c = augmentation + 1; *c != '\0' && reader.ok(); c++) {
+        switch (*c) {
+            case 'R':
+                cie.fdeEncoding = static_cast<uint8_t>(reader.fixed(1));
+                break;
+            case 'P': {
+                uint8_t encoding = static_cast<uint8_t>(reader.fixed(1));
+                reader.pointer(encoding & ~PeIndirect, sectionAddress);
+                break;
+            }
+            case 'L':
+                reader.fixed(1);
+                break;
+            case 'S':
+            case 'B':
+                break;
+            default:
+                // Unknown augmentation: the length lets us skip the rest.
+                reader.seek(end);
+                return reader.ok();
+        }
+    }
+    return reader.ok();
+}
+
+} // namespace
+
+bool parseEhFrame(std::span<const uint8_t> data, uint64_t address, size_t pointerSize, std::vector<FdeRange>& out) {
+    std::unordered_map<size_t, CieInfo> cies;
+    size_t pos = 0;
+    while (pos < data.size()) {
+        ByteReader header(data, pos, data.size());
+        uint64_t length = header.fixed(4);
+        if (!header.ok()) {
+            return false;
+        }
+        if (length == 0) {
+            break;  // Zero terminator
+        }
+        if (length == 0xFFFFFFFF) {
+            length = header.fixed(8);  // 64-bit DWARF extended length
+        }
+        size_t bodyStart = header.position();
+        if (!header.ok() || length > data.size() - bodyStart) {
+            return false;
+        }
+        size_t end = bodyStart + length;
+
+        ByteReader reader(data, bodyStart, end, pointerSize);
+        uint32_t id = static_cast<uint32_t>(reader.fixed(4));
+        if (id == 0) {
+            CieInfo cie;
+            if (parseCie(reader, address, cie)) {
+                cies[pos] = cie;
+            }
+        } else {
+            // The CIE pointer is the distance back from the id field.
+            size_t ciePos = bodyStart - id;
+            auto cie = id <= bodyStart ? cies.find(ciePos) : cies.end();
+            if (cie != cies.end() && cie->second.fdeEncoding != PeOmit) {
+                uint8_t encoding = cie->second.fdeEncoding;
+                uint64_t start = reader.pointer(encoding & ~PeIndirect, address);
+                // The range uses the same format but is never relative.
+                uint64_t range = reader.pointer(encoding & PeFormatMask, address);
+                if (reader.ok() && range != 0 && (encoding & PeIndirect) == 0) {
+                    out.push_back({start, start + range});
+                }
+            }
+        }
+        pos = end;
+    }
+    return true;
+}
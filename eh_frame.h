@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+// Address range of one function as described by a Frame Description Entry.
+struct FdeRange {
+    uint64_t start;  // pc_begin
+    uint64_t end;    // pc_begin + pc_range
+};
+
+// DWARF pointer encodings (DW_EH_PE_*) used by .eh_frame.
+enum PointerEncoding : uint8_t {
+    PeAbsolute = 0x00,   // Format: native pointer (8 bytes in ELF64, 4 in ELF32)
+    PeUleb128  = 0x01,
+    PeUdata2   = 0x02,
+    PeUdata4   = 0x03,
+    PeUdata8   = 0x04,
+    PeSleb128  = 0x09,
+    PeSdata2   = 0x0A,
+    PeSdata4   = 0x0B,
+    PeSdata8   = 0x0C,
+    PeFormatMask = 0x0F,
+    PePcRelative = 0x10, // Application: relative to the address of the field
+    PeApplicationMask = 0x70,
+    PeIndirect = 0x80,
+    PeOmit     = 0xFF,
+};
+
+// Walks the CIEs and FDEs of an .eh_frame section loaded at address and
+// appends the function range of every FDE to out. Every compiled function
+// with unwind info has one, so this finds functions even in stripped
+// binaries, with exact sizes. Parsing is bounds-checked throughout: a
+// malformed record ends the walk and the ranges found so far are kept.
+// Returns false if the walk ended early. pointerSize is the native pointer
+// size of the file (8 for ELF64, 4 for ELF32).
+bool parseEhFrame(std::span<const uint8_t> data, uint64_t address, size_t pointerSize, std::vector<FdeRange>& out);
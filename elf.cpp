@@ -0,0 +1,511 @@
+#include "elf.h"
+
+#include <algorithm>
+#include <cstring>
+
+// Function to check whether a file is an ELF file
+// It does this by checking the first 4 bytes of the file for the magic number
+bool isELF(std::span<const uint8_t> data) {
+    if (data.size() < 4) {
+        return false;
+    }
+    return (data[EI_MAG0] == ELFMAG0 &&
+            data[EI_MAG1] == ELFMAG1 &&
+            data[EI_MAG2] == ELFMAG2 &&
+            data[EI_MAG3] == ELFMAG3);
+}
+
+// Function to print the details from the ELF header
+// It distinguishes between 32-bit and 64-bit headers
+void printELFHeader(std::span<const uint8_t> data, OutputWriter& out) {
+    if (!isELF(data)) {
+        out << "Not an ELF file\n";
+        return;
+    }
+    // e_ident[EI_CLASS] indicates the class:
+    // 1 means ELF32; 2 means ELF64.
+    uint8_t elfClass = data[EI_CLASS];
+
+    if (elfClass == 1) { // ELF32
+        if (data.size() < sizeof(Elf32_Ehdr)) {
+            out << "File is too small to be a valid ELF32 file\n";
+            return;
+        }
+        const Elf32_Ehdr* hdr = reinterpret_cast<const Elf32_Ehdr*>(data.data());
+        out << "File is an ELF32 file\n";
+        out << "ELF32 Header:\n";
+        out << "Magic: ";
+        for (int i = 0; i < 4; i++) {
+            out.hex(hdr->e_ident[i]);
+            out << ' ';
+        }
+        out << '\n';
+
+        out << "Class: " << (hdr->e_ident[EI_CLASS] == 1 ? "ELF32" : "Unknown") << '\n';
+
+        // Data encoding: 1 = little endian, 2 = big endian
+        out << "Data: " << (hdr->e_ident[EI_DATA] == 1 ? "little endian" : "big endian") << '\n';
+
+        // ELF version
+        out << "Version: ";
+        out.dec(hdr->e_ident[EI_VERSION]);
+        out << '\n';
+
+        // OS/ABI identification
+        out << "OS/ABI: ";
+        out.dec(hdr->e_ident[EI_OSABI]);
+        out << '\n';
+
+        // Object file type (e.g., relocatable, executable, shared object, core file).
+        out << "Type: 0x";
+        out.hex(hdr->e_type);
+        out << '\n';
+
+        // Machine type (e.g., 0x03 for x86).
+        out << "Machine: 0x";
+        out.hex(hdr->e_machine);
+        out << '\n';
+
+        // Entry point address
+        out << "Entry: 0x";
+        out.hex(hdr->e_entry);
+        out << '\n';
+    } else if (elfClass == 2) { // ELF64
+        if (data.size() < sizeof(Elf64_Ehdr)) {
+            out << "File is too small to be a valid ELF64 file\n";
+            return;
+        }
+        const Elf64_Ehdr* hdr = reinterpret_cast<const Elf64_Ehdr*>(data.data());
+        out << "File is an ELF64 file\n";
+
+        // Print magic numbers.
+        out << "Magic: ";
+        for (int i = 0; i < 16; i++) {
+            out.hex(hdr->e_ident[i]);
+            out << ' ';
+        }
+        out << '\n';
+
+        // Print class information.
+        out << "Class: " << (elfClass == 2 ? "ELF64" : "Unknown") << '\n';
+
+        // Data encoding.
+        uint8_t dataEncoding = hdr->e_ident[EI_DATA];
+        out << "Data: " << (dataEncoding == 1 ? "Little Endian" : "Big Endian") << '\n';
+
+        // ELF version.
+        out << "Version: ";
+        out.dec(hdr->e_ident[EI_VERSION]);
+        out << '\n';
+
+        // OS/ABI.
+        out << "OS/ABI: ";
+        out.dec(hdr->e_ident[EI_OSABI]);
+        out << '\n';
+
+        // Object file type.
+        out << "Type: 0x";
+        out.hex(hdr->e_type);
+        out << '\n';
+
+        // Machine type.
+        out << "Machine: 0x";
+        out.hex(hdr->e_machine);
+        out << '\n';
+
+        // Entry point address.
+        out << "Entry point: 0x";
+        out.hex(hdr->e_entry);
+        out << '\n';
+    }
+    else {
+        out << "Unknown ELF class: ";
+        out.dec(elfClass);
+        out << '\n';
+    }
+}
+
+bool isELF64(std::span<const uint8_t> data) {
+    return isELF(data) && data.size() >= sizeof(Elf64_Ehdr) && data[EI_CLASS] == ELFCLASS64;
+}
+
+bool isELF32(std::span<const uint8_t> data) {
+    return isELF(data) && data.size() >= sizeof(Elf32_Ehdr) && data[EI_CLASS] == ELFCLASS32;
+}
+
+// FNV-1a over the section name; names are short, so this is cheaper than
+// anything fancier and spreads ".text", ".text.hot" etc. well enough.
+static uint32_t hashName(std::string_view name) {
+    uint32_t hash = 2166136261u;
+    for (char c : name) {
+        hash = (hash ^ static_cast<uint8_t>(c)) * 16777619u;
+    }
+    return hash;
+}
+
+// True if [offset, offset + size) lies inside a file of fileSize bytes,
+// written so that neither sum can overflow.
+static bool fitsInFile(uint64_t offset, uint64_t size, size_t fileSize) {
+    return offset <= fileSize && size <= fileSize - offset;
+}
+
+bool ElfView::parse(std::span<const uint8_t> file, OutputWriter& out) {
+    file_ = {};
+    sectionTable_ = {};
+    programTable_ = {};
+    sectionNames_ = {};
+    declaresSections_ = false;
+    declaresSegments_ = false;
+
+    if (!isELF64(file) && !isELF32(file)) {
+        out << "Not a complete ELF32 or ELF64 header\n";
+        return false;
+    }
+    // The tables are read in host byte order, which is little endian on
+    // every machine this decoder targets.
+    if (file[EI_DATA] != 1) {
+        out << "Unsupported ELF data encoding (only little endian is supported)\n";
+        return false;
+    }
+    file_ = file;
+    is64_ = file[EI_CLASS] == ELFCLASS64;
+    if (is64_) {
+        parseTables<Elf64Types>(out);
+    } else {
+        parseTables<Elf32Types>(out);
+    }
+    return true;
+}
+
+template <typename Types>
+void ElfView::parseTables(OutputWriter& out) {
+    using Shdr = typename Types::Shdr;
+    using Phdr = typename Types::Phdr;
+    const typename Types::Ehdr* header = reinterpret_cast<const typename Types::Ehdr*>(file_.data());
+    entry_ = header->e_entry;
+    // i386 code runs in 32-bit mode; x86-64 code (and anything unknown,
+    // which is decoded as the common case) in 64-bit mode.
+    mode_ = header->e_machine == EM_386 ? CpuMode::Bits32 : CpuMode::Bits64;
+
+    // The section header table and its string table. e_shoff or e_shnum of
+    // zero simply means there is none (a stripped or packed sample).
+    declaresSections_ = header->e_shoff != 0 && header->e_shnum != 0;
+    if (declaresSections_) {
+        uint64_t tableSize = uint64_t{header->e_shnum} * sizeof(Shdr);
+        if (header->e_shentsize != sizeof(Shdr) || !fitsInFile(header->e_shoff, tableSize, file_.size())) {
+            out << "Section header table exceeds file size\n";
+        } else if (header->e_shstrndx >= header->e_shnum) {
+            out << "Invalid section string table index\n";
+        } else {
+            std::span<const uint8_t> table = file_.subspan(header->e_shoff, tableSize);
+            const Shdr& names = elfRecords<Shdr>(table)[header->e_shstrndx];
+            if (!fitsInFile(names.sh_offset, names.sh_size, file_.size())) {
+                out << "Section string table exceeds file size\n";
+            } else {
+                sectionTable_ = table;
+                sectionNames_ = {reinterpret_cast<const char*>(file_.data() + names.sh_offset),
+                                 static_cast<size_t>(names.sh_size)};
+            }
+        }
+    }
+
+    declaresSegments_ = header->e_phoff != 0 && header->e_phnum != 0;
+    if (declaresSegments_) {
+        uint64_t tableSize = uint64_t{header->e_phnum} * sizeof(Phdr);
+        if (header->e_phentsize != sizeof(Phdr) || !fitsInFile(header->e_phoff, tableSize, file_.size())) {
+            out << "Program header table exceeds file size\n";
+        } else {
+            programTable_ = file_.subspan(header->e_phoff, tableSize);
+        }
+    }
+}
+
+std::string_view ElfView::sectionName(uint32_t nameOffset) const {
+    if (nameOffset >= sectionNames_.size()) {
+        return {};
+    }
+    std::string_view rest = sectionNames_.substr(nameOffset);
+    size_t length = rest.find('\0');
+    return length == std::string_view::npos ? std::string_view() : rest.substr(0, length);
+}
+
+// Converts the validated section headers of one ELF class to ElfSections.
+template <typename Types>
+static void readSections(const ElfView& elf, std::vector<ElfSection>& sections) {
+    std::span<const typename Types::Shdr> sectionHeaders = elf.sectionHeaders<Types>();
+    sections.resize(sectionHeaders.size());
+    for (size_t i = 0; i < sectionHeaders.size(); i++) {
+        const typename Types::Shdr& sh = sectionHeaders[i];
+        ElfSection& section = sections[i];
+        section.name = elf.sectionName(sh.sh_name);
+        section.index = static_cast<uint16_t>(i);
+        section.type = sh.sh_type;
+        section.flags = sh.sh_flags;
+        section.address = sh.sh_addr;
+        section.offset = sh.sh_offset;
+        section.size = sh.sh_size;
+        section.link = sh.sh_link;
+        section.info = sh.sh_info;
+        section.entrySize = sh.sh_entsize;
+        section.inFile = sh.sh_type != SHT_NOBITS && fitsInFile(sh.sh_offset, sh.sh_size, elf.bytes().size());
+    }
+}
+
+bool ElfSectionTable::load(const ElfView& elf, OutputWriter& out) {
+    sections_.clear();
+    buckets_.clear();
+
+    if (!elf.hasSectionHeaders()) {
+        // A table that exists but was rejected has already been reported.
+        if (!elf.declaresSectionHeaders()) {
+            out << "No section header table found\n";
+        }
+        return false;
+    }
+    is64_ = elf.is64();
+    if (is64_) {
+        readSections<Elf64Types>(elf, sections_);
+    } else {
+        readSections<Elf32Types>(elf, sections_);
+    }
+    size_t sectionCount = sections_.size();
+
+    // Open addressing with linear probing at a load factor of at most 1/2.
+    size_t bucketCount = 16;
+    while (bucketCount < size_t{sectionCount} * 2) {
+        bucketCount *= 2;
+    }
+    buckets_.assign(bucketCount, 0);
+    for (uint32_t i = 0; i < sectionCount; i++) {
+        size_t bucket = hashName(sections_[i].name) & (bucketCount - 1);
+        for (;;) {
+            if (buckets_[bucket] == 0) {
+                buckets_[bucket] = i + 1;
+                break;
+            }
+            if (sections_[buckets_[bucket] - 1].name == sections_[i].name) {
+                break;  // Keep the first section of a given name
+            }
+            bucket = (bucket + 1) & (bucketCount - 1);
+        }
+    }
+    return true;
+}
+
+const ElfSection* ElfSectionTable::find(std::string_view name) const {
+    if (buckets_.empty()) {
+        return nullptr;
+    }
+    size_t mask = buckets_.size() - 1;
+    for (size_t bucket = hashName(name) & mask; buckets_[bucket] != 0; bucket = (bucket + 1) & mask) {
+        const ElfSection& section = sections_[buckets_[bucket] - 1];
+        if (section.name == name) {
+            return &section;
+        }
+    }
+    return nullptr;
+}
+
+// Converts the validated program headers of one ELF class to ElfSegments.
+template <typename Types>
+static void readSegments(const ElfView& elf, std::vector<ElfSegment>& segments) {
+    std::span<const typename Types::Phdr> programHeaders = elf.programHeaders<Types>();
+    segments.resize(programHeaders.size());
+    for (size_t i = 0; i < programHeaders.size(); i++) {
+        const typename Types::Phdr& ph = programHeaders[i];
+        ElfSegment& segment = segments[i];
+        segment.index = static_cast<uint16_t>(i);
+        segment.type = ph.p_type;
+        segment.flags = ph.p_flags;
+        segment.offset = ph.p_offset;
+        segment.address = ph.p_vaddr;
+        segment.fileSize = ph.p_filesz;
+        // The file image of a segment never extends past its memory image.
+        segment.memorySize = std::max(ph.p_memsz, ph.p_filesz);
+        segment.inFile = fitsInFile(ph.p_offset, ph.p_filesz, elf.bytes().size());
+    }
+}
+
+bool ElfSegmentMap::load(const ElfView& elf, OutputWriter& out) {
+    segments_.clear();
+    loadSegments_.clear();
+
+    if (!elf.hasProgramHeaders()) {
+        if (!elf.declaresProgramHeaders()) {
+            out << "No program header table found\n";
+        }
+        return false;
+    }
+    if (elf.is64()) {
+        readSegments<Elf64Types>(elf, segments_);
+    } else {
+        readSegments<Elf32Types>(elf, segments_);
+    }
+
+    for (const ElfSegment& segment : segments_) {
+        if (segment.type == PT_LOAD) {
+            loadSegments_.push_back(&segment);
+        }
+    }
+    std::sort(loadSegments_.begin(), loadSegments_.end(), [](const ElfSegment* a, const ElfSegment* b) {
+        return a->address < b->address;
+    });
+    return true;
+}
+
+const ElfSegment* ElfSegmentMap::findSegment(uint64_t va) const {
+    // Last segment starting at or below va; PT_LOAD segments do not overlap.
+    auto it = std::upper_bound(loadSegments_.begin(), loadSegments_.end(), va,
+        [](uint64_t address, const ElfSegment* segment) { return address < segment->address; });
+    if (it == loadSegments_.begin()) {
+        return nullptr;
+    }
+    const ElfSegment* segment = *(it - 1);
+    return segment->contains(va) ? segment : nullptr;
+}
+
+std::span<const uint8_t> ElfSegmentMap::bytesAt(std::span<const uint8_t> file, uint64_t va) const {
+    const ElfSegment* segment = findSegment(va);
+    if (segment == nullptr || !segment->inFile || va - segment->address >= segment->fileSize) {
+        return {};
+    }
+    return segment->contents(file).subspan(va - segment->address);
+}
+
+bool findCodeRegions(const ElfView& elf, const ElfSectionTable* sectionTable,
+                     std::vector<CodeRegion>& regions, OutputWriter& out) {
+    regions.clear();
+    std::span<const uint8_t> file = elf.bytes();
+
+    if (sectionTable != nullptr) {
+        for (const ElfSection& section : sectionTable->sections()) {
+            if (section.isExecutable() && section.size != 0) {
+                regions.push_back({std::string(section.name), "section", section.offset, section.address,
+                                   section.contents(file), elf.mode()});
+            }
+        }
+        if (!regions.empty()) {
+            return true;
+        }
+        out << "No executable sections found\n";
+    }
+
+    // No usable section headers: fall back to what the loader maps.
+    out << "Falling back to executable PT_LOAD segments\n";
+    ElfSegmentMap segmentMap;
+    if (!segmentMap.load(elf, out)) {
+        return false;
+    }
+    uint64_t entry = elf.entry();
+    for (const ElfSegment& segment : segmentMap.segments()) {
+        if (!segment.isExecutable() || segment.fileSize == 0) {
+            continue;
+        }
+        std::string name = "LOAD#" + std::to_string(segment.index);
+        std::span<const uint8_t> bytes = segment.contents(file);
+        uint64_t split = segment.fileSize;
+        if (segment.contains(entry) && entry - segment.address < segment.fileSize) {
+            split = entry - segment.address;
+        }
+        // The sweep restarts at the entry point so that it is decoded from a
+        // true instruction boundary whatever precedes it in the segment.
+        if (split != 0) {
+            regions.push_back({name, "segment", segment.offset, segment.address, bytes.first(split), elf.mode()});
+        }
+        if (split != segment.fileSize) {
+            regions.push_back({name, "segment from entry point", segment.offset + split,
+                               segment.address + split, bytes.subspan(split), elf.mode()});
+        }
+    }
+    if (regions.empty()) {
+        out << "No executable segments found\n";
+        return false;
+    }
+    return true;
+}
+
+void AddressMap::build(const ElfSegmentMap* segments, const ElfSectionTable* sectionTable) {
+    byAddress_.clear();
+    if (segments != nullptr) {
+        for (const ElfSegment& segment : segments->segments()) {
+            if (segment.type == PT_LOAD && segment.inFile && segment.fileSize != 0) {
+                byAddress_.push_back({segment.address, segment.offset, segment.fileSize});
+            }
+        }
+    }
+    if (byAddress_.empty() && sectionTable != nullptr) {
+        for (const ElfSection& section : sectionTable->sections()) {
+            if ((section.flags & SHF_ALLOC) && section.type != SHT_NOBITS && section.inFile && section.size != 0) {
+                byAddress_.push_back({section.address, section.offset, section.size});
+            }
+        }
+    }
+    std::sort(byAddress_.begin(), byAddress_.end(),
+        [](const AddressInterval& a, const AddressInterval& b) { return a.address < b.address; });
+    byOffset_ = byAddress_;
+    std::sort(byOffset_.begin(), byOffset_.end(),
+        [](const AddressInterval& a, const AddressInterval& b) { return a.offset < b.offset; });
+}
+
+bool AddressMap::toFileOffset(uint64_t address, uint64_t& offset) const {
+    // Last interval starting at or below address.
+    auto it = std::upper_bound(byAddress_.begin(), byAddress_.end(), address,
+        [](uint64_t value, const AddressInterval& interval) { return value < interval.address; });
+    if (it == byAddress_.begin() || address - (it - 1)->address >= (it - 1)->size) {
+        return false;
+    }
+    offset = (it - 1)->offset + (address - (it - 1)->address);
+    return true;
+}
+
+bool AddressMap::toAddress(uint64_t offset, uint64_t& address) const {
+    auto it = std::upper_bound(byOffset_.begin(), byOffset_.end(), offset,
+        [](uint64_t value, const AddressInterval& interval) { return value < interval.offset; });
+    if (it == byOffset_.begin() || offset - (it - 1)->offset >= (it - 1)->size) {
+        return false;
+    }
+    address = (it - 1)->address + (offset - (it - 1)->offset);
+    return true;
+}
+
+std::span<const uint8_t> findBuildId(std::span<const uint8_t> file, const ElfSectionTable& sectionTable) {
+    for (const ElfSection& section : sectionTable.sections()) {
+        if (section.type != SHT_NOTE) {
+            continue;
+        }
+        // Each note: namesz, descsz, type, then name and descriptor, each
+        // padded to 4 bytes.
+        std::span<const uint8_t> notes = section.contents(file);
+        size_t pos = 0;
+        while (notes.size() - pos >= 12) {
+            uint32_t nameSize, descSize, type;
+            std::memcpy(&nameSize, notes.data() + pos, 4);
+            std::memcpy(&descSize, notes.data() + pos + 4, 4);
+            std::memcpy(&type, notes.data() + pos + 8, 4);
+            size_t name = pos + 12;
+            size_t desc = name + ((static_cast<size_t>(nameSize) + 3) & ~size_t{3});
+            size_t next = desc + ((static_cast<size_t>(descSize) + 3) & ~size_t{3});
+            if (desc > notes.size() || next > notes.size()) {
+                break;
+            }
+            if (type == NT_GNU_BUILD_ID && nameSize == 4 && std::memcmp(notes.data() + name, "GNU", 4) == 0 &&
+                descSize != 0) {
+                return notes.subspan(desc, descSize);
+            }
+            pos = next;
+        }
+    }
+    return {};
+}
+
+void printCodeRegions(std::span<const CodeRegion> regions, OutputWriter& out) {
+    for (const CodeRegion& region : regions) {
+        out << "Found " << region.name << ' ' << region.kind << " at offset 0x";
+        out.hex(region.offset);
+        out << " with size 0x";
+        out.hex(region.bytes.size());
+        out << " (address 0x";
+        out.hex(region.address);
+        out << ")\n";
+    }
+}
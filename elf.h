@@ -0,0 +1,436 @@
+#pragma once
+
+#include <cstdint>  // For fixed-width integer types (uint8_t, uint32_t)
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "decoded_instruction.h"
+#include "output_writer.h"
+
+// The ELF header is defined in a packed format, so we disable padding.
+#if defined(_MSC_VER)
+    #pragma pack(push, 1)
+#elif defined(__GNUC__)
+    #pragma pack(push, 1)
+#endif
+
+// Definition for 32-bit ELF header (Elf32_Ehdr)
+// This structure is based on the System V Application Binary Interface (ABI)
+// for the ELF format. For more details, see:
+//   - "System V Application Binary Interface, Edition 4"
+//   - The "ELF" specification (search for "ELF header" online).
+struct Elf32_Ehdr {
+    unsigned char e_ident[16]; // Magic number and other info
+    uint16_t e_type;           // Object file type
+    uint16_t e_machine;        // Architecture (e.g., EM_386)
+    uint32_t e_version;        // Object file version
+    uint32_t e_entry;          // Entry point virtual address
+    uint32_t e_phoff;          // Program header table file offset
+    uint32_t e_shoff;          // Section header table file offset
+    uint32_t e_flags;          // Processor-specific flags
+    uint16_t e_ehsize;         // ELF header size in bytes
+    uint16_t e_phentsize;      // Program header table entry size
+    uint16_t e_phnum;          // Program header table entry count
+    uint16_t e_shentsize;      // Section header table entry size
+    uint16_t e_shnum;          // Section header table entry count
+    uint16_t e_shstrndx;       // Section header string table index
+};
+
+// Definition for 64-bit ELF header (Elf64_Ehdr)
+struct Elf64_Ehdr {
+    unsigned char e_ident[16]; // Magic number and other info
+    uint16_t e_type;           // Object file type
+    uint16_t e_machine;        // Architecture (e.g., EM_X86_64)
+    uint32_t e_version;        // Object file version
+    uint64_t e_entry;          // Entry point virtual address
+    uint64_t e_phoff;          // Program header table file offset
+    uint64_t e_shoff;          // Section header table file offset
+    uint32_t e_flags;          // Processor-specific flags
+    uint16_t e_ehsize;         // ELF header size in bytes
+    uint16_t e_phentsize;      // Program header table entry size
+    uint16_t e_phnum;          // Program header table entry count
+    uint16_t e_shentsize;      // Section header table entry size
+    uint16_t e_shnum;          // Section header table entry count
+    uint16_t e_shstrndx;       // Section header string table index
+};
+
+// ELF64 Section Header structure.
+// Each section header describes a section (for example, the .text section contains code).
+struct Elf64_Shdr {
+    uint32_t sh_name;      // Offset into the section header string table for this section's name
+    uint32_t sh_type;      // Section type (e.g., SHT_PROGBITS)
+    uint64_t sh_flags;     // Section flags (e.g., executable, writable, etc.)
+    uint64_t sh_addr;      // Virtual address of the section in memory
+    uint64_t sh_offset;    // File offset where the section data begins
+    uint64_t sh_size;      // Size of the section in bytes
+    uint32_t sh_link;      // Section header table index link (meaning depends on section type)
+    uint32_t sh_info;      // Extra information (depends on section type)
+    uint64_t sh_addralign; // Alignment of the section in memory
+    uint64_t sh_entsize;   // Size of each entry if the section holds a table of fixed-size entries
+};
+
+// ELF64 Program Header structure.
+// Each program header describes a segment: a range of the file the loader
+// maps into memory (PT_LOAD) or other information needed at run time. Unlike
+// section headers, program headers cannot be stripped from an executable.
+struct Elf64_Phdr {
+    uint32_t p_type;   // Segment type (e.g., PT_LOAD)
+    uint32_t p_flags;  // Segment permissions (PF_X, PF_W, PF_R)
+    uint64_t p_offset; // File offset where the segment data begins
+    uint64_t p_vaddr;  // Virtual address of the segment in memory
+    uint64_t p_paddr;  // Physical address (unused on most systems)
+    uint64_t p_filesz; // Number of bytes of the segment present in the file
+    uint64_t p_memsz;  // Size of the segment in memory (>= p_filesz, the rest is zero-filled)
+    uint64_t p_align;  // Alignment of the segment in memory and in the file
+};
+
+// ELF64 Symbol table entry.
+// Entries of .symtab and .dynsym name functions and data objects; the
+// string table holding the names is the section referenced by sh_link.
+struct Elf64_Sym {
+    uint32_t st_name;  // Offset of the name in the associated string table
+    uint8_t st_info;   // Symbol type (low 4 bits) and binding (high 4 bits)
+    uint8_t st_other;  // Symbol visibility
+    uint16_t st_shndx; // Index of the section the symbol is defined in (SHN_UNDEF if imported)
+    uint64_t st_value; // Symbol address (in executables and shared objects)
+    uint64_t st_size;  // Size of the object or function in bytes, 0 if unknown
+};
+
+// ELF32 counterparts of the section header, program header and symbol
+// structures. The fields mean the same; addresses, offsets and sizes are
+// 32 bits wide, and the program header and symbol fields are reordered.
+struct Elf32_Shdr {
+    uint32_t sh_name;
+    uint32_t sh_type;
+    uint32_t sh_flags;
+    uint32_t sh_addr;
+    uint32_t sh_offset;
+    uint32_t sh_size;
+    uint32_t sh_link;
+    uint32_t sh_info;
+    uint32_t sh_addralign;
+    uint32_t sh_entsize;
+};
+
+struct Elf32_Phdr {
+    uint32_t p_type;
+    uint32_t p_offset;
+    uint32_t p_vaddr;
+    uint32_t p_paddr;
+    uint32_t p_filesz;
+    uint32_t p_memsz;
+    uint32_t p_flags;
+    uint32_t p_align;
+};
+
+struct Elf32_Sym {
+    uint32_t st_name;
+    uint32_t st_value;
+    uint32_t st_size;
+    uint8_t st_info;
+    uint8_t st_other;
+    uint16_t st_shndx;
+};
+
+// Restore the default packing of structure members
+#if defined(_MSC_VER) || defined(__GNUC__)
+    #pragma pack(pop)
+#endif
+
+// Constants for identifying ELF files via e_ident[]
+constexpr int EI_MAG0    = 0;  // File identification index 0
+constexpr int EI_MAG1    = 1;  // File identification index 1
+constexpr int EI_MAG2    = 2;  // File identification index 2
+constexpr int EI_MAG3    = 3;  // File identification index 3
+constexpr int EI_CLASS   = 4;  // File class: 1 = 32-bit, 2 = 64-bit
+constexpr int EI_DATA    = 5;  // Data encoding: 1 = little endian, 2 = big endian
+constexpr int EI_VERSION = 6;  // File version
+constexpr int EI_OSABI   = 7;  // Operating system/ABI identification
+
+// e_ident[EI_CLASS] values
+constexpr unsigned char ELFCLASS32 = 1;
+constexpr unsigned char ELFCLASS64 = 2;
+
+// e_machine values of the x86 family
+constexpr uint16_t EM_386    = 3;   // Intel 80386: 32-bit code
+constexpr uint16_t EM_X86_64 = 62;  // AMD x86-64: 64-bit code (also in ELF32 files, for the x32 ABI)
+
+// Expected magic numbers for ELF files
+constexpr unsigned char ELFMAG0 = 0x7f;
+constexpr unsigned char ELFMAG1 = 'E';
+constexpr unsigned char ELFMAG2 = 'L';
+constexpr unsigned char ELFMAG3 = 'F';
+
+// Section types and flags used by the section model
+constexpr uint32_t SHT_NOBITS    = 8;    // Occupies no space in the file (e.g. .bss)
+constexpr uint64_t SHF_ALLOC     = 0x2;  // Section occupies memory at run time
+constexpr uint64_t SHF_EXECINSTR = 0x4;  // Section contains executable instructions
+constexpr uint32_t SHT_NOTE      = 7;    // Vendor notes (.note.gnu.build-id, .note.ABI-tag, ...)
+constexpr uint32_t NT_GNU_BUILD_ID = 3;  // Note type of the linker-generated build ID
+
+// Symbol table section types, symbol types and bindings, special indices
+constexpr uint32_t SHT_SYMTAB  = 2;   // Full symbol table (.symtab, removed by strip)
+constexpr uint32_t SHT_DYNSYM  = 11;  // Dynamic linking symbols (.dynsym)
+constexpr uint8_t STT_NOTYPE   = 0;
+constexpr uint8_t STT_OBJECT   = 1;
+constexpr uint8_t STT_FUNC     = 2;
+constexpr uint8_t STB_LOCAL    = 0;
+constexpr uint8_t STB_GLOBAL   = 1;
+constexpr uint8_t STB_WEAK     = 2;
+constexpr uint16_t SHN_UNDEF   = 0;
+constexpr uint16_t SHN_LORESERVE = 0xff00;  // Start of the reserved indices (SHN_ABS, SHN_COMMON, ...)
+
+// Segment types and flags used by the segment model
+constexpr uint32_t PT_LOAD = 1;  // Loadable segment
+constexpr uint32_t PF_X    = 0x1;  // Segment is executable
+
+// Function to check whether a file is an ELF file
+// It does this by checking the first 4 bytes of the file for the magic number
+bool isELF(std::span<const uint8_t> data);
+
+// Function to print the details from the ELF header
+// It distinguishes between 32-bit and 64-bit headers
+void printELFHeader(std::span<const uint8_t> data, OutputWriter& out);
+
+// Returns true if data is large enough to hold an ELF64 header and is marked
+// as ELF64, so that it can be viewed as an Elf64_Ehdr.
+bool isELF64(std::span<const uint8_t> data);
+
+// The same for ELF32 and Elf32_Ehdr.
+bool isELF32(std::span<const uint8_t> data);
+
+// The record types of one ELF class, so table walkers are written once as
+// templates and instantiated for both.
+struct Elf64Types {
+    using Ehdr = Elf64_Ehdr;
+    using Shdr = Elf64_Shdr;
+    using Phdr = Elf64_Phdr;
+    using Sym = Elf64_Sym;
+};
+
+struct Elf32Types {
+    using Ehdr = Elf32_Ehdr;
+    using Shdr = Elf32_Shdr;
+    using Phdr = Elf32_Phdr;
+    using Sym = Elf32_Sym;
+};
+
+// Views bytes as an array of the ELF record type T; a trailing partial record
+// is dropped. The records are packed, so they may start at any address.
+template <typename T>
+std::span<const T> elfRecords(std::span<const uint8_t> bytes) {
+    return {reinterpret_cast<const T*>(bytes.data()), bytes.size() / sizeof(T)};
+}
+
+// A validated, zero-copy view of an ELF32 or ELF64 file. parse() checks the
+// header, the section header table with its string table and the program
+// header table against the file once; afterwards the accessors hand out
+// views into the file that callers can index without any further checks, and
+// nothing is allocated. A table that is malformed (truncated, wrong entry
+// size, string table index out of range) is reported and treated as absent,
+// so a corrupt sample degrades to whatever is still usable instead of being
+// read out of bounds.
+class ElfView {
+public:
+    // Returns false (after printing the reason to out) if file is not a
+    // little-endian ELF32 or ELF64 file with a complete header.
+    bool parse(std::span<const uint8_t> file, OutputWriter& out);
+
+    std::span<const uint8_t> bytes() const { return file_; }
+    bool is64() const { return is64_; }
+
+    // Processor mode of the code: 32-bit for i386 files, 64-bit for x86-64
+    // files of either class (x32 binaries are ELF32 but run 64-bit code).
+    CpuMode mode() const { return mode_; }
+    uint64_t entry() const { return entry_; }
+
+    // Whether the header declares a section / program header table at all;
+    // a declared table may still have been rejected by parse().
+    bool declaresSectionHeaders() const { return declaresSections_; }
+    bool declaresProgramHeaders() const { return declaresSegments_; }
+
+    // The tables as records of the file's class: Types is Elf64Types when
+    // is64(), Elf32Types otherwise. Empty if absent or rejected.
+    template <typename Types>
+    std::span<const typename Types::Shdr> sectionHeaders() const {
+        return elfRecords<typename Types::Shdr>(sectionTable_);
+    }
+    template <typename Types>
+    std::span<const typename Types::Phdr> programHeaders() const {
+        return elfRecords<typename Types::Phdr>(programTable_);
+    }
+    bool hasSectionHeaders() const { return !sectionTable_.empty(); }
+    bool hasProgramHeaders() const { return !programTable_.empty(); }
+
+    // The name at nameOffset (sh_name) in the section header string table;
+    // empty if it is not a terminated string inside it.
+    std::string_view sectionName(uint32_t nameOffset) const;
+
+private:
+    template <typename Types>
+    void parseTables(OutputWriter& out);
+
+    std::span<const uint8_t> file_;
+    bool is64_ = false;
+    CpuMode mode_ = CpuMode::Bits64;
+    uint64_t entry_ = 0;
+    bool declaresSections_ = false;
+    bool declaresSegments_ = false;
+    std::span<const uint8_t> sectionTable_;
+    std::span<const uint8_t> programTable_;
+    std::string_view sectionNames_;
+};
+
+// One entry of the section header table with its name resolved.
+struct ElfSection {
+    std::string_view name;  // Points into the mapped section header string table
+    uint16_t index = 0;     // Position in the section header table
+    uint32_t type = 0;
+    uint64_t flags = 0;
+    uint64_t address = 0;   // sh_addr: where the section lives when loaded
+    uint64_t offset = 0;
+    uint64_t size = 0;
+    uint32_t link = 0;
+    uint32_t info = 0;
+    uint64_t entrySize = 0;
+    bool inFile = false;    // [offset, offset + size) lies inside the file
+
+    bool isExecutable() const { return (flags & SHF_EXECINSTR) != 0 && inFile; }
+
+    // View of the section's bytes in file; empty unless inFile.
+    std::span<const uint8_t> contents(std::span<const uint8_t> file) const {
+        return inFile ? file.subspan(offset, size) : std::span<const uint8_t>();
+    }
+};
+
+// The section header table of an ELF file. Names are resolved and hashed
+// into an open-addressing index once on load, so lookups by name cost one
+// hash and a probe or two instead of a strcmp per section.
+class ElfSectionTable {
+public:
+    // Resolves the section header table elf validated. Returns false if the
+    // file has none (printing that to out) or it was rejected by parse().
+    bool load(const ElfView& elf, OutputWriter& out);
+
+    // Returns the first section called name, or nullptr.
+    const ElfSection* find(std::string_view name) const;
+
+    std::span<const ElfSection> sections() const { return sections_; }
+
+    // Whether the file is ELF64; symbol tables have the same class.
+    bool is64() const { return is64_; }
+
+private:
+    bool is64_ = true;
+    std::vector<ElfSection> sections_;
+    std::vector<uint32_t> buckets_;  // Section index + 1; 0 marks an empty bucket
+};
+
+// One entry of the program header table.
+struct ElfSegment {
+    uint16_t index = 0;       // Position in the program header table
+    uint32_t type = 0;
+    uint32_t flags = 0;
+    uint64_t offset = 0;
+    uint64_t address = 0;     // p_vaddr
+    uint64_t fileSize = 0;
+    uint64_t memorySize = 0;
+    bool inFile = false;      // [offset, offset + fileSize) lies inside the file
+
+    bool isExecutable() const { return type == PT_LOAD && (flags & PF_X) != 0 && inFile; }
+
+    bool contains(uint64_t va) const { return va >= address && va - address < memorySize; }
+
+    // View of the segment's file-backed bytes; empty unless inFile.
+    std::span<const uint8_t> contents(std::span<const uint8_t> file) const {
+        return inFile ? file.subspan(offset, fileSize) : std::span<const uint8_t>();
+    }
+};
+
+// The loaded view of an ELF file as described by its PT_LOAD segments.
+// Loadable segments are kept sorted by address so a virtual address is
+// resolved with a binary search. This is what the kernel itself uses, so it
+// works on stripped and packed binaries that carry no section headers.
+class ElfSegmentMap {
+public:
+    // Resolves the program header table elf validated. Returns false if the
+    // file has none (printing that to out) or it was rejected by parse().
+    bool load(const ElfView& elf, OutputWriter& out);
+
+    std::span<const ElfSegment> segments() const { return segments_; }
+
+    // Returns the PT_LOAD segment that maps va, or nullptr.
+    const ElfSegment* findSegment(uint64_t va) const;
+
+    // File bytes from va to the end of the file-backed part of its segment;
+    // empty if va is not backed by file bytes.
+    std::span<const uint8_t> bytesAt(std::span<const uint8_t> file, uint64_t va) const;
+
+private:
+    std::vector<ElfSegment> segments_;
+    std::vector<const ElfSegment*> loadSegments_;  // PT_LOAD entries sorted by address
+};
+
+// One run of file bytes that is mapped at a virtual address.
+struct AddressInterval {
+    uint64_t address;
+    uint64_t offset;
+    uint64_t size;
+};
+
+// Translates between virtual addresses and file offsets. The intervals are
+// the file-backed parts of the PT_LOAD segments (what the loader maps) or,
+// for files without any (relocatable objects), the allocated sections at
+// their sh_addr. They are kept in two sorted arrays, one by address and one
+// by offset, so either direction is one binary search.
+class AddressMap {
+public:
+    // segments and sectionTable may be nullptr when the file lacks them.
+    void build(const ElfSegmentMap* segments, const ElfSectionTable* sectionTable);
+
+    // File offset of the byte loaded at address. False if it is not backed
+    // by the file (unmapped, or .bss-style zero fill).
+    bool toFileOffset(uint64_t address, uint64_t& offset) const;
+
+    // Address at which the file byte at offset is loaded. False if it is
+    // not loaded (headers outside segments, symbol tables, debug info).
+    bool toAddress(uint64_t offset, uint64_t& address) const;
+
+    std::span<const AddressInterval> intervals() const { return byAddress_; }
+
+private:
+    std::vector<AddressInterval> byAddress_;
+    std::vector<AddressInterval> byOffset_;
+};
+
+// A run of executable bytes to disassemble, taken from a section or, for
+// binaries without section headers, from a PT_LOAD segment.
+struct CodeRegion {
+    std::string name;                // Section name, or "LOAD#<index>" for a segment
+    const char* kind = "section";    // "section", "segment" or "segment from entry point"
+    uint64_t offset = 0;             // File offset of the first byte
+    uint64_t address = 0;            // Virtual address of the first byte
+    std::span<const uint8_t> bytes;  // View into the file
+    CpuMode mode = CpuMode::Bits64;  // Processor mode to decode the bytes in
+};
+
+// Collects what to disassemble in an ELF file: every executable section,
+// or, when the file has no usable section headers (stripped or packed
+// samples), its executable PT_LOAD segments. The segment holding e_entry is
+// split there into two regions, so the sweep is guaranteed to decode the
+// entry point from a real instruction boundary. Prints the reason for any
+// fallback to out. Returns false if nothing executable was found. Every
+// region is tagged with elf.mode(). sectionTable is the file's loaded
+// section table, or nullptr if it has none.
+bool findCodeRegions(const ElfView& elf, const ElfSectionTable* sectionTable,
+                     std::vector<CodeRegion>& regions, OutputWriter& out);
+
+// Returns the descriptor of the NT_GNU_BUILD_ID note ("GNU" owner) found in
+// any SHT_NOTE section: the unique ID the linker stamps into each build.
+// Empty if there is none or the notes are malformed.
+std::span<const uint8_t> findBuildId(std::span<const uint8_t> file, const ElfSectionTable& sectionTable);
+
+// Prints one "Found <name> <kind> ..." line per region.
+void printCodeRegions(std::span<const CodeRegion> regions, OutputWriter& out);
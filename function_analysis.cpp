@@ -0,0 +1,194 @@
+#include "function_analysis.h"
+
+#include <algorithm>
+
+#include "control_flow_graph.h"
+#include "disassembler.h"
+#include "eh_frame.h"
+#include "symbol_table.h"
+#include "thread_pool.h"
+
+namespace {
+
+// Bytes of code one analysis task covers at least. Functions are small
+// (tens to hundreds of bytes), so one task per function would spend more
+// time in the pool than decoding.
+constexpr size_t functionBatchBytes = 64 << 10;
+
+// Index of the region containing address, or regions.size(). order holds
+// the region indices sorted by address.
+size_t findRegion(std::span<const CodeRegion> regions, std::span<const uint32_t> order, uint64_t address) {
+    auto it = std::upper_bound(order.begin(), order.end(), address,
+        [&](uint64_t value, uint32_t k) { return value < regions[k].address; });
+    if (it == order.begin()) {
+        return regions.size();
+    }
+    const CodeRegion& region = regions[*(it - 1)];
+    return address - region.address < region.bytes.size() ? *(it - 1) : regions.size();
+}
+
+// Decodes and graphs functions[first, last). records and graph are the
+// task's scratch, reused from one function to the next.
+void analyzeRange(std::span<const CodeRegion> regions, std::span<const FunctionInfo> functions,
+                  std::span<FunctionSummary> summaries, size_t first, size_t last) {
+    std::vector<DecodedInstruction> records;
+    ControlFlowGraph graph;
+    for (size_t i = first; i < last; i++) {
+        const FunctionInfo& function = functions[i];
+        const CodeRegion& region = regions[function.region];
+        records.clear();
+        decodeRange(region.bytes, function.start - region.address, function.end - region.address, records,
+                    region.mode);
+        graph.build(region.bytes, records);
+
+        FunctionSummary& summary = summaries[i];
+        summary.instructions = static_cast<uint32_t>(records.size());
+        summary.invalid = static_cast<uint32_t>(std::count_if(records.begin(), records.end(),
+            [](const DecodedInstruction& insn) { return (insn.flags & InsnInvalid) != 0; }));
+        summary.blocks = static_cast<uint32_t>(graph.blocks().size());
+        summary.edges = static_cast<uint32_t>(graph.edgeCount());
+    }
+}
+
+} // namespace
+
+void discoverFunctions(std::span<const uint8_t> file, const ElfSectionTable* sectionTable,
+                       const SymbolTable& symbols, std::span<const CodeRegion> regions,
+                       std::vector<FunctionInfo>& functions) {
+    functions.clear();
+    std::vector<uint32_t> order(regions.size());
+    for (size_t k = 0; k < order.size(); k++) {
+        order[k] = static_cast<uint32_t>(k);
+    }
+    std::sort(order.begin(), order.end(),
+        [&](uint32_t a, uint32_t b) { return regions[a].address < regions[b].address; });
+
+    // Candidates from both sources; end == 0 means the size is unknown.
+    auto addCandidate = [&](uint64_t start, uint64_t end, uint8_t source) {
+        size_t region = findRegion(regions, order, start);
+        if (region < regions.size()) {
+            functions.push_back({start, end, static_cast<uint32_t>(region), source});
+        }
+    };
+    for (const Symbol& symbol : symbols.symbols()) {
+        if (symbol.type == STT_FUNC) {
+            addCandidate(symbol.address, symbol.size != 0 ? symbol.address + symbol.size : 0, FromSymbol);
+        }
+    }
+    const ElfSection* ehFrame = sectionTable != nullptr ? sectionTable->find(".eh_frame") : nullptr;
+    if (ehFrame != nullptr) {
+        std::vector<FdeRange> fdes;
+        parseEhFrame(ehFrame->contents(file), ehFrame->address, sectionTable->is64() ? 8 : 4, fdes);
+        for (const FdeRange& fde : fdes) {
+            addCandidate(fde.start, fde.end, FromEhFrame);
+        }
+    }
+
+    // Merge candidates that share a start. FDEs sort after symbols at the
+    // same address, so their range overrides the symbol size.
+    std::sort(functions.begin(), functions.end(), [](const FunctionInfo& a, const FunctionInfo& b) {
+        return a.start != b.start ? a.start < b.start : a.sources < b.sources;
+    });
+    size_t kept = 0;
+    for (size_t i = 0; i < functions.size(); i++) {
+        if (kept != 0 && functions[kept - 1].start == functions[i].start) {
+            FunctionInfo& merged = functions[kept - 1];
+            merged.sources |= functions[i].sources;
+            if (functions[i].end != 0 && (functions[i].sources & FromEhFrame)) {
+                merged.end = functions[i].end;
+            } else if (merged.end == 0) {
+                merged.end = functions[i].end;
+            }
+        } else {
+            functions[kept++] = functions[i];
+        }
+    }
+    functions.resize(kept);
+
+    // Fill in unknown ends and clamp every range to its region.
+    for (size_t i = 0; i < functions.size(); i++) {
+        FunctionInfo& function = functions[i];
+        const CodeRegion& region = regions[function.region];
+        uint64_t regionEnd = region.address + region.bytes.size();
+        if (function.end == 0) {
+            function.end = i + 1 < functions.size() ? std::min(functions[i + 1].start, regionEnd) : regionEnd;
+        }
+        function.end = std::clamp(function.end, function.start, regionEnd);
+    }
+}
+
+void analyzeFunctions(std::span<const CodeRegion> regions, std::span<const FunctionInfo> functions,
+                      std::vector<FunctionSummary>& summaries, unsigned threads) {
+    summaries.assign(functions.size(), FunctionSummary{});
+    if (threads == 1) {
+        analyzeRange(regions, functions, summaries, 0, functions.size());
+        return;
+    }
+
+    // Each task writes only its own slots of summaries, so no locking is
+    // needed beyond the pool's.
+    WorkStealingPool pool(threads);
+    size_t first = 0;
+    size_t bytes = 0;
+    for (size_t i = 0; i < functions.size(); i++) {
+        bytes += functions[i].end - functions[i].start;
+        if (bytes >= functionBatchBytes || i + 1 == functions.size()) {
+            pool.submit([regions, functions, &summaries, first, last = i + 1] {
+                analyzeRange(regions, functions, summaries, first, last);
+            });
+            first = i + 1;
+            bytes = 0;
+        }
+    }
+    pool.wait();
+}
+
+void printFunctionSummaries(std::span<const FunctionInfo> functions, std::span<const FunctionSummary> summaries,
+                            const SymbolTable& symbols, OutputWriter& out) {
+    size_t fromSymbols = 0;
+    size_t fromEhFrame = 0;
+    for (const FunctionInfo& function : functions) {
+        fromSymbols += (function.sources & FromSymbol) != 0;
+        fromEhFrame += (function.sources & FromEhFrame) != 0;
+    }
+    out << "Found ";
+    out.dec(static_cast<uint64_t>(functions.size()));
+    out << " functions (";
+    out.dec(static_cast<uint64_t>(fromSymbols));
+    out << " from symbols, ";
+    out.dec(static_cast<uint64_t>(fromEhFrame));
+    out << " from .eh_frame)\n";
+
+    uint64_t lastAddress = 0;
+    for (const FunctionInfo& function : functions) {
+        lastAddress = std::max(lastAddress, function.end);
+    }
+    int digits = addressDigits(lastAddress);
+    for (size_t i = 0; i < functions.size(); i++) {
+        const FunctionInfo& function = functions[i];
+        const FunctionSummary& summary = summaries[i];
+        out.reserveLine();
+        out.hex(function.start, digits);
+        out << '-';
+        out.hex(function.end, digits);
+        const Symbol* symbol = symbols.lookup(function.start);
+        if (symbol != nullptr && symbol->address == function.start) {
+            out << " <" << symbol->name << '>';
+        }
+        out << ": ";
+        out.dec(summary.instructions);
+        out << " instructions, ";
+        out.dec(summary.blocks);
+        out << " blocks, ";
+        out.dec(summary.edges);
+        out << " edges";
+        if (summary.invalid != 0) {
+            out << ", ";
+            out.dec(summary.invalid);
+            out << " invalid";
+        }
+        out << ((function.sources & FromSymbol) ? " [symbol" : " [");
+        out << ((function.sources == (FromSymbol | FromEhFrame)) ? ", " : "");
+        out << ((function.sources & FromEhFrame) ? "eh_frame]\n" : "]\n");
+    }
+}
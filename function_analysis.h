@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "elf.h"
+#include "output_writer.h"
+
+class SymbolTable;
+
+// Where a function start came from; a function may have both.
+enum FunctionSource : uint8_t {
+    FromSymbol  = 1,  // An STT_FUNC symbol
+    FromEhFrame = 2,  // An .eh_frame FDE
+};
+
+// One function: an address range inside a code region.
+struct FunctionInfo {
+    uint64_t start = 0;
+    uint64_t end = 0;      // Exclusive
+    uint32_t region = 0;   // Index into the regions it was discovered in
+    uint8_t sources = 0;   // FunctionSource bits
+};
+
+// Per-function results of analyzeFunctions().
+struct FunctionSummary {
+    uint32_t instructions = 0;
+    uint32_t invalid = 0;  // Bytes that did not decode
+    uint32_t blocks = 0;
+    uint32_t edges = 0;
+};
+
+// Collects the functions of an ELF32 or ELF64 file into functions, sorted by
+// start address: every STT_FUNC symbol and every FDE in .eh_frame (which
+// stripped binaries keep for unwinding) whose start lies in one of regions.
+// Where both describe a function the FDE range wins, since it is exact;
+// otherwise the symbol size is used, and functions of unknown size run to
+// the next function or the end of their region. sectionTable may be
+// nullptr.
+void discoverFunctions(std::span<const uint8_t> file, const ElfSectionTable* sectionTable,
+                       const SymbolTable& symbols, std::span<const CodeRegion> regions,
+                       std::vector<FunctionInfo>& functions);
+
+// Decodes every function over its own byte range and builds its
+// control-flow graph, writing one summary per function to summaries. The
+// functions are independent, so they are spread over threads (0 = one per
+// hardware thread) as tasks on a work-stealing pool; each task takes a run
+// of neighbouring functions and reuses one record buffer and one graph for
+// all of them.
+void analyzeFunctions(std::span<const CodeRegion> regions, std::span<const FunctionInfo> functions,
+                      std::vector<FunctionSummary>& summaries, unsigned threads);
+
+// Writes a count line followed by one line per function: its range, name,
+// instruction, block and edge counts, and where it was found.
+void printFunctionSummaries(std::span<const FunctionInfo> functions, std::span<const FunctionSummary> summaries,
+                            const SymbolTable& symbols, OutputWriter& out);
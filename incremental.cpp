@@ -0,0 +1,101 @@
+#include "incremental.h"
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+#include "disassembler.h"
+#include "opcode_table.h"
+
+void findChangedRanges(std::span<const uint8_t> before, std::span<const uint8_t> after,
+                       std::vector<ByteRange>& changes) {
+    // Skip identical blocks with memcmp (vectorised by the C library) and
+    // only look at single bytes inside blocks that differ.
+    constexpr size_t blockSize = 64;
+    size_t size = std::min(before.size(), after.size());
+    for (size_t block = 0; block < size; block += blockSize) {
+        size_t end = std::min(block + blockSize, size);
+        if (std::memcmp(before.data() + block, after.data() + block, end - block) == 0) {
+            continue;
+        }
+        for (size_t i = block; i < end; i++) {
+            if (before[i] == after[i]) {
+                continue;
+            }
+            if (!changes.empty() && changes.back().end == i) {
+                changes.back().end = i + 1;
+            } else {
+                changes.push_back({i, i + 1});
+            }
+        }
+    }
+}
+
+void redecodeChanges(std::span<const uint8_t> code, std::span<const DecodedInstruction> instructions,
+                     std::span<const ByteRange> changes, std::vector<PatchWindow>& windows, CpuMode mode) {
+    size_t next = 0;
+    while (next < changes.size()) {
+        // Restart at the old instruction that contains the first changed
+        // byte: the one before the first record starting past it.
+        size_t begin = changes[next].begin;
+        auto it = std::upper_bound(instructions.begin(), instructions.end(), begin,
+            [](size_t value, const DecodedInstruction& insn) { return value < insn.offset; });
+        size_t first = it == instructions.begin() ? 0 : static_cast<size_t>(it - instructions.begin()) - 1;
+        // An invalid byte only became a one-byte record after the decoder
+        // looked at up to maxInstructionLength bytes from it, so a change
+        // that close may turn it (and what follows) into a real instruction.
+        for (size_t k = first; k > 0 && instructions[k - 1].offset + maxInstructionLength > begin; k--) {
+            if (instructions[k - 1].flags & InsnInvalid) {
+                first = k - 1;
+            }
+        }
+        size_t position = first < instructions.size() ? instructions[first].offset : begin;
+
+        PatchWindow window{first, 0, {}};
+        size_t dirtyEnd = changes[next].end;
+        size_t old = first;  // First old record not yet known to be replaced
+        while (position < code.size()) {
+            // Changes the re-decoded stream runs into, or that are close
+            // enough to reach back into it through invalid records, join
+            // this window.
+            while (next < changes.size() &&
+                   changes[next].begin < std::max(position, dirtyEnd) + maxInstructionLength) {
+                dirtyEnd = std::max(dirtyEnd, changes[next].end);
+                next++;
+            }
+            // Past the patch and back on an old boundary: resynchronised.
+            while (old < instructions.size() && instructions[old].offset < position) {
+                old++;
+            }
+            if (position >= dirtyEnd && old < instructions.size() && instructions[old].offset == position) {
+                break;
+            }
+            DecodedInstruction insn;
+            position += decodeInstructionAt(code, position, insn, mode);
+            window.records.push_back(insn);
+        }
+        if (position >= code.size()) {
+            old = instructions.size();
+            next = changes.size();
+        }
+        window.oldCount = old - first;
+        windows.push_back(std::move(window));
+    }
+}
+
+void applyPatchWindows(std::vector<DecodedInstruction>& instructions, std::span<const PatchWindow> windows) {
+    // Back to front, so the indices of the windows still to apply stay valid.
+    for (size_t w = windows.size(); w-- > 0;) {
+        const PatchWindow& window = windows[w];
+        auto first = instructions.begin() + static_cast<ptrdiff_t>(window.first);
+        size_t common = std::min(window.oldCount, window.records.size());
+        std::copy_n(window.records.begin(), common, first);
+        if (window.records.size() > common) {
+            instructions.insert(first + static_cast<ptrdiff_t>(common), window.records.begin() + common,
+                                window.records.end());
+        } else {
+            instructions.erase(first + static_cast<ptrdiff_t>(common),
+                               first + static_cast<ptrdiff_t>(window.oldCount));
+        }
+    }
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "decoded_instruction.h"
+
+// A half-open range of byte offsets [begin, end).
+struct ByteRange {
+    size_t begin;
+    size_t end;
+};
+
+// One stretch of a linear sweep that a patch changed: records
+// [first, first + oldCount) of the previous decode are replaced by records.
+struct PatchWindow {
+    size_t first;
+    size_t oldCount;
+    std::vector<DecodedInstruction> records;
+};
+
+// Appends the ranges where before and after (two versions of the same
+// bytes, of equal size) differ to changes, in ascending order.
+void findChangedRanges(std::span<const uint8_t> before, std::span<const uint8_t> after,
+                       std::vector<ByteRange>& changes);
+
+// Works out how the linear sweep instructions (decodeInstructions() of the
+// previous bytes) changes after the bytes in changes (sorted, as from
+// findChangedRanges()) were patched to give code. Decoding restarts at the
+// instruction that holds the first changed byte (or a little earlier, if it
+// follows invalid bytes whose decode looked at the changed bytes), since
+// everything before it still decodes the same, and continues past the last
+// changed byte until it lands on a boundary of the old stream again, from
+// where the old records are still valid. x86 resynchronises within a few
+// instructions, so the work is proportional to the patch, not to the code.
+// Changes less than an instruction length apart are folded into one window.
+// Appends the windows in ascending order to windows. mode must be the one
+// instructions were decoded in.
+void redecodeChanges(std::span<const uint8_t> code, std::span<const DecodedInstruction> instructions,
+                     std::span<const ByteRange> changes, std::vector<PatchWindow>& windows,
+                     CpuMode mode = CpuMode::Bits64);
+
+// Splices windows into instructions, which then equal decodeInstructions()
+// of the patched code.
+void applyPatchWindows(std::vector<DecodedInstruction>& instructions, std::span<const PatchWindow> windows);
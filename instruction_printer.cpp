@@ -0,0 +1,745 @@
+#include "disassembler.h"
+
+#include <string_view>
+
+#include "control_flow.h"
+#include "opcode_table.h"
+#include "symbol_table.h"
+
+static const char* const reg64Names[] = {"rax", "rcx", "rdx", "rbx", "rsp", "rbp", "rsi", "rdi",
+                                         "r8", "r9", "r10", "r11", "r12", "r13", "r14", "r15"};
+static const char* const reg32Names[] = {"eax", "ecx", "edx", "ebx", "esp", "ebp", "esi", "edi",
+                                         "r8d", "r9d", "r10d", "r11d", "r12d", "r13d", "r14d", "r15d"};
+static const char* const reg16Names[] = {"ax", "cx", "dx", "bx", "sp", "bp", "si", "di",
+                                         "r8w", "r9w", "r10w", "r11w", "r12w", "r13w", "r14w", "r15w"};
+static const char* const reg8Names[] = {"al", "cl", "dl", "bl", "spl", "bpl", "sil", "dil",
+                                        "r8b", "r9b", "r10b", "r11b", "r12b", "r13b", "r14b", "r15b"};
+// Without a REX prefix, byte registers 4-7 are the legacy high-byte registers.
+static const char* const reg8LegacyNames[] = {"al", "cl", "dl", "bl", "ah", "ch", "dh", "bh"};
+static const char* const segmentNames[] = {"es", "cs", "ss", "ds", "fs", "gs", "?", "?"};
+// Base and index registers of the eight 16-bit addressing forms (r/m field).
+static const char* const address16Names[] = {"bx+si", "bx+di", "bp+si", "bp+di", "si", "di", "bp", "bx"};
+
+static const char* registerName(unsigned reg, int bits, bool hasRex) {
+    switch (bits) {
+        case 8:  return hasRex ? reg8Names[reg] : (reg < 8 ? reg8LegacyNames[reg] : reg8Names[reg]);
+        case 16: return reg16Names[reg];
+        case 32: return reg32Names[reg];
+        default: return reg64Names[reg];
+    }
+}
+
+static const char* sizeKeyword(int bits) {
+    switch (bits) {
+        case 8:   return "BYTE PTR ";
+        case 16:  return "WORD PTR ";
+        case 32:  return "DWORD PTR ";
+        case 48:  return "FWORD PTR ";
+        case 64:  return "QWORD PTR ";
+        case 80:  return "TBYTE PTR ";
+        case 128: return "XMMWORD PTR ";
+        case 256: return "YMMWORD PTR ";
+        case 512: return "ZMMWORD PTR ";
+        default:  return "";
+    }
+}
+
+// Little-endian field reader on top of read32.
+static uint64_t readField(const uint8_t* bytes, size_t size) {
+    switch (size) {
+        case 1: return bytes[0];
+        case 2: return static_cast<uint64_t>(bytes[0]) | (static_cast<uint64_t>(bytes[1]) << 8);
+        case 4: return read32(std::span<const uint8_t>(bytes, 4), 0);
+        default: {
+            std::span<const uint8_t> field(bytes, 8);
+            return read32(field, 0) | (static_cast<uint64_t>(read32(field, 4)) << 32);
+        }
+    }
+}
+
+static int64_t signExtend(uint64_t value, size_t size) {
+    int shift = 64 - static_cast<int>(size) * 8;
+    return static_cast<int64_t>(value << shift) >> shift;
+}
+
+static uint64_t truncate(uint64_t value, int bits) {
+    return bits >= 64 ? value : value & ((uint64_t{1} << bits) - 1);
+}
+
+// Register file of a vector operand as wide as bits.
+static const char* vectorRegisterPrefix(int bits) {
+    return bits <= 128 ? "xmm" : (bits == 256 ? "ymm" : "zmm");
+}
+
+namespace {
+
+// State shared by the operand formatters of one instruction.
+struct FormatContext {
+    const uint8_t* bytes;            // First byte of the instruction
+    const DecodedInstruction& insn;
+    const OpcodeEntry& entry;
+    uint64_t address;                // Address of the first byte
+    CpuMode mode;                    // Mode the record was decoded in
+    int operandBits;
+    int addressBits;
+    int vectorBits;                  // Width of Vx/Wx/Hx: 128, or VEX.L/EVEX.L'L
+    size_t immCursor;                // Position of the next immediate to print
+    bool ripRelative = false;
+    uint64_t ripTarget = 0;
+    const SymbolTable* symbols;      // nullptr when the binary has none
+};
+
+} // namespace
+
+static void writeSigned(OutputWriter& out, int64_t value) {
+    if (value < 0) {
+        out << "-0x";
+        out.hex(static_cast<uint64_t>(-value));
+    } else {
+        out << "+0x";
+        out.hex(static_cast<uint64_t>(value));
+    }
+}
+
+static void writeSegmentOverride(OutputWriter& out, uint8_t prefixes) {
+    unsigned segment = (prefixes & PrefixSegmentMask) >> PrefixSegmentShift;
+    if (segment != 0) {
+        out << segmentNames[segment - 1] << ':';
+    }
+}
+
+// Writes an absolute memory address, with its segment like objdump.
+static void writeAbsolute(OutputWriter& out, uint8_t prefixes, uint64_t address) {
+    if ((prefixes & PrefixSegmentMask) == 0) {
+        out << "ds:";
+    } else {
+        writeSegmentOverride(out, prefixes);
+    }
+    out << "0x";
+    out.hex(address);
+}
+
+// Writes a memory operand in 16-bit addressing: a fixed base/index pair
+// chosen by r/m and an 8- or 16-bit displacement.
+static void writeMemory16(OutputWriter& out, const FormatContext& ctx) {
+    const DecodedInstruction& insn = ctx.insn;
+    uint8_t mod = insn.modrm >> 6;
+    uint8_t rm = insn.modrm & 0x07;
+    if (mod == 0 && rm == 6) {
+        writeAbsolute(out, insn.prefixes, readField(ctx.bytes + insn.dispPos, 2));
+        return;
+    }
+    writeSegmentOverride(out, insn.prefixes);
+    out << '[' << address16Names[rm];
+    if (mod != 0) {
+        size_t dispSize = mod == 1 ? 1 : 2;
+        writeSigned(out, signExtend(readField(ctx.bytes + insn.dispPos, dispSize), dispSize));
+    }
+    out << ']';
+}
+
+// Writes the memory operand described by ModR/M, SIB and displacement.
+static void writeMemory(OutputWriter& out, FormatContext& ctx, int bits) {
+    const DecodedInstruction& insn = ctx.insn;
+    int addrBits = ctx.addressBits;
+    uint8_t mod = insn.modrm >> 6;
+    uint8_t rm = insn.modrm & 0x07;
+
+    bool evex = (insn.flags & InsnEvex) != 0;
+    bool broadcast = evex && (insn.evex & EvexBroadcast);
+    int elementBytes = (insn.rex & 0x08) ? 8 : 4;
+    if (broadcast) {
+        // One element, repeated across the vector.
+        out << (elementBytes == 8 ? "QWORD BCST " : "DWORD BCST ");
+    } else {
+        out << sizeKeyword(bits);
+    }
+    if (addrBits == 16) {
+        writeMemory16(out, ctx);
+        return;
+    }
+
+    size_t dispSize = mod == 1 ? 1 : 4;
+    int64_t disp = 0;
+    bool hasDisp = mod != 0;
+    int base = -1;
+    int index = -1;
+    int scale = 1;
+
+    if (rm == 4) {
+        uint8_t sib = insn.sib;
+        scale = 1 << (sib >> 6);
+        int indexReg = ((sib >> 3) & 0x07) | ((insn.rex & 0x02) << 2);
+        if (indexReg != 4) {
+            index = indexReg;
+        }
+        if ((sib & 0x07) == 5 && mod == 0) {
+            hasDisp = true;
+        } else {
+            base = (sib & 0x07) | ((insn.rex & 0x01) << 3);
+        }
+    } else if (rm == 5 && mod == 0 && ctx.mode != CpuMode::Bits64) {
+        // Outside 64-bit mode this is a plain absolute disp32.
+        hasDisp = true;
+    } else if (rm == 5 && mod == 0) {
+        // rip-relative: disp32 from the end of the instruction.
+        disp = signExtend(readField(ctx.bytes + insn.dispPos, 4), 4);
+        ctx.ripRelative = true;
+        ctx.ripTarget = ctx.address + insn.length + disp;
+        writeSegmentOverride(out, insn.prefixes);
+        out << (addrBits == 32 ? "[eip" : "[rip");
+        writeSigned(out, disp);
+        out << ']';
+        return;
+    } else {
+        base = rm | ((insn.rex & 0x01) << 3);
+    }
+
+    if (hasDisp) {
+        disp = signExtend(readField(ctx.bytes + insn.dispPos, dispSize), dispSize);
+        // EVEX disp8 counts in units of the memory operand (or of one
+        // element when broadcasting).
+        if (evex && dispSize == 1) {
+            disp *= broadcast ? elementBytes : (bits >= 8 ? bits / 8 : 1);
+        }
+    }
+
+    if (base < 0 && index < 0) {
+        writeAbsolute(out, insn.prefixes, truncate(static_cast<uint64_t>(disp), addrBits));
+        return;
+    }
+
+    writeSegmentOverride(out, insn.prefixes);
+    out << '[';
+    if (base >= 0) {
+        out << registerName(base, addrBits, true);
+    }
+    if (index >= 0) {
+        if (base >= 0) {
+            out << '+';
+        }
+        out << registerName(index, addrBits, true) << '*';
+        out.dec(scale);
+    }
+    if (hasDisp) {
+        writeSigned(out, disp);
+    }
+    out << ']';
+}
+
+// Writes an r/m operand: a register when mod == 3, memory otherwise.
+static void writeRegOrMemory(OutputWriter& out, FormatContext& ctx, int bits) {
+    const DecodedInstruction& insn = ctx.insn;
+    if ((insn.modrm >> 6) == 3) {
+        unsigned reg = (insn.modrm & 0x07) | ((insn.rex & 0x01) << 3);
+        out << registerName(reg, bits, insn.rex != 0);
+    } else {
+        writeMemory(out, ctx, bits);
+    }
+}
+
+// Writes a numbered register such as xmm12, mm3 or cr0.
+static void writeNumberedRegister(OutputWriter& out, const char* prefix, unsigned number) {
+    out << prefix;
+    out.dec(number);
+}
+
+// Writes an r/m operand of the 0F maps: a register of another file (xmm,
+// ymm, zmm, mmx, opmask, or a 32-bit general-purpose register) when
+// mod == 3, memory of memoryBits otherwise.
+static void writeRegisterFileOrMemory(OutputWriter& out, FormatContext& ctx, const char* prefix, int memoryBits) {
+    const DecodedInstruction& insn = ctx.insn;
+    if ((insn.modrm >> 6) != 3) {
+        writeMemory(out, ctx, memoryBits);
+    } else if (prefix == nullptr) {
+        out << registerName((insn.modrm & 0x07) | ((insn.rex & 0x01) << 3), 32, true);
+    } else if (prefix[0] == 'm' || prefix[0] == 'k') {
+        // mmx and opmask registers are not extended by REX.B.
+        writeNumberedRegister(out, prefix, insn.modrm & 0x07);
+    } else {
+        // EVEX reaches vector registers 16-31 through X.
+        unsigned extension = (insn.rex & 0x01) << 3;
+        if (insn.flags & InsnEvex) {
+            extension |= (insn.rex & 0x02) << 3;
+        }
+        writeNumberedRegister(out, prefix, (insn.modrm & 0x07) | extension);
+    }
+}
+
+// Writes the next immediate of width size, masked to the operand width.
+static void writeImmediate(OutputWriter& out, FormatContext& ctx, size_t size, int bits, bool signExtended) {
+    uint64_t value = readField(ctx.bytes + ctx.immCursor, size);
+    ctx.immCursor += size;
+    if (signExtended) {
+        value = static_cast<uint64_t>(signExtend(value, size));
+    }
+    out << "0x";
+    out.hex(truncate(value, bits));
+}
+
+static void writeBranchTarget(OutputWriter& out, FormatContext& ctx, size_t size) {
+    int64_t rel = signExtend(readField(ctx.bytes + ctx.immCursor, size), size);
+    ctx.immCursor += size;
+    uint64_t target = relativeBranchTarget(ctx.insn, ctx.address, rel);
+    out << "0x";
+    out.hex(target);
+    writeSymbolReference(out, ctx.symbols, target);
+}
+
+// String instruction operands: ds:[rsi] (source) or es:[rdi] (destination),
+// with the index register as wide as the address size.
+static void writeStringOperand(OutputWriter& out, const FormatContext& ctx, int bits, bool destination) {
+    out << sizeKeyword(bits);
+    if (destination) {
+        out << "es:[" << registerName(7, ctx.addressBits, false) << ']';
+    } else {
+        unsigned segment = (ctx.insn.prefixes & PrefixSegmentMask) >> PrefixSegmentShift;
+        out << (segment != 0 ? segmentNames[segment - 1] : "ds") << ':';
+        out << '[' << registerName(6, ctx.addressBits, false) << ']';
+    }
+}
+
+static void writeOperand(OutputWriter& out, FormatContext& ctx, OperandSpec spec) {
+    const DecodedInstruction& insn = ctx.insn;
+    bool hasRex = insn.rex != 0;
+    unsigned modrmReg = ((insn.modrm >> 3) & 0x07) | ((insn.rex & 0x04) << 1);
+    unsigned opcodeReg = (insn.opcode & 0x07) | ((insn.rex & 0x01) << 3);
+    int bits = ctx.operandBits;
+    int wordOrDword = bits == 16 ? 16 : 32;
+    int vector = ctx.vectorBits;
+    int halfVector = vector > 128 ? vector / 2 : 128;
+    // Vector registers of the ModR/M reg field and VEX.vvvv, with EVEX's
+    // fifth bits.
+    unsigned vectorReg = modrmReg | ((insn.evex & EvexHighReg) ? 16 : 0);
+    unsigned vvvv = (insn.vex & VexRegisterMask) | ((insn.evex & EvexHighVvvv) ? 16 : 0);
+
+    switch (spec) {
+        case OperandSpec::None: break;
+        case OperandSpec::Eb: writeRegOrMemory(out, ctx, 8); break;
+        case OperandSpec::Ew: writeRegOrMemory(out, ctx, 16); break;
+        case OperandSpec::Ed: writeRegOrMemory(out, ctx, 32); break;
+        case OperandSpec::Ev: writeRegOrMemory(out, ctx, bits); break;
+        case OperandSpec::Ey: writeRegOrMemory(out, ctx, (insn.rex & 0x08) ? 64 : 32); break;
+        case OperandSpec::Gb: out << registerName(modrmReg, 8, hasRex); break;
+        case OperandSpec::Gv: out << registerName(modrmReg, bits, hasRex); break;
+        case OperandSpec::Gw: out << registerName(modrmReg, 16, hasRex); break;
+        case OperandSpec::M:  writeMemory(out, ctx, 0); break;
+        case OperandSpec::Mb: writeMemory(out, ctx, 8); break;
+        case OperandSpec::Mw: writeMemory(out, ctx, 16); break;
+        case OperandSpec::Md: writeMemory(out, ctx, 32); break;
+        case OperandSpec::Mq: writeMemory(out, ctx, 64); break;
+        case OperandSpec::Mt: writeMemory(out, ctx, 80); break;
+        case OperandSpec::Mx: writeMemory(out, ctx, 128); break;
+        case OperandSpec::Mp: writeMemory(out, ctx, (insn.rex & 0x08) ? 80 : (bits == 16 ? 32 : 48)); break;
+        case OperandSpec::Ib: writeImmediate(out, ctx, 1, 8, false); break;
+        case OperandSpec::Ibs: writeImmediate(out, ctx, 1, bits, true); break;
+        case OperandSpec::Iw: writeImmediate(out, ctx, 2, 16, false); break;
+        case OperandSpec::Iz: writeImmediate(out, ctx, bits == 16 ? 2 : 4, bits, true); break;
+        case OperandSpec::Iv: writeImmediate(out, ctx, static_cast<size_t>(bits / 8), bits, false); break;
+        case OperandSpec::Ap: {
+            // ptr16:16 or ptr16:32, stored offset first.
+            size_t size = bits == 16 ? 2 : 4;
+            uint64_t offset = readField(ctx.bytes + ctx.immCursor, size);
+            out << "0x";
+            out.hex(readField(ctx.bytes + ctx.immCursor + size, 2));
+            out << ":0x";
+            out.hex(offset);
+            ctx.immCursor += size + 2;
+            break;
+        }
+        case OperandSpec::Jb: writeBranchTarget(out, ctx, 1); break;
+        case OperandSpec::Jz: writeBranchTarget(out, ctx, relativeSizeZ(ctx.mode, bits)); break;
+        case OperandSpec::Zb: out << registerName(opcodeReg, 8, hasRex); break;
+        case OperandSpec::Zv: out << registerName(opcodeReg, bits, hasRex); break;
+        case OperandSpec::AL: out << "al"; break;
+        case OperandSpec::CL: out << "cl"; break;
+        case OperandSpec::AX: out << "ax"; break;
+        case OperandSpec::DX: out << "dx"; break;
+        case OperandSpec::rAX: out << registerName(0, bits, hasRex); break;
+        case OperandSpec::eAX: out << registerName(0, wordOrDword, hasRex); break;
+        case OperandSpec::One: out << '1'; break;
+        case OperandSpec::Sw: out << segmentNames[(insn.modrm >> 3) & 0x07]; break;
+        case OperandSpec::ES: out << "es"; break;
+        case OperandSpec::CS: out << "cs"; break;
+        case OperandSpec::SS: out << "ss"; break;
+        case OperandSpec::DS: out << "ds"; break;
+        case OperandSpec::Ob:
+        case OperandSpec::Ov: {
+            size_t size = static_cast<size_t>(ctx.addressBits / 8);
+            uint64_t moffs = readField(ctx.bytes + ctx.immCursor, size);
+            ctx.immCursor += size;
+            writeAbsolute(out, insn.prefixes, moffs);
+            break;
+        }
+        case OperandSpec::Xb: writeStringOperand(out, ctx, 8, false); break;
+        case OperandSpec::Xv: writeStringOperand(out, ctx, bits, false); break;
+        case OperandSpec::Xz: writeStringOperand(out, ctx, wordOrDword, false); break;
+        case OperandSpec::Yb: writeStringOperand(out, ctx, 8, true); break;
+        case OperandSpec::Yv: writeStringOperand(out, ctx, bits, true); break;
+        case OperandSpec::Yz: writeStringOperand(out, ctx, wordOrDword, true); break;
+        case OperandSpec::ST0: out << "st"; break;
+        case OperandSpec::STi:
+            out << "st(";
+            out.dec(insn.modrm & 0x07);
+            out << ')';
+            break;
+        case OperandSpec::FS: out << "fs"; break;
+        case OperandSpec::GS: out << "gs"; break;
+        case OperandSpec::Vx: writeNumberedRegister(out, vectorRegisterPrefix(vector), vectorReg); break;
+        case OperandSpec::Pq: writeNumberedRegister(out, "mm", modrmReg & 0x07); break;
+        case OperandSpec::Cd: writeNumberedRegister(out, "cr", modrmReg); break;
+        case OperandSpec::Dd: writeNumberedRegister(out, "dr", modrmReg); break;
+        case OperandSpec::Gd: out << registerName(modrmReg, 32, hasRex); break;
+        case OperandSpec::Gy: out << registerName(modrmReg, (insn.rex & 0x08) ? 64 : 32, hasRex); break;
+        case OperandSpec::Wx: writeRegisterFileOrMemory(out, ctx, vectorRegisterPrefix(vector), vector); break;
+        case OperandSpec::Wq: writeRegisterFileOrMemory(out, ctx, "xmm", 64); break;
+        case OperandSpec::Wd: writeRegisterFileOrMemory(out, ctx, "xmm", 32); break;
+        case OperandSpec::Ww: writeRegisterFileOrMemory(out, ctx, "xmm", 16); break;
+        case OperandSpec::Qq: writeRegisterFileOrMemory(out, ctx, "mm", 64); break;
+        case OperandSpec::RdMb: writeRegisterFileOrMemory(out, ctx, nullptr, 8); break;
+        case OperandSpec::RdMw: writeRegisterFileOrMemory(out, ctx, nullptr, 16); break;
+        case OperandSpec::RvMw: writeRegOrMemory(out, ctx, (ctx.insn.modrm >> 6) == 3 ? bits : 16); break;
+        case OperandSpec::Ux: writeRegisterFileOrMemory(out, ctx, vectorRegisterPrefix(vector), 0); break;
+        case OperandSpec::Nq: writeRegisterFileOrMemory(out, ctx, "mm", 0); break;
+        case OperandSpec::Rv: writeRegOrMemory(out, ctx, bits); break;
+        case OperandSpec::Ry: writeRegOrMemory(out, ctx, ctx.mode == CpuMode::Bits64 ? 64 : 32); break;
+        case OperandSpec::XMM0: out << "xmm0"; break;
+        case OperandSpec::Hx: writeNumberedRegister(out, vectorRegisterPrefix(vector), vvvv); break;
+        case OperandSpec::Lx: {
+            // The register number is in the high nibble of an imm8 (its top
+            // bit is ignored outside 64-bit mode).
+            unsigned number = ctx.bytes[ctx.immCursor] >> 4;
+            writeNumberedRegister(out, vectorRegisterPrefix(vector),
+                                  ctx.mode == CpuMode::Bits64 ? number : number & 0x07);
+            ctx.immCursor += 1;
+            break;
+        }
+        case OperandSpec::By: out << registerName(vvvv & 0x0F, (insn.rex & 0x08) ? 64 : 32, true); break;
+        case OperandSpec::Kh: writeNumberedRegister(out, "k", vvvv & 0x07); break;
+        case OperandSpec::Vh: writeNumberedRegister(out, vectorRegisterPrefix(halfVector), vectorReg); break;
+        case OperandSpec::Wh: writeRegisterFileOrMemory(out, ctx, vectorRegisterPrefix(halfVector), vector / 2); break;
+        case OperandSpec::Wf: writeRegisterFileOrMemory(out, ctx, "xmm", vector / 4); break;
+        case OperandSpec::We: writeRegisterFileOrMemory(out, ctx, "xmm", vector / 8); break;
+        case OperandSpec::Ws: writeRegisterFileOrMemory(out, ctx, "xmm", (insn.rex & 0x08) ? 64 : 32); break;
+        case OperandSpec::Wb: writeRegisterFileOrMemory(out, ctx, "xmm", 8); break;
+        case OperandSpec::Wdq: writeRegisterFileOrMemory(out, ctx, "xmm", 128); break;
+        case OperandSpec::Wqq: writeRegisterFileOrMemory(out, ctx, "ymm", 256); break;
+        case OperandSpec::Kg: writeNumberedRegister(out, "k", modrmReg & 0x07); break;
+        case OperandSpec::Ke: {
+            // kmovb/w/d/q: the memory form is as wide as the mnemonic.
+            int maskBits = (mandatoryPrefix(insn.prefixes) == Mandatory66 ? 8 : 16) << ((insn.rex & 0x08) ? 2 : 0);
+            writeRegisterFileOrMemory(out, ctx, "k", maskBits);
+            break;
+        }
+        case OperandSpec::Kr: writeRegisterFileOrMemory(out, ctx, "k", 0); break;
+    }
+}
+
+static bool isStringOperand(OperandSpec spec) {
+    return spec >= OperandSpec::Xb && spec <= OperandSpec::Yz;
+}
+
+// Writes prefixes that objdump spells out in front of the mnemonic.
+static void writePrefixMnemonics(OutputWriter& out, const DecodedInstruction& insn, const OpcodeEntry& entry) {
+    if (insn.prefixes & PrefixLock) {
+        out << "lock ";
+    }
+    bool stringOp = isStringOperand(entry.operands[0]) || isStringOperand(entry.operands[1]);
+    if (stringOp) {
+        if (insn.prefixes & PrefixRep) {
+            out << ((entry.flags & OpRepCond) ? "repz " : "rep ");
+        } else if (insn.prefixes & PrefixRepne) {
+            out << "repnz ";
+        }
+        return;
+    }
+
+    bool branch = (entry.flags & OpForce64) != 0;
+    if (branch && (insn.prefixes & PrefixRepne)) {
+        out << "bnd ";
+    } else if (branch && (insn.prefixes & PrefixRep) && insn.opcode == 0xC3) {
+        out << "repz ";
+    }
+    // A ds override on an indirect branch is the CET no-track prefix.
+    if (insn.opcode == 0xFF && (insn.prefixes & PrefixSegmentMask) == (4 << PrefixSegmentShift)) {
+        uint8_t reg = (insn.modrm >> 3) & 0x07;
+        if (reg == 2 || reg == 4) {
+            out << "notrack ";
+        }
+    }
+}
+
+// Returns the mnemonic, choosing among size-dependent spellings (without
+// the v of an SSE entry reused for its VEX form).
+static std::string_view selectMnemonic(const FormatContext& ctx) {
+    std::string_view mnemonic = ctx.entry.mnemonic;
+    if (ctx.entry.flags & OpSizedMnemonic) {
+        // "cbw cwde cdqe": pick the word for 16, 32 or 64-bit operands.
+        int word = ctx.operandBits == 16 ? 0 : (ctx.operandBits == 32 ? 1 : 2);
+        for (int n = 0; n < word; n++) {
+            mnemonic.remove_prefix(mnemonic.find(' ') + 1);
+        }
+        mnemonic = mnemonic.substr(0, mnemonic.find(' '));
+    } else if ((ctx.insn.opcode & 0xFFF8) == 0xB8 && ctx.operandBits == 64) {
+        mnemonic = "movabs";
+    } else if ((ctx.insn.opcode == 0x112 || ctx.insn.opcode == 0x116) && (ctx.insn.modrm >> 6) == 3 &&
+               mandatoryPrefix(ctx.insn.prefixes) == MandatoryNone) {
+        // The register forms of movlps and movhps.
+        mnemonic = ctx.insn.opcode == 0x112 ? "movhlps" : "movlhps";
+    } else if (ctx.insn.opcode == 0xE3) {
+        // The count register of jrcxz follows the address size.
+        mnemonic = ctx.addressBits == 16 ? "jcxz" : (ctx.addressBits == 32 ? "jecxz" : "jrcxz");
+    } else if ((ctx.insn.flags & InsnVex) && ctx.insn.opcode == 0x177 && (ctx.insn.vex & VexLengthMask)) {
+        mnemonic = "vzeroall";
+    }
+    return mnemonic;
+}
+
+static void writeMnemonic(OutputWriter& out, const FormatContext& ctx) {
+    if (ctx.entry.flags & OpVexMnemonic) {
+        out << 'v';
+    }
+    out << selectMnemonic(ctx);
+}
+
+// Compares and carry-less multiplies whose imm8 selects a predicate are
+// printed as the pseudo-op that names it (cmpltsd, vcmpge_oqps, vpcmpnequb,
+// pclmullqhqdq), without the imm8. Returns false when the imm8 has no name.
+static bool writePredicateMnemonic(OutputWriter& out, const FormatContext& ctx) {
+    static const char* const comparePredicates[] = {
+        "eq", "lt", "le", "unord", "neq", "nlt", "nle", "ord",
+        "eq_uq", "nge", "ngt", "false", "neq_oq", "ge", "gt", "true",
+        "eq_os", "lt_oq", "le_oq", "unord_s", "neq_us", "nlt_uq", "nle_uq", "ord_s",
+        "eq_us", "nge_uq", "ngt_uq", "false_os", "neq_os", "ge_oq", "gt_oq", "true_us"};
+    static const char* const integerPredicates[] = {"eq", "lt", "le", nullptr, "neq", "nlt", "nle", nullptr};
+    static const char* const clmulHalves[] = {"lqlq", "hqlq", "lqhq", "hqhq"};
+    const DecodedInstruction& insn = ctx.insn;
+    uint8_t imm = ctx.bytes[insn.immPos];
+    const char* v = (ctx.entry.flags & OpVexMnemonic) ? "v" : "";
+    std::string_view mnemonic = selectMnemonic(ctx);
+
+    if (insn.opcode == 0x1C2) {
+        // Legacy SSE has the first eight predicates, VEX and EVEX all 32.
+        if (imm >= ((insn.flags & (InsnVex | InsnEvex)) ? 32 : 8)) {
+            return false;
+        }
+        out << v << "cmp" << comparePredicates[imm] << mnemonic.substr(3);
+        return true;
+    }
+    if (insn.opcode == 0x344) {
+        unsigned halves = imm == 0x10 ? 2 : (imm == 0x11 ? 3 : imm);
+        if (halves >= 4) {
+            return false;
+        }
+        out << v << "pclmul" << clmulHalves[halves] << "dq";
+        return true;
+    }
+    if ((insn.flags & InsnEvex) && (insn.opcode == 0x31E || insn.opcode == 0x31F || insn.opcode == 0x33E ||
+                                    insn.opcode == 0x33F)) {
+        if (imm >= 8 || integerPredicates[imm] == nullptr) {
+            return false;
+        }
+        out << "vpcmp" << integerPredicates[imm] << mnemonic.substr(5);
+        return true;
+    }
+    return false;
+}
+
+// Whether an entry is a scalar operation (vaddss, vcvtsi2sd, vfmadd231sd),
+// whose registers stay xmm whatever the vector length says. Broadcasts also
+// read a scalar but fill a whole vector; they have neither a VEX.vvvv
+// source nor a legacy SSE form.
+static bool isScalarEntry(const OpcodeEntry& entry) {
+    if (!(entry.flags & (OpVexMnemonic | OpVexNds | OpVexNdsRegister))) {
+        return false;
+    }
+    for (OperandSpec spec : entry.operands) {
+        switch (spec) {
+            case OperandSpec::Wd: case OperandSpec::Wq: case OperandSpec::Ws: case OperandSpec::Ed:
+            case OperandSpec::Ey:
+                return true;
+            default: break;
+        }
+    }
+    return false;
+}
+
+// Whether VEX.vvvv (with EVEX.V') names an operand of the instruction.
+// Encodings that do not use it must leave it clear, or they fault.
+static bool usesVexRegister(const DecodedInstruction& insn, const OpcodeEntry& entry) {
+    if ((entry.flags & OpVexNds) || ((entry.flags & OpVexNdsRegister) && (insn.modrm >> 6) == 3)) {
+        return true;
+    }
+    for (OperandSpec spec : entry.operands) {
+        if (spec == OperandSpec::Hx || spec == OperandSpec::By || spec == OperandSpec::Kh) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Width of the vector operands of an instruction: 128 bits for legacy SSE
+// and scalar operations, VEX.L or EVEX.L'L otherwise. In an EVEX register
+// form with b set, L'L is the rounding mode instead and the vector is 512
+// bits.
+static int vectorLength(const DecodedInstruction& insn, const OpcodeEntry& entry) {
+    if (!(insn.flags & (InsnVex | InsnEvex)) || isScalarEntry(entry)) {
+        return 128;
+    }
+    if ((insn.flags & InsnEvex) && (insn.evex & EvexBroadcast) && (insn.modrm >> 6) == 3) {
+        return 512;
+    }
+    int length = (insn.vex & VexLengthMask) >> VexLengthShift;
+    return 128 << (length < 2 ? length : 2);
+}
+
+// Formats one instruction (without address) in Intel syntax.
+static void writeInstruction(OutputWriter& out, const uint8_t* bytes, const DecodedInstruction& insn,
+                             uint64_t address, const SymbolTable* symbols) {
+    if (insn.flags & InsnInvalid) {
+        out << "db 0x";
+        out.hexByte(bytes[0]);
+        return;
+    }
+
+    const OpcodeEntry& entry = resolveOpcodeEntry(insn);
+    bool unusedVexRegister = (insn.flags & (InsnVex | InsnEvex)) &&
+                             ((insn.vex & VexRegisterMask) || (insn.evex & EvexHighVvvv)) &&
+                             !usesVexRegister(insn, entry);
+    if (entry.mnemonic == nullptr || unusedVexRegister) {
+        out << "(bad)";
+        return;
+    }
+
+    // 0x90 is nop unless REX.B turns it into xchg r8, rax; F3 90 is pause.
+    if (insn.opcode == 0x90 && (insn.rex & 0x01) == 0) {
+        if (insn.prefixes & PrefixRep) {
+            out << "pause";
+        } else if (insn.prefixes & PrefixOperandSize) {
+            out << "xchg ax, ax";
+        } else {
+            out << "nop";
+        }
+        return;
+    }
+
+    CpuMode mode = instructionMode(insn);
+    FormatContext ctx{bytes, insn, entry, address, mode,
+                      operandSizeBits(mode, insn.prefixes, insn.rex, entry.flags),
+                      addressSizeBits(mode, insn.prefixes), vectorLength(insn, entry), insn.immPos,
+                      false, 0, symbols};
+    if (insn.flags & (InsnVex | InsnEvex)) {
+        // VEX.W and pp pick among sized spellings: "vmovdqa32 vmovdqa32
+        // vmovdqa64", "kmovb kmovb kmovd" (66) or "kmovw kmovw kmovq".
+        ctx.operandBits = (insn.rex & 0x08) ? 64 : (mandatoryPrefix(insn.prefixes) == Mandatory66 ? 16 : 32);
+    }
+
+    writePrefixMnemonics(out, insn, entry);
+    if (insn.opcode == 0x90) {
+        out << "xchg";
+        ctx.operandBits = operandSizeBits(mode, insn.prefixes, insn.rex, 0);
+        out << ' ';
+        writeOperand(out, ctx, OperandSpec::Zv);
+        out << ", ";
+        writeOperand(out, ctx, OperandSpec::rAX);
+        return;
+    }
+    int operandCount = 3;
+    if (writePredicateMnemonic(out, ctx)) {
+        operandCount = 2;
+    } else {
+        writeMnemonic(out, ctx);
+    }
+
+    bool registerForm = (insn.modrm >> 6) == 3;
+    bool nds = (entry.flags & OpVexNds) || ((entry.flags & OpVexNdsRegister) && registerForm);
+    // Embedded rounding (EVEX.b on a register form, in place of the vector
+    // length) follows the last register operand.
+    int roundingAfter = -1;
+    if ((insn.flags & InsnEvex) && (insn.evex & EvexBroadcast) && registerForm) {
+        for (int n = 0; n < operandCount && entry.operands[n] != OperandSpec::None; n++) {
+            if (entry.operands[n] != OperandSpec::Ib) {
+                roundingAfter = n;
+            }
+        }
+    }
+    for (int n = 0; n < operandCount && entry.operands[n] != OperandSpec::None; n++) {
+        out << (n == 0 ? " " : ", ");
+        writeOperand(out, ctx, entry.operands[n]);
+        if (n == roundingAfter) {
+            static const char* const roundingModes[] = {"{rn-sae}", "{rd-sae}", "{ru-sae}", "{rz-sae}"};
+            out << roundingModes[(insn.vex & VexLengthMask) >> VexLengthShift];
+        }
+        if (n != 0) {
+            continue;
+        }
+        // EVEX opmask and zeroing decorate the destination; the first
+        // source in VEX.vvvv follows it.
+        if (insn.evex & EvexMaskRegister) {
+            out << "{k";
+            out.dec(insn.evex & EvexMaskRegister);
+            out << '}';
+        }
+        if (insn.evex & EvexZeroing) {
+            out << "{z}";
+        }
+        if (nds) {
+            out << ", ";
+            writeOperand(out, ctx, OperandSpec::Hx);
+        }
+    }
+
+    if (ctx.ripRelative) {
+        out << "  # 0x";
+        out.hex(ctx.ripTarget);
+        writeSymbolReference(out, symbols, ctx.ripTarget);
+    }
+}
+
+void printInstructions(std::span<const uint8_t> code,
+                       std::span<const DecodedInstruction> instructions,
+                       uint64_t baseAddress,
+                       OutputWriter& out,
+                       const SymbolTable* symbols) {
+    // Symbols are sorted like the instructions, so labels are found by
+    // advancing a cursor rather than by a search per instruction.
+    std::span<const Symbol> labels;
+    size_t nextLabel = 0;
+    if (symbols != nullptr && !instructions.empty()) {
+        labels = symbols->symbols();
+        nextLabel = symbols->lowerBound(baseAddress + instructions.front().offset);
+    }
+    // Sized for the whole buffer, so batches printed separately line up.
+    int digits = addressDigits(baseAddress + (code.empty() ? 0 : code.size() - 1));
+
+    for (const DecodedInstruction& insn : instructions) {
+        uint64_t address = baseAddress + insn.offset;
+        // Symbols that start inside the previous instruction are not
+        // boundaries of this sweep and get no label.
+        while (nextLabel < labels.size() && labels[nextLabel].address < address) {
+            nextLabel++;
+        }
+        if (nextLabel < labels.size() && labels[nextLabel].address == address) {
+            // Labels carry the full address width of the mode, as objdump
+            // prints them: 16 digits in 64-bit code, 8 otherwise.
+            out << '\n';
+            out.hex(address, instructionMode(insn) == CpuMode::Bits64 ? 16 : 8);
+            out << " <" << labels[nextLabel].name << ">:\n";
+            nextLabel++;
+        }
+
+        out.reserveLine();
+        out.hex(address, digits);
+        out << ": ";
+
+        // Fields are read from a padded copy so that printing an instruction
+        // at the very end of the buffer never reads past it.
+        uint8_t bytes[maxInstructionLength + 1] = {};
+        const uint8_t* source = code.data() + insn.offset;
+        for (size_t n = 0; n < insn.length; n++) {
+            bytes[n] = source[n];
+        }
+        writeInstruction(out, bytes, insn, address, symbols);
+        out << '\n';
+    }
+}
@@ -0,0 +1,393 @@
+#include "disassembler.h"
+
+#include <array>
+#include <bit>
+#include <cstring>
+
+#include "byte_classifier.h"
+#include "opcode_table.h"
+
+// The length decoder answers "where does the next instruction start?" from
+// small tables derived at compile time from the opcode tables, so it stays
+// in step with the full decoder without materialising operands:
+//   - lengthClassTable: one 16-bit class per primary opcode byte
+//   - escapeLengthClassTable: the same per escape map, opcode byte and
+//     mandatory prefix, with vexLengthClassTable and evexLengthClassTable
+//     for the VEX and EVEX forms of the maps
+//   - groupLengthClassTable: the same classes per opcode group member
+//   - modrmTailTable: SIB/displacement bytes implied by each ModR/M value
+// Like the decoder, the tables and the loop are instantiated per CpuMode.
+
+namespace {
+
+// Low four bits of a length class: the kind of immediate that follows.
+enum ImmediateClass : uint16_t {
+    ClassImmNone = 0,
+    ClassImm1 = 1,
+    ClassImm2 = 2,
+    ClassImm3 = 3,      // enter: imm16 + imm8
+    ClassImm4 = 4,
+    ClassImmSizeZ = 5,  // 2 or 4 bytes by operand size
+    ClassImmSizeV = 6,  // 2, 4 or 8 bytes by operand size
+    ClassImmMoffs = 7,  // 2, 4 or 8 bytes by address size
+    ClassImmFar = 8,    // Far pointer: 2 or 4 bytes by operand size, plus a 2-byte selector
+    ClassImmMask = 15,
+};
+
+enum LengthClassFlags : uint16_t {
+    ClassModRM      = 1 << 4,
+    ClassLegacy     = 1 << 5,  // Legacy prefix byte
+    ClassRex        = 1 << 6,  // REX prefix byte
+    ClassInvalid    = 1 << 7,
+    ClassMemoryOnly = 1 << 8,
+    ClassGroup      = 1 << 9,  // Immediate and validity depend on ModR/M reg
+    ClassRegisterOnly = 1 << 10,
+    ClassSpecial    = 1 << 11,  // Register forms need no group lookup (OpModRMSpecial)
+    ClassEscape     = 1 << 12,  // 0F, 0F 38 or 0F 3A: another opcode byte follows
+    ClassVex        = 1 << 13,  // C4, C5 or 62: may start a VEX/EVEX prefix (see decodeVex())
+    ClassModRMF8    = 1 << 14,  // ModR/M must be exactly F8 (OpModRMF8)
+    ClassModRMRegister = 1 << 15,  // No SIB or displacement, whatever mod says (OpModRMRegister)
+};
+
+template <CpuMode Mode>
+constexpr uint16_t lengthClassOf(const OpcodeEntry& entry) {
+    if ((entry.flags & OpKindMask) == OpInvalid) {
+        return ClassInvalid;
+    }
+    if ((entry.flags & OpKindMask) == OpEscape) {
+        return ClassEscape;
+    }
+    // The rest of the class describes the legacy instruction (les, lds or
+    // bound) that the VEX bytes are outside 64-bit mode.
+    uint16_t cls = 0;
+    if ((entry.flags & OpKindMask) == OpVexPrefix) {
+        cls |= ClassVex;
+    }
+    if (entry.flags & OpHasModRM) {
+        cls |= ClassModRM;
+    }
+    if (entry.flags & OpMemoryOnly) {
+        cls |= ClassMemoryOnly;
+    }
+    if (entry.flags & OpRegisterOnly) {
+        cls |= ClassRegisterOnly;
+    }
+    if (entry.flags & OpModRMSpecial) {
+        cls |= ClassSpecial;
+    }
+    if (entry.flags & OpModRMF8) {
+        cls |= ClassModRMF8;
+    }
+    if (entry.flags & OpModRMRegister) {
+        cls |= ClassModRMRegister;
+    }
+    if (entry.group != GroupNone) {
+        return cls | ClassGroup;
+    }
+    if ((entry.immVariable & ImmZ) && entry.immBytes == 2) {
+        cls |= ClassImmFar;
+    } else if (entry.immVariable & ImmZ) {
+        cls |= ClassImmSizeZ;
+    } else if (entry.immVariable & ImmV) {
+        cls |= ClassImmSizeV;
+    } else if (entry.immVariable & ::ImmMoffs) {
+        cls |= ClassImmMoffs;
+    } else if (entry.immVariable & ImmJz) {
+        // rel32 in 64-bit mode whatever the prefixes, rel16/32 elsewhere.
+        cls |= Mode == CpuMode::Bits64 ? ClassImm4 : ClassImmSizeZ;
+    } else {
+        cls |= entry.immBytes;
+    }
+    return cls;
+}
+
+template <CpuMode Mode>
+constexpr std::array<uint16_t, 256> buildLengthClassTable() {
+    std::array<uint16_t, 256> table{};
+    for (int op = 0; op < 256; op++) {
+        table[op] = lengthClassOf<Mode>(primaryOpcodeTable<Mode>[op]);
+    }
+    for (int op : {0x26, 0x2E, 0x36, 0x3E, 0x64, 0x65, 0x66, 0x67, 0xF0, 0xF2, 0xF3}) {
+        table[op] = ClassLegacy;
+    }
+    if constexpr (Mode == CpuMode::Bits64) {
+        for (int op = 0x40; op <= 0x4F; op++) {
+            table[op] = ClassRex;
+        }
+    }
+    return table;
+}
+
+using EscapeLengthClasses = std::array<std::array<std::array<uint16_t, MandatoryPrefixCount>, 256>, 3>;
+
+template <CpuMode Mode>
+constexpr EscapeLengthClasses buildEscapeLengthClassTable(const std::array<EscapeOpcodeTable, 3>& maps) {
+    EscapeLengthClasses table{};
+    for (int map = 0; map < 3; map++) {
+        for (int op = 0; op < 256; op++) {
+            for (int prefix = 0; prefix < MandatoryPrefixCount; prefix++) {
+                table[map][op][prefix] = lengthClassOf<Mode>(maps[map][op][prefix]);
+            }
+        }
+    }
+    return table;
+}
+
+template <CpuMode Mode>
+constexpr std::array<std::array<uint16_t, 8>, GroupCount> buildGroupLengthClassTable() {
+    std::array<std::array<uint16_t, 8>, GroupCount> table{};
+    for (int group = 0; group < GroupCount; group++) {
+        for (int reg = 0; reg < 8; reg++) {
+            const OpcodeEntry& member = groupOpcodeTable[group][reg];
+            table[group][reg] = member.mnemonic == nullptr ? uint16_t{ClassInvalid} : lengthClassOf<Mode>(member);
+        }
+    }
+    return table;
+}
+
+// Bytes following a ModR/M byte (SIB and displacement), or 0xFF when a SIB
+// byte follows and its base field decides whether a disp32 is present.
+constexpr std::array<uint8_t, 256> buildModRMTailTable() {
+    std::array<uint8_t, 256> table{};
+    for (int modrm = 0; modrm < 256; modrm++) {
+        int mod = modrm >> 6;
+        int rm = modrm & 0x07;
+        if (mod == 3) {
+            table[modrm] = 0;
+        } else if (rm == 4) {
+            table[modrm] = mod == 0 ? 0xFF : static_cast<uint8_t>(1 + (mod == 1 ? 1 : 4));
+        } else if (mod == 0) {
+            table[modrm] = rm == 5 ? 4 : 0;
+        } else {
+            table[modrm] = mod == 1 ? 1 : 4;
+        }
+    }
+    return table;
+}
+
+// The same for 16-bit addressing, which has no SIB byte.
+constexpr std::array<uint8_t, 256> buildModRMTail16Table() {
+    std::array<uint8_t, 256> table{};
+    for (int modrm = 0; modrm < 256; modrm++) {
+        int mod = modrm >> 6;
+        int rm = modrm & 0x07;
+        if (mod == 3) {
+            table[modrm] = 0;
+        } else if (mod == 0) {
+            table[modrm] = rm == 6 ? 2 : 0;
+        } else {
+            table[modrm] = mod == 1 ? 1 : 2;
+        }
+    }
+    return table;
+}
+
+template <CpuMode Mode>
+constexpr std::array<uint16_t, 256> lengthClassTable = buildLengthClassTable<Mode>();
+template <CpuMode Mode>
+constexpr EscapeLengthClasses escapeLengthClassTable = buildEscapeLengthClassTable<Mode>(escapeOpcodeTable<Mode>);
+template <CpuMode Mode>
+constexpr EscapeLengthClasses vexLengthClassTable = buildEscapeLengthClassTable<Mode>(vexOpcodeTable<Mode>);
+template <CpuMode Mode>
+constexpr EscapeLengthClasses evexLengthClassTable = buildEscapeLengthClassTable<Mode>(evexOpcodeTable<Mode>);
+template <CpuMode Mode>
+constexpr std::array<std::array<uint16_t, 8>, GroupCount> groupLengthClassTable = buildGroupLengthClassTable<Mode>();
+constexpr std::array<uint8_t, 256> modrmTailTable = buildModRMTailTable();
+constexpr std::array<uint8_t, 256> modrmTail16Table = buildModRMTail16Table();
+
+} // namespace
+
+// Returns the length of the instruction at bytes (which must have at least
+// maxInstructionLength readable bytes), or 0 for an invalid encoding.
+template <CpuMode Mode>
+static size_t instructionLength(const uint8_t* bytes) {
+    size_t pos = 0;
+    uint8_t prefixes = 0;  // Only the size and mandatory prefix bits matter here
+    uint8_t rex = 0;
+
+    uint16_t cls = lengthClassTable<Mode>[bytes[0]];
+    while (cls & (ClassLegacy | ClassRex)) {
+        if (cls & ClassLegacy) {
+            switch (bytes[pos]) {
+                case 0x66: prefixes |= PrefixOperandSize; break;
+                case 0x67: prefixes |= PrefixAddressSize; break;
+                case 0xF0: prefixes |= PrefixLock; break;
+                case 0xF2: prefixes = (prefixes & ~PrefixRep) | PrefixRepne; break;
+                case 0xF3: prefixes = (prefixes & ~PrefixRepne) | PrefixRep; break;
+                default: break;
+            }
+            rex = 0;  // REX only counts right before the opcode
+        } else {
+            rex = bytes[pos];
+        }
+        if (++pos == maxInstructionLength) {
+            return 0;
+        }
+        cls = lengthClassTable<Mode>[bytes[pos]];
+    }
+
+    // 0F, then optionally 38 or 3A: classes of the escape map, by the
+    // mandatory prefix.
+    const OpcodeEntry* entry = &primaryOpcodeTable<Mode>[bytes[pos]];
+    if (cls & ClassEscape) {
+        MandatoryPrefix prefix = mandatoryPrefix(prefixes);
+        size_t map = 0;
+        cls = escapeLengthClassTable<Mode>[map][bytes[++pos]][prefix];
+        if (cls & ClassEscape) {
+            map = bytes[pos] == 0x38 ? 1 : 2;
+            cls = escapeLengthClassTable<Mode>[map][bytes[++pos]][prefix];
+        }
+        entry = &escapeOpcodeTable<Mode>[map][bytes[pos]][prefix];
+    } else if ((cls & ClassVex) && (Mode == CpuMode::Bits64 || (bytes[pos + 1] >> 6) == 3)) {
+        // VEX/EVEX: the same checks as decodeVex(), then the class of the
+        // opcode in the VEX or EVEX map that the prefix selects.
+        if ((prefixes & (PrefixOperandSize | PrefixLock | PrefixRep | PrefixRepne)) || rex != 0) {
+            return 0;
+        }
+        uint8_t first = bytes[pos];
+        uint8_t p0 = bytes[pos + 1];
+        size_t map = 0;
+        MandatoryPrefix prefix;
+        if (first == 0xC5) {
+            prefix = static_cast<MandatoryPrefix>(p0 & 0x03);
+            pos += 2;
+        } else {
+            uint8_t p1 = bytes[pos + 2];
+            prefix = static_cast<MandatoryPrefix>(p1 & 0x03);
+            if (first == 0x62 && ((p0 & 0x0C) != 0 || (p1 & 0x04) == 0)) {
+                return 0;
+            }
+            map = (p0 & (first == 0x62 ? 0x03 : 0x1F)) - 1;
+            if (map > 2) {
+                return 0;
+            }
+            pos += first == 0x62 ? 4 : 3;
+        }
+        const auto& classes = first == 0x62 ? evexLengthClassTable<Mode> : vexLengthClassTable<Mode>;
+        const auto& maps = first == 0x62 ? evexOpcodeTable<Mode> : vexOpcodeTable<Mode>;
+        cls = classes[map][bytes[pos]][prefix];
+        entry = &maps[map][bytes[pos]][prefix];
+    }
+    if (cls & ClassInvalid) {
+        return 0;
+    }
+
+    pos++;
+    if (cls & ClassModRM) {
+        uint8_t modrm = bytes[pos++];
+        if (cls & ClassModRMRegister) {
+            modrm |= 0xC0;
+        }
+        if ((cls & ClassSpecial) && (modrm >> 6) == 3) {
+            cls = static_cast<uint16_t>(cls & ~ClassGroup & ~ClassImmMask);
+        }
+        if (cls & ClassGroup) {
+            cls = groupLengthClassTable<Mode>[entry->group][(modrm >> 3) & 0x07];
+            if (cls & ClassInvalid) {
+                return 0;
+            }
+        }
+        if ((cls & ClassMemoryOnly) && (modrm >> 6) == 3) {
+            return 0;
+        }
+        if ((cls & ClassRegisterOnly) && (modrm >> 6) != 3) {
+            return 0;
+        }
+        if ((cls & ClassModRMF8) && modrm != 0xF8) {
+            return 0;
+        }
+        if (Mode != CpuMode::Bits64 && addressSizeBits(Mode, prefixes) == 16) {
+            pos += modrmTail16Table[modrm];
+        } else {
+            uint8_t tail = modrmTailTable[modrm];
+            if (tail == 0xFF) {
+                tail = (bytes[pos] & 0x07) == 5 ? 5 : 1;
+            }
+            pos += tail;
+        }
+    }
+
+    // Immediates never depend on OpDefault64/OpForce64: those only widen
+    // 32-bit operands to 64 bits, and a z-sized immediate stays 4 bytes.
+    int operandBits = operandSizeBits(Mode, prefixes, rex, 0);
+    switch (cls & ClassImmMask) {
+        case ClassImmNone: break;
+        case ClassImm1: pos += 1; break;
+        case ClassImm2: pos += 2; break;
+        case ClassImm3: pos += 3; break;
+        case ClassImm4: pos += 4; break;
+        case ClassImmSizeZ: pos += operandBits == 16 ? 2 : 4; break;
+        case ClassImmSizeV: pos += static_cast<size_t>(operandBits / 8); break;
+        case ClassImmMoffs: pos += static_cast<size_t>(addressSizeBits(Mode, prefixes) / 8); break;
+        case ClassImmFar: pos += operandBits == 16 ? 4 : 6; break;
+    }
+    return pos <= maxInstructionLength ? pos : 0;
+}
+
+template <CpuMode Mode>
+static void decodeLengthsIn(std::span<const uint8_t> code, std::vector<uint8_t>& lengths) {
+    lengths.reserve(lengths.size() + code.size() / 3 + 1);
+
+    const uint8_t* data = code.data();
+    size_t size = code.size();
+    size_t i = 0;
+
+    // Same split as decodeInstructions(): in place while a whole instruction
+    // fits, then from a zero-padded copy for the tail. Class 0 is a complete
+    // one-byte instruction (the byte classifier's simple class); where two
+    // of them follow each other, the classifier finds the end of the run
+    // (int3/nop padding, push/pop sequences) a block at a time.
+    ByteClassifier classify = byteClassifier(Mode, activeByteClassifierKernel());
+    while (size - i >= maxInstructionLength) {
+        if (lengthClassTable<Mode>[data[i]] == 0) {
+            size_t run = 1;
+            if (lengthClassTable<Mode>[data[i + 1]] == 0 && size - i >= byteClassBlockSize) {
+                run = static_cast<size_t>(std::countr_one(classify(data + i)));
+            }
+            lengths.insert(lengths.end(), run, 1);
+            i += run;
+            continue;
+        }
+        size_t length = instructionLength<Mode>(data + i);
+        if (length == 0) {
+            length = 1;
+        }
+        lengths.push_back(static_cast<uint8_t>(length));
+        i += length;
+    }
+    while (i < size) {
+        uint8_t window[maxInstructionLength] = {};
+        std::memcpy(window, data + i, size - i);
+        size_t length = instructionLength<Mode>(window);
+        if (length == 0 || length > size - i) {
+            length = 1;
+        }
+        lengths.push_back(static_cast<uint8_t>(length));
+        i += length;
+    }
+}
+
+void decodeLengths(std::span<const uint8_t> code, std::vector<uint8_t>& lengths, CpuMode mode) {
+    switch (mode) {
+        case CpuMode::Bits32: decodeLengthsIn<CpuMode::Bits32>(code, lengths); break;
+        case CpuMode::Bits16: decodeLengthsIn<CpuMode::Bits16>(code, lengths); break;
+        default: decodeLengthsIn<CpuMode::Bits64>(code, lengths); break;
+    }
+}
+
+void printLengths(std::span<const uint8_t> lengths, uint64_t baseAddress, OutputWriter& out) {
+    uint64_t lastAddress = baseAddress;
+    for (size_t n = 0; n + 1 < lengths.size(); n++) {
+        lastAddress += lengths[n];
+    }
+    int digits = addressDigits(lastAddress);
+    uint64_t address = baseAddress;
+    for (uint8_t length : lengths) {
+        out.reserveLine();
+        out.hex(address, digits);
+        out << ": ";
+        out.dec(static_cast<uint32_t>(length));
+        out << '\n';
+        address += length;
+    }
+}
@@ -1,320 +1,607 @@
+#include <algorithm>
 #include <iostream>
-#include <fstream>
+#include <span>
+#include <string>
+#include <string_view>
 #include <vector>
 #include <cstdint>  // For fixed-width integer types (uint8_t, uint32_t)
+#include <cstdlib>
 #include <cstring>
-#include <iomanip>
 
-// The ELF header is defined in a packed format, so we disable padding.
-#if defined(_MSC_VER)
-    #pragma pack(push, 1)
-#elif defined(__GNUC__)
-    #pragma pack(push, 1)
-#endif
-
-// Definition for 32-bit ELF header (Elf32_Ehdr)
-// This structure is based on the System V Application Binary Interface (ABI)
-// for the ELF format. For more details, see:
-//   - "System V Application Binary Interface, Edition 4"
-//   - The "ELF" specification (search for "ELF header" online).
-struct Elf32_Ehdr {
-    unsigned char e_ident[16]; // Magic number and other info
-    uint16_t e_type;           // Object file type
-    uint16_t e_machine;        // Architecture (e.g., EM_386)
-    uint32_t e_version;        // Object file version
-    uint32_t e_entry;          // Entry point virtual address
-    uint32_t e_phoff;          // Program header table file offset
-    uint32_t e_shoff;          // Section header table file offset
-    uint32_t e_flags;          // Processor-specific flags
-    uint16_t e_ehsize;         // ELF header size in bytes
-    uint16_t e_phentsize;      // Program header table entry size
-    uint16_t e_phnum;          // Program header table entry count
-    uint16_t e_shentsize;      // Section header table entry size
-    uint16_t e_shnum;          // Section header table entry count
-    uint16_t e_shstrndx;       // Section header string table index
+#include "analysis_cache.h"
+#include "batch.h"
+#include "benchmark.h"
+#include "binary_image.h"
+#include "control_flow_graph.h"
+#include "disassembler.h"
+#include "elf.h"
+#include "function_analysis.h"
+#include "incremental.h"
+#include "output_writer.h"
+#include "parallel_disassembler.h"
+#include "recursive_disassembler.h"
+#include "signature_scanner.h"
+#include "symbol_table.h"
+#include "xref.h"
+
+// What the user asked for on the command line.
+enum class Mode {
+    Disassemble,  // Full listing (default)
+    Recursive,    // Listing of the code reachable from the entry point and symbols
+    Graph,        // Basic blocks and edges of the reachable code
+    Functions,    // Per-function decode and CFG summary
+    Xrefs,        // References to and from one address or function
+    Diff,         // Instructions changed by a byte patch
+    LengthsOnly,  // Instruction boundaries only
+    Benchmark,    // Decoder throughput report
+    Scan,         // Byte signature matches
 };
 
-// Definition for 64-bit ELF header (Elf64_Ehdr)
-struct Elf64_Ehdr {
-    unsigned char e_ident[16]; // Magic number and other info
-    uint16_t e_type;           // Object file type
-    uint16_t e_machine;        // Architecture (e.g., EM_X86_64)
-    uint32_t e_version;        // Object file version
-    uint64_t e_entry;          // Entry point virtual address
-    uint64_t e_phoff;          // Program header table file offset
-    uint64_t e_shoff;          // Section header table file offset
-    uint32_t e_flags;          // Processor-specific flags
-    uint16_t e_ehsize;         // ELF header size in bytes
-    uint16_t e_phentsize;      // Program header table entry size
-    uint16_t e_phnum;          // Program header table entry count
-    uint16_t e_shentsize;      // Section header table entry size
-    uint16_t e_shnum;          // Section header table entry count
-    uint16_t e_shstrndx;       // Section header string table index
+struct Options {
+    Mode mode = Mode::Disassemble;
+    unsigned threads = 1;  // 0 = one per hardware thread
+    const char* path = nullptr;
+    const char* xrefTarget = nullptr;  // Address or symbol name for --xrefs
+    const char* cacheDir = nullptr;    // Where analysis caches are kept
+    const char* diffBase = nullptr;    // Unpatched file for --diff
+    const char* rangeStart = nullptr;  // --start address
+    const char* rangeStop = nullptr;   // --stop address
+    const char* function = nullptr;    // --function name or address
+    const char* batchInput = nullptr;  // Directory or list file for --batch
+    const char* outputDir = nullptr;   // Where --batch writes its listings
+    const char* signatures = nullptr;  // Signature rules for --scan
 };
 
-// ELF64 Section Header structure.
-// Each section header describes a section (for example, the .text section contains code).
-struct Elf64_Shdr {
-    uint32_t sh_name;      // Offset into the section header string table for this section's name
-    uint32_t sh_type;      // Section type (e.g., SHT_PROGBITS)
-    uint64_t sh_flags;     // Section flags (e.g., executable, writable, etc.)
-    uint64_t sh_addr;      // Virtual address of the section in memory
-    uint64_t sh_offset;    // File offset where the section data begins
-    uint64_t sh_size;      // Size of the section in bytes
-    uint32_t sh_link;      // Section header table index link (meaning depends on section type)
-    uint32_t sh_info;      // Extra information (depends on section type)
-    uint64_t sh_addralign; // Alignment of the section in memory
-    uint64_t sh_entsize;   // Size of each entry if the section holds a table of fixed-size entries
-};
+static void printUsage(const char* program) {
+    std::cerr << "Usage: " << program << " [options] <file>\n"
+              << "       " << program << " --batch <dir|list> --out-dir <dir> [--threads N]\n"
+              << "Options:\n"
+              << "  --recursive      Follow control flow from the entry point and function symbols\n"
+              << "  --cfg            Print the basic blocks and edges of the reachable code\n"
+              << "  --functions      Analyze every function found in symbols and .eh_frame\n"
+              << "  --xrefs ADDR     List references to and from an address or function name\n"
+              << "  --cache DIR      Reuse (or create) a cached decode, CFG and symbol index in DIR\n"
+              << "  --diff OLD       Show the instructions a byte patch changed relative to OLD\n"
+              << "  --start ADDR     Disassemble from ADDR only (with --stop: up to ADDR)\n"
+              << "  --stop ADDR      Stop disassembling at ADDR\n"
+              << "  --function NAME  Disassemble one function, by name or start address\n"
+              << "  --lengths-only   Print instruction boundaries (address: length) only\n"
+              << "  --bench          Measure full vs length-only decoding throughput\n"
+              << "  --scan RULES     Search the code for the byte signatures in RULES (name: 48 8b ?? e8)\n"
+              << "  --threads N      Decode and format on N threads (0 = all cores)\n"
+              << "  --batch INPUT    Disassemble every file in a directory tree or list file\n"
+              << "  --out-dir DIR    Directory that receives one listing per batch file\n";
+}
 
-// Restore the default packing of structure members
-#if defined(_MSC_VER) || defined(__GNUC__)
-    #pragma pack(pop)
-#endif
+// Seeds recursive from the entry point and every function symbol and runs
+// it; whatever they reach through direct branches and calls is decoded.
+static void runRecursive(RecursiveDisassembler& recursive, uint64_t entry, const SymbolTable& symbols) {
+    recursive.addSeed(entry);
+    for (const Symbol& symbol : symbols.symbols()) {
+        if (symbol.type == STT_FUNC) {
+            recursive.addSeed(symbol.address);
+        }
+    }
+    recursive.run();
+}
 
-// Constants for identifying ELF files via e_ident[]
-constexpr int EI_MAG0    = 0;  // File identification index 0
-constexpr int EI_MAG1    = 1;  // File identification index 1
-constexpr int EI_MAG2    = 2;  // File identification index 2
-constexpr int EI_MAG3    = 3;  // File identification index 3
-constexpr int EI_CLASS   = 4;  // File class: 1 = 32-bit, 2 = 64-bit
-constexpr int EI_DATA    = 5;  // Data encoding: 1 = little endian, 2 = big endian
-constexpr int EI_VERSION = 6;  // File version
-constexpr int EI_OSABI   = 7;  // Operating system/ABI identification
+// Decodes every region (linear sweep and recursive traversal), builds the
+// graphs of the reachable code, writes them with symbols to a cache file at
+// path and opens it into cache.
+static bool buildAnalysisCache(const std::string& path, std::span<const uint8_t> key, const ElfView& elf,
+                               std::span<const CodeRegion> regions, const SymbolTable& symbols, unsigned threads,
+                               AnalysisCache& cache) {
+    std::vector<RegionAnalysis> analyses(regions.size());
+    for (size_t k = 0; k < regions.size(); k++) {
+        if (threads == 1) {
+            decodeInstructions(regions[k].bytes, analyses[k].linear, regions[k].mode);
+        } else {
+            decodeInstructionsParallel(regions[k].bytes, analyses[k].linear, threads, regions[k].mode);
+        }
+    }
+    RecursiveDisassembler recursive(regions);
+    runRecursive(recursive, elf.entry(), symbols);
+    for (size_t k = 0; k < recursive.regionCount(); k++) {
+        // The traversal orders regions by address; map back to ours.
+        RegionAnalysis& analysis = analyses[&recursive.region(k) - regions.data()];
+        std::span<const DecodedInstruction> reachable = recursive.instructions(k);
+        analysis.reachable.assign(reachable.begin(), reachable.end());
+        analysis.graph.build(recursive.region(k).bytes, analysis.reachable);
+    }
+    std::span<const uint8_t> file = elf.bytes();
+    return AnalysisCache::write(path, key, file, regions, analyses, symbols) && cache.open(path, key, file, regions);
+}
 
-// Expected magic numbers for ELF files
-constexpr unsigned char ELFMAG0 = 0x7f;
-constexpr unsigned char ELFMAG1 = 'E';
-constexpr unsigned char ELFMAG2 = 'L';
-constexpr unsigned char ELFMAG3 = 'F';
+// Indices of regions in address order, the order a RecursiveDisassembler
+// lists them in; used to print cached traversal results the same way.
+static std::vector<size_t> addressOrder(std::span<const CodeRegion> regions) {
+    std::vector<size_t> order(regions.size());
+    for (size_t k = 0; k < order.size(); k++) {
+        order[k] = k;
+    }
+    std::stable_sort(order.begin(), order.end(),
+                     [&](size_t a, size_t b) { return regions[a].address < regions[b].address; });
+    return order;
+}
 
-// Function to check whether a file is an ELF file
-// It does this by checking the first 4 bytes of the file for the magic number
-bool isELF(const std::vector<uint8_t>& data) {
-    if (data.size() < 4) {
-        return false;
+// Appends " (file offset 0x...)" for address, if it is backed by the file.
+static void writeFileOffset(OutputWriter& out, const AddressMap& addressMap, uint64_t address) {
+    uint64_t offset;
+    if (addressMap.toFileOffset(address, offset)) {
+        out << " (file offset 0x";
+        out.hex(offset);
+        out << ')';
     }
-    return (data[EI_MAG0] == ELFMAG0 &&
-            data[EI_MAG1] == ELFMAG1 &&
-            data[EI_MAG2] == ELFMAG2 &&
-            data[EI_MAG3] == ELFMAG3);
 }
 
-// Function to print the details from the ELF header
-// It distinguishes between 32-bit and 64-bit headers
-void printELFHeader(const std::vector<uint8_t>& data) {
-    if (!isELF(data)) {
-        std::cout << "Not an ELF file" << std::endl;
-        return;
+// Compares file with the unpatched before (same size) region by region and
+// prints every stretch of instructions the patch changed, before and after.
+// The old linear sweep comes from before's analysis cache when there is one,
+// so neither file is decoded in full.
+static bool runDiff(std::span<const uint8_t> file, std::span<const uint8_t> before,
+                    const ElfSectionTable* sectionTable, const AddressMap& addressMap,
+                    std::span<const CodeRegion> regions,
+                    const SymbolTable& symbols, const char* cacheDir, OutputWriter& out) {
+    if (before.size() != file.size()) {
+        std::cerr << "Error: --diff compares a byte patch; the files differ in size\n";
+        return false;
+    }
+    // The same regions, viewing the old bytes.
+    std::vector<CodeRegion> oldRegions(regions.begin(), regions.end());
+    for (CodeRegion& region : oldRegions) {
+        region.bytes = before.subspan(region.offset, region.bytes.size());
+    }
+    AnalysisCache cache;
+    if (cacheDir != nullptr) {
+        std::vector<uint8_t> key = computeCacheKey(before, sectionTable);
+        cache.open(cachePath(cacheDir, key), key, before, oldRegions);
     }
-    // e_ident[EI_CLASS] indicates the class:
-    // 1 means ELF32; 2 means ELF64.
-    uint8_t elfClass = data[EI_CLASS];
 
-    if (elfClass == 1) { // ELF32
-        if (data.size() < sizeof(Elf32_Ehdr)) {
-            std::cout << "File is too small to be a valid ELF32 file" << std::endl;
-            return;
+    std::vector<ByteRange> changes;
+    std::vector<DecodedInstruction> decoded;
+    std::vector<PatchWindow> windows;
+    size_t changedBytes = 0;
+    size_t windowCount = 0;
+    for (size_t k = 0; k < regions.size(); k++) {
+        const CodeRegion& region = regions[k];
+        std::span<const uint8_t> oldBytes = oldRegions[k].bytes;
+        changes.clear();
+        findChangedRanges(oldBytes, region.bytes, changes);
+        if (changes.empty()) {
+            continue;
         }
-        const Elf32_Ehdr* hdr = reinterpret_cast<const Elf32_Ehdr*>(data.data());
-        std::cout << "File is an ELF32 file" << std::endl;
-        std::cout << "ELF32 Header:" << std::endl;
-        std::cout << "Magic: ";
-        for (int i = 0; i < 4; i++)
-            std::cout << std::hex << static_cast<int>(hdr->e_ident[i]) << " ";
-        std::cout << std::dec << std::endl;
-
-        std::cout << "Class: " << (hdr->e_ident[EI_CLASS] == 1 ? "ELF32" : "Unknown") << std::endl;
-
-        // Data encoding: 1 = little endian, 2 = big endian
-        std::cout << "Data: " << (hdr->e_ident[EI_DATA] == 1 ? "little endian" : "big endian") << std::endl;
-
-        // ELF version
-        std::cout << "Version: " << hdr->e_ident[EI_VERSION] << std::endl;
-
-        // OS/ABI identification
-        std::cout << "OS/ABI: " << static_cast<int>(hdr->e_ident[EI_OSABI]) << std::endl;
-
-        // Object file type (e.g., relocatable, executable, shared object, core file).
-        std::cout << "Type: 0x" << std::hex << hdr->e_type << std::dec << std::endl;
-
-        // Machine type (e.g., 0x03 for x86).
-        std::cout << "Machine: 0x" << std::hex << hdr->e_machine << std::dec << std::endl;
-
-        // Entry point address
-        std::cout << "Entry: 0x" << std::hex << hdr->e_entry << std::dec << std::endl;
-    } else if (elfClass == 2) { // ELF64
-        if (data.size() < sizeof(Elf64_Ehdr)) {
-            std::cout << "File is too small to be a valid ELF64 file" << std::endl;
-            return;
+        std::span<const DecodedInstruction> previous;
+        if (cache.isOpen()) {
+            previous = cache.linearInstructions(k);
+        } else {
+            decoded.clear();
+            decodeInstructions(oldBytes, decoded, region.mode);
+            previous = decoded;
         }
-        const Elf64_Ehdr* hdr = reinterpret_cast<const Elf64_Ehdr*>(data.data());
-        std::cout << "File is an ELF64 file" << std::endl;
-
-        // Print magic numbers.
-        std::cout << "Magic: ";
-        for (int i = 0; i < 16; i++)
-            std::cout << std::hex << static_cast<int>(hdr->e_ident[i]) << " ";
-        std::cout << std::dec << std::endl;
-
-        // Print class information.
-        std::cout << "Class: " << (elfClass == 2 ? "ELF64" : "Unknown") << std::endl;
-
-        // Data encoding.
-        uint8_t dataEncoding = hdr->e_ident[EI_DATA];
-        std::cout << "Data: " << (dataEncoding == 1 ? "Little Endian" : "Big Endian") << std::endl;
-
-        // ELF version.
-        std::cout << "Version: " << static_cast<int>(hdr->e_ident[EI_VERSION]) << std::endl;
+        windows.clear();
+        redecodeChanges(region.bytes, previous, changes, windows, region.mode);
 
-        // OS/ABI.
-        std::cout << "OS/ABI: " << static_cast<int>(hdr->e_ident[EI_OSABI]) << std::endl;
-
-        // Object file type.
-        std::cout << "Type: 0x" << std::hex << hdr->e_type << std::dec << std::endl;
+        for (const ByteRange& change : changes) {
+            changedBytes += change.end - change.begin;
+        }
+        for (const PatchWindow& window : windows) {
+            const DecodedInstruction& last = window.records.back();
+            out << "\nPatched " << region.name << ' ' << region.kind << " at 0x";
+            out.hex(region.address + window.records.front().offset);
+            out << "-0x";
+            out.hex(region.address + last.offset + last.length);
+            writeFileOffset(out, addressMap, region.address + window.records.front().offset);
+            out << ": ";
+            out.dec(static_cast<uint64_t>(window.oldCount));
+            out << " instructions replaced by ";
+            out.dec(static_cast<uint64_t>(window.records.size()));
+            out << "\nBefore:\n";
+            printInstructions(oldBytes, previous.subspan(window.first, window.oldCount), region.address, out, &symbols);
+            out << "After:\n";
+            printInstructions(region.bytes, window.records, region.address, out, &symbols);
+        }
+        windowCount += windows.size();
+    }
+    out << "\n";
+    out.dec(static_cast<uint64_t>(changedBytes));
+    out << " bytes of code changed, ";
+    out.dec(static_cast<uint64_t>(windowCount));
+    out << (windowCount == 1 ? " stretch" : " stretches") << " re-decoded\n";
+    return true;
+}
 
-        // Machine type.
-        std::cout << "Machine: 0x" << std::hex << hdr->e_machine << std::dec << std::endl;
+// Parses a decimal or 0x-prefixed address. Returns false if text is not one.
+static bool parseAddress(const char* text, uint64_t& address) {
+    char* rest = nullptr;
+    address = std::strtoull(text, &rest, 0);
+    return rest != text && *rest == '\0';
+}
 
-        // Entry point address.
-        std::cout << "Entry point: 0x" << std::hex << hdr->e_entry << std::dec << std::endl;
+// Resolves a symbol name or a number (decimal or 0x-prefixed hex) to an
+// address range: the whole symbol when it names one or is a symbol's start
+// address, otherwise the single byte. Returns false if it is neither.
+static bool resolveTarget(const char* text, const SymbolTable& symbols, uint64_t& begin, uint64_t& end) {
+    const Symbol* symbol = symbols.findByName(text);
+    if (symbol == nullptr) {
+        if (!parseAddress(text, begin)) {
+            return false;
+        }
+        symbol = symbols.lookup(begin);
+        if (symbol != nullptr && symbol->address != begin) {
+            symbol = nullptr;
+        }
     }
-    else {
-        std::cout << "Unknown ELF class: " << static_cast<int>(elfClass) << std::endl;
+    if (symbol != nullptr) {
+        begin = symbol->address;
+        end = begin + std::max<uint64_t>(symbol->size, 1);
+    } else {
+        end = begin + 1;
     }
+    return true;
 }
 
-bool findTextSection(const std::vector<uint8_t>& fileData,
-                    const Elf64_Ehdr* elfHeader,
-                    uint64_t& textSectionOffset,
-                    uint64_t& textSectionSize) {
-    if (elfHeader->e_shoff == 0 || elfHeader->e_shnum == 0) {
-        std::cout << "No section header table found" << std::endl;
+// Resolves --function to the function's range: its .eh_frame extent or
+// symbol size, or up to the next function when neither is known.
+static bool resolveFunction(const char* text, std::span<const uint8_t> file, const ElfSectionTable* sectionTable,
+                            const SymbolTable& symbols, std::span<const CodeRegion> regions,
+                            uint64_t& begin, uint64_t& end) {
+    if (!resolveTarget(text, symbols, begin, end)) {
         return false;
     }
-    // The section header table is located at the file offset specified by e_shoff.
-    // Each entry in the section header table has a size specified by e_shentsize.
-    // The number of entries in the section header table is specified by e_shnum.
-    // The section header string table index is specified by e_shstrndx.
-    uint64_t sectionHeaderOffset = elfHeader->e_shoff;
-    uint16_t sectionHeaderSize = elfHeader->e_shentsize;
-    uint16_t sectionCount = elfHeader->e_shnum;
-    uint16_t sectionStringTableIndex = elfHeader->e_shstrndx;
-
-    const Elf64_Shdr* sectionHeaders = reinterpret_cast<const Elf64_Shdr*>(fileData.data() + sectionHeaderOffset);
-
-    if (sectionStringTableIndex >= sectionCount) {
-        std::cout << "Invalid section string table index" << std::endl;
-        return false;
+    std::vector<FunctionInfo> functions;
+    discoverFunctions(file, sectionTable, symbols, regions, functions);
+    auto it = std::lower_bound(functions.begin(), functions.end(), begin,
+        [](const FunctionInfo& function, uint64_t value) { return function.start < value; });
+    if (it != functions.end() && it->start == begin) {
+        end = it->end;
     }
+    return true;
+}
 
-    const Elf64_Shdr sectionStringTableHeader = sectionHeaders[sectionStringTableIndex];
-
-    // Pointer to the section header string table.
-    const char* sectionStringTable = reinterpret_cast<const char*>(fileData.data() + sectionStringTableHeader.sh_offset);
-
-    // Iterate over the section headers to find the .text section.
-    for (uint16_t i = 0; i < sectionCount; i++) {
-        const Elf64_Shdr& sh = sectionHeaders[i];
-        // sh_name contains the offset in the section header string table where the name of the section is stored.
-        const char* sectionName = sectionStringTable + sh.sh_name;
-        if (std::strcmp(sectionName, ".text") == 0) {
-            textSectionOffset = sh.sh_offset;
-            textSectionSize = sh.sh_size;
-            std::cout << "Found .text section at offset 0x" << std::hex << textSectionOffset << std::dec
-                      << " with size 0x" << std::hex << textSectionSize << std::dec << std::endl;
-            return true;
+// Disassembles the part of every region that overlaps [begin, end),
+// decoding nothing outside it. Returns false if no code lies in the range.
+static bool disassembleAddressRange(std::span<const CodeRegion> regions, const AddressMap& addressMap,
+                                    uint64_t begin, uint64_t end, OutputWriter& out, const SymbolTable& symbols) {
+    bool found = false;
+    for (const CodeRegion& region : regions) {
+        uint64_t regionEnd = region.address + region.bytes.size();
+        if (begin >= regionEnd || end <= region.address) {
+            continue;
         }
+        uint64_t first = std::max(begin, region.address);
+        uint64_t last = std::min(end, regionEnd);
+        out << (found ? "\n" : "") << "Disassembly of " << region.name << ' ' << region.kind << " from 0x";
+        out.hex(first);
+        out << " to 0x";
+        out.hex(last);
+        writeFileOffset(out, addressMap, first);
+        out << ":\n";
+        disassembleRange(region.bytes, first - region.address, last - region.address, region.address, out, &symbols,
+                         region.mode);
+        found = true;
     }
-    std::cout << "No .text section found" << std::endl;
-    return false;
-
-}
-
-
-// A helper function to read a 32-bit little-endian integer from a byte vector.
-// We assume that the code vector has enough bytes starting at index.
-uint32_t read32(const std::vector<uint8_t>& code, size_t index) {
-    return  static_cast<uint32_t>(code[index])                  | // Byte 0: least significant
-            (static_cast<uint32_t>(code[index+1]) << 8)         | // Byte 1
-            (static_cast<uint32_t>(code[index+2]) << 16)        | // Byte 2
-            (static_cast<uint32_t>(code[index+3]) << 24);         // Byte 3: most significant
-
+    if (!found) {
+        std::cerr << "No code between 0x" << std::hex << begin << " and 0x" << end << std::dec << '\n';
+    }
+    return found;
 }
 
-
-// This function disassembles a buffer of code bytes. For demonstration, we only
-// recognize two kinds of instructions:
-//   - 0xB8-0xBF: "mov reg, imm32" (we map these to 64-bit registers: rax, rcx, ...)
-//   - 0x90: "nop"
-// All other bytes are simply output as "db" directives.
-void disassemble(const std::vector<uint8_t>& code, uint64_t baseAddress = 0) {
-    size_t i = 0;
-
-    while (i < code.size()) {
-        std::cout << std::hex << std::setw(4) << std::setfill('0') << (baseAddress + i) << ": ";
-        uint8_t opcode = code[i];
-
-        if (opcode >= 0xB8 && opcode <= 0xBF) {
-            if (i + 4 > code.size()) {
-                std::cerr << "Unexpected end of code" << std::endl;
-                return;
-            }
-            uint32_t imm = read32(code, i + 1);
-
-            int reg = opcode - 0xB8;
-
-            const char* reg_names[] = {"rax", "rcx", "rdx", "rbx", "rsp", "rbp", "rsi", "rdi"};
-
-            std::cout << "mov " << reg_names[reg] << ", 0x" << std::hex << imm << std::endl;
-
-            i+=5;
-        } else if (opcode == 0x90) {
-            std::cout << "nop" << std::endl;
-            i++;
+// Parses argv into options. Returns false (after printing usage) on error.
+static bool parseArguments(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; i++) {
+        std::string_view arg = argv[i];
+        if (arg == "--recursive") {
+            options.mode = Mode::Recursive;
+        } else if (arg == "--cfg") {
+            options.mode = Mode::Graph;
+        } else if (arg == "--functions") {
+            options.mode = Mode::Functions;
+        } else if (arg == "--xrefs" && i + 1 < argc) {
+            options.mode = Mode::Xrefs;
+            options.xrefTarget = argv[++i];
+        } else if (arg == "--cache" && i + 1 < argc) {
+            options.cacheDir = argv[++i];
+        } else if (arg == "--diff" && i + 1 < argc) {
+            options.mode = Mode::Diff;
+            options.diffBase = argv[++i];
+        } else if (arg == "--start" && i + 1 < argc) {
+            options.rangeStart = argv[++i];
+        } else if (arg == "--stop" && i + 1 < argc) {
+            options.rangeStop = argv[++i];
+        } else if (arg == "--function" && i + 1 < argc) {
+            options.function = argv[++i];
+        } else if (arg == "--lengths-only") {
+            options.mode = Mode::LengthsOnly;
+        } else if (arg == "--bench") {
+            options.mode = Mode::Benchmark;
+        } else if (arg == "--scan" && i + 1 < argc) {
+            options.mode = Mode::Scan;
+            options.signatures = argv[++i];
+        } else if (arg == "--threads" && i + 1 < argc) {
+            options.threads = static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 10));
+        } else if (arg == "--batch" && i + 1 < argc) {
+            options.batchInput = argv[++i];
+        } else if (arg == "--out-dir" && i + 1 < argc) {
+            options.outputDir = argv[++i];
+        } else if (arg.starts_with("--") || options.path != nullptr) {
+            printUsage(argv[0]);
+            return false;
         } else {
-            std::cout << "db 0x" << std::setw(2) << std::setfill('0') << static_cast<int>(opcode) << std::endl;
-            i++;
+            options.path = argv[i];
         }
     }
+    // Batch mode replaces the single input file and needs somewhere to put
+    // its listings.
+    bool batch = options.batchInput != nullptr;
+    bool range = options.rangeStart != nullptr || options.rangeStop != nullptr;
+    if ((range || options.function != nullptr) &&
+        (batch || options.mode != Mode::Disassemble || (range && options.function != nullptr))) {
+        printUsage(argv[0]);
+        return false;
+    }
+    if (batch ? (options.path != nullptr || options.outputDir == nullptr || options.mode != Mode::Disassemble ||
+                 options.cacheDir != nullptr)
+              : (options.path == nullptr || options.outputDir != nullptr)) {
+        printUsage(argv[0]);
+        return false;
+    }
+    return true;
 }
 
 int main(int argc, char** argv) {
-    if (argc < 2) {
-        std::cerr << "Usage: " << argv[0] << " <file>" << std::endl;
+    Options options;
+    if (!parseArguments(argc, argv, options)) {
         return 1;
     }
+    if (options.batchInput != nullptr) {
+        return runBatch(options.batchInput, options.outputDir, options.threads) ? 0 : 1;
+    }
 
-    std::ifstream file(argv[1], std::ios::binary);
-    if (!file) {
-        std::cerr << "Failed to open file: " << argv[1] << std::endl;
+    // Map the file read-only; the image stays in the page cache and every
+    // function below works on views into it instead of heap copies.
+    BinaryImage image;
+    if (!image.open(options.path)) {
         return 1;
     }
 
-    std::vector<uint8_t> code((std::istreambuf_iterator<char>(file)),
-                                std::istreambuf_iterator<char>());
-
-    file.close();
-    printELFHeader(code);
-    const Elf64_Ehdr* elfHeader = reinterpret_cast<const Elf64_Ehdr*>(code.data());
-
+    // All listing output goes through one buffered writer on stdout.
+    OutputWriter out(stdout);
 
-    // Locate the .text session
-    uint64_t textSectionOffset = 0, textSize = 0;
-    if (!findTextSection(code, elfHeader, textSectionOffset, textSize)) {
+    std::span<const uint8_t> code = image.bytes();
+    printELFHeader(code, out);
+    // Everything below reads the file through views that were bounds-checked
+    // once here.
+    ElfView elf;
+    if (!elf.parse(code, out)) {
         return 1;
     }
 
-    // Check that the file contains the entire .text section.
-    if (textSectionOffset + textSize > code.size()) {
-        std::cerr << "Error: .text section exceeds file size.\n";
+    // Every executable section is decoded at its own sh_addr so addresses
+    // and branch targets match the loaded image; section-less binaries fall
+    // back to their executable segments.
+    ElfSectionTable sectionTable;
+    bool hasSections = sectionTable.load(elf, out);
+    std::vector<CodeRegion> regions;
+    if (!findCodeRegions(elf, hasSections ? &sectionTable : nullptr, regions, out)) {
         return 1;
     }
+    printCodeRegions(regions, out);
+
+    // Virtual address <-> file offset translation for reports that point
+    // back into the file.
+    ElfSegmentMap segmentMap;
+    bool hasSegments = elf.hasProgramHeaders() && segmentMap.load(elf, out);
+    AddressMap addressMap;
+    addressMap.build(hasSegments ? &segmentMap : nullptr, hasSections ? &sectionTable : nullptr);
+
+    // With --cache, a previous run's results for the same build are mapped
+    // instead of recomputed.
+    // --diff only reads the unpatched file's cache.
+    bool useCache = options.cacheDir != nullptr && options.mode != Mode::Diff;
+    AnalysisCache cache;
+    std::vector<uint8_t> cacheKey;
+    std::string cacheFile;
+    if (useCache) {
+        cacheKey = computeCacheKey(code, hasSections ? &sectionTable : nullptr);
+        cacheFile = cachePath(options.cacheDir, cacheKey);
+        cache.open(cacheFile, cacheKey, code, regions);
+    }
+
+    // Function names for labels and branch targets.
+    SymbolTable symbols;
+    if (cache.isOpen()) {
+        cache.loadSymbols(symbols);
+    } else if (hasSections) {
+        symbols.load(code, sectionTable);
+    }
+    if (!symbols.empty()) {
+        out << "Found ";
+        out.dec(static_cast<uint64_t>(symbols.size()));
+        out << " symbols\n";
+    }
+
+    if (useCache) {
+        if (cache.isOpen()) {
+            out << "Loaded analysis cache " << cacheFile << '\n';
+        } else if (buildAnalysisCache(cacheFile, cacheKey, elf, regions, symbols, options.threads, cache)) {
+            out << "Wrote analysis cache " << cacheFile << '\n';
+        }
+    }
 
-    // Extract the .text section into its own buffer.
-    std::vector<uint8_t> textSection(code.begin() + textSectionOffset, code.begin() + textSectionOffset + textSize);
-    std::cout << "Disassembly of .text section:" << std::endl;
-    disassemble(textSection, /** baseAddress = */ 0);
+    switch (options.mode) {
+        case Mode::Disassemble:
+            if (options.function != nullptr || options.rangeStart != nullptr || options.rangeStop != nullptr) {
+                uint64_t begin = 0;
+                uint64_t end = UINT64_MAX;
+                if (options.function != nullptr) {
+                    if (!resolveFunction(options.function, code, hasSections ? &sectionTable : nullptr, symbols,
+                                         regions, begin, end)) {
+                        std::cerr << "Unknown function: " << options.function << '\n';
+                        return 1;
+                    }
+                } else if ((options.rangeStart != nullptr && !parseAddress(options.rangeStart, begin)) ||
+                           (options.rangeStop != nullptr && !parseAddress(options.rangeStop, end))) {
+                    std::cerr << "Invalid address for --start or --stop\n";
+                    return 1;
+                }
+                if (!disassembleAddressRange(regions, addressMap, begin, end, out, symbols)) {
+                    return 1;
+                }
+                break;
+            }
+            for (size_t k = 0; k < regions.size(); k++) {
+                // Regions view the file in place; no bytes are copied.
+                const CodeRegion& region = regions[k];
+                out << (k == 0 ? "" : "\n") << "Disassembly of " << region.name << ' ' << region.kind << ":\n";
+                if (cache.isOpen()) {
+                    printInstructions(region.bytes, cache.linearInstructions(k), region.address, out, &symbols);
+                } else if (options.threads == 1) {
+                    disassemble(region.bytes, region.address, out, &symbols, region.mode);
+                } else {
+                    disassembleParallel(region.bytes, region.address, out, options.threads, &symbols, region.mode);
+                }
+            }
+            break;
+        case Mode::Recursive: {
+            if (cache.isOpen()) {
+                std::vector<size_t> order = addressOrder(regions);
+                for (size_t n = 0; n < order.size(); n++) {
+                    const CodeRegion& region = regions[order[n]];
+                    out << (n == 0 ? "" : "\n") << "Disassembly of " << region.name << ' ' << region.kind << ":\n";
+                    printReachedInstructions(region, cache.reachableInstructions(order[n]), out, &symbols);
+                }
+                break;
+            }
+            RecursiveDisassembler recursive(regions);
+            runRecursive(recursive, elf.entry(), symbols);
+            printRecursiveListing(recursive, out, &symbols);
+            break;
+        }
+        case Mode::Graph: {
+            // Blocks are built over the reachable code only, so data in
+            // code does not produce bogus blocks. Regions are listed in
+            // address order, as the traversal reports them.
+            std::vector<size_t> order(regions.size());
+            ControlFlowGraph graph;
+            RecursiveDisassembler recursive(regions);
+            if (cache.isOpen()) {
+                order = addressOrder(regions);
+            } else {
+                runRecursive(recursive, elf.entry(), symbols);
+                for (size_t k = 0; k < recursive.regionCount(); k++) {
+                    order[k] = static_cast<size_t>(&recursive.region(k) - regions.data());
+                }
+            }
+            for (size_t n = 0; n < order.size(); n++) {
+                const CodeRegion& region = regions[order[n]];
+                if (cache.isOpen()) {
+                    cache.loadGraph(order[n], graph);
+                } else {
+                    graph.build(region.bytes, recursive.instructions(n));
+                }
+                out << (n == 0 ? "" : "\n") << "Basic blocks of " << region.name << ' ' << region.kind << ": ";
+                out.dec(static_cast<uint64_t>(graph.blocks().size()));
+                out << " blocks, ";
+                out.dec(static_cast<uint64_t>(graph.edgeCount()));
+                out << " edges\n";
+                printControlFlowGraph(graph, region.address, out, &symbols);
+            }
+            break;
+        }
+        case Mode::Functions: {
+            // Functions are decoded and graphed independently, in parallel
+            // with --threads.
+            std::vector<FunctionInfo> functions;
+            discoverFunctions(code, hasSections ? &sectionTable : nullptr, symbols, regions, functions);
+            std::vector<FunctionSummary> summaries;
+            analyzeFunctions(regions, functions, summaries, options.threads);
+            printFunctionSummaries(functions, summaries, symbols, out);
+            break;
+        }
+        case Mode::Xrefs: {
+            uint64_t begin;
+            uint64_t end;
+            if (!resolveTarget(options.xrefTarget, symbols, begin, end)) {
+                std::cerr << "Unknown address or symbol: " << options.xrefTarget << '\n';
+                return 1;
+            }
+            // Index the linear sweep of every region, then answer the query.
+            XrefTable xrefs;
+            std::vector<DecodedInstruction> instructions;
+            for (size_t k = 0; k < regions.size(); k++) {
+                const CodeRegion& region = regions[k];
+                if (cache.isOpen()) {
+                    xrefs.add(region, cache.linearInstructions(k));
+                    continue;
+                }
+                instructions.clear();
+                if (options.threads == 1) {
+                    decodeInstructions(region.bytes, instructions, region.mode);
+                } else {
+                    decodeInstructionsParallel(region.bytes, instructions, options.threads, region.mode);
+                }
+                xrefs.add(region, instructions);
+            }
+            xrefs.finish(options.threads);
+            out << "Indexed ";
+            out.dec(static_cast<uint64_t>(xrefs.size()));
+            out << " references\n";
+            printXrefs(xrefs, begin, end, out, &symbols);
+            break;
+        }
+        case Mode::Diff: {
+            BinaryImage before;
+            if (!before.open(options.diffBase) ||
+                !runDiff(code, before.bytes(), hasSections ? &sectionTable : nullptr, addressMap, regions, symbols,
+                         options.cacheDir, out)) {
+                return 1;
+            }
+            break;
+        }
+        case Mode::LengthsOnly: {
+            std::vector<uint8_t> lengths;
+            for (size_t k = 0; k < regions.size(); k++) {
+                const CodeRegion& region = regions[k];
+                out << (k == 0 ? "" : "\n") << "Instruction lengths in " << region.name << ' ' << region.kind << ":\n";
+                lengths.clear();
+                decodeLengths(region.bytes, lengths, region.mode);
+                printLengths(lengths, region.address, out);
+            }
+            break;
+        }
+        case Mode::Benchmark: {
+            // Measure .text when there is one, otherwise the largest region.
+            auto region = std::find_if(regions.begin(), regions.end(),
+                [](const CodeRegion& r) { return r.name == ".text"; });
+            if (region == regions.end()) {
+                region = std::max_element(regions.begin(), regions.end(),
+                    [](const CodeRegion& a, const CodeRegion& b) { return a.bytes.size() < b.bytes.size(); });
+            }
+            out << "Benchmarking " << region->name << ' ' << region->kind << ":\n";
+            runDecodeBenchmark(region->bytes, out, options.threads, region->mode);
+            break;
+        }
+        case Mode::Scan: {
+            std::vector<Signature> signatures;
+            if (!loadSignatures(options.signatures, signatures)) {
+                return 1;
+            }
+            // Anchors are chosen by how common they are in the largest
+            // region.
+            std::span<const uint8_t> sample;
+            for (const CodeRegion& region : regions) {
+                if (region.bytes.size() > sample.size()) {
+                    sample = region.bytes;
+                }
+            }
+            SignatureScanner scanner;
+            scanner.build(std::move(signatures), sample);
+            std::vector<SignatureMatch> matches;
+            scanRegions(scanner, regions, options.threads, matches);
+            printSignatureMatches(scanner, regions, matches, out, &symbols);
+            break;
+        }
+    }
 
     return 0;
 }
\ No newline at end of file
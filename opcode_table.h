@@ -0,0 +1,1525 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include "decoded_instruction.h"
+
+struct OpcodeEntry;
+
+// Every opcode byte dispatches to a handler. A handler decodes the rest of the
+// instruction whose opcode byte is bytes[pos] into out and returns the total
+// instruction length, or 0 when the encoding is invalid. There is one opcode
+// table per CpuMode, whose handlers are instantiated for that mode, so the
+// mode never has to be tested while decoding.
+//
+// bytes always has at least maxInstructionLength readable bytes (the decoder
+// pads the tail of a buffer), so handlers never bounds-check individual
+// fields; the caller checks the returned length once per instruction.
+// Handlers never format text; see printInstructions() for that.
+using OpcodeHandler = size_t (*)(const uint8_t* bytes, size_t pos,
+                                 const OpcodeEntry& entry, DecodedInstruction& out);
+
+// Architectural limit on the length of one x86 instruction.
+constexpr size_t maxInstructionLength = 15;
+
+// Static operand descriptions, following the operand notation of the
+// Intel SDM opcode map (appendix A): the letter is the addressing method and
+// the suffix the operand size (b = byte, w = word, d = dword, q = qword,
+// v = 16/32/64 by operand size, z = 16/32, y = 32/64).
+enum class OperandSpec : uint8_t {
+    None,
+    // ModR/M r/m field: general-purpose register or memory
+    Eb, Ew, Ed, Ev, Ey,
+    // ModR/M reg field: general-purpose register
+    Gb, Gv, Gw,
+    // ModR/M r/m field, memory only (M: no size printed, t: 80-bit, x: 128-bit,
+    // p: far pointer)
+    M, Mb, Mw, Md, Mq, Mt, Mx, Mp,
+    // Immediates (Ibs: imm8 sign-extended to the operand size; Ap: far
+    // pointer, a 16/32-bit offset followed by a 16-bit segment selector)
+    Ib, Ibs, Iw, Iz, Iv, Ap,
+    // Relative branch targets
+    Jb, Jz,
+    // Register in the low three bits of the opcode (plus REX.B)
+    Zb, Zv,
+    // Fixed registers and constants
+    AL, CL, AX, DX, rAX, eAX, One,
+    // ModR/M reg field: segment register
+    Sw,
+    // Fixed segment registers (push/pop of a segment; only fs and gs in 64-bit mode)
+    ES, CS, SS, DS, FS, GS,
+    // Absolute memory offset (moffs) following the opcode
+    Ob, Ov,
+    // String operands: ds:[rsi] and es:[rdi]
+    Xb, Xv, Xz, Yb, Yv, Yz,
+    // x87 stack registers: st(0) and st(i) from ModR/M r/m
+    ST0, STi,
+    // Operands of the 0F maps. ModR/M reg field: xmm (V), mmx (P), control
+    // (C), debug (D) and 32-bit or 32/64-bit general-purpose registers (Gd, Gy)
+    Vx, Pq, Cd, Dd, Gd, Gy,
+    // ModR/M r/m field: xmm register or memory of the given size (W), mmx
+    // register or qword memory (Q), 32-bit register or byte/word memory,
+    // general-purpose register of operand size or word memory (RvMw)
+    Wx, Wq, Wd, Ww, Qq, RdMb, RdMw, RvMw,
+    // ModR/M r/m field, register only: xmm (U), mmx (N), general-purpose
+    // of operand size (Rv) or 32/64 bits by mode (Ry)
+    Ux, Nq, Rv, Ry,
+    // Implicit xmm0 (blendv and sha256rnds2)
+    XMM0,
+    // Operands of VEX/EVEX encodings. Vector operands (V, W, U, H, L) are as
+    // wide as the vector length, xmm, ymm or zmm. Without a ModR/M byte: the
+    // vector register in VEX.vvvv (H) or in imm8[7:4] (L), the 32/64-bit
+    // general-purpose register (By) or opmask register (Kh) in VEX.vvvv
+    Hx, Lx, By, Kh,
+    // With one: a half-width destination (Vh); half, quarter and eighth of a
+    // vector (Wh, Wf, We: the source of a widening conversion); a scalar of
+    // 32 or 64 bits by VEX.W (Ws); a byte (Wb); a fixed 128- or 256-bit lane
+    // (Wdq, Wqq); opmask registers in ModR/M reg (Kg), r/m register or memory
+    // (Ke) and r/m register only (Kr)
+    Vh, Wh, Wf, We, Ws, Wb, Wdq, Wqq, Kg, Ke, Kr,
+};
+
+// Static attributes of an opcode.
+enum OpcodeFlags : uint16_t {
+    OpHasModRM      = 1 << 0,  // A ModR/M byte follows the opcode
+    OpDefault64     = 1 << 1,  // Operand size defaults to 64 bits in 64-bit mode (push, pop, ...)
+    OpForce64       = 1 << 2,  // Operand size is always 64 bits in 64-bit mode (near branches)
+    OpSizedMnemonic = 1 << 3,  // Mnemonic lists 16/32/64-bit spellings separated by spaces
+    OpRepCond       = 1 << 4,  // F2/F3 print as repnz/repz rather than rep
+    OpX87           = 1 << 5,  // Mnemonic and operands come from the x87 tables
+    OpMemoryOnly    = 1 << 6,  // ModR/M must encode a memory operand (mod != 3)
+    OpRegisterOnly  = 1 << 7,  // ModR/M must encode a register operand (mod == 3)
+    OpModRMSpecial  = 1 << 8,  // Register forms are first looked up by the whole
+                               // ModR/M byte in escapeSpecialTable (0F 01, 0F AE, ...)
+    OpVexNds        = 1 << 9,  // VEX.vvvv is the first source, printed as the second operand (Hx)
+    OpVexNdsRegister = 1 << 10, // The same, but only for register forms (vmovss, vmovsd)
+    OpVexMnemonic   = 1 << 11, // An SSE entry reused for its VEX form: printed with a leading v
+    OpModRMF8       = 1 << 12, // ModR/M must be exactly F8 (xabort, xbegin)
+    // Which kind of handler the entry has, for the tables derived from these
+    // at compile time (handler pointers cannot be compared there): one of
+    // the values below in OpKindMask, or none for the others.
+    OpInvalid       = 1 << 13, // decodeInvalid()
+    OpEscape        = 2 << 13, // decodeEscape(): 0F, 0F 38 or 0F 3A
+    OpVexPrefix     = 3 << 13, // decodeVex(): C4, C5 or 62
+    OpKindMask      = 3 << 13,
+    OpModRMRegister = 1 << 15, // ModR/M r/m is a register whatever mod says (mov to/from CRn, DRn)
+};
+
+// Opcode groups: opcodes whose ModR/M reg field selects the instruction.
+enum OpcodeGroup : uint8_t {
+    GroupNone,
+    Group1_80, Group1_81, Group1_83,
+    Group1A_8F,
+    Group2_C0, Group2_C1, Group2_D0, Group2_D1, Group2_D2, Group2_D3,
+    Group3_F6, Group3_F7,
+    Group4_FE, Group5_FF,
+    Group11_C6, Group11_C7,
+    // Groups of the 0F map; a suffix names the mandatory prefix of a variant.
+    Group6_0F00, Group7_0F01, Group7_F3_0F01, Group8_0FBA, Group9_0FC7,
+    Group12_0F71, Group12_66_0F71, Group13_0F72, Group13_66_0F72, Group14_0F73, Group14_66_0F73,
+    Group15_0FAE, Group15_66_0FAE, Group15_F3_0FAE, Group16_0F18, GroupP_0F0D,
+    // Groups of the VEX and EVEX maps (shifts by an immediate, whose
+    // destination is VEX.vvvv; vldmxcsr/vstmxcsr; BMI1 blsr/blsmsk/blsi).
+    GroupVex12_0F71, GroupVex13_0F72, GroupVex14_0F73, GroupVex15_0FAE, GroupVex17_0F38F3,
+    GroupEvex12_0F71, GroupEvex13_0F72, GroupEvex14_0F73,
+    GroupCount,
+};
+
+// Opcode maps. An instruction's opcode id is map << 8 | its last opcode
+// byte, so the id alone says which table describes it.
+enum OpcodeMap : uint8_t {
+    MapPrimary,  // One-byte opcodes
+    Map0F,       // 0F xx
+    Map0F38,     // 0F 38 xx
+    Map0F3A,     // 0F 3A xx
+};
+
+// Columns of the escape opcode tables. In the 0F maps 66, F3 and F2 often
+// act as part of the opcode (a mandatory prefix) rather than as modifiers:
+// 0F 58 is addps, 66 0F 58 addpd, F3 0F 58 addss and F2 0F 58 addsd.
+enum MandatoryPrefix : uint8_t {
+    MandatoryNone,
+    Mandatory66,
+    MandatoryF3,
+    MandatoryF2,
+    MandatoryPrefixCount,
+};
+
+// The column a set of prefixes selects. F3 and F2 take precedence over 66
+// (66 F3 0F B8 is popcnt with a 16-bit operand); the decoder keeps only the
+// last of F2/F3, so at most one of them is set.
+constexpr MandatoryPrefix mandatoryPrefix(uint8_t prefixes) {
+    if (prefixes & PrefixRep) {
+        return MandatoryF3;
+    }
+    if (prefixes & PrefixRepne) {
+        return MandatoryF2;
+    }
+    return (prefixes & PrefixOperandSize) ? Mandatory66 : MandatoryNone;
+}
+
+// One entry of an opcode table.
+struct OpcodeEntry {
+    OpcodeHandler handler;       // Routine that decodes this opcode
+    const char* mnemonic;        // Assembly mnemonic, or nullptr for invalid encodings
+    OperandSpec operands[3];     // Operands in Intel order (destination first)
+    uint8_t group;               // OpcodeGroup selected by ModR/M reg, or GroupNone
+    uint16_t flags;              // OpcodeFlags
+    uint8_t immBytes;            // Bytes of fixed-size immediates (Ib, Iw, Jb, Jz)
+    uint8_t immVariable;         // ImmediateKinds whose size depends on prefixes
+};
+
+// Immediates whose size is only known once the prefixes have been seen.
+// Precomputed per entry so the decoder does not walk the operand specs.
+enum ImmediateKinds : uint8_t {
+    ImmZ     = 1 << 0,  // Iz: 2 or 4 bytes by operand size
+    ImmV     = 1 << 1,  // Iv: 2, 4 or 8 bytes by operand size
+    ImmMoffs = 1 << 2,  // Ob/Ov: 2, 4 or 8 bytes by address size
+    ImmJz    = 1 << 3,  // Jz: 4 bytes in 64-bit mode, otherwise 2 or 4 by operand size
+};
+
+// Handlers referenced from the tables; defined (and instantiated for every
+// CpuMode) in disassembler.cpp.
+size_t decodeInvalid(const uint8_t* bytes, size_t pos, const OpcodeEntry& entry, DecodedInstruction& out);
+size_t decodeNoOperands(const uint8_t* bytes, size_t pos, const OpcodeEntry& entry, DecodedInstruction& out);
+template <CpuMode Mode>
+size_t decodeOperands(const uint8_t* bytes, size_t pos, const OpcodeEntry& entry, DecodedInstruction& out);
+template <CpuMode Mode>
+size_t decodeGroup(const uint8_t* bytes, size_t pos, const OpcodeEntry& entry, DecodedInstruction& out);
+template <CpuMode Mode, OpcodeMap Map>
+size_t decodeEscape(const uint8_t* bytes, size_t pos, const OpcodeEntry& entry, DecodedInstruction& out);
+// Prefix is the byte that starts the encoding: C5 (two-byte VEX), C4
+// (three-byte VEX) or 62 (EVEX).
+template <CpuMode Mode, uint8_t Prefix>
+size_t decodeVex(const uint8_t* bytes, size_t pos, const OpcodeEntry& entry, DecodedInstruction& out);
+
+// Returns the table entry that describes a decoded instruction: the entry of
+// its opcode map and mandatory prefix, with opcode groups, x87 escapes and
+// special register forms resolved through its ModR/M byte.
+const OpcodeEntry& resolveOpcodeEntry(const DecodedInstruction& insn);
+
+namespace opcode_table_detail {
+
+using S = OperandSpec;
+
+constexpr OpcodeEntry invalidEntry = {decodeInvalid, nullptr, {S::None, S::None, S::None}, GroupNone, OpInvalid, 0, 0};
+
+// Group and x87 members are decoded by the handler of their primary opcode,
+// so the Mode of their own (unused) handler does not matter.
+template <CpuMode Mode = CpuMode::Bits64>
+constexpr OpcodeEntry entry(const char* mnemonic, S a = S::None, S b = S::None, S c = S::None, uint16_t flags = 0) {
+    bool hasModRM = false;
+    bool hasOperands = false;
+    for (S spec : {a, b, c}) {
+        hasOperands = hasOperands || spec != S::None;
+        hasModRM = hasModRM || (spec >= S::Eb && spec <= S::Mp) || spec == S::Sw || spec == S::STi ||
+                   (spec >= S::Vx && spec <= S::Ry) || (spec >= S::Vh && spec <= S::Kr);
+    }
+    if (hasModRM) {
+        flags |= OpHasModRM;
+    }
+    for (S spec : {a, b, c}) {
+        if (spec >= S::M && spec <= S::Mp) {
+            flags |= OpMemoryOnly;
+        }
+        if ((spec >= S::Ux && spec <= S::Ry) || spec == S::Kr) {
+            flags |= OpRegisterOnly;
+        }
+    }
+    if (flags & OpModRMRegister) {
+        flags &= ~OpRegisterOnly;
+    }
+    uint8_t immBytes = 0;
+    uint8_t immVariable = 0;
+    for (S spec : {a, b, c}) {
+        switch (spec) {
+            case S::Ib: case S::Ibs: case S::Jb: case S::Lx: immBytes += 1; break;
+            case S::Iw: immBytes += 2; break;
+            case S::Jz: immVariable |= ImmJz; break;
+            case S::Iz: immVariable |= ImmZ; break;
+            case S::Ap: immBytes += 2; immVariable |= ImmZ; break;
+            case S::Iv: immVariable |= ImmV; break;
+            case S::Ob: case S::Ov: immVariable |= ImmMoffs; break;
+            default: break;
+        }
+    }
+    OpcodeHandler handler = (hasOperands || (flags & OpHasModRM)) ? decodeOperands<Mode> : decodeNoOperands;
+    return {handler, mnemonic, {a, b, c}, GroupNone, flags, immBytes, immVariable};
+}
+
+template <CpuMode Mode>
+constexpr OpcodeEntry groupEntry(OpcodeGroup group, uint16_t flags = 0) {
+    return {decodeGroup<Mode>, nullptr, {S::None, S::None, S::None}, group,
+            static_cast<uint16_t>(OpHasModRM | flags), 0, 0};
+}
+
+// The 0F, 0F 38 and 0F 3A bytes: the next byte indexes the table of map.
+template <CpuMode Mode, OpcodeMap Map>
+constexpr OpcodeEntry escapeEntry() {
+    return {decodeEscape<Mode, Map>, nullptr, {S::None, S::None, S::None}, GroupNone, OpEscape, 0, 0};
+}
+
+// C4, C5 and 62: the VEX and EVEX prefixes. Outside 64-bit mode the same
+// bytes are also les, lds and bound (legacy), which decodeVex() falls back to.
+template <CpuMode Mode, uint8_t Prefix>
+constexpr OpcodeEntry vexEntry(OpcodeEntry legacy = invalidEntry) {
+    legacy.handler = decodeVex<Mode, Prefix>;
+    legacy.flags = static_cast<uint16_t>((legacy.flags & ~OpKindMask) | OpVexPrefix);
+    return legacy;
+}
+
+} // namespace opcode_table_detail
+
+// Builds the primary (one-byte) opcode table for Mode at compile time.
+// Prefix bytes (legacy, and REX in 64-bit mode) are consumed by the decoder
+// before the table is consulted, so their slots are never dispatched to.
+template <CpuMode Mode>
+constexpr std::array<OpcodeEntry, 256> buildPrimaryOpcodeTable() {
+    using namespace opcode_table_detail;
+    std::array<OpcodeEntry, 256> table{};
+    for (auto& slot : table) {
+        slot = invalidEntry;
+    }
+
+    // 00-3F: the eight classic ALU operations, six encodings each.
+    constexpr const char* alu[] = {"add", "or", "adc", "sbb", "and", "sub", "xor", "cmp"};
+    for (int op = 0; op < 8; op++) {
+        int base = op * 8;
+        table[base + 0] = entry<Mode>(alu[op], S::Eb, S::Gb);
+        table[base + 1] = entry<Mode>(alu[op], S::Ev, S::Gv);
+        table[base + 2] = entry<Mode>(alu[op], S::Gb, S::Eb);
+        table[base + 3] = entry<Mode>(alu[op], S::Gv, S::Ev);
+        table[base + 4] = entry<Mode>(alu[op], S::AL, S::Ib);
+        table[base + 5] = entry<Mode>(alu[op], S::rAX, S::Iz);
+    }
+
+    // 0F: escape to the two- and three-byte opcode maps.
+    table[0x0F] = escapeEntry<Mode, Map0F>();
+
+    // 50-5F: push/pop with the register in the opcode.
+    for (int r = 0; r < 8; r++) {
+        table[0x50 + r] = entry<Mode>("push", S::Zv, S::None, S::None, OpDefault64);
+        table[0x58 + r] = entry<Mode>("pop", S::Zv, S::None, S::None, OpDefault64);
+    }
+
+    table[0x63] = entry<Mode>("movsxd", S::Gv, S::Ed);
+    table[0x68] = entry<Mode>("push", S::Iz, S::None, S::None, OpDefault64);
+    table[0x69] = entry<Mode>("imul", S::Gv, S::Ev, S::Iz);
+    table[0x6A] = entry<Mode>("push", S::Ibs, S::None, S::None, OpDefault64);
+    table[0x6B] = entry<Mode>("imul", S::Gv, S::Ev, S::Ibs);
+    table[0x6C] = entry<Mode>("ins", S::Yb, S::DX);
+    table[0x6D] = entry<Mode>("ins", S::Yz, S::DX);
+    table[0x6E] = entry<Mode>("outs", S::DX, S::Xb);
+    table[0x6F] = entry<Mode>("outs", S::DX, S::Xz);
+
+    // 70-7F: short conditional jumps.
+    constexpr const char* jcc[] = {"jo", "jno", "jb", "jae", "je", "jne", "jbe", "ja",
+                                   "js", "jns", "jp", "jnp", "jl", "jge", "jle", "jg"};
+    for (int cc = 0; cc < 16; cc++) {
+        table[0x70 + cc] = entry<Mode>(jcc[cc], S::Jb, S::None, S::None, OpForce64);
+    }
+
+    table[0x80] = groupEntry<Mode>(Group1_80);
+    table[0x81] = groupEntry<Mode>(Group1_81);
+    table[0x83] = groupEntry<Mode>(Group1_83);
+    table[0x84] = entry<Mode>("test", S::Eb, S::Gb);
+    table[0x85] = entry<Mode>("test", S::Ev, S::Gv);
+    table[0x86] = entry<Mode>("xchg", S::Eb, S::Gb);
+    table[0x87] = entry<Mode>("xchg", S::Ev, S::Gv);
+    table[0x88] = entry<Mode>("mov", S::Eb, S::Gb);
+    table[0x89] = entry<Mode>("mov", S::Ev, S::Gv);
+    table[0x8A] = entry<Mode>("mov", S::Gb, S::Eb);
+    table[0x8B] = entry<Mode>("mov", S::Gv, S::Ev);
+    table[0x8C] = entry<Mode>("mov", S::RvMw, S::Sw);
+    table[0x8D] = entry<Mode>("lea", S::Gv, S::M);
+    table[0x8E] = entry<Mode>("mov", S::Sw, S::Ew);
+    table[0x8F] = groupEntry<Mode>(Group1A_8F);
+
+    // 90 is nop (or pause/xchg, see the printer); 91-97 exchange with rAX.
+    table[0x90] = entry<Mode>("nop");
+    for (int r = 1; r < 8; r++) {
+        table[0x90 + r] = entry<Mode>("xchg", S::Zv, S::rAX);
+    }
+    table[0x98] = entry<Mode>("cbw cwde cdqe", S::None, S::None, S::None, OpSizedMnemonic);
+    table[0x99] = entry<Mode>("cwd cdq cqo", S::None, S::None, S::None, OpSizedMnemonic);
+    table[0x9B] = entry<Mode>("fwait");
+    table[0x9C] = entry<Mode>("pushf pushf pushfq", S::None, S::None, S::None, OpSizedMnemonic | OpDefault64);
+    table[0x9D] = entry<Mode>("popf popf popfq", S::None, S::None, S::None, OpSizedMnemonic | OpDefault64);
+    table[0x9E] = entry<Mode>("sahf");
+    table[0x9F] = entry<Mode>("lahf");
+
+    table[0xA0] = entry<Mode>("movabs", S::AL, S::Ob);
+    table[0xA1] = entry<Mode>("movabs", S::rAX, S::Ov);
+    table[0xA2] = entry<Mode>("movabs", S::Ob, S::AL);
+    table[0xA3] = entry<Mode>("movabs", S::Ov, S::rAX);
+    table[0xA4] = entry<Mode>("movs", S::Yb, S::Xb);
+    table[0xA5] = entry<Mode>("movs", S::Yv, S::Xv);
+    table[0xA6] = entry<Mode>("cmps", S::Xb, S::Yb, S::None, OpRepCond);
+    table[0xA7] = entry<Mode>("cmps", S::Xv, S::Yv, S::None, OpRepCond);
+    table[0xA8] = entry<Mode>("test", S::AL, S::Ib);
+    table[0xA9] = entry<Mode>("test", S::rAX, S::Iz);
+    table[0xAA] = entry<Mode>("stos", S::Yb, S::AL);
+    table[0xAB] = entry<Mode>("stos", S::Yv, S::rAX);
+    table[0xAC] = entry<Mode>("lods", S::AL, S::Xb);
+    table[0xAD] = entry<Mode>("lods", S::rAX, S::Xv);
+    table[0xAE] = entry<Mode>("scas", S::AL, S::Yb, S::None, OpRepCond);
+    table[0xAF] = entry<Mode>("scas", S::rAX, S::Yv, S::None, OpRepCond);
+
+    // B0-BF: mov reg, imm (imm64 with REX.W, printed as movabs).
+    for (int r = 0; r < 8; r++) {
+        table[0xB0 + r] = entry<Mode>("mov", S::Zb, S::Ib);
+        table[0xB8 + r] = entry<Mode>("mov", S::Zv, S::Iv);
+    }
+
+    table[0xC0] = groupEntry<Mode>(Group2_C0);
+    table[0xC1] = groupEntry<Mode>(Group2_C1);
+    table[0xC2] = entry<Mode>("ret", S::Iw, S::None, S::None, OpForce64);
+    table[0xC3] = entry<Mode>("ret", S::None, S::None, S::None, OpForce64);
+    table[0xC6] = groupEntry<Mode>(Group11_C6);
+    table[0xC7] = groupEntry<Mode>(Group11_C7);
+    table[0xC8] = entry<Mode>("enter", S::Iw, S::Ib, S::None, OpDefault64);
+    table[0xC9] = entry<Mode>("leave", S::None, S::None, S::None, OpDefault64);
+    table[0xCA] = entry<Mode>("retf", S::Iw);
+    table[0xCB] = entry<Mode>("retf");
+    table[0xCC] = entry<Mode>("int3");
+    table[0xCD] = entry<Mode>("int", S::Ib);
+    table[0xCF] = entry<Mode>("iret iretd iretq", S::None, S::None, S::None, OpSizedMnemonic);
+
+    table[0xD0] = groupEntry<Mode>(Group2_D0);
+    table[0xD1] = groupEntry<Mode>(Group2_D1);
+    table[0xD2] = groupEntry<Mode>(Group2_D2);
+    table[0xD3] = groupEntry<Mode>(Group2_D3);
+    table[0xD7] = entry<Mode>("xlat");
+    // D8-DF: x87 escapes. Only the ModR/M shape matters for decoding.
+    for (int op = 0xD8; op <= 0xDF; op++) {
+        table[op] = entry<Mode>(nullptr, S::None, S::None, S::None, OpHasModRM | OpX87);
+    }
+
+    table[0xE0] = entry<Mode>("loopne", S::Jb, S::None, S::None, OpForce64);
+    table[0xE1] = entry<Mode>("loope", S::Jb, S::None, S::None, OpForce64);
+    table[0xE2] = entry<Mode>("loop", S::Jb, S::None, S::None, OpForce64);
+    table[0xE3] = entry<Mode>("jrcxz", S::Jb, S::None, S::None, OpForce64);
+    table[0xE4] = entry<Mode>("in", S::AL, S::Ib);
+    table[0xE5] = entry<Mode>("in", S::eAX, S::Ib);
+    table[0xE6] = entry<Mode>("out", S::Ib, S::AL);
+    table[0xE7] = entry<Mode>("out", S::Ib, S::eAX);
+    table[0xE8] = entry<Mode>("call", S::Jz, S::None, S::None, OpForce64);
+    table[0xE9] = entry<Mode>("jmp", S::Jz, S::None, S::None, OpForce64);
+    table[0xEB] = entry<Mode>("jmp", S::Jb, S::None, S::None, OpForce64);
+    table[0xEC] = entry<Mode>("in", S::AL, S::DX);
+    table[0xED] = entry<Mode>("in", S::eAX, S::DX);
+    table[0xEE] = entry<Mode>("out", S::DX, S::AL);
+    table[0xEF] = entry<Mode>("out", S::DX, S::eAX);
+
+    table[0xF1] = entry<Mode>("int1");
+    table[0xF4] = entry<Mode>("hlt");
+    table[0xF5] = entry<Mode>("cmc");
+    table[0xF6] = groupEntry<Mode>(Group3_F6);
+    table[0xF7] = groupEntry<Mode>(Group3_F7);
+    table[0xF8] = entry<Mode>("clc");
+    table[0xF9] = entry<Mode>("stc");
+    table[0xFA] = entry<Mode>("cli");
+    table[0xFB] = entry<Mode>("sti");
+    table[0xFC] = entry<Mode>("cld");
+    table[0xFD] = entry<Mode>("std");
+    table[0xFE] = groupEntry<Mode>(Group4_FE);
+    table[0xFF] = groupEntry<Mode>(Group5_FF);
+
+    // Opcodes that 64-bit mode dropped or reassigned (40-4F became REX).
+    if constexpr (Mode != CpuMode::Bits64) {
+        table[0x06] = entry<Mode>("push", S::ES);
+        table[0x07] = entry<Mode>("pop", S::ES);
+        table[0x0E] = entry<Mode>("push", S::CS);
+        table[0x16] = entry<Mode>("push", S::SS);
+        table[0x17] = entry<Mode>("pop", S::SS);
+        table[0x1E] = entry<Mode>("push", S::DS);
+        table[0x1F] = entry<Mode>("pop", S::DS);
+        table[0x27] = entry<Mode>("daa");
+        table[0x2F] = entry<Mode>("das");
+        table[0x37] = entry<Mode>("aaa");
+        table[0x3F] = entry<Mode>("aas");
+        for (int r = 0; r < 8; r++) {
+            table[0x40 + r] = entry<Mode>("inc", S::Zv);
+            table[0x48 + r] = entry<Mode>("dec", S::Zv);
+        }
+        table[0x60] = entry<Mode>("pushaw pusha pusha", S::None, S::None, S::None, OpSizedMnemonic);
+        table[0x61] = entry<Mode>("popaw popa popa", S::None, S::None, S::None, OpSizedMnemonic);
+        table[0x62] = entry<Mode>("bound", S::Gv, S::M);
+        table[0x63] = entry<Mode>("arpl", S::Ew, S::Gw);
+        table[0x82] = groupEntry<Mode>(Group1_80);
+        table[0x9A] = entry<Mode>("call", S::Ap);
+        table[0xA0] = entry<Mode>("mov", S::AL, S::Ob);
+        table[0xA1] = entry<Mode>("mov", S::rAX, S::Ov);
+        table[0xA2] = entry<Mode>("mov", S::Ob, S::AL);
+        table[0xA3] = entry<Mode>("mov", S::Ov, S::rAX);
+        table[0xC4] = entry<Mode>("les", S::Gv, S::Mp);
+        table[0xC5] = entry<Mode>("lds", S::Gv, S::Mp);
+        table[0xCE] = entry<Mode>("into");
+        table[0xD4] = entry<Mode>("aam", S::Ib);
+        table[0xD5] = entry<Mode>("aad", S::Ib);
+        table[0xEA] = entry<Mode>("jmp", S::Ap);
+    }
+    table[0x62] = vexEntry<Mode, 0x62>(table[0x62]);
+    table[0xC4] = vexEntry<Mode, 0xC4>(table[0xC4]);
+    table[0xC5] = vexEntry<Mode, 0xC5>(table[0xC5]);
+    return table;
+}
+
+// An escape map has one row per opcode byte and one column per mandatory
+// prefix, so selecting the instruction is still a single indexed load.
+using OpcodeColumns = std::array<OpcodeEntry, MandatoryPrefixCount>;
+using EscapeOpcodeTable = std::array<OpcodeColumns, 256>;
+
+namespace opcode_table_detail {
+
+// The same instruction whatever the prefixes; 66 stays an operand-size
+// prefix (66 0F B6 is movzx with a 16-bit destination).
+constexpr OpcodeColumns anyPrefix(const OpcodeEntry& e) {
+    return {e, e, e, e};
+}
+
+// One instruction per mandatory prefix: none, 66, F3, F2.
+constexpr OpcodeColumns byPrefix(const OpcodeEntry& none, const OpcodeEntry& p66 = invalidEntry,
+                                 const OpcodeEntry& pF3 = invalidEntry, const OpcodeEntry& pF2 = invalidEntry) {
+    return {none, p66, pF3, pF2};
+}
+
+// An integer op with an MMX form (no prefix) and an SSE form (66), e.g.
+// "paddb mm, mm/m64" and "paddb xmm, xmm/m128".
+template <CpuMode Mode>
+constexpr OpcodeColumns mmxOrSse(const char* mnemonic, S c = S::None) {
+    return byPrefix(entry<Mode>(mnemonic, S::Pq, S::Qq, c), entry<Mode>(mnemonic, S::Vx, S::Wx, c));
+}
+
+// An op that only exists with a 66 prefix.
+template <CpuMode Mode>
+constexpr OpcodeColumns sse66(const char* mnemonic, S a = S::Vx, S b = S::Wx, S c = S::None) {
+    return byPrefix(invalidEntry, entry<Mode>(mnemonic, a, b, c));
+}
+
+// Packed single, packed double, scalar single and scalar double forms of
+// an SSE floating-point op; nullptr where a form does not exist.
+template <CpuMode Mode>
+constexpr OpcodeColumns sseFloat(const char* ps, const char* pd, const char* ss, const char* sd) {
+    return byPrefix(ps ? entry<Mode>(ps, S::Vx, S::Wx) : invalidEntry,
+                    pd ? entry<Mode>(pd, S::Vx, S::Wx) : invalidEntry,
+                    ss ? entry<Mode>(ss, S::Vx, S::Wd) : invalidEntry,
+                    sd ? entry<Mode>(sd, S::Vx, S::Wq) : invalidEntry);
+}
+
+constexpr EscapeOpcodeTable invalidEscapeTable() {
+    EscapeOpcodeTable table{};
+    for (auto& row : table) {
+        row = anyPrefix(invalidEntry);
+    }
+    return table;
+}
+
+} // namespace opcode_table_detail
+
+// Builds the two-byte (0F xx) opcode map for Mode: system instructions,
+// jcc rel32, setcc, cmovcc, movzx/movsx, bit operations and the MMX/SSE
+// instructions, with 0F 38 and 0F 3A escaping to the three-byte maps.
+template <CpuMode Mode>
+constexpr EscapeOpcodeTable build0FOpcodeTable() {
+    using namespace opcode_table_detail;
+    EscapeOpcodeTable table = invalidEscapeTable();
+
+    table[0x00] = anyPrefix(groupEntry<Mode>(Group6_0F00));
+    // F3 0F 01 /5 is rstorssp; the other members ignore the prefix.
+    constexpr OpcodeEntry group7 = groupEntry<Mode>(Group7_0F01, OpModRMSpecial);
+    table[0x01] = byPrefix(group7, group7, groupEntry<Mode>(Group7_F3_0F01, OpModRMSpecial), group7);
+    table[0x02] = anyPrefix(entry<Mode>("lar", S::Gv, S::Ew));
+    table[0x03] = anyPrefix(entry<Mode>("lsl", S::Gv, S::Ew));
+    table[0x05] = anyPrefix(entry<Mode>("syscall"));
+    table[0x06] = anyPrefix(entry<Mode>("clts"));
+    table[0x07] = anyPrefix(entry<Mode>("sysret sysretd sysretq", S::None, S::None, S::None, OpSizedMnemonic));
+    table[0x08] = anyPrefix(entry<Mode>("invd"));
+    table[0x09] = anyPrefix(entry<Mode>("wbinvd"));
+    table[0x0B] = anyPrefix(entry<Mode>("ud2"));
+    table[0x0D] = anyPrefix(groupEntry<Mode>(GroupP_0F0D));
+
+    table[0x10] = byPrefix(entry<Mode>("movups", S::Vx, S::Wx), entry<Mode>("movupd", S::Vx, S::Wx),
+                           entry<Mode>("movss", S::Vx, S::Wd), entry<Mode>("movsd", S::Vx, S::Wq));
+    table[0x11] = byPrefix(entry<Mode>("movups", S::Wx, S::Vx), entry<Mode>("movupd", S::Wx, S::Vx),
+                           entry<Mode>("movss", S::Wd, S::Vx), entry<Mode>("movsd", S::Wq, S::Vx));
+    // The register forms of 0F 12 and 0F 16 are movhlps and movlhps (see
+    // the printer).
+    table[0x12] = byPrefix(entry<Mode>("movlps", S::Vx, S::Wq), entry<Mode>("movlpd", S::Vx, S::Mq),
+                           entry<Mode>("movsldup", S::Vx, S::Wx), entry<Mode>("movddup", S::Vx, S::Wq));
+    table[0x13] = byPrefix(entry<Mode>("movlps", S::Mq, S::Vx), entry<Mode>("movlpd", S::Mq, S::Vx));
+    table[0x14] = sseFloat<Mode>("unpcklps", "unpcklpd", nullptr, nullptr);
+    table[0x15] = sseFloat<Mode>("unpckhps", "unpckhpd", nullptr, nullptr);
+    table[0x16] = byPrefix(entry<Mode>("movhps", S::Vx, S::Wq), entry<Mode>("movhpd", S::Vx, S::Mq),
+                           entry<Mode>("movshdup", S::Vx, S::Wx));
+    table[0x17] = byPrefix(entry<Mode>("movhps", S::Mq, S::Vx), entry<Mode>("movhpd", S::Mq, S::Vx));
+    table[0x18] = anyPrefix(groupEntry<Mode>(Group16_0F18));
+    // 0F 19-1F are hint nops; F3 0F 1E FA/FB are endbr64/endbr32 and
+    // F3 0F 1E /1 register forms are rdssp.
+    for (int op = 0x19; op <= 0x1F; op++) {
+        table[op] = anyPrefix(entry<Mode>("nop", S::Ev));
+    }
+    table[0x1E] = byPrefix(entry<Mode>("nop", S::Ev), entry<Mode>("nop", S::Ev),
+                           entry<Mode>("nop", S::Ev, S::None, S::None, OpModRMSpecial), entry<Mode>("nop", S::Ev));
+
+    // The processor ignores mod here: r/m always names a register.
+    table[0x20] = anyPrefix(entry<Mode>("mov", S::Ry, S::Cd, S::None, OpModRMRegister));
+    table[0x21] = anyPrefix(entry<Mode>("mov", S::Ry, S::Dd, S::None, OpModRMRegister));
+    table[0x22] = anyPrefix(entry<Mode>("mov", S::Cd, S::Ry, S::None, OpModRMRegister));
+    table[0x23] = anyPrefix(entry<Mode>("mov", S::Dd, S::Ry, S::None, OpModRMRegister));
+    table[0x28] = sseFloat<Mode>("movaps", "movapd", nullptr, nullptr);
+    table[0x29] = byPrefix(entry<Mode>("movaps", S::Wx, S::Vx), entry<Mode>("movapd", S::Wx, S::Vx));
+    table[0x2A] = byPrefix(entry<Mode>("cvtpi2ps", S::Vx, S::Qq), entry<Mode>("cvtpi2pd", S::Vx, S::Qq),
+                           entry<Mode>("cvtsi2ss", S::Vx, S::Ey), entry<Mode>("cvtsi2sd", S::Vx, S::Ey));
+    // Non-temporal stores are memory-only Wx, so their VEX forms widen.
+    table[0x2B] = byPrefix(entry<Mode>("movntps", S::Wx, S::Vx, S::None, OpMemoryOnly),
+                           entry<Mode>("movntpd", S::Wx, S::Vx, S::None, OpMemoryOnly));
+    table[0x2C] = byPrefix(entry<Mode>("cvttps2pi", S::Pq, S::Wq), entry<Mode>("cvttpd2pi", S::Pq, S::Wx),
+                           entry<Mode>("cvttss2si", S::Gy, S::Wd), entry<Mode>("cvttsd2si", S::Gy, S::Wq));
+    table[0x2D] = byPrefix(entry<Mode>("cvtps2pi", S::Pq, S::Wq), entry<Mode>("cvtpd2pi", S::Pq, S::Wx),
+                           entry<Mode>("cvtss2si", S::Gy, S::Wd), entry<Mode>("cvtsd2si", S::Gy, S::Wq));
+    table[0x2E] = byPrefix(entry<Mode>("ucomiss", S::Vx, S::Wd), entry<Mode>("ucomisd", S::Vx, S::Wq));
+    table[0x2F] = byPrefix(entry<Mode>("comiss", S::Vx, S::Wd), entry<Mode>("comisd", S::Vx, S::Wq));
+
+    table[0x30] = anyPrefix(entry<Mode>("wrmsr"));
+    table[0x31] = anyPrefix(entry<Mode>("rdtsc"));
+    table[0x32] = anyPrefix(entry<Mode>("rdmsr"));
+    table[0x33] = anyPrefix(entry<Mode>("rdpmc"));
+    table[0x34] = anyPrefix(entry<Mode>("sysenter"));
+    table[0x35] = anyPrefix(entry<Mode>("sysexit"));
+    table[0x37] = anyPrefix(entry<Mode>("getsec"));
+    table[0x38] = anyPrefix(escapeEntry<Mode, Map0F38>());
+    table[0x3A] = anyPrefix(escapeEntry<Mode, Map0F3A>());
+
+    // 40-4F: conditional moves.
+    constexpr const char* cmovcc[] = {"cmovo", "cmovno", "cmovb", "cmovae", "cmove", "cmovne", "cmovbe", "cmova",
+                                      "cmovs", "cmovns", "cmovp", "cmovnp", "cmovl", "cmovge", "cmovle", "cmovg"};
+    for (int cc = 0; cc < 16; cc++) {
+        table[0x40 + cc] = anyPrefix(entry<Mode>(cmovcc[cc], S::Gv, S::Ev));
+    }
+
+    table[0x50] = byPrefix(entry<Mode>("movmskps", S::Gd, S::Ux), entry<Mode>("movmskpd", S::Gd, S::Ux));
+    table[0x51] = sseFloat<Mode>("sqrtps", "sqrtpd", "sqrtss", "sqrtsd");
+    table[0x52] = sseFloat<Mode>("rsqrtps", nullptr, "rsqrtss", nullptr);
+    table[0x53] = sseFloat<Mode>("rcpps", nullptr, "rcpss", nullptr);
+    table[0x54] = sseFloat<Mode>("andps", "andpd", nullptr, nullptr);
+    table[0x55] = sseFloat<Mode>("andnps", "andnpd", nullptr, nullptr);
+    table[0x56] = sseFloat<Mode>("orps", "orpd", nullptr, nullptr);
+    table[0x57] = sseFloat<Mode>("xorps", "xorpd", nullptr, nullptr);
+    table[0x58] = sseFloat<Mode>("addps", "addpd", "addss", "addsd");
+    table[0x59] = sseFloat<Mode>("mulps", "mulpd", "mulss", "mulsd");
+    table[0x5A] = byPrefix(entry<Mode>("cvtps2pd", S::Vx, S::Wh), entry<Mode>("cvtpd2ps", S::Vh, S::Wx),
+                           entry<Mode>("cvtss2sd", S::Vx, S::Wd), entry<Mode>("cvtsd2ss", S::Vx, S::Wq));
+    table[0x5B] = byPrefix(entry<Mode>("cvtdq2ps", S::Vx, S::Wx), entry<Mode>("cvtps2dq", S::Vx, S::Wx),
+                           entry<Mode>("cvttps2dq", S::Vx, S::Wx));
+    table[0x5C] = sseFloat<Mode>("subps", "subpd", "subss", "subsd");
+    table[0x5D] = sseFloat<Mode>("minps", "minpd", "minss", "minsd");
+    table[0x5E] = sseFloat<Mode>("divps", "divpd", "divss", "divsd");
+    table[0x5F] = sseFloat<Mode>("maxps", "maxpd", "maxss", "maxsd");
+
+    constexpr const char* unpack[] = {"punpcklbw", "punpcklwd", "punpckldq", "packsswb",
+                                      "pcmpgtb", "pcmpgtw", "pcmpgtd", "packuswb",
+                                      "punpckhbw", "punpckhwd", "punpckhdq", "packssdw"};
+    for (int op = 0; op < 12; op++) {
+        table[0x60 + op] = mmxOrSse<Mode>(unpack[op]);
+    }
+    table[0x6C] = sse66<Mode>("punpcklqdq");
+    table[0x6D] = sse66<Mode>("punpckhqdq");
+    table[0x6E] = byPrefix(entry<Mode>("movd movd movq", S::Pq, S::Ey, S::None, OpSizedMnemonic),
+                           entry<Mode>("movd movd movq", S::Vx, S::Ey, S::None, OpSizedMnemonic));
+    table[0x6F] = byPrefix(entry<Mode>("movq", S::Pq, S::Qq), entry<Mode>("movdqa", S::Vx, S::Wx),
+                           entry<Mode>("movdqu", S::Vx, S::Wx));
+    table[0x70] = byPrefix(entry<Mode>("pshufw", S::Pq, S::Qq, S::Ib), entry<Mode>("pshufd", S::Vx, S::Wx, S::Ib),
+                           entry<Mode>("pshufhw", S::Vx, S::Wx, S::Ib), entry<Mode>("pshuflw", S::Vx, S::Wx, S::Ib));
+    table[0x71] = byPrefix(groupEntry<Mode>(Group12_0F71), groupEntry<Mode>(Group12_66_0F71));
+    table[0x72] = byPrefix(groupEntry<Mode>(Group13_0F72), groupEntry<Mode>(Group13_66_0F72));
+    table[0x73] = byPrefix(groupEntry<Mode>(Group14_0F73), groupEntry<Mode>(Group14_66_0F73));
+    table[0x74] = mmxOrSse<Mode>("pcmpeqb");
+    table[0x75] = mmxOrSse<Mode>("pcmpeqw");
+    table[0x76] = mmxOrSse<Mode>("pcmpeqd");
+    table[0x77] = byPrefix(entry<Mode>("emms"));
+    table[0x7C] = sseFloat<Mode>(nullptr, "haddpd", nullptr, "haddps");
+    table[0x7D] = sseFloat<Mode>(nullptr, "hsubpd", nullptr, "hsubps");
+    table[0x7E] = byPrefix(entry<Mode>("movd movd movq", S::Ey, S::Pq, S::None, OpSizedMnemonic),
+                           entry<Mode>("movd movd movq", S::Ey, S::Vx, S::None, OpSizedMnemonic),
+                           entry<Mode>("movq", S::Vx, S::Wq));
+    table[0x7F] = byPrefix(entry<Mode>("movq", S::Qq, S::Pq), entry<Mode>("movdqa", S::Wx, S::Vx),
+                           entry<Mode>("movdqu", S::Wx, S::Vx));
+
+    // 80-8F: jcc rel32 (rel16 with 66 outside 64-bit mode); 90-9F: setcc.
+    constexpr const char* jcc[] = {"jo", "jno", "jb", "jae", "je", "jne", "jbe", "ja",
+                                   "js", "jns", "jp", "jnp", "jl", "jge", "jle", "jg"};
+    constexpr const char* setcc[] = {"seto", "setno", "setb", "setae", "sete", "setne", "setbe", "seta",
+                                     "sets", "setns", "setp", "setnp", "setl", "setge", "setle", "setg"};
+    for (int cc = 0; cc < 16; cc++) {
+        table[0x80 + cc] = anyPrefix(entry<Mode>(jcc[cc], S::Jz, S::None, S::None, OpForce64));
+        table[0x90 + cc] = anyPrefix(entry<Mode>(setcc[cc], S::Eb));
+    }
+
+    table[0xA0] = anyPrefix(entry<Mode>("push", S::FS, S::None, S::None, OpDefault64));
+    table[0xA1] = anyPrefix(entry<Mode>("pop", S::FS, S::None, S::None, OpDefault64));
+    table[0xA2] = anyPrefix(entry<Mode>("cpuid"));
+    table[0xA3] = anyPrefix(entry<Mode>("bt", S::Ev, S::Gv));
+    table[0xA4] = anyPrefix(entry<Mode>("shld", S::Ev, S::Gv, S::Ib));
+    table[0xA5] = anyPrefix(entry<Mode>("shld", S::Ev, S::Gv, S::CL));
+    table[0xA8] = anyPrefix(entry<Mode>("push", S::GS, S::None, S::None, OpDefault64));
+    table[0xA9] = anyPrefix(entry<Mode>("pop", S::GS, S::None, S::None, OpDefault64));
+    table[0xAA] = anyPrefix(entry<Mode>("rsm"));
+    table[0xAB] = anyPrefix(entry<Mode>("bts", S::Ev, S::Gv));
+    table[0xAC] = anyPrefix(entry<Mode>("shrd", S::Ev, S::Gv, S::Ib));
+    table[0xAD] = anyPrefix(entry<Mode>("shrd", S::Ev, S::Gv, S::CL));
+    table[0xAE] = byPrefix(groupEntry<Mode>(Group15_0FAE, OpModRMSpecial), groupEntry<Mode>(Group15_66_0FAE),
+                           groupEntry<Mode>(Group15_F3_0FAE));
+    table[0xAF] = anyPrefix(entry<Mode>("imul", S::Gv, S::Ev));
+
+    table[0xB0] = anyPrefix(entry<Mode>("cmpxchg", S::Eb, S::Gb));
+    table[0xB1] = anyPrefix(entry<Mode>("cmpxchg", S::Ev, S::Gv));
+    table[0xB2] = anyPrefix(entry<Mode>("lss", S::Gv, S::Mp));
+    table[0xB3] = anyPrefix(entry<Mode>("btr", S::Ev, S::Gv));
+    table[0xB4] = anyPrefix(entry<Mode>("lfs", S::Gv, S::Mp));
+    table[0xB5] = anyPrefix(entry<Mode>("lgs", S::Gv, S::Mp));
+    table[0xB6] = anyPrefix(entry<Mode>("movzx", S::Gv, S::Eb));
+    table[0xB7] = anyPrefix(entry<Mode>("movzx", S::Gv, S::Ew));
+    table[0xB8] = byPrefix(invalidEntry, invalidEntry, entry<Mode>("popcnt", S::Gv, S::Ev));
+    table[0xB9] = anyPrefix(entry<Mode>("ud1", S::Gv, S::Ev));
+    table[0xBA] = anyPrefix(groupEntry<Mode>(Group8_0FBA));
+    table[0xBB] = anyPrefix(entry<Mode>("btc", S::Ev, S::Gv));
+    table[0xBC] = anyPrefix(entry<Mode>("bsf", S::Gv, S::Ev));
+    table[0xBC][MandatoryF3] = entry<Mode>("tzcnt", S::Gv, S::Ev);
+    table[0xBD] = anyPrefix(entry<Mode>("bsr", S::Gv, S::Ev));
+    table[0xBD][MandatoryF3] = entry<Mode>("lzcnt", S::Gv, S::Ev);
+    table[0xBE] = anyPrefix(entry<Mode>("movsx", S::Gv, S::Eb));
+    table[0xBF] = anyPrefix(entry<Mode>("movsx", S::Gv, S::Ew));
+
+    table[0xC0] = anyPrefix(entry<Mode>("xadd", S::Eb, S::Gb));
+    table[0xC1] = anyPrefix(entry<Mode>("xadd", S::Ev, S::Gv));
+    table[0xC2] = byPrefix(entry<Mode>("cmpps", S::Vx, S::Wx, S::Ib), entry<Mode>("cmppd", S::Vx, S::Wx, S::Ib),
+                           entry<Mode>("cmpss", S::Vx, S::Wd, S::Ib), entry<Mode>("cmpsd", S::Vx, S::Wq, S::Ib));
+    table[0xC3] = byPrefix(entry<Mode>("movnti", S::Ey, S::Gy, S::None, OpMemoryOnly));
+    table[0xC4] = byPrefix(entry<Mode>("pinsrw", S::Pq, S::RdMw, S::Ib), entry<Mode>("pinsrw", S::Vx, S::RdMw, S::Ib));
+    table[0xC5] = byPrefix(entry<Mode>("pextrw", S::Gd, S::Nq, S::Ib), entry<Mode>("pextrw", S::Gd, S::Ux, S::Ib));
+    table[0xC6] = byPrefix(entry<Mode>("shufps", S::Vx, S::Wx, S::Ib), entry<Mode>("shufpd", S::Vx, S::Wx, S::Ib));
+    table[0xC7] = anyPrefix(groupEntry<Mode>(Group9_0FC7));
+    for (int r = 0; r < 8; r++) {
+        table[0xC8 + r] = anyPrefix(entry<Mode>("bswap", S::Zv));
+    }
+
+    // D0-FF: mostly MMX/SSE2 integer arithmetic.
+    constexpr const char* integerOps[48] = {
+        nullptr, "psrlw", "psrld", "psrlq", "paddq", "pmullw", nullptr, nullptr,
+        "psubusb", "psubusw", "pminub", "pand", "paddusb", "paddusw", "pmaxub", "pandn",
+        "pavgb", "psraw", "psrad", "pavgw", "pmulhuw", "pmulhw", nullptr, nullptr,
+        "psubsb", "psubsw", "pminsw", "por", "paddsb", "paddsw", "pmaxsw", "pxor",
+        nullptr, "psllw", "pslld", "psllq", "pmuludq", "pmaddwd", "psadbw", nullptr,
+        "psubb", "psubw", "psubd", "psubq", "paddb", "paddw", "paddd", nullptr};
+    for (int op = 0; op < 48; op++) {
+        if (integerOps[op] != nullptr) {
+            table[0xD0 + op] = mmxOrSse<Mode>(integerOps[op]);
+        }
+    }
+    table[0xD0] = sseFloat<Mode>(nullptr, "addsubpd", nullptr, "addsubps");
+    table[0xD6] = byPrefix(invalidEntry, entry<Mode>("movq", S::Wq, S::Vx),
+                           entry<Mode>("movq2dq", S::Vx, S::Nq), entry<Mode>("movdq2q", S::Pq, S::Ux));
+    table[0xD7] = byPrefix(entry<Mode>("pmovmskb", S::Gd, S::Nq), entry<Mode>("pmovmskb", S::Gd, S::Ux));
+    table[0xE6] = byPrefix(invalidEntry, entry<Mode>("cvttpd2dq", S::Vh, S::Wx),
+                           entry<Mode>("cvtdq2pd", S::Vx, S::Wh), entry<Mode>("cvtpd2dq", S::Vh, S::Wx));
+    table[0xE7] = byPrefix(entry<Mode>("movntq", S::Mq, S::Pq), entry<Mode>("movntdq", S::Wx, S::Vx, S::None, OpMemoryOnly));
+    table[0xF0] = byPrefix(invalidEntry, invalidEntry, invalidEntry, entry<Mode>("lddqu", S::Vx, S::M));
+    table[0xF7] = byPrefix(entry<Mode>("maskmovq", S::Pq, S::Nq), entry<Mode>("maskmovdqu", S::Vx, S::Ux));
+    table[0xFF] = anyPrefix(entry<Mode>("ud0", S::Gv, S::Ev));
+    return table;
+}
+
+// Builds the 0F 38 map: SSSE3/SSE4 integer ops, AES-NI, SHA, crc32, movbe
+// and adcx/adox.
+template <CpuMode Mode>
+constexpr EscapeOpcodeTable build0F38OpcodeTable() {
+    using namespace opcode_table_detail;
+    EscapeOpcodeTable table = invalidEscapeTable();
+
+    constexpr const char* ssse3[] = {"pshufb", "phaddw", "phaddd", "phaddsw", "pmaddubsw", "phsubw", "phsubd",
+                                     "phsubsw", "psignb", "psignw", "psignd", "pmulhrsw"};
+    for (int op = 0; op < 12; op++) {
+        table[op] = mmxOrSse<Mode>(ssse3[op]);
+    }
+    table[0x10] = sse66<Mode>("pblendvb", S::Vx, S::Wx, S::XMM0);
+    table[0x14] = sse66<Mode>("blendvps", S::Vx, S::Wx, S::XMM0);
+    table[0x15] = sse66<Mode>("blendvpd", S::Vx, S::Wx, S::XMM0);
+    table[0x17] = sse66<Mode>("ptest");
+    table[0x1C] = mmxOrSse<Mode>("pabsb");
+    table[0x1D] = mmxOrSse<Mode>("pabsw");
+    table[0x1E] = mmxOrSse<Mode>("pabsd");
+
+    // 20-25 and 30-35: sign and zero extension; the source is as wide as
+    // the elements it widens into a full register.
+    constexpr const char* movsx[] = {"pmovsxbw", "pmovsxbd", "pmovsxbq", "pmovsxwd", "pmovsxwq", "pmovsxdq"};
+    constexpr const char* movzx[] = {"pmovzxbw", "pmovzxbd", "pmovzxbq", "pmovzxwd", "pmovzxwq", "pmovzxdq"};
+    constexpr S extendSource[] = {S::Wh, S::Wf, S::We, S::Wh, S::Wf, S::Wh};
+    for (int op = 0; op < 6; op++) {
+        table[0x20 + op] = sse66<Mode>(movsx[op], S::Vx, extendSource[op]);
+        table[0x30 + op] = sse66<Mode>(movzx[op], S::Vx, extendSource[op]);
+    }
+    table[0x28] = sse66<Mode>("pmuldq");
+    table[0x29] = sse66<Mode>("pcmpeqq");
+    table[0x2A] = byPrefix(invalidEntry, entry<Mode>("movntdqa", S::Vx, S::Wx, S::None, OpMemoryOnly));
+    table[0x2B] = sse66<Mode>("packusdw");
+    table[0x37] = sse66<Mode>("pcmpgtq");
+    constexpr const char* minMax[] = {"pminsb", "pminsd", "pminuw", "pminud", "pmaxsb", "pmaxsd", "pmaxuw", "pmaxud"};
+    for (int op = 0; op < 8; op++) {
+        table[0x38 + op] = sse66<Mode>(minMax[op]);
+    }
+    table[0x40] = sse66<Mode>("pmulld");
+    table[0x41] = sse66<Mode>("phminposuw");
+
+    table[0xC8] = byPrefix(entry<Mode>("sha1nexte", S::Vx, S::Wx));
+    table[0xC9] = byPrefix(entry<Mode>("sha1msg1", S::Vx, S::Wx));
+    table[0xCA] = byPrefix(entry<Mode>("sha1msg2", S::Vx, S::Wx));
+    table[0xCB] = byPrefix(entry<Mode>("sha256rnds2", S::Vx, S::Wx, S::XMM0));
+    table[0xCC] = byPrefix(entry<Mode>("sha256msg1", S::Vx, S::Wx));
+    table[0xCD] = byPrefix(entry<Mode>("sha256msg2", S::Vx, S::Wx));
+    table[0xCF] = sse66<Mode>("gf2p8mulb");
+    table[0xDB] = sse66<Mode>("aesimc");
+    table[0xDC] = sse66<Mode>("aesenc");
+    table[0xDD] = sse66<Mode>("aesenclast");
+    table[0xDE] = sse66<Mode>("aesdec");
+    table[0xDF] = sse66<Mode>("aesdeclast");
+
+    // F0/F1 are movbe, or crc32 with F2 (66 F2 keeps 66 as operand size).
+    OpcodeEntry movbeLoad = entry<Mode>("movbe", S::Gv, S::Ev, S::None, OpMemoryOnly);
+    OpcodeEntry movbeStore = entry<Mode>("movbe", S::Ev, S::Gv, S::None, OpMemoryOnly);
+    table[0xF0] = byPrefix(movbeLoad, movbeLoad, invalidEntry, entry<Mode>("crc32", S::Gy, S::Eb));
+    table[0xF1] = byPrefix(movbeStore, movbeStore, invalidEntry, entry<Mode>("crc32", S::Gy, S::Ev));
+    table[0xF6] = byPrefix(invalidEntry, entry<Mode>("adcx", S::Gy, S::Ey), entry<Mode>("adox", S::Gy, S::Ey));
+    return table;
+}
+
+// Builds the 0F 3A map, whose instructions all take an imm8.
+template <CpuMode Mode>
+constexpr EscapeOpcodeTable build0F3AOpcodeTable() {
+    using namespace opcode_table_detail;
+    EscapeOpcodeTable table = invalidEscapeTable();
+
+    table[0x08] = sse66<Mode>("roundps", S::Vx, S::Wx, S::Ib);
+    table[0x09] = sse66<Mode>("roundpd", S::Vx, S::Wx, S::Ib);
+    table[0x0A] = sse66<Mode>("roundss", S::Vx, S::Wd, S::Ib);
+    table[0x0B] = sse66<Mode>("roundsd", S::Vx, S::Wq, S::Ib);
+    table[0x0C] = sse66<Mode>("blendps", S::Vx, S::Wx, S::Ib);
+    table[0x0D] = sse66<Mode>("blendpd", S::Vx, S::Wx, S::Ib);
+    table[0x0E] = sse66<Mode>("pblendw", S::Vx, S::Wx, S::Ib);
+    table[0x0F] = mmxOrSse<Mode>("palignr", S::Ib);
+    table[0x14] = sse66<Mode>("pextrb", S::RdMb, S::Vx, S::Ib);
+    table[0x15] = sse66<Mode>("pextrw", S::RdMw, S::Vx, S::Ib);
+    table[0x16] = byPrefix(invalidEntry, entry<Mode>("pextrd pextrd pextrq", S::Ey, S::Vx, S::Ib, OpSizedMnemonic));
+    table[0x17] = sse66<Mode>("extractps", S::Ed, S::Vx, S::Ib);
+    table[0x20] = sse66<Mode>("pinsrb", S::Vx, S::RdMb, S::Ib);
+    table[0x21] = sse66<Mode>("insertps", S::Vx, S::Wd, S::Ib);
+    table[0x22] = byPrefix(invalidEntry, entry<Mode>("pinsrd pinsrd pinsrq", S::Vx, S::Ey, S::Ib, OpSizedMnemonic));
+    table[0x40] = sse66<Mode>("dpps", S::Vx, S::Wx, S::Ib);
+    table[0x41] = sse66<Mode>("dppd", S::Vx, S::Wx, S::Ib);
+    table[0x42] = sse66<Mode>("mpsadbw", S::Vx, S::Wx, S::Ib);
+    table[0x44] = sse66<Mode>("pclmulqdq", S::Vx, S::Wx, S::Ib);
+    table[0x60] = sse66<Mode>("pcmpestrm", S::Vx, S::Wx, S::Ib);
+    table[0x61] = sse66<Mode>("pcmpestri", S::Vx, S::Wx, S::Ib);
+    table[0x62] = sse66<Mode>("pcmpistrm", S::Vx, S::Wx, S::Ib);
+    table[0x63] = sse66<Mode>("pcmpistri", S::Vx, S::Wx, S::Ib);
+    table[0xCC] = byPrefix(entry<Mode>("sha1rnds4", S::Vx, S::Wx, S::Ib));
+    table[0xCE] = sse66<Mode>("gf2p8affineqb", S::Vx, S::Wx, S::Ib);
+    table[0xCF] = sse66<Mode>("gf2p8affineinvqb", S::Vx, S::Wx, S::Ib);
+    table[0xDF] = sse66<Mode>("aeskeygenassist", S::Vx, S::Wx, S::Ib);
+    return table;
+}
+
+// Builds the tables for opcode groups, indexed by OpcodeGroup and ModR/M reg.
+constexpr std::array<std::array<OpcodeEntry, 8>, GroupCount> buildGroupTable() {
+    using namespace opcode_table_detail;
+    std::array<std::array<OpcodeEntry, 8>, GroupCount> groups{};
+    for (auto& group : groups) {
+        for (auto& slot : group) {
+            slot = invalidEntry;
+        }
+    }
+
+    constexpr const char* alu[] = {"add", "or", "adc", "sbb", "and", "sub", "xor", "cmp"};
+    constexpr const char* shift[] = {"rol", "ror", "rcl", "rcr", "shl", "shr", "sal", "sar"};
+    for (int reg = 0; reg < 8; reg++) {
+        groups[Group1_80][reg] = entry(alu[reg], S::Eb, S::Ib);
+        groups[Group1_81][reg] = entry(alu[reg], S::Ev, S::Iz);
+        groups[Group1_83][reg] = entry(alu[reg], S::Ev, S::Ibs);
+        groups[Group2_C0][reg] = entry(shift[reg], S::Eb, S::Ib);
+        groups[Group2_C1][reg] = entry(shift[reg], S::Ev, S::Ib);
+        groups[Group2_D0][reg] = entry(shift[reg], S::Eb, S::One);
+        groups[Group2_D1][reg] = entry(shift[reg], S::Ev, S::One);
+        groups[Group2_D2][reg] = entry(shift[reg], S::Eb, S::CL);
+        groups[Group2_D3][reg] = entry(shift[reg], S::Ev, S::CL);
+    }
+
+    groups[Group1A_8F][0] = entry("pop", S::Ev, S::None, S::None, OpDefault64);
+
+    constexpr const char* unary[] = {"test", "test", "not", "neg", "mul", "imul", "div", "idiv"};
+    groups[Group3_F6][0] = entry("test", S::Eb, S::Ib);
+    groups[Group3_F6][1] = entry("test", S::Eb, S::Ib);
+    groups[Group3_F7][0] = entry("test", S::Ev, S::Iz);
+    groups[Group3_F7][1] = entry("test", S::Ev, S::Iz);
+    for (int reg = 2; reg < 8; reg++) {
+        groups[Group3_F6][reg] = entry(unary[reg], S::Eb);
+        groups[Group3_F7][reg] = entry(unary[reg], S::Ev);
+    }
+
+    groups[Group4_FE][0] = entry("inc", S::Eb);
+    groups[Group4_FE][1] = entry("dec", S::Eb);
+
+    groups[Group5_FF][0] = entry("inc", S::Ev);
+    groups[Group5_FF][1] = entry("dec", S::Ev);
+    groups[Group5_FF][2] = entry("call", S::Ev, S::None, S::None, OpForce64);
+    groups[Group5_FF][3] = entry("call", S::Mp);
+    groups[Group5_FF][4] = entry("jmp", S::Ev, S::None, S::None, OpForce64);
+    groups[Group5_FF][5] = entry("jmp", S::Mp);
+    groups[Group5_FF][6] = entry("push", S::Ev, S::None, S::None, OpDefault64);
+
+    groups[Group11_C6][0] = entry("mov", S::Eb, S::Ib);
+    // C6 F8 and C7 F8 only: every other /7 form is invalid.
+    groups[Group11_C6][7] = entry("xabort", S::Ib, S::None, S::None, OpModRMF8);
+    groups[Group11_C7][0] = entry("mov", S::Ev, S::Iz);
+    groups[Group11_C7][7] = entry("xbegin", S::Jz, S::None, S::None, OpForce64 | OpModRMF8);
+
+    constexpr const char* descriptor[] = {"sldt", "str", "lldt", "ltr", "verr", "verw"};
+    for (int reg = 0; reg < 6; reg++) {
+        groups[Group6_0F00][reg] = entry(descriptor[reg], S::Ew);
+    }
+    // Register forms of 0F 01 are mostly distinct instructions; see
+    // escapeSpecialTable.
+    groups[Group7_0F01] = {entry("sgdt", S::M), entry("sidt", S::M), entry("lgdt", S::M), entry("lidt", S::M),
+                           entry("smsw", S::Ew), invalidEntry, entry("lmsw", S::Ew), entry("invlpg", S::Mb)};
+    groups[Group7_F3_0F01] = groups[Group7_0F01];
+    groups[Group7_F3_0F01][5] = entry("rstorssp", S::Mq);
+    constexpr const char* bitTest[] = {"bt", "bts", "btr", "btc"};
+    for (int reg = 4; reg < 8; reg++) {
+        groups[Group8_0FBA][reg] = entry(bitTest[reg - 4], S::Ev, S::Ib);
+    }
+    groups[Group9_0FC7][1] = entry("cmpxchg8b cmpxchg8b cmpxchg16b", S::Mq, S::None, S::None, OpSizedMnemonic);
+    groups[Group9_0FC7][6] = entry("rdrand", S::Rv);
+    groups[Group9_0FC7][7] = entry("rdseed", S::Rv);
+
+    // MMX (no prefix) and SSE (66) shifts by an immediate.
+    groups[Group12_0F71][2] = entry("psrlw", S::Nq, S::Ib);
+    groups[Group12_0F71][4] = entry("psraw", S::Nq, S::Ib);
+    groups[Group12_0F71][6] = entry("psllw", S::Nq, S::Ib);
+    groups[Group12_66_0F71][2] = entry("psrlw", S::Ux, S::Ib);
+    groups[Group12_66_0F71][4] = entry("psraw", S::Ux, S::Ib);
+    groups[Group12_66_0F71][6] = entry("psllw", S::Ux, S::Ib);
+    groups[Group13_0F72][2] = entry("psrld", S::Nq, S::Ib);
+    groups[Group13_0F72][4] = entry("psrad", S::Nq, S::Ib);
+    groups[Group13_0F72][6] = entry("pslld", S::Nq, S::Ib);
+    groups[Group13_66_0F72][2] = entry("psrld", S::Ux, S::Ib);
+    groups[Group13_66_0F72][4] = entry("psrad", S::Ux, S::Ib);
+    groups[Group13_66_0F72][6] = entry("pslld", S::Ux, S::Ib);
+    groups[Group14_0F73][2] = entry("psrlq", S::Nq, S::Ib);
+    groups[Group14_0F73][6] = entry("psllq", S::Nq, S::Ib);
+    groups[Group14_66_0F73][2] = entry("psrlq", S::Ux, S::Ib);
+    groups[Group14_66_0F73][3] = entry("psrldq", S::Ux, S::Ib);
+    groups[Group14_66_0F73][6] = entry("psllq", S::Ux, S::Ib);
+    groups[Group14_66_0F73][7] = entry("pslldq", S::Ux, S::Ib);
+
+    // Register forms of 0F AE without a prefix are the fences; see
+    // escapeSpecialTable.
+    groups[Group15_0FAE] = {entry("fxsave fxsave fxsave64", S::M, S::None, S::None, OpSizedMnemonic),
+                            entry("fxrstor fxrstor fxrstor64", S::M, S::None, S::None, OpSizedMnemonic),
+                            entry("ldmxcsr", S::Md), entry("stmxcsr", S::Md),
+                            entry("xsave xsave xsave64", S::M, S::None, S::None, OpSizedMnemonic),
+                            entry("xrstor xrstor xrstor64", S::M, S::None, S::None, OpSizedMnemonic),
+                            entry("xsaveopt xsaveopt xsaveopt64", S::M, S::None, S::None, OpSizedMnemonic),
+                            entry("clflush", S::Mb)};
+    groups[Group15_66_0FAE][6] = entry("clwb", S::Mb);
+    groups[Group15_66_0FAE][7] = entry("clflushopt", S::Mb);
+    groups[Group15_F3_0FAE][0] = entry("rdfsbase", S::Ey, S::None, S::None, OpRegisterOnly);
+    groups[Group15_F3_0FAE][1] = entry("rdgsbase", S::Ey, S::None, S::None, OpRegisterOnly);
+    groups[Group15_F3_0FAE][2] = entry("wrfsbase", S::Ey, S::None, S::None, OpRegisterOnly);
+    groups[Group15_F3_0FAE][3] = entry("wrgsbase", S::Ey, S::None, S::None, OpRegisterOnly);
+    groups[Group15_F3_0FAE][5] = entry("incsspd incsspd incsspq", S::Ey, S::None, S::None,
+                                       OpRegisterOnly | OpSizedMnemonic);
+
+    groups[Group16_0F18] = {entry("prefetchnta", S::Mb), entry("prefetcht0", S::Mb),
+                            entry("prefetcht1", S::Mb), entry("prefetcht2", S::Mb),
+                            entry("nop", S::Ev), entry("nop", S::Ev), entry("nop", S::Ev), entry("nop", S::Ev)};
+    groups[GroupP_0F0D][0] = entry("prefetch", S::Mb);
+    groups[GroupP_0F0D][1] = entry("prefetchw", S::Mb);
+    groups[GroupP_0F0D][2] = entry("prefetchwt1", S::Mb);
+
+    // VEX shifts by an immediate write VEX.vvvv; EVEX also accepts a memory
+    // source and adds rotates (W picks the d or q form).
+    constexpr const char* shiftWords[] = {nullptr, nullptr, "vpsrlw", nullptr, "vpsraw", nullptr, "vpsllw", nullptr};
+    constexpr const char* shiftDwords[] = {nullptr, nullptr, "vpsrld", nullptr, "vpsrad", nullptr, "vpslld", nullptr};
+    constexpr const char* shiftQwords[] = {nullptr, nullptr, "vpsrlq", "vpsrldq", nullptr, nullptr, "vpsllq", "vpslldq"};
+    for (int reg = 0; reg < 8; reg++) {
+        if (shiftWords[reg] != nullptr) {
+            groups[GroupVex12_0F71][reg] = entry(shiftWords[reg], S::Hx, S::Ux, S::Ib);
+            groups[GroupEvex12_0F71][reg] = entry(shiftWords[reg], S::Hx, S::Wx, S::Ib);
+        }
+        if (shiftDwords[reg] != nullptr) {
+            groups[GroupVex13_0F72][reg] = entry(shiftDwords[reg], S::Hx, S::Ux, S::Ib);
+            groups[GroupEvex13_0F72][reg] = entry(shiftDwords[reg], S::Hx, S::Wx, S::Ib);
+        }
+        if (shiftQwords[reg] != nullptr) {
+            groups[GroupVex14_0F73][reg] = entry(shiftQwords[reg], S::Hx, S::Ux, S::Ib);
+            groups[GroupEvex14_0F73][reg] = entry(shiftQwords[reg], S::Hx, S::Wx, S::Ib);
+        }
+    }
+    groups[GroupEvex13_0F72][0] = entry("vprord vprord vprorq", S::Hx, S::Wx, S::Ib, OpSizedMnemonic);
+    groups[GroupEvex13_0F72][1] = entry("vprold vprold vprolq", S::Hx, S::Wx, S::Ib, OpSizedMnemonic);
+    groups[GroupEvex13_0F72][4] = entry("vpsrad vpsrad vpsraq", S::Hx, S::Wx, S::Ib, OpSizedMnemonic);
+    groups[GroupVex15_0FAE][2] = entry("vldmxcsr", S::Md);
+    groups[GroupVex15_0FAE][3] = entry("vstmxcsr", S::Md);
+    groups[GroupVex17_0F38F3][1] = entry("blsr", S::By, S::Ey);
+    groups[GroupVex17_0F38F3][2] = entry("blsmsk", S::By, S::Ey);
+    groups[GroupVex17_0F38F3][3] = entry("blsi", S::By, S::Ey);
+    return groups;
+}
+
+// x87 escape opcodes D8-DF. Memory forms are indexed by [opcode - 0xD8][reg];
+// register forms (mod == 3) by [opcode - 0xD8][reg], except for the rows that
+// encode a distinct instruction per r/m value, which live in x87SpecialTable.
+constexpr std::array<std::array<OpcodeEntry, 8>, 8> buildX87MemoryTable() {
+    using namespace opcode_table_detail;
+    constexpr const char* arith[] = {"fadd", "fmul", "fcom", "fcomp", "fsub", "fsubr", "fdiv", "fdivr"};
+    constexpr const char* intArith[] = {"fiadd", "fimul", "ficom", "ficomp", "fisub", "fisubr", "fidiv", "fidivr"};
+    std::array<std::array<OpcodeEntry, 8>, 8> table{};
+    for (int reg = 0; reg < 8; reg++) {
+        table[0][reg] = entry(arith[reg], S::Md);
+        table[2][reg] = entry(intArith[reg], S::Md);
+        table[4][reg] = entry(arith[reg], S::Mq);
+        table[6][reg] = entry(intArith[reg], S::Mw);
+    }
+    table[1] = {entry("fld", S::Md), invalidEntry, entry("fst", S::Md), entry("fstp", S::Md),
+                entry("fldenv", S::M), entry("fldcw", S::Mw), entry("fnstenv", S::M), entry("fnstcw", S::Mw)};
+    table[3] = {entry("fild", S::Md), entry("fisttp", S::Md), entry("fist", S::Md), entry("fistp", S::Md),
+                invalidEntry, entry("fld", S::Mt), invalidEntry, entry("fstp", S::Mt)};
+    table[5] = {entry("fld", S::Mq), entry("fisttp", S::Mq), entry("fst", S::Mq), entry("fstp", S::Mq),
+                entry("frstor", S::M), invalidEntry, entry("fnsave", S::M), entry("fnstsw", S::Mw)};
+    table[7] = {entry("fild", S::Mw), entry("fisttp", S::Mw), entry("fist", S::Mw), entry("fistp", S::Mw),
+                entry("fbld", S::Mt), entry("fild", S::Mq), entry("fbstp", S::Mt), entry("fistp", S::Mq)};
+    return table;
+}
+
+constexpr std::array<std::array<OpcodeEntry, 8>, 8> buildX87RegisterTable() {
+    using namespace opcode_table_detail;
+    std::array<std::array<OpcodeEntry, 8>, 8> table{};
+    for (auto& row : table) {
+        for (auto& slot : row) {
+            slot = invalidEntry;
+        }
+    }
+    constexpr const char* arith[] = {"fadd", "fmul", "fcom", "fcomp", "fsub", "fsubr", "fdiv", "fdivr"};
+    for (int reg = 0; reg < 8; reg++) {
+        table[0][reg] = (reg == 2 || reg == 3) ? entry(arith[reg], S::STi) : entry(arith[reg], S::ST0, S::STi);
+    }
+    table[1][0] = entry("fld", S::STi);
+    table[1][1] = entry("fxch", S::STi);
+    table[2] = {entry("fcmovb", S::ST0, S::STi), entry("fcmove", S::ST0, S::STi),
+                entry("fcmovbe", S::ST0, S::STi), entry("fcmovu", S::ST0, S::STi),
+                invalidEntry, invalidEntry, invalidEntry, invalidEntry};
+    table[3] = {entry("fcmovnb", S::ST0, S::STi), entry("fcmovne", S::ST0, S::STi),
+                entry("fcmovnbe", S::ST0, S::STi), entry("fcmovnu", S::ST0, S::STi),
+                invalidEntry, entry("fucomi", S::ST0, S::STi), entry("fcomi", S::ST0, S::STi), invalidEntry};
+    table[4] = {entry("fadd", S::STi, S::ST0), entry("fmul", S::STi, S::ST0), invalidEntry, invalidEntry,
+                entry("fsubr", S::STi, S::ST0), entry("fsub", S::STi, S::ST0),
+                entry("fdivr", S::STi, S::ST0), entry("fdiv", S::STi, S::ST0)};
+    table[5] = {entry("ffree", S::STi), invalidEntry, entry("fst", S::STi), entry("fstp", S::STi),
+                entry("fucom", S::STi), entry("fucomp", S::STi), invalidEntry, invalidEntry};
+    table[6] = {entry("faddp", S::STi, S::ST0), entry("fmulp", S::STi, S::ST0), invalidEntry, invalidEntry,
+                entry("fsubrp", S::STi, S::ST0), entry("fsubp", S::STi, S::ST0),
+                entry("fdivrp", S::STi, S::ST0), entry("fdivp", S::STi, S::ST0)};
+    table[7] = {invalidEntry, invalidEntry, invalidEntry, invalidEntry,
+                invalidEntry, entry("fucomip", S::ST0, S::STi), entry("fcomip", S::ST0, S::STi), invalidEntry};
+    return table;
+}
+
+// x87 register forms that are selected by the full ModR/M byte.
+struct X87SpecialEntry {
+    uint8_t opcode;
+    uint8_t modrm;
+    OpcodeEntry entry;
+};
+
+constexpr X87SpecialEntry x87Special(uint8_t opcode, uint8_t modrm, const char* mnemonic,
+                                     OperandSpec operand = OperandSpec::None) {
+    return {opcode, modrm, opcode_table_detail::entry(mnemonic, operand)};
+}
+
+inline constexpr X87SpecialEntry x87SpecialTable[] = {
+    x87Special(0xD9, 0xD0, "fnop"),
+    x87Special(0xD9, 0xE0, "fchs"),    x87Special(0xD9, 0xE1, "fabs"),
+    x87Special(0xD9, 0xE4, "ftst"),    x87Special(0xD9, 0xE5, "fxam"),
+    x87Special(0xD9, 0xE8, "fld1"),    x87Special(0xD9, 0xE9, "fldl2t"),
+    x87Special(0xD9, 0xEA, "fldl2e"),  x87Special(0xD9, 0xEB, "fldpi"),
+    x87Special(0xD9, 0xEC, "fldlg2"),  x87Special(0xD9, 0xED, "fldln2"),
+    x87Special(0xD9, 0xEE, "fldz"),
+    x87Special(0xD9, 0xF0, "f2xm1"),   x87Special(0xD9, 0xF1, "fyl2x"),
+    x87Special(0xD9, 0xF2, "fptan"),   x87Special(0xD9, 0xF3, "fpatan"),
+    x87Special(0xD9, 0xF4, "fxtract"), x87Special(0xD9, 0xF5, "fprem1"),
+    x87Special(0xD9, 0xF6, "fdecstp"), x87Special(0xD9, 0xF7, "fincstp"),
+    x87Special(0xD9, 0xF8, "fprem"),   x87Special(0xD9, 0xF9, "fyl2xp1"),
+    x87Special(0xD9, 0xFA, "fsqrt"),   x87Special(0xD9, 0xFB, "fsincos"),
+    x87Special(0xD9, 0xFC, "frndint"), x87Special(0xD9, 0xFD, "fscale"),
+    x87Special(0xD9, 0xFE, "fsin"),    x87Special(0xD9, 0xFF, "fcos"),
+    x87Special(0xDA, 0xE9, "fucompp"),
+    x87Special(0xDB, 0xE2, "fnclex"),  x87Special(0xDB, 0xE3, "fninit"),
+    x87Special(0xDE, 0xD9, "fcompp"),
+    x87Special(0xDF, 0xE0, "fnstsw", OperandSpec::AX),
+};
+
+// Register forms of the escape maps that are selected by the whole ModR/M
+// byte (and the mandatory prefix column) rather than by its reg field.
+struct EscapeSpecialEntry {
+    uint16_t opcode;  // Opcode id (map << 8 | byte)
+    uint8_t prefix;   // MandatoryPrefix column
+    uint8_t modrm;
+    OpcodeEntry entry;
+};
+
+constexpr EscapeSpecialEntry escapeSpecial(uint16_t opcode, MandatoryPrefix prefix, uint8_t modrm,
+                                           const char* mnemonic, OperandSpec operand = OperandSpec::None,
+                                           uint16_t flags = 0) {
+    return {opcode, prefix, modrm, opcode_table_detail::entry(mnemonic, operand, OperandSpec::None,
+                                                              OperandSpec::None, flags)};
+}
+
+constexpr EscapeSpecialEntry rdssp(uint8_t modrm) {
+    return escapeSpecial(0x11E, MandatoryF3, modrm, "rdsspd rdsspd rdsspq", OperandSpec::Ey, OpSizedMnemonic);
+}
+
+inline constexpr EscapeSpecialEntry escapeSpecialTable[] = {
+    escapeSpecial(0x101, MandatoryNone, 0xC1, "vmcall"),   escapeSpecial(0x101, MandatoryNone, 0xC2, "vmlaunch"),
+    escapeSpecial(0x101, MandatoryNone, 0xC3, "vmresume"), escapeSpecial(0x101, MandatoryNone, 0xC4, "vmxoff"),
+    escapeSpecial(0x101, MandatoryNone, 0xC8, "monitor"),  escapeSpecial(0x101, MandatoryNone, 0xC9, "mwait"),
+    escapeSpecial(0x101, MandatoryNone, 0xCA, "clac"),     escapeSpecial(0x101, MandatoryNone, 0xCB, "stac"),
+    escapeSpecial(0x101, MandatoryNone, 0xD0, "xgetbv"),   escapeSpecial(0x101, MandatoryNone, 0xD1, "xsetbv"),
+    escapeSpecial(0x101, MandatoryNone, 0xD5, "xend"),     escapeSpecial(0x101, MandatoryNone, 0xD6, "xtest"),
+    escapeSpecial(0x101, MandatoryNone, 0xE8, "serialize"),
+    escapeSpecial(0x101, MandatoryF3, 0xE8, "setssbsy"),   escapeSpecial(0x101, MandatoryF3, 0xEA, "saveprevssp"),
+    escapeSpecial(0x101, MandatoryNone, 0xEE, "rdpkru"),   escapeSpecial(0x101, MandatoryNone, 0xEF, "wrpkru"),
+    escapeSpecial(0x101, MandatoryNone, 0xF8, "swapgs"),   escapeSpecial(0x101, MandatoryNone, 0xF9, "rdtscp"),
+    escapeSpecial(0x11E, MandatoryF3, 0xFA, "endbr64"),    escapeSpecial(0x11E, MandatoryF3, 0xFB, "endbr32"),
+    rdssp(0xC8), rdssp(0xC9), rdssp(0xCA), rdssp(0xCB), rdssp(0xCC), rdssp(0xCD), rdssp(0xCE), rdssp(0xCF),
+    escapeSpecial(0x1AE, MandatoryNone, 0xE8, "lfence"),   escapeSpecial(0x1AE, MandatoryNone, 0xF0, "mfence"),
+    escapeSpecial(0x1AE, MandatoryNone, 0xF8, "sfence"),
+};
+
+// Effective operand size in bits of an instruction decoded in mode. The
+// decoder passes its Mode template argument, so the mode tests fold away.
+constexpr int operandSizeBits(CpuMode mode, uint8_t prefixes, uint8_t rex, uint16_t opcodeFlags) {
+    if (mode == CpuMode::Bits16) {
+        return (prefixes & PrefixOperandSize) ? 32 : 16;
+    }
+    if (mode == CpuMode::Bits32) {
+        return (prefixes & PrefixOperandSize) ? 16 : 32;
+    }
+    if ((opcodeFlags & OpForce64) || (rex & 0x08)) {
+        return 64;
+    }
+    if (prefixes & PrefixOperandSize) {
+        return 16;
+    }
+    return (opcodeFlags & OpDefault64) ? 64 : 32;
+}
+
+// Effective address size in bits: the mode's default, switched by 0x67.
+constexpr int addressSizeBits(CpuMode mode, uint8_t prefixes) {
+    bool toggled = (prefixes & PrefixAddressSize) != 0;
+    switch (mode) {
+        case CpuMode::Bits16: return toggled ? 32 : 16;
+        case CpuMode::Bits32: return toggled ? 16 : 32;
+        default: return toggled ? 32 : 64;
+    }
+}
+
+// Size in bytes of a Jz branch displacement.
+constexpr size_t relativeSizeZ(CpuMode mode, int operandBits) {
+    return mode != CpuMode::Bits64 && operandBits == 16 ? 2 : 4;
+}
+
+template <CpuMode Mode>
+inline constexpr std::array<OpcodeEntry, 256> primaryOpcodeTable = buildPrimaryOpcodeTable<Mode>();
+// The 0F, 0F 38 and 0F 3A maps, indexed by map - Map0F.
+template <CpuMode Mode>
+inline constexpr std::array<EscapeOpcodeTable, 3> escapeOpcodeTable = {
+    build0FOpcodeTable<Mode>(), build0F38OpcodeTable<Mode>(), build0F3AOpcodeTable<Mode>()};
+inline constexpr std::array<std::array<OpcodeEntry, 8>, GroupCount> groupOpcodeTable = buildGroupTable();
+inline constexpr std::array<std::array<OpcodeEntry, 8>, 8> x87MemoryTable = buildX87MemoryTable();
+inline constexpr std::array<std::array<OpcodeEntry, 8>, 8> x87RegisterTable = buildX87RegisterTable();
+
+namespace opcode_table_detail {
+
+// How the VEX form of a legacy SSE instruction uses VEX.vvvv. Most ops take
+// it as their first source (vaddps xmm0, xmm1, xmm2 adds xmm1 and xmm2).
+// Moves, conversions and other one-source ops leave it unused, and a few
+// legacy ops have no VEX form at all.
+enum VexSourceShape : uint8_t { VexNoForm, VexUnary, VexNds, VexNdsRegister };
+
+constexpr VexSourceShape vexSourceShape(OpcodeMap map, int op, int prefix) {
+    bool packed = prefix == MandatoryNone || prefix == Mandatory66;
+    if (map == Map0F) {
+        switch (op) {
+            case 0x10: case 0x11: return packed ? VexUnary : VexNdsRegister;  // vmovss/vmovsd xmm, xmm, xmm
+            case 0x12: case 0x16: return packed ? VexNds : VexUnary;          // vmovlps vs vmovsldup
+            case 0x51: case 0x52: case 0x53: case 0x5A: return packed ? VexUnary : VexNds;
+            case 0x13: case 0x17: case 0x28: case 0x29: case 0x2B: case 0x2C: case 0x2D: case 0x2E: case 0x2F:
+            case 0x50: case 0x5B: case 0x6E: case 0x6F: case 0x70: case 0x7E: case 0x7F: case 0xC5:
+            case 0xD6: case 0xD7: case 0xE6: case 0xE7: case 0xF0: case 0xF7:
+                return VexUnary;
+            default: return VexNds;
+        }
+    }
+    if (map == Map0F38) {
+        if ((op >= 0x20 && op <= 0x25) || (op >= 0x30 && op <= 0x35)) {
+            return VexUnary;
+        }
+        switch (op) {
+            case 0x17: case 0x1C: case 0x1D: case 0x1E: case 0x2A: case 0x41: case 0xDB: return VexUnary;
+            case 0xC8: case 0xC9: case 0xCA: case 0xCB: case 0xCC: case 0xCD: return VexNoForm;  // SHA
+            default: return VexNds;
+        }
+    }
+    switch (op) {
+        case 0x08: case 0x09: case 0x14: case 0x15: case 0x16: case 0x17:
+        case 0x60: case 0x61: case 0x62: case 0x63: case 0xDF:
+            return VexUnary;
+        case 0xCC: return VexNoForm;
+        default: return VexNds;
+    }
+}
+
+// Whether a legacy escape-map entry is an SSE instruction VEX can encode:
+// it has an xmm operand and no mmx one (and no implicit xmm0).
+constexpr bool isSseEntry(const OpcodeEntry& e) {
+    if (e.mnemonic == nullptr) {
+        return false;
+    }
+    bool xmm = false;
+    for (S spec : e.operands) {
+        if (spec == S::Pq || spec == S::Qq || spec == S::Nq || spec == S::XMM0) {
+            return false;
+        }
+        xmm = xmm || spec == S::Vx || spec == S::Vh || spec == S::Ux || (spec >= S::Wx && spec <= S::Ww) ||
+              (spec >= S::Wh && spec <= S::We);
+    }
+    return xmm;
+}
+
+// The VEX form of a legacy SSE entry: the same operands (widened by VEX.L
+// when printed) and the mnemonic with a v in front.
+constexpr OpcodeEntry vexForm(OpcodeEntry legacy, VexSourceShape shape) {
+    legacy.flags |= OpVexMnemonic;
+    if (shape == VexNds) {
+        legacy.flags |= OpVexNds;
+    } else if (shape == VexNdsRegister) {
+        legacy.flags |= OpVexNdsRegister;
+    }
+    return legacy;
+}
+
+// An entry whose first source is VEX.vvvv.
+template <CpuMode Mode>
+constexpr OpcodeEntry nds(const char* mnemonic, S a, S b, S c = S::None, uint16_t flags = 0) {
+    return entry<Mode>(mnemonic, a, b, c, static_cast<uint16_t>(flags | OpVexNds));
+}
+
+// Slots of the VEX and EVEX maps that this decoder does not name still have
+// the shape every such instruction shares (a ModR/M byte, plus an imm8 in
+// the 0F 3A map), so they decode to their full length and print as (bad)
+// instead of desynchronising the sweep.
+template <CpuMode Mode>
+constexpr EscapeOpcodeTable unnamedVexTable(OpcodeMap map) {
+    OpcodeEntry unnamed = {decodeOperands<Mode>, nullptr, {S::None, S::None, S::None}, GroupNone,
+                           OpHasModRM, static_cast<uint8_t>(map == Map0F3A ? 1 : 0), 0};
+    EscapeOpcodeTable table{};
+    for (auto& row : table) {
+        row = anyPrefix(unnamed);
+    }
+    return table;
+}
+
+} // namespace opcode_table_detail
+
+// Builds the VEX form of one escape map for Mode: the SSE instructions of
+// the same slot re-encoded (vaddps, vpxor, ...), plus AVX/AVX2, FMA, F16C,
+// BMI1/BMI2 and the VEX-encoded AVX-512 opmask instructions. VEX.W picks
+// the second spelling of sized mnemonics ("vpsrlvd vpsrlvd vpsrlvq").
+template <CpuMode Mode>
+constexpr EscapeOpcodeTable buildVexOpcodeTable(OpcodeMap map) {
+    using namespace opcode_table_detail;
+    EscapeOpcodeTable table = unnamedVexTable<Mode>(map);
+    const EscapeOpcodeTable& legacy = escapeOpcodeTable<Mode>[map - Map0F];
+    for (int op = 0; op < 256; op++) {
+        for (int prefix = 0; prefix < MandatoryPrefixCount; prefix++) {
+            VexSourceShape shape = vexSourceShape(map, op, prefix);
+            if (shape != VexNoForm && isSseEntry(legacy[op][prefix])) {
+                table[op][prefix] = vexForm(legacy[op][prefix], shape);
+            }
+        }
+    }
+
+    if (map == Map0F) {
+        // Shifts by a register count take the count from an xmm register
+        // or 128 bits of memory at every vector length.
+        for (int op : {0xD1, 0xD2, 0xD3, 0xE1, 0xE2, 0xF1, 0xF2, 0xF3}) {
+            table[op][Mandatory66].operands[1] = S::Wdq;
+        }
+        // Opmask logic: w/q without a prefix, b/d with 66.
+        struct MaskOp {
+            int op;
+            const char* word;
+            const char* byte;
+        };
+        constexpr MaskOp maskOps[] = {
+            {0x41, "kandw kandw kandq", "kandb kandb kandd"}, {0x42, "kandnw kandnw kandnq", "kandnb kandnb kandnd"},
+            {0x45, "korw korw korq", "korb korb kord"},       {0x46, "kxnorw kxnorw kxnorq", "kxnorb kxnorb kxnord"},
+            {0x47, "kxorw kxorw kxorq", "kxorb kxorb kxord"}, {0x4A, "kaddw kaddw kaddq", "kaddb kaddb kaddd"}};
+        for (const MaskOp& mask : maskOps) {
+            table[mask.op][MandatoryNone] = entry<Mode>(mask.word, S::Kg, S::Kh, S::Kr, OpSizedMnemonic);
+            table[mask.op][Mandatory66] = entry<Mode>(mask.byte, S::Kg, S::Kh, S::Kr, OpSizedMnemonic);
+        }
+        table[0x44][MandatoryNone] = entry<Mode>("knotw knotw knotq", S::Kg, S::Kr, S::None, OpSizedMnemonic);
+        table[0x44][Mandatory66] = entry<Mode>("knotb knotb knotd", S::Kg, S::Kr, S::None, OpSizedMnemonic);
+        table[0x4B][MandatoryNone] = entry<Mode>("kunpckwd kunpckwd kunpckdq", S::Kg, S::Kh, S::Kr, OpSizedMnemonic);
+        table[0x4B][Mandatory66] = entry<Mode>("kunpckbw", S::Kg, S::Kh, S::Kr);
+        table[0x77][MandatoryNone] = entry<Mode>("vzeroupper");  // vzeroall with VEX.L (see the printer)
+        table[0x90][MandatoryNone] = entry<Mode>("kmovw kmovw kmovq", S::Kg, S::Ke, S::None, OpSizedMnemonic);
+        table[0x90][Mandatory66] = entry<Mode>("kmovb kmovb kmovd", S::Kg, S::Ke, S::None, OpSizedMnemonic);
+        table[0x91][MandatoryNone] = entry<Mode>("kmovw kmovw kmovq", S::Ke, S::Kg, S::None, OpSizedMnemonic | OpMemoryOnly);
+        table[0x91][Mandatory66] = entry<Mode>("kmovb kmovb kmovd", S::Ke, S::Kg, S::None, OpSizedMnemonic | OpMemoryOnly);
+        table[0x92][MandatoryNone] = entry<Mode>("kmovw", S::Kg, S::Ey, S::None, OpRegisterOnly);
+        table[0x92][Mandatory66] = entry<Mode>("kmovb", S::Kg, S::Ey, S::None, OpRegisterOnly);
+        table[0x92][MandatoryF2] = entry<Mode>("kmovd kmovd kmovq", S::Kg, S::Ey, S::None, OpSizedMnemonic | OpRegisterOnly);
+        table[0x93][MandatoryNone] = entry<Mode>("kmovw", S::Gd, S::Kr);
+        table[0x93][Mandatory66] = entry<Mode>("kmovb", S::Gd, S::Kr);
+        table[0x93][MandatoryF2] = entry<Mode>("kmovd kmovd kmovq", S::Gy, S::Kr, S::None, OpSizedMnemonic);
+        table[0x98][MandatoryNone] = entry<Mode>("kortestw kortestw kortestq", S::Kg, S::Kr, S::None, OpSizedMnemonic);
+        table[0x98][Mandatory66] = entry<Mode>("kortestb kortestb kortestd", S::Kg, S::Kr, S::None, OpSizedMnemonic);
+        table[0x99][MandatoryNone] = entry<Mode>("ktestw ktestw ktestq", S::Kg, S::Kr, S::None, OpSizedMnemonic);
+        table[0x99][Mandatory66] = entry<Mode>("ktestb ktestb ktestd", S::Kg, S::Kr, S::None, OpSizedMnemonic);
+        table[0x71][Mandatory66] = groupEntry<Mode>(GroupVex12_0F71);
+        table[0x72][Mandatory66] = groupEntry<Mode>(GroupVex13_0F72);
+        table[0x73][Mandatory66] = groupEntry<Mode>(GroupVex14_0F73);
+        table[0xAE][MandatoryNone] = groupEntry<Mode>(GroupVex15_0FAE);
+    } else if (map == Map0F38) {
+        table[0x0C][Mandatory66] = nds<Mode>("vpermilps", S::Vx, S::Wx);
+        table[0x0D][Mandatory66] = nds<Mode>("vpermilpd", S::Vx, S::Wx);
+        table[0x0E][Mandatory66] = entry<Mode>("vtestps", S::Vx, S::Wx);
+        table[0x0F][Mandatory66] = entry<Mode>("vtestpd", S::Vx, S::Wx);
+        table[0x13][Mandatory66] = entry<Mode>("vcvtph2ps", S::Vx, S::Wh);
+        table[0x16][Mandatory66] = nds<Mode>("vpermps vpermps vpermpd", S::Vx, S::Wx, S::None, OpSizedMnemonic);
+        table[0x18][Mandatory66] = entry<Mode>("vbroadcastss", S::Vx, S::Wd);
+        table[0x19][Mandatory66] = entry<Mode>("vbroadcastsd", S::Vx, S::Wq);
+        table[0x1A][Mandatory66] = entry<Mode>("vbroadcastf128", S::Vx, S::Mx);
+        table[0x2C][Mandatory66] = nds<Mode>("vmaskmovps", S::Vx, S::Wx, S::None, OpMemoryOnly);
+        table[0x2D][Mandatory66] = nds<Mode>("vmaskmovpd", S::Vx, S::Wx, S::None, OpMemoryOnly);
+        table[0x2E][Mandatory66] = entry<Mode>("vmaskmovps", S::Wx, S::Hx, S::Vx, OpMemoryOnly);
+        table[0x2F][Mandatory66] = entry<Mode>("vmaskmovpd", S::Wx, S::Hx, S::Vx, OpMemoryOnly);
+        table[0x36][Mandatory66] = nds<Mode>("vpermd vpermd vpermq", S::Vx, S::Wx, S::None, OpSizedMnemonic);
+        table[0x45][Mandatory66] = nds<Mode>("vpsrlvd vpsrlvd vpsrlvq", S::Vx, S::Wx, S::None, OpSizedMnemonic);
+        table[0x46][Mandatory66] = nds<Mode>("vpsravd vpsravd vpsravq", S::Vx, S::Wx, S::None, OpSizedMnemonic);
+        table[0x47][Mandatory66] = nds<Mode>("vpsllvd vpsllvd vpsllvq", S::Vx, S::Wx, S::None, OpSizedMnemonic);
+        table[0x50][Mandatory66] = nds<Mode>("vpdpbusd", S::Vx, S::Wx);
+        table[0x51][Mandatory66] = nds<Mode>("vpdpbusds", S::Vx, S::Wx);
+        table[0x52][Mandatory66] = nds<Mode>("vpdpwssd", S::Vx, S::Wx);
+        table[0x53][Mandatory66] = nds<Mode>("vpdpwssds", S::Vx, S::Wx);
+        table[0x58][Mandatory66] = entry<Mode>("vpbroadcastd", S::Vx, S::Wd);
+        table[0x59][Mandatory66] = entry<Mode>("vpbroadcastq", S::Vx, S::Wq);
+        table[0x5A][Mandatory66] = entry<Mode>("vbroadcasti128", S::Vx, S::Mx);
+        table[0x78][Mandatory66] = entry<Mode>("vpbroadcastb", S::Vx, S::Wb);
+        table[0x79][Mandatory66] = entry<Mode>("vpbroadcastw", S::Vx, S::Ww);
+        table[0x8C][Mandatory66] = nds<Mode>("vpmaskmovd vpmaskmovd vpmaskmovq", S::Vx, S::Wx, S::None,
+                                             OpSizedMnemonic | OpMemoryOnly);
+        table[0x8E][Mandatory66] = entry<Mode>("vpmaskmovd vpmaskmovd vpmaskmovq", S::Wx, S::Hx, S::Vx,
+                                               OpSizedMnemonic | OpMemoryOnly);
+
+        // 96-BF: fused multiply-add. The high nibble is the operand order
+        // (132, 213, 231), the low one the operation; odd ones are scalar.
+        constexpr const char* fma[3][10] = {
+            {"vfmaddsub132ps vfmaddsub132ps vfmaddsub132pd", "vfmsubadd132ps vfmsubadd132ps vfmsubadd132pd",
+             "vfmadd132ps vfmadd132ps vfmadd132pd", "vfmadd132ss vfmadd132ss vfmadd132sd",
+             "vfmsub132ps vfmsub132ps vfmsub132pd", "vfmsub132ss vfmsub132ss vfmsub132sd",
+             "vfnmadd132ps vfnmadd132ps vfnmadd132pd", "vfnmadd132ss vfnmadd132ss vfnmadd132sd",
+             "vfnmsub132ps vfnmsub132ps vfnmsub132pd", "vfnmsub132ss vfnmsub132ss vfnmsub132sd"},
+            {"vfmaddsub213ps vfmaddsub213ps vfmaddsub213pd", "vfmsubadd213ps vfmsubadd213ps vfmsubadd213pd",
+             "vfmadd213ps vfmadd213ps vfmadd213pd", "vfmadd213ss vfmadd213ss vfmadd213sd",
+             "vfmsub213ps vfmsub213ps vfmsub213pd", "vfmsub213ss vfmsub213ss vfmsub213sd",
+             "vfnmadd213ps vfnmadd213ps vfnmadd213pd", "vfnmadd213ss vfnmadd213ss vfnmadd213sd",
+             "vfnmsub213ps vfnmsub213ps vfnmsub213pd", "vfnmsub213ss vfnmsub213ss vfnmsub213sd"},
+            {"vfmaddsub231ps vfmaddsub231ps vfmaddsub231pd", "vfmsubadd231ps vfmsubadd231ps vfmsubadd231pd",
+             "vfmadd231ps vfmadd231ps vfmadd231pd", "vfmadd231ss vfmadd231ss vfmadd231sd",
+             "vfmsub231ps vfmsub231ps vfmsub231pd", "vfmsub231ss vfmsub231ss vfmsub231sd",
+             "vfnmadd231ps vfnmadd231ps vfnmadd231pd", "vfnmadd231ss vfnmadd231ss vfnmadd231sd",
+             "vfnmsub231ps vfnmsub231ps vfnmsub231pd", "vfnmsub231ss vfnmsub231ss vfnmsub231sd"}};
+        for (int order = 0; order < 3; order++) {
+            for (int op = 0; op < 10; op++) {
+                bool scalar = op >= 3 && (op & 1);
+                table[0x96 + order * 16 + op][Mandatory66] =
+                    nds<Mode>(fma[order][op], S::Vx, scalar ? S::Ws : S::Wx, S::None, OpSizedMnemonic);
+            }
+        }
+        table[0xB4][Mandatory66] = nds<Mode>("vpmadd52luq", S::Vx, S::Wx);
+        table[0xB5][Mandatory66] = nds<Mode>("vpmadd52huq", S::Vx, S::Wx);
+
+        // BMI1/BMI2: general-purpose operations with a third register in VEX.vvvv.
+        table[0xF2][MandatoryNone] = entry<Mode>("andn", S::Gy, S::By, S::Ey);
+        table[0xF3][MandatoryNone] = groupEntry<Mode>(GroupVex17_0F38F3);
+        table[0xF5][MandatoryNone] = entry<Mode>("bzhi", S::Gy, S::Ey, S::By);
+        table[0xF5][MandatoryF3] = entry<Mode>("pext", S::Gy, S::By, S::Ey);
+        table[0xF5][MandatoryF2] = entry<Mode>("pdep", S::Gy, S::By, S::Ey);
+        table[0xF6][MandatoryF2] = entry<Mode>("mulx", S::Gy, S::By, S::Ey);
+        table[0xF7][MandatoryNone] = entry<Mode>("bextr", S::Gy, S::Ey, S::By);
+        table[0xF7][Mandatory66] = entry<Mode>("shlx", S::Gy, S::Ey, S::By);
+        table[0xF7][MandatoryF3] = entry<Mode>("sarx", S::Gy, S::Ey, S::By);
+        table[0xF7][MandatoryF2] = entry<Mode>("shrx", S::Gy, S::Ey, S::By);
+    } else {
+        table[0x00][Mandatory66] = entry<Mode>("vpermq", S::Vx, S::Wx, S::Ib);
+        table[0x01][Mandatory66] = entry<Mode>("vpermpd", S::Vx, S::Wx, S::Ib);
+        table[0x02][Mandatory66] = nds<Mode>("vpblendd", S::Vx, S::Wx, S::Ib);
+        table[0x04][Mandatory66] = entry<Mode>("vpermilps", S::Vx, S::Wx, S::Ib);
+        table[0x05][Mandatory66] = entry<Mode>("vpermilpd", S::Vx, S::Wx, S::Ib);
+        table[0x06][Mandatory66] = nds<Mode>("vperm2f128", S::Vx, S::Wx, S::Ib);
+        table[0x18][Mandatory66] = nds<Mode>("vinsertf128", S::Vx, S::Wdq, S::Ib);
+        table[0x19][Mandatory66] = entry<Mode>("vextractf128", S::Wdq, S::Vx, S::Ib);
+        table[0x1D][Mandatory66] = entry<Mode>("vcvtps2ph", S::Wh, S::Vx, S::Ib);
+        table[0x30][Mandatory66] = entry<Mode>("kshiftrb kshiftrb kshiftrw", S::Kg, S::Kr, S::Ib, OpSizedMnemonic);
+        table[0x31][Mandatory66] = entry<Mode>("kshiftrd kshiftrd kshiftrq", S::Kg, S::Kr, S::Ib, OpSizedMnemonic);
+        table[0x32][Mandatory66] = entry<Mode>("kshiftlb kshiftlb kshiftlw", S::Kg, S::Kr, S::Ib, OpSizedMnemonic);
+        table[0x33][Mandatory66] = entry<Mode>("kshiftld kshiftld kshiftlq", S::Kg, S::Kr, S::Ib, OpSizedMnemonic);
+        table[0x38][Mandatory66] = nds<Mode>("vinserti128", S::Vx, S::Wdq, S::Ib);
+        table[0x39][Mandatory66] = entry<Mode>("vextracti128", S::Wdq, S::Vx, S::Ib);
+        table[0x46][Mandatory66] = nds<Mode>("vperm2i128", S::Vx, S::Wx, S::Ib);
+        table[0x4A][Mandatory66] = nds<Mode>("vblendvps", S::Vx, S::Wx, S::Lx);
+        table[0x4B][Mandatory66] = nds<Mode>("vblendvpd", S::Vx, S::Wx, S::Lx);
+        table[0x4C][Mandatory66] = nds<Mode>("vpblendvb", S::Vx, S::Wx, S::Lx);
+        table[0xF0][MandatoryF2] = entry<Mode>("rorx", S::Gy, S::Ey, S::Ib);
+    }
+    return table;
+}
+
+// Builds the EVEX (AVX-512) form of one escape map for Mode. Most VEX
+// instructions keep their name and operands under EVEX, which adds the
+// opmask, zeroing and broadcast decorations; the VEX-only ones are dropped,
+// and the ops AVX-512 renamed or added are filled in.
+template <CpuMode Mode>
+constexpr EscapeOpcodeTable buildEvexOpcodeTable(OpcodeMap map) {
+    using namespace opcode_table_detail;
+    EscapeOpcodeTable table = buildVexOpcodeTable<Mode>(map);
+    EscapeOpcodeTable unnamed = unnamedVexTable<Mode>(map);
+
+    if (map == Map0F) {
+        for (int op : {0x41, 0x42, 0x44, 0x45, 0x46, 0x47, 0x4A, 0x4B, 0x50, 0x77, 0x7C, 0x7D, 0x90, 0x91, 0x92,
+                       0x93, 0x98, 0x99, 0xAE, 0xD0, 0xD7, 0xF0, 0xF7}) {
+            table[op] = unnamed[op];
+        }
+        // Integer compares write an opmask register.
+        for (int op : {0x64, 0x65, 0x66, 0x74, 0x75, 0x76}) {
+            table[op][Mandatory66].operands[0] = S::Kg;
+        }
+        for (int prefix = 0; prefix < MandatoryPrefixCount; prefix++) {
+            table[0xC2][prefix].operands[0] = S::Kg;
+        }
+        table[0x6F][Mandatory66] = entry<Mode>("vmovdqa32 vmovdqa32 vmovdqa64", S::Vx, S::Wx, S::None, OpSizedMnemonic);
+        table[0x6F][MandatoryF3] = entry<Mode>("vmovdqu32 vmovdqu32 vmovdqu64", S::Vx, S::Wx, S::None, OpSizedMnemonic);
+        table[0x6F][MandatoryF2] = entry<Mode>("vmovdqu8 vmovdqu8 vmovdqu16", S::Vx, S::Wx, S::None, OpSizedMnemonic);
+        table[0x7F][Mandatory66] = entry<Mode>("vmovdqa32 vmovdqa32 vmovdqa64", S::Wx, S::Vx, S::None, OpSizedMnemonic);
+        table[0x7F][MandatoryF3] = entry<Mode>("vmovdqu32 vmovdqu32 vmovdqu64", S::Wx, S::Vx, S::None, OpSizedMnemonic);
+        table[0x7F][MandatoryF2] = entry<Mode>("vmovdqu8 vmovdqu8 vmovdqu16", S::Wx, S::Vx, S::None, OpSizedMnemonic);
+        table[0xDB][Mandatory66] = nds<Mode>("vpandd vpandd vpandq", S::Vx, S::Wx, S::None, OpSizedMnemonic);
+        table[0xDF][Mandatory66] = nds<Mode>("vpandnd vpandnd vpandnq", S::Vx, S::Wx, S::None, OpSizedMnemonic);
+        table[0xEB][Mandatory66] = nds<Mode>("vpord vpord vporq", S::Vx, S::Wx, S::None, OpSizedMnemonic);
+        table[0xEF][Mandatory66] = nds<Mode>("vpxord vpxord vpxorq", S::Vx, S::Wx, S::None, OpSizedMnemonic);
+        table[0x71][Mandatory66] = groupEntry<Mode>(GroupEvex12_0F71);
+        table[0x72][Mandatory66] = groupEntry<Mode>(GroupEvex13_0F72);
+        table[0x73][Mandatory66] = groupEntry<Mode>(GroupEvex14_0F73);
+    } else if (map == Map0F38) {
+        for (int op : {0x01, 0x02, 0x03, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0E, 0x0F, 0x17, 0x1A, 0x2C, 0x2D,
+                       0x2E, 0x2F, 0x41, 0x5A, 0x8C, 0x8E, 0xDB, 0xF2, 0xF3, 0xF5, 0xF6, 0xF7}) {
+            table[op] = unnamed[op];
+        }
+        table[0x29][Mandatory66].operands[0] = S::Kg;
+        table[0x37][Mandatory66].operands[0] = S::Kg;
+        table[0x10][Mandatory66] = nds<Mode>("vpsrlvw", S::Vx, S::Wx);
+        table[0x11][Mandatory66] = nds<Mode>("vpsravw", S::Vx, S::Wx);
+        table[0x12][Mandatory66] = nds<Mode>("vpsllvw", S::Vx, S::Wx);
+        table[0x19][Mandatory66] = entry<Mode>("vbroadcastf32x2 vbroadcastf32x2 vbroadcastsd", S::Vx, S::Wq, S::None,
+                                               OpSizedMnemonic);
+        table[0x1A][Mandatory66] = entry<Mode>("vbroadcastf32x4 vbroadcastf32x4 vbroadcastf64x2", S::Vx, S::Mx,
+                                               S::None, OpSizedMnemonic);
+        table[0x1B][Mandatory66] = entry<Mode>("vbroadcastf32x8 vbroadcastf32x8 vbroadcastf64x4", S::Vx, S::Wqq,
+                                               S::None, OpSizedMnemonic | OpMemoryOnly);
+        table[0x1F][Mandatory66] = entry<Mode>("vpabsq", S::Vx, S::Wx);
+        table[0x26][Mandatory66] = nds<Mode>("vptestmb vptestmb vptestmw", S::Kg, S::Wx, S::None, OpSizedMnemonic);
+        table[0x26][MandatoryF3] = nds<Mode>("vptestnmb vptestnmb vptestnmw", S::Kg, S::Wx, S::None, OpSizedMnemonic);
+        table[0x27][Mandatory66] = nds<Mode>("vptestmd vptestmd vptestmq", S::Kg, S::Wx, S::None, OpSizedMnemonic);
+        table[0x27][MandatoryF3] = nds<Mode>("vptestnmd vptestnmd vptestnmq", S::Kg, S::Wx, S::None, OpSizedMnemonic);
+        table[0x39][Mandatory66] = nds<Mode>("vpminsd vpminsd vpminsq", S::Vx, S::Wx, S::None, OpSizedMnemonic);
+        table[0x3B][Mandatory66] = nds<Mode>("vpminud vpminud vpminuq", S::Vx, S::Wx, S::None, OpSizedMnemonic);
+        table[0x3D][Mandatory66] = nds<Mode>("vpmaxsd vpmaxsd vpmaxsq", S::Vx, S::Wx, S::None, OpSizedMnemonic);
+        table[0x3F][Mandatory66] = nds<Mode>("vpmaxud vpmaxud vpmaxuq", S::Vx, S::Wx, S::None, OpSizedMnemonic);
+        table[0x40][Mandatory66] = nds<Mode>("vpmulld vpmulld vpmullq", S::Vx, S::Wx, S::None, OpSizedMnemonic);
+        table[0x44][Mandatory66] = entry<Mode>("vplzcntd vplzcntd vplzcntq", S::Vx, S::Wx, S::None, OpSizedMnemonic);
+        table[0x59][Mandatory66] = entry<Mode>("vbroadcasti32x2 vbroadcasti32x2 vpbroadcastq", S::Vx, S::Wq, S::None,
+                                               OpSizedMnemonic);
+        table[0x5A][Mandatory66] = entry<Mode>("vbroadcasti32x4 vbroadcasti32x4 vbroadcasti64x2", S::Vx, S::Mx,
+                                               S::None, OpSizedMnemonic);
+        table[0x5B][Mandatory66] = entry<Mode>("vbroadcasti32x8 vbroadcasti32x8 vbroadcasti64x4", S::Vx, S::Wqq,
+                                               S::None, OpSizedMnemonic | OpMemoryOnly);
+        table[0x64][Mandatory66] = nds<Mode>("vpblendmd vpblendmd vpblendmq", S::Vx, S::Wx, S::None, OpSizedMnemonic);
+        table[0x65][Mandatory66] = nds<Mode>("vblendmps vblendmps vblendmpd", S::Vx, S::Wx, S::None, OpSizedMnemonic);
+        table[0x66][Mandatory66] = nds<Mode>("vpblendmb vpblendmb vpblendmw", S::Vx, S::Wx, S::None, OpSizedMnemonic);
+        table[0x75][Mandatory66] = nds<Mode>("vpermi2b vpermi2b vpermi2w", S::Vx, S::Wx, S::None, OpSizedMnemonic);
+        table[0x76][Mandatory66] = nds<Mode>("vpermi2d vpermi2d vpermi2q", S::Vx, S::Wx, S::None, OpSizedMnemonic);
+        table[0x77][Mandatory66] = nds<Mode>("vpermi2ps vpermi2ps vpermi2pd", S::Vx, S::Wx, S::None, OpSizedMnemonic);
+        table[0x7A][Mandatory66] = entry<Mode>("vpbroadcastb", S::Vx, S::Ed, S::None, OpRegisterOnly);
+        table[0x7B][Mandatory66] = entry<Mode>("vpbroadcastw", S::Vx, S::Ed, S::None, OpRegisterOnly);
+        table[0x7C][Mandatory66] = entry<Mode>("vpbroadcastd vpbroadcastd vpbroadcastq", S::Vx, S::Ey, S::None,
+                                               OpSizedMnemonic | OpRegisterOnly);
+        table[0x7D][Mandatory66] = nds<Mode>("vpermt2b vpermt2b vpermt2w", S::Vx, S::Wx, S::None, OpSizedMnemonic);
+        table[0x7E][Mandatory66] = nds<Mode>("vpermt2d vpermt2d vpermt2q", S::Vx, S::Wx, S::None, OpSizedMnemonic);
+        table[0x7F][Mandatory66] = nds<Mode>("vpermt2ps vpermt2ps vpermt2pd", S::Vx, S::Wx, S::None, OpSizedMnemonic);
+        table[0x8D][Mandatory66] = nds<Mode>("vpermb vpermb vpermw", S::Vx, S::Wx, S::None, OpSizedMnemonic);
+        table[0xC4][Mandatory66] = entry<Mode>("vpconflictd vpconflictd vpconflictq", S::Vx, S::Wx, S::None,
+                                               OpSizedMnemonic);
+    } else {
+        for (int op : {0x02, 0x06, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x30, 0x31, 0x32, 0x33, 0x40, 0x41,
+                       0x42, 0x46, 0x4A, 0x4B, 0x4C, 0x60, 0x61, 0x62, 0x63, 0xDF, 0xF0}) {
+            table[op] = unnamed[op];
+        }
+        table[0x03][Mandatory66] = nds<Mode>("valignd valignd valignq", S::Vx, S::Wx, S::Ib, OpSizedMnemonic);
+        constexpr const char* insertExtract[2][4] = {
+            {"vinsertf32x4 vinsertf32x4 vinsertf64x2", "vextractf32x4 vextractf32x4 vextractf64x2",
+             "vinsertf32x8 vinsertf32x8 vinsertf64x4", "vextractf32x8 vextractf32x8 vextractf64x4"},
+            {"vinserti32x4 vinserti32x4 vinserti64x2", "vextracti32x4 vextracti32x4 vextracti64x2",
+             "vinserti32x8 vinserti32x8 vinserti64x4", "vextracti32x8 vextracti32x8 vextracti64x4"}};
+        for (int integer = 0; integer < 2; integer++) {
+            int base = integer ? 0x38 : 0x18;
+            const char* const* names = insertExtract[integer];
+            table[base][Mandatory66] = nds<Mode>(names[0], S::Vx, S::Wdq, S::Ib, OpSizedMnemonic);
+            table[base + 1][Mandatory66] = entry<Mode>(names[1], S::Wdq, S::Vx, S::Ib, OpSizedMnemonic);
+            table[base + 2][Mandatory66] = nds<Mode>(names[2], S::Vx, S::Wqq, S::Ib, OpSizedMnemonic);
+            table[base + 3][Mandatory66] = entry<Mode>(names[3], S::Wqq, S::Vx, S::Ib, OpSizedMnemonic);
+        }
+        // vpcmp with a predicate imm8 (printed as vpcmpltub, ...): the
+        // destination is an opmask register.
+        table[0x1E][Mandatory66] = nds<Mode>("vpcmpud vpcmpud vpcmpuq", S::Kg, S::Wx, S::Ib, OpSizedMnemonic);
+        table[0x1F][Mandatory66] = nds<Mode>("vpcmpd vpcmpd vpcmpq", S::Kg, S::Wx, S::Ib, OpSizedMnemonic);
+        table[0x3E][Mandatory66] = nds<Mode>("vpcmpub vpcmpub vpcmpuw", S::Kg, S::Wx, S::Ib, OpSizedMnemonic);
+        table[0x3F][Mandatory66] = nds<Mode>("vpcmpb vpcmpb vpcmpw", S::Kg, S::Wx, S::Ib, OpSizedMnemonic);
+        table[0x23][Mandatory66] = nds<Mode>("vshuff32x4 vshuff32x4 vshuff64x2", S::Vx, S::Wx, S::Ib, OpSizedMnemonic);
+        table[0x43][Mandatory66] = nds<Mode>("vshufi32x4 vshufi32x4 vshufi64x2", S::Vx, S::Wx, S::Ib, OpSizedMnemonic);
+        table[0x25][Mandatory66] = nds<Mode>("vpternlogd vpternlogd vpternlogq", S::Vx, S::Wx, S::Ib, OpSizedMnemonic);
+    }
+    return table;
+}
+
+// The VEX and EVEX forms of the 0F, 0F 38 and 0F 3A maps, indexed by
+// map - Map0F.
+template <CpuMode Mode>
+inline constexpr std::array<EscapeOpcodeTable, 3> vexOpcodeTable = {
+    buildVexOpcodeTable<Mode>(Map0F), buildVexOpcodeTable<Mode>(Map0F38), buildVexOpcodeTable<Mode>(Map0F3A)};
+template <CpuMode Mode>
+inline constexpr std::array<EscapeOpcodeTable, 3> evexOpcodeTable = {
+    buildEvexOpcodeTable<Mode>(Map0F), buildEvexOpcodeTable<Mode>(Map0F38), buildEvexOpcodeTable<Mode>(Map0F3A)};
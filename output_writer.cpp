@@ -0,0 +1,122 @@
+#include "output_writer.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <charconv>
+#include <cstring>
+
+// "000102...feff": two characters per byte value.
+static constexpr std::array<char, 512> buildHexPairs() {
+    constexpr char digits[] = "0123456789abcdef";
+    std::array<char, 512> table{};
+    for (int i = 0; i < 256; i++) {
+        table[2 * i] = digits[i >> 4];
+        table[2 * i + 1] = digits[i & 0x0F];
+    }
+    return table;
+}
+
+static constexpr std::array<char, 512> hexPairs = buildHexPairs();
+
+OutputWriter::OutputWriter(FILE* stream, size_t capacity)
+    : stream_(stream),
+      buffer_(new char[capacity < maxLineLength ? maxLineLength : capacity]),
+      capacity_(capacity < maxLineLength ? maxLineLength : capacity) {}
+
+OutputWriter::OutputWriter(std::string& sink, size_t capacity)
+    : sink_(&sink),
+      buffer_(new char[capacity < maxLineLength ? maxLineLength : capacity]),
+      capacity_(capacity < maxLineLength ? maxLineLength : capacity) {}
+
+OutputWriter::~OutputWriter() {
+    flush();
+}
+
+void OutputWriter::emit(const char* data, size_t size) {
+    if (sink_ != nullptr) {
+        sink_->append(data, size);
+    } else {
+        std::fwrite(data, 1, size, stream_);
+    }
+}
+
+void OutputWriter::flush() {
+    if (used_ > 0) {
+        emit(buffer_.get(), used_);
+        used_ = 0;
+    }
+    if (stream_ != nullptr) {
+        std::fflush(stream_);
+    }
+}
+
+void OutputWriter::write(std::string_view text) {
+    if (text.size() > capacity_ - used_) {
+        flush();
+        if (text.size() > capacity_) {
+            emit(text.data(), text.size());
+            return;
+        }
+    }
+    std::memcpy(buffer_.get() + used_, text.data(), text.size());
+    used_ += text.size();
+}
+
+int addressDigits(uint64_t lastAddress) {
+    return std::max(4, static_cast<int>(std::bit_width(lastAddress) + 3) / 4);
+}
+
+void OutputWriter::hex(uint64_t value, int minDigits) {
+    int digits = (std::bit_width(value) + 3) / 4;
+    if (digits < minDigits) {
+        digits = minDigits;
+    }
+    if (digits < 1) {
+        digits = 1;
+    }
+    if (capacity_ - used_ < static_cast<size_t>(digits)) {
+        flush();
+    }
+    // Fill from the least significant end, a byte (two digits) at a time.
+    char* end = buffer_.get() + used_ + digits;
+    char* p = end;
+    while (p - (buffer_.get() + used_) >= 2) {
+        const char* pair = &hexPairs[2 * (value & 0xFF)];
+        p -= 2;
+        p[0] = pair[0];
+        p[1] = pair[1];
+        value >>= 8;
+    }
+    if (p != buffer_.get() + used_) {
+        *--p = hexPairs[2 * (value & 0x0F) + 1];
+    }
+    used_ += digits;
+}
+
+void OutputWriter::hexByte(uint8_t value) {
+    if (capacity_ - used_ < 2) {
+        flush();
+    }
+    buffer_[used_] = hexPairs[2 * value];
+    buffer_[used_ + 1] = hexPairs[2 * value + 1];
+    used_ += 2;
+}
+
+void OutputWriter::dec(int64_t value) {
+    if (capacity_ - used_ < 20) {
+        flush();
+    }
+    char* begin = buffer_.get() + used_;
+    auto result = std::to_chars(begin, begin + 20, value);
+    used_ += result.ptr - begin;
+}
+
+void OutputWriter::dec(uint64_t value) {
+    if (capacity_ - used_ < 20) {
+        flush();
+    }
+    char* begin = buffer_.get() + used_;
+    auto result = std::to_chars(begin, begin + 20, value);
+    used_ += result.ptr - begin;
+}
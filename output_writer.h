@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <string_view>
+
+// Hex digits for an address column that must fit every address up to
+// lastAddress: at least 4 and as many as the widest address needs (up to 16
+// for the full 64-bit space), so one listing's columns stay aligned.
+int addressDigits(uint64_t lastAddress);
+
+// Buffered text writer for disassembly listings.
+// Text is rendered straight into one large reusable buffer (hex digits come
+// from a 256-entry lookup table, decimals from std::to_chars) and handed to
+// the stream with a single fwrite() per block. Nothing is flushed per line,
+// which is what made the iostream path slow on big sections.
+class OutputWriter {
+public:
+    static constexpr size_t defaultCapacity = 1 << 20;
+
+    explicit OutputWriter(FILE* stream, size_t capacity = defaultCapacity);
+    // Appends to sink instead of a stream, e.g. to format text on a worker
+    // thread and write it out later in order.
+    explicit OutputWriter(std::string& sink, size_t capacity = defaultCapacity);
+    ~OutputWriter();
+
+    OutputWriter(const OutputWriter&) = delete;
+    OutputWriter& operator=(const OutputWriter&) = delete;
+
+    // Longest text a single formatting call may append. Callers that build a
+    // line piecewise call reserveLine() once instead of checking per piece.
+    static constexpr size_t maxLineLength = 256;
+
+    // Makes sure at least maxLineLength bytes are free in the buffer.
+    void reserveLine() {
+        if (capacity_ - used_ < maxLineLength) {
+            flush();
+        }
+    }
+
+    void write(std::string_view text);
+    void put(char c) {
+        if (used_ == capacity_) {
+            flush();
+        }
+        buffer_[used_++] = c;
+    }
+
+    // Lowercase hex without a prefix, zero-padded to at least minDigits digits.
+    void hex(uint64_t value, int minDigits = 1);
+    // Exactly two lowercase hex digits.
+    void hexByte(uint8_t value);
+    void dec(int64_t value);
+    void dec(uint64_t value);
+    void dec(uint32_t value) { dec(static_cast<uint64_t>(value)); }
+    void dec(int value) { dec(static_cast<int64_t>(value)); }
+
+    OutputWriter& operator<<(std::string_view text) {
+        write(text);
+        return *this;
+    }
+    OutputWriter& operator<<(char c) {
+        put(c);
+        return *this;
+    }
+
+    // Hands everything buffered so far to the stream (or sink).
+    void flush();
+
+private:
+    void emit(const char* data, size_t size);
+
+    FILE* stream_ = nullptr;
+    std::string* sink_ = nullptr;
+    std::unique_ptr<char[]> buffer_;
+    size_t capacity_;
+    size_t used_ = 0;
+};
@@ -0,0 +1,129 @@
+#include "parallel_disassembler.h"
+
+#include <algorithm>
+#include <string>
+#include <thread>
+
+#include "disassembler.h"
+
+namespace {
+
+unsigned resolveThreadCount(unsigned threads) {
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    return threads;
+}
+
+// Runs body(index) for index in [0, count) on up to count threads and waits.
+template <typename Body>
+void runOnThreads(size_t count, Body&& body) {
+    std::vector<std::thread> workers;
+    workers.reserve(count > 0 ? count - 1 : 0);
+    for (size_t index = 1; index < count; index++) {
+        workers.emplace_back(body, index);
+    }
+    if (count > 0) {
+        body(size_t{0});
+    }
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
+bool startsBefore(const DecodedInstruction& insn, size_t offset) {
+    return insn.offset < offset;
+}
+
+} // namespace
+
+std::vector<DecodeChunk> splitIntoChunks(size_t size, size_t count) {
+    std::vector<DecodeChunk> chunks(count);
+    size_t chunkSize = size / count;
+    for (size_t k = 0; k < count; k++) {
+        chunks[k].begin = k * chunkSize;
+        chunks[k].end = (k + 1 == count) ? size : (k + 1) * chunkSize;
+    }
+    return chunks;
+}
+
+void decodeChunk(std::span<const uint8_t> code, DecodeChunk& chunk, CpuMode mode) {
+    chunk.stop = decodeRange(code, chunk.begin, chunk.end, chunk.records, mode);
+}
+
+void stitchChunks(std::span<const uint8_t> code, std::span<DecodeChunk> chunks,
+                  std::vector<DecodedInstruction>& out, CpuMode mode) {
+    // The first chunk starts on a true boundary; for each later one, continue
+    // the true stream from where the previous chunk stopped until it lands on
+    // a boundary this chunk also found. From there on both streams decode the
+    // same bytes from the same offsets.
+    size_t total = 0;
+    for (const DecodeChunk& chunk : chunks) {
+        total += chunk.records.size();
+    }
+    out.reserve(out.size() + total + chunks.size() * 16);
+    out.insert(out.end(), chunks[0].records.begin(), chunks[0].records.end());
+    std::vector<DecodedInstruction>().swap(chunks[0].records);
+    size_t next = chunks[0].stop;
+
+    for (size_t k = 1; k < chunks.size(); k++) {
+        DecodeChunk& chunk = chunks[k];
+        auto candidate = std::lower_bound(chunk.records.begin(), chunk.records.end(), next, startsBefore);
+        while (next < chunk.end && (candidate == chunk.records.end() || candidate->offset != next)) {
+            next = decodeRange(code, next, next + 1, out, mode);
+            candidate = std::lower_bound(candidate, chunk.records.end(), next, startsBefore);
+        }
+        if (next < chunk.end) {
+            out.insert(out.end(), candidate, chunk.records.end());
+            next = chunk.stop;
+        }
+        std::vector<DecodedInstruction>().swap(chunk.records);
+    }
+}
+
+void decodeInstructionsParallel(std::span<const uint8_t> code,
+                                std::vector<DecodedInstruction>& out,
+                                unsigned threads, CpuMode mode) {
+    threads = resolveThreadCount(threads);
+    size_t chunkCount = std::min<size_t>(threads, code.size() / minParallelChunkSize);
+    if (chunkCount <= 1) {
+        decodeInstructions(code, out, mode);
+        return;
+    }
+
+    // Decode every chunk from its first byte, in parallel, then stitch.
+    std::vector<DecodeChunk> chunks = splitIntoChunks(code.size(), chunkCount);
+    runOnThreads(chunkCount, [&](size_t k) {
+        decodeChunk(code, chunks[k], mode);
+    });
+    stitchChunks(code, chunks, out, mode);
+}
+
+void disassembleParallel(std::span<const uint8_t> code, uint64_t baseAddress,
+                         OutputWriter& out, unsigned threads,
+                         const SymbolTable* symbols, CpuMode mode) {
+    threads = resolveThreadCount(threads);
+    std::vector<DecodedInstruction> instructions;
+    decodeInstructionsParallel(code, instructions, threads, mode);
+
+    // Format in bounded batches: each thread renders a slice of the batch
+    // into its own buffer, then the buffers are written in order.
+    constexpr size_t recordsPerSlice = 1 << 16;
+    std::vector<std::string> texts(threads);
+    std::span<const DecodedInstruction> remaining(instructions);
+    while (!remaining.empty()) {
+        size_t batch = std::min(remaining.size(), recordsPerSlice * threads);
+        size_t sliceCount = (batch + recordsPerSlice - 1) / recordsPerSlice;
+        runOnThreads(sliceCount, [&](size_t s) {
+            size_t first = s * recordsPerSlice;
+            size_t count = std::min(recordsPerSlice, batch - first);
+            texts[s].clear();
+            OutputWriter writer(texts[s]);
+            printInstructions(code, remaining.subspan(first, count), baseAddress, writer, symbols);
+        });
+        for (size_t s = 0; s < sliceCount; s++) {
+            out.write(texts[s]);
+        }
+        remaining = remaining.subspan(batch);
+    }
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "decoded_instruction.h"
+#include "output_writer.h"
+
+class SymbolTable;
+
+// Sections smaller than this are not worth splitting across threads.
+constexpr size_t minParallelChunkSize = 1 << 20;
+
+// One slice of a section, decoded independently from its first byte as a
+// candidate instruction boundary.
+struct DecodeChunk {
+    size_t begin = 0;                         // First byte of the slice
+    size_t end = 0;                           // One past the last byte of the slice
+    size_t stop = 0;                          // Offset just past the last decoded instruction
+    std::vector<DecodedInstruction> records;  // Instructions starting in [begin, end)
+};
+
+// Splits [0, size) into count contiguous chunks of roughly equal size.
+std::vector<DecodeChunk> splitIntoChunks(size_t size, size_t count);
+
+// Decodes the instructions starting in [chunk.begin, chunk.end).
+void decodeChunk(std::span<const uint8_t> code, DecodeChunk& chunk, CpuMode mode = CpuMode::Bits64);
+
+// Appends the true instruction stream of code to out, given chunks that were
+// split by splitIntoChunks() and decoded by decodeChunk(). Seams are
+// re-decoded serially until they resynchronise; chunk records are released
+// as they are consumed.
+void stitchChunks(std::span<const uint8_t> code, std::span<DecodeChunk> chunks,
+                  std::vector<DecodedInstruction>& out, CpuMode mode = CpuMode::Bits64);
+
+// Multi-threaded linear sweep. code is split into one chunk per thread and
+// every chunk is decoded from its first byte as a candidate boundary. The
+// chunks are then stitched together in order: where the stream coming out of
+// the previous chunk does not land on a boundary the next chunk found, the
+// seam is re-decoded serially until the two streams resynchronise (x86
+// self-synchronises within a few instructions). The result is identical to
+// decodeInstructions(). threads == 0 means one per hardware thread.
+void decodeInstructionsParallel(std::span<const uint8_t> code,
+                                std::vector<DecodedInstruction>& out,
+                                unsigned threads, CpuMode mode = CpuMode::Bits64);
+
+// Parallel counterpart of disassemble(): decodes with
+// decodeInstructionsParallel() and formats batches of records on worker
+// threads, writing them to out in order. The text is byte-identical to the
+// serial listing.
+void disassembleParallel(std::span<const uint8_t> code, uint64_t baseAddress,
+                         OutputWriter& out, unsigned threads,
+                         const SymbolTable* symbols = nullptr, CpuMode mode = CpuMode::Bits64);
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+#include "thread_pool.h"
+
+// Below this many items a parallel sort is not worth starting threads for.
+constexpr size_t minParallelSortSize = 1 << 16;
+
+// Sorts items with less on threads workers (0 = one per hardware thread):
+// the array is cut into one run per worker, the runs are sorted as pool
+// tasks, and then merged pairwise, each round's merges again running in
+// parallel, ping-ponging between items and one scratch buffer. Not stable.
+template <typename T, typename Less>
+void parallelSort(std::vector<T>& items, Less less, unsigned threads) {
+    if (threads == 1 || items.size() < minParallelSortSize) {
+        std::sort(items.begin(), items.end(), less);
+        return;
+    }
+    WorkStealingPool pool(threads);
+    size_t runs = pool.size();
+    if (runs <= 1) {
+        std::sort(items.begin(), items.end(), less);
+        return;
+    }
+
+    // Run r covers [bounds[r], bounds[r + 1]).
+    std::vector<size_t> bounds(runs + 1);
+    for (size_t r = 0; r <= runs; r++) {
+        bounds[r] = items.size() * r / runs;
+    }
+    for (size_t r = 0; r < runs; r++) {
+        pool.submit([&items, &bounds, less, r] {
+            std::sort(items.begin() + bounds[r], items.begin() + bounds[r + 1], less);
+        });
+    }
+    pool.wait();
+
+    std::vector<T> scratch(items.size());
+    std::vector<T>* from = &items;
+    std::vector<T>* to = &scratch;
+    for (size_t width = 1; width < runs; width *= 2) {
+        for (size_t r = 0; r < runs; r += 2 * width) {
+            size_t begin = bounds[r];
+            size_t middle = bounds[std::min(r + width, runs)];
+            size_t end = bounds[std::min(r + 2 * width, runs)];
+            pool.submit([from, to, less, begin, middle, end] {
+                std::merge(from->begin() + begin, from->begin() + middle,
+                           from->begin() + middle, from->begin() + end,
+                           to->begin() + begin, less);
+            });
+        }
+        pool.wait();
+        std::swap(from, to);
+    }
+    if (from != &items) {
+        items.swap(scratch);
+    }
+}
@@ -0,0 +1,147 @@
+#include "recursive_disassembler.h"
+
+#include <algorithm>
+
+#include "control_flow.h"
+#include "disassembler.h"
+
+RecursiveDisassembler::RecursiveDisassembler(std::span<const CodeRegion> regions) {
+    regions_.reserve(regions.size());
+    for (const CodeRegion& region : regions) {
+        RegionState state;
+        state.region = &region;
+        state.visited.assign((region.bytes.size() + 63) / 64, 0);
+        regions_.push_back(std::move(state));
+    }
+    std::stable_sort(regions_.begin(), regions_.end(), [](const RegionState& a, const RegionState& b) {
+        return a.region->address < b.region->address;
+    });
+}
+
+RecursiveDisassembler::RegionState* RecursiveDisassembler::findRegion(uint64_t address) {
+    auto it = std::upper_bound(regions_.begin(), regions_.end(), address,
+        [](uint64_t value, const RegionState& state) { return value < state.region->address; });
+    if (it == regions_.begin()) {
+        return nullptr;
+    }
+    --it;
+    return address - it->region->address < it->region->bytes.size() ? &*it : nullptr;
+}
+
+bool RecursiveDisassembler::addSeed(uint64_t address) {
+    if (findRegion(address) == nullptr) {
+        return false;
+    }
+    worklist_.push_back(address);
+    return true;
+}
+
+static bool testBit(const std::vector<uint64_t>& bits, size_t index) {
+    return (bits[index >> 6] >> (index & 63)) & 1;
+}
+
+void RecursiveDisassembler::traceFrom(RegionState& state, size_t offset) {
+    std::span<const uint8_t> code = state.region->bytes;
+    std::vector<uint64_t>& visited = state.visited;
+
+    while (offset < code.size() && !testBit(visited, offset)) {
+        DecodedInstruction insn;
+        size_t length = decodeInstructionAt(code, offset, insn, state.region->mode);
+
+        // Stop rather than decode bytes a previous path has already
+        // claimed; the two paths disagree on instruction boundaries and
+        // the first one wins.
+        for (size_t n = 1; n < length; n++) {
+            if (testBit(visited, offset + n)) {
+                return;
+            }
+        }
+        for (size_t n = 0; n < length; n++) {
+            visited[(offset + n) >> 6] |= uint64_t{1} << ((offset + n) & 63);
+        }
+        if (!state.instructions.empty() && state.instructions.back().offset > offset) {
+            state.sorted = false;
+        }
+        state.instructions.push_back(insn);
+        state.reachedBytes += length;
+
+        FlowKind kind = classifyFlow(insn);
+        if (hasBranchTarget(kind)) {
+            uint64_t target = branchTarget(code.data() + offset, insn, state.region->address + offset);
+            // Targets are filtered here so the worklist only holds work.
+            RegionState* targetState = findRegion(target);
+            if (targetState != nullptr && !testBit(targetState->visited, target - targetState->region->address)) {
+                worklist_.push_back(target);
+            }
+        }
+        if (!fallsThrough(kind)) {
+            return;
+        }
+        offset += length;
+    }
+}
+
+void RecursiveDisassembler::run() {
+    while (!worklist_.empty()) {
+        uint64_t address = worklist_.back();
+        worklist_.pop_back();
+        RegionState* state = findRegion(address);
+        if (state != nullptr) {
+            traceFrom(*state, address - state->region->address);
+        }
+    }
+    // Paths are traced in worklist order; put every region back in address
+    // order for the consumers.
+    for (RegionState& state : regions_) {
+        if (!state.sorted) {
+            std::sort(state.instructions.begin(), state.instructions.end(),
+                [](const DecodedInstruction& a, const DecodedInstruction& b) { return a.offset < b.offset; });
+            state.sorted = true;
+        }
+    }
+}
+
+// Writes a line marking size bytes at address that no path reached.
+static void printGap(OutputWriter& out, uint64_t address, size_t size, int digits) {
+    out.reserveLine();
+    out.hex(address, digits);
+    out << ": (0x";
+    out.hex(size);
+    out << " bytes not reached)\n";
+}
+
+void printRecursiveListing(const RecursiveDisassembler& disassembler, OutputWriter& out,
+                           const SymbolTable* symbols) {
+    for (size_t k = 0; k < disassembler.regionCount(); k++) {
+        const CodeRegion& region = disassembler.region(k);
+        out << (k == 0 ? "" : "\n") << "Disassembly of " << region.name << ' ' << region.kind << ":\n";
+        printReachedInstructions(region, disassembler.instructions(k), out, symbols);
+    }
+}
+
+void printReachedInstructions(const CodeRegion& region, std::span<const DecodedInstruction> instructions,
+                              OutputWriter& out, const SymbolTable* symbols) {
+    // Print each run of back-to-back instructions in one call and mark the
+    // gaps between runs.
+    int digits = addressDigits(region.address + (region.bytes.empty() ? 0 : region.bytes.size() - 1));
+    size_t expected = 0;
+    size_t runStart = 0;
+    for (size_t i = 0; i <= instructions.size(); i++) {
+        bool endOfRun = i == instructions.size() || instructions[i].offset != expected;
+        if (endOfRun && i > runStart) {
+            printInstructions(region.bytes, instructions.subspan(runStart, i - runStart), region.address, out,
+                              symbols);
+        }
+        if (i == instructions.size()) {
+            break;
+        }
+        if (endOfRun) {
+            printGap(out, region.address + expected, instructions[i].offset - expected, digits);
+            runStart = i;
+        }
+        expected = instructions[i].offset + instructions[i].length;
+    }
+    if (expected < region.bytes.size()) {
+        printGap(out, region.address + expected, region.bytes.size() - expected, digits);
+    }
+}
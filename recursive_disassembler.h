@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "decoded_instruction.h"
+#include "elf.h"
+#include "output_writer.h"
+
+class SymbolTable;
+
+// Recursive-traversal disassembler. Starting from seed addresses (the entry
+// point, function symbols), it follows fall-through and direct branch and
+// call targets, so bytes only reached by a linear sweep, such as jump tables
+// and literal pools embedded in code, are never decoded as instructions.
+//
+// Work is driven by a worklist of virtual addresses and a visited bitmap
+// with one bit per code byte. A byte is decoded at most once: a path stops
+// as soon as its next instruction would overlap bytes already claimed, so
+// the cost is linear in the amount of reachable code however many branches
+// point into it.
+class RecursiveDisassembler {
+public:
+    // regions must outlive the disassembler. Regions are looked up by
+    // address with a binary search, so they are expected not to overlap;
+    // in relocatable objects, where every section starts at 0, only one of
+    // the overlapping sections is traversed.
+    explicit RecursiveDisassembler(std::span<const CodeRegion> regions);
+
+    // Queues address for decoding. Returns false if no region contains it.
+    bool addSeed(uint64_t address);
+
+    // Drains the worklist. May be called again after adding more seeds.
+    void run();
+
+    size_t regionCount() const { return regions_.size(); }
+    const CodeRegion& region(size_t index) const { return *regions_[index].region; }
+
+    // Instructions reached in region index, sorted by offset.
+    std::span<const DecodedInstruction> instructions(size_t index) const {
+        return regions_[index].instructions;
+    }
+
+    // Number of bytes of region index covered by reached instructions.
+    size_t reachedBytes(size_t index) const { return regions_[index].reachedBytes; }
+
+private:
+    struct RegionState {
+        const CodeRegion* region;
+        std::vector<uint64_t> visited;  // One bit per byte of the region
+        std::vector<DecodedInstruction> instructions;
+        size_t reachedBytes = 0;
+        bool sorted = true;
+    };
+
+    RegionState* findRegion(uint64_t address);
+    void traceFrom(RegionState& state, size_t offset);
+
+    std::vector<RegionState> regions_;  // Sorted by start address
+    std::vector<uint64_t> worklist_;
+};
+
+// Writes the instructions reached in every region, one listing per region
+// like disassemble(), with a line marking each run of bytes that no path
+// reached.
+void printRecursiveListing(const RecursiveDisassembler& disassembler, OutputWriter& out,
+                           const SymbolTable* symbols = nullptr);
+
+// The body of one such listing: instructions are those reached in region,
+// sorted by offset, whether from a traversal or an analysis cache.
+void printReachedInstructions(const CodeRegion& region, std::span<const DecodedInstruction> instructions,
+                              OutputWriter& out, const SymbolTable* symbols = nullptr);
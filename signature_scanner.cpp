@@ -0,0 +1,703 @@
+#include "signature_scanner.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+
+#include "byte_classifier.h"
+#include "symbol_table.h"
+#include "thread_pool.h"
+
+namespace {
+
+// Regions are scanned in slices of this size when spread over threads.
+constexpr size_t scanSliceSize = 1 << 20;
+
+// Approximate share of each byte value in x86-64 code (the .text of libc
+// and libcrypto), in hundredths of a percent. Anchors are chosen to keep
+// the filter sets clear of the common bytes.
+constexpr std::array<uint16_t, 256> buildByteFrequencies() {
+    std::array<uint16_t, 256> frequency{};
+    frequency.fill(12);
+    constexpr std::pair<uint8_t, uint16_t> common[] = {
+        {0x00, 1195}, {0x48, 577}, {0xFF, 519}, {0x89, 376}, {0x0F, 355}, {0x31, 206}, {0x8B, 200}, {0x24, 195},
+        {0xE8, 183}, {0x41, 162}, {0x4C, 156}, {0x85, 143}, {0xC0, 142}, {0x01, 141}, {0x44, 135}, {0x83, 132},
+        {0x66, 131}, {0x8D, 127}, {0x1F, 109}, {0x84, 108}, {0x08, 95}, {0x49, 93}, {0x74, 80}, {0xE9, 74},
+        {0x45, 72}, {0x10, 68}, {0xC1, 65}, {0xC3, 64}, {0xF6, 60}, {0xD2, 59}, {0xC4, 58}, {0x04, 58},
+        {0xFE, 57}, {0xC5, 57}, {0xC7, 51}, {0xEF, 49}, {0x40, 48}, {0x20, 46}, {0x02, 45}, {0x28, 43},
+    };
+    for (auto [value, share] : common) {
+        frequency[value] = share;
+    }
+    return frequency;
+}
+
+constexpr std::array<uint16_t, 256> byteFrequency = buildByteFrequencies();
+
+// Code bytes are far from independent (48 8b, 0f 1f, 00 00 are much more
+// common than their bytes' shares suggest), so the estimated share of an
+// anchor is weighted up before it is compared with the filter's.
+constexpr uint64_t anchorWeight = 64;
+
+// Anchors counted in a sample need no such correction; the weight left is
+// the cost of verifying a hit against that of a position the filter passes.
+constexpr uint64_t countedWeight = 4;
+
+// Pair shares are in units of 1e-8 of the positions in code.
+constexpr uint64_t shareScale = 100000000;
+
+// The ByteSet gate only runs while it passes at most this share of code
+// (in hundredths of a percent squared, as the product of its two sets);
+// past that the bucket filter alone is faster.
+constexpr uint64_t byteGateShare = 10000ull * 10000 / 16;
+
+// Only this much of a sample is counted, in evenly spaced chunks.
+constexpr size_t sampleLimit = 2 << 20;
+constexpr size_t sampleChunks = 16;
+
+constexpr uint32_t filterBuckets = 8;
+
+// The parts of sample that are counted.
+std::vector<std::span<const uint8_t>> sampleParts(std::span<const uint8_t> sample) {
+    if (sample.size() <= sampleLimit) {
+        return {sample};
+    }
+    std::vector<std::span<const uint8_t>> parts;
+    size_t size = sampleLimit / sampleChunks;
+    for (size_t k = 0; k < sampleChunks; k++) {
+        parts.push_back(sample.subspan(k * (sample.size() - size) / (sampleChunks - 1), size));
+    }
+    return parts;
+}
+
+// Estimated share of each byte pair b0 | b1 << 8 in code: counted in the
+// sample if there is one (never quite zero, so that unseen pairs are not
+// free), else the product of the bytes' shares.
+std::vector<uint32_t> estimatePairShares(std::span<const uint8_t> sample) {
+    std::vector<uint32_t> shares(65536);
+    if (sample.size() < 2) {
+        for (uint32_t pair = 0; pair < 65536; pair++) {
+            shares[pair] = static_cast<uint32_t>(byteFrequency[pair & 0xFF]) * byteFrequency[pair >> 8];
+        }
+        return shares;
+    }
+    uint64_t positions = 0;
+    for (std::span<const uint8_t> part : sampleParts(sample)) {
+        for (size_t k = 0; k + 1 < part.size(); k++) {
+            shares[part[k] | part[k + 1] << 8]++;
+        }
+        positions += part.size() - 1;
+    }
+    for (uint32_t& share : shares) {
+        share = static_cast<uint32_t>(std::max<uint64_t>(share * shareScale / positions, 1));
+    }
+    return shares;
+}
+
+// Occurrences in sample of each of quads (four bytes loaded as one word),
+// counted through an open-addressed table of the distinct ones.
+std::vector<uint32_t> countQuads(std::span<const uint8_t> sample, std::span<const uint32_t> quads) {
+    std::vector<uint32_t> counts(quads.size());
+    if (quads.empty()) {
+        return counts;
+    }
+    size_t size = std::bit_ceil(quads.size() * 2);
+    int shift = 32 - std::countr_zero(size);
+    std::vector<uint32_t> keys(size);
+    std::vector<uint32_t> hits(size);
+    std::vector<bool> used(size);
+    auto slotOf = [&](uint32_t quad) {
+        size_t slot = (quad * 0x9E3779B1u) >> shift;
+        while (used[slot] && keys[slot] != quad) {
+            slot = (slot + 1) & (size - 1);
+        }
+        return slot;
+    };
+    for (uint32_t quad : quads) {
+        size_t slot = slotOf(quad);
+        keys[slot] = quad;
+        used[slot] = true;
+    }
+    for (std::span<const uint8_t> part : sampleParts(sample)) {
+        for (size_t k = 0; k + 4 <= part.size(); k++) {
+            uint32_t quad;
+            std::memcpy(&quad, part.data() + k, 4);
+            size_t slot = slotOf(quad);
+            hits[slot] += used[slot];
+        }
+    }
+    for (size_t k = 0; k < quads.size(); k++) {
+        counts[k] = hits[slotOf(quads[k])];
+    }
+    return counts;
+}
+
+// Two neighbouring pattern bytes as b0 | b1 << 8, with their masks. Bytes
+// past the end of the pattern are wildcards.
+struct MaskedPair {
+    uint32_t bytes = 0;
+    uint32_t mask = 0;
+
+    MaskedPair(const Signature& signature, size_t offset) {
+        for (size_t k = 0; k < 2 && offset + k < signature.bytes.size(); k++) {
+            bytes |= static_cast<uint32_t>(signature.bytes[offset + k]) << (8 * k);
+            mask |= static_cast<uint32_t>(signature.mask[offset + k]) << (8 * k);
+        }
+    }
+
+    // Calls fn with every pair value that matches.
+    template <typename Fn>
+    void forEach(Fn fn) const {
+        uint32_t free = ~mask & 0xFFFF;
+        uint32_t wild = 0;
+        do {
+            fn(bytes | wild);
+            wild = (wild - free) & free;
+        } while (wild != 0);
+    }
+
+    uint64_t share(std::span<const uint32_t> shares) const {
+        uint64_t share = 0;
+        forEach([&](uint32_t value) { share += shares[value]; });
+        return share;
+    }
+};
+
+// Number of fully specified pattern bytes from offset on.
+size_t fixedRun(const Signature& signature, size_t offset) {
+    size_t run = 0;
+    while (offset + run < signature.bytes.size() && signature.mask[offset + run] == 0xFF) {
+        run++;
+    }
+    return run;
+}
+
+// Share of code that may start each bucket's anchors (its first pairs) or
+// end them (its last pairs), tracked while anchors are added. Membership
+// itself is kept in the scanner's pair table.
+struct FilterBucket {
+    uint64_t first = 0;
+    uint64_t last = 0;
+};
+
+// Share of the values of pair not yet in the pair table under bit.
+uint64_t addedShare(std::span<const uint16_t> table, std::span<const uint32_t> shares, const MaskedPair& pair,
+                    uint32_t bit) {
+    uint64_t share = 0;
+    pair.forEach([&](uint32_t value) {
+        if (!(table[value] & bit)) {
+            share += shares[value];
+        }
+    });
+    return share;
+}
+
+int hexDigit(char c) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    return c == '?' ? -1 : -2;
+}
+
+bool reportSignatureError(size_t line, std::string_view message) {
+    std::cerr << "Error: signature line " << line << ": " << message << '\n';
+    return false;
+}
+
+} // namespace
+
+bool parseSignatures(std::string_view text, std::vector<Signature>& signatures) {
+    size_t lineNumber = 0;
+    while (!text.empty()) {
+        size_t newline = text.find('\n');
+        std::string_view line = text.substr(0, newline);
+        text = newline == std::string_view::npos ? std::string_view() : text.substr(newline + 1);
+        lineNumber++;
+
+        // Blank lines and '#' comments are ignored.
+        size_t comment = line.find('#');
+        if (comment != std::string_view::npos) {
+            line = line.substr(0, comment);
+        }
+        if (line.find_first_not_of(" \t\r") == std::string_view::npos) {
+            continue;
+        }
+        size_t colon = line.find(':');
+        if (colon == std::string_view::npos) {
+            return reportSignatureError(lineNumber, "expected \"name: hex bytes\"");
+        }
+        std::string_view name = line.substr(0, colon);
+        name.remove_prefix(std::min(name.size(), name.find_first_not_of(" \t")));
+        name = name.substr(0, name.find_last_not_of(" \t") + 1);
+        if (name.empty()) {
+            return reportSignatureError(lineNumber, "missing signature name");
+        }
+
+        Signature signature;
+        signature.name = name;
+        int high = -3;  // Pending high nibble: -3 none, -1 wildcard, else its value
+        bool fixed = false;
+        for (char c : line.substr(colon + 1)) {
+            if (c == ' ' || c == '\t' || c == '\r') {
+                if (high != -3) {
+                    return reportSignatureError(lineNumber, "odd number of hex digits");
+                }
+                continue;
+            }
+            int digit = hexDigit(c);
+            if (digit == -2) {
+                return reportSignatureError(lineNumber, "bytes must be hex digits or '?' wildcards");
+            }
+            if (high == -3) {
+                high = digit;
+                continue;
+            }
+            uint8_t mask = static_cast<uint8_t>((high >= 0 ? 0xF0 : 0) | (digit >= 0 ? 0x0F : 0));
+            uint8_t value = static_cast<uint8_t>((std::max(high, 0) << 4) | std::max(digit, 0));
+            signature.bytes.push_back(value);
+            signature.mask.push_back(mask);
+            fixed = fixed || mask == 0xFF;
+            high = -3;
+        }
+        if (high != -3) {
+            return reportSignatureError(lineNumber, "odd number of hex digits");
+        }
+        if (!fixed) {
+            return reportSignatureError(lineNumber, "a signature needs at least one fully specified byte");
+        }
+        signatures.push_back(std::move(signature));
+    }
+    return true;
+}
+
+bool loadSignatures(const char* path, std::vector<Signature>& signatures) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        std::cerr << "Error: cannot open signature file " << path << '\n';
+        return false;
+    }
+    std::string text((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    return parseSignatures(text, signatures);
+}
+
+SignatureScanner::Anchor SignatureScanner::makeAnchor(const Signature& signature, uint32_t index, size_t offset,
+                                                       uint32_t bucket) {
+    size_t length = signature.bytes.size();
+    Anchor anchor = {index, static_cast<uint32_t>(offset), static_cast<uint32_t>(length), bucket, 0, {}, {}, {}};
+    size_t size = length >= 8 ? 8 : length >= 4 ? 4 : 0;
+    if (size != 0) {
+        // Two words from the anchor on, unless that runs past the end; a
+        // pattern shorter than two words is covered by overlapping ones.
+        size_t first = length >= 2 * size ? std::min(offset, length - 2 * size) : 0;
+        anchor.windowSize = static_cast<uint32_t>(size);
+        anchor.window = {static_cast<uint32_t>(first), static_cast<uint32_t>(std::min(first + size, length - size))};
+        for (size_t k = 0; k < 2; k++) {
+            std::memcpy(&anchor.windowBytes[k], signature.bytes.data() + anchor.window[k], size);
+            std::memcpy(&anchor.windowMask[k], signature.mask.data() + anchor.window[k], size);
+        }
+    }
+    return anchor;
+}
+
+void SignatureScanner::build(std::vector<Signature> signatures, std::span<const uint8_t> sample) {
+    signatures_ = std::move(signatures);
+    pairBuckets_.assign(65536, 0);
+    std::vector<uint32_t> shares = estimatePairShares(sample);
+
+    // Greedy anchor and bucket choice: for each signature, the four bytes
+    // and the bucket that add the least work. That is the growth of the
+    // share of code the bucket passes (the product of the shares of its
+    // first and last pairs, so pairs the bucket already holds cost nothing)
+    // plus the weighted share of the anchor itself, which is how often its
+    // signature has to be verified.
+    std::array<FilterBucket, filterBuckets> buckets{};
+    std::vector<std::pair<uint32_t, Anchor>> quadAnchors;  // Key b0 | b1 << 8 | b2 << 16 | b3 << 24
+    std::vector<std::pair<uint32_t, Anchor>> pairs;        // Key b0 | b1 << 8
+    std::vector<Anchor> loose;
+    std::array<bool, 256> first{};
+    std::array<bool, 256> second{};
+
+    // With a sample, fully specified anchors are costed by how often they
+    // occur in it.
+    std::vector<uint32_t> quads;
+    if (!sample.empty()) {
+        for (const Signature& signature : signatures_) {
+            for (size_t p = 0; p < signature.bytes.size(); p++) {
+                if (fixedRun(signature, p) >= 4) {
+                    uint32_t quad;
+                    std::memcpy(&quad, signature.bytes.data() + p, 4);
+                    quads.push_back(quad);
+                }
+            }
+        }
+    }
+    std::vector<uint32_t> quadCounts = countQuads(sample, quads);
+    uint64_t samplePositions = std::max<size_t>(std::min(sample.size(), sampleLimit), 1);
+    size_t quadIndex = 0;
+
+    for (uint32_t index = 0; index < signatures_.size(); index++) {
+        const Signature& signature = signatures_[index];
+        // Fully specified bytes an anchor must start with: four if the
+        // pattern has such a run, else two (a run of three is indexed by its
+        // pair), else one.
+        size_t needed = 1;
+        for (size_t p = 0; p < signature.bytes.size(); p++) {
+            needed = std::max(needed, std::min<size_t>(fixedRun(signature, p), 4));
+        }
+        needed = needed == 3 ? 2 : needed;
+
+        size_t best = 0;
+        uint32_t bestBucket = 0;
+        uint64_t bestCost = UINT64_MAX;
+        for (size_t p = 0; p < signature.bytes.size(); p++) {
+            if (fixedRun(signature, p) < needed) {
+                continue;
+            }
+            MaskedPair head(signature, p);
+            MaskedPair tail(signature, p + 2);
+            uint64_t anchorCost = head.share(shares) * tail.share(shares) / shareScale * anchorWeight;
+            if (!quads.empty() && needed == 4) {
+                anchorCost = (quadCounts[quadIndex++] * shareScale + shareScale / 2) / samplePositions * countedWeight;
+            }
+            for (uint32_t k = 0; k < filterBuckets; k++) {
+                const FilterBucket& bucket = buckets[k];
+                uint64_t firstShare = bucket.first + addedShare(pairBuckets_, shares, head, 1u << k);
+                uint64_t lastShare = bucket.last + addedShare(pairBuckets_, shares, tail, 1u << (k + 8));
+                uint64_t cost = (firstShare * lastShare - bucket.first * bucket.last) / shareScale + anchorCost;
+                if (cost < bestCost) {
+                    best = p;
+                    bestBucket = k;
+                    bestCost = cost;
+                }
+            }
+        }
+
+        MaskedPair head(signature, best);
+        MaskedPair tail(signature, best + 2);
+        FilterBucket& bucket = buckets[bestBucket];
+        bucket.first += addedShare(pairBuckets_, shares, head, 1u << bestBucket);
+        bucket.last += addedShare(pairBuckets_, shares, tail, 1u << (bestBucket + 8));
+        head.forEach([&](uint32_t value) { pairBuckets_[value] |= static_cast<uint16_t>(1u << bestBucket); });
+        tail.forEach([&](uint32_t value) { pairBuckets_[value] |= static_cast<uint16_t>(1u << (bestBucket + 8)); });
+        for (unsigned v = 0; v < 256; v++) {
+            first[v] = first[v] || (v & head.mask & 0xFF) == (head.bytes & 0xFF);
+            second[v] = second[v] || (v & head.mask >> 8) == head.bytes >> 8;
+        }
+        Anchor anchor = makeAnchor(signature, index, best, bestBucket);
+        if (needed == 4) {
+            quadAnchors.push_back({head.bytes | tail.bytes << 16, anchor});
+        } else if (needed == 2) {
+            pairs.push_back({head.bytes, anchor});
+        } else {
+            loose.push_back(anchor);
+        }
+    }
+
+    // The ByteSet gate, if its sets are rare enough to be worth it.
+    firstBytes_ = {};
+    secondBytes_ = {};
+    uint64_t firstShare = 0;
+    uint64_t secondShare = 0;
+    for (unsigned v = 0; v < 256; v++) {
+        if (first[v]) {
+            firstBytes_.insert(static_cast<uint8_t>(v));
+            firstShare += byteFrequency[v];
+        }
+        if (second[v]) {
+            secondBytes_.insert(static_cast<uint8_t>(v));
+            secondShare += byteFrequency[v];
+        }
+    }
+    byteGate_ = firstShare * secondShare <= byteGateShare;
+
+    anchors_.clear();
+    anchors_.reserve(quadAnchors.size() + pairs.size() + loose.size());
+
+    // Anchors grouped by key; stable so signatures keep their file order.
+    auto byKey = [](const auto& a, const auto& b) { return a.first < b.first; };
+    std::stable_sort(quadAnchors.begin(), quadAnchors.end(), byKey);
+    std::stable_sort(pairs.begin(), pairs.end(), byKey);
+
+    size_t distinctQuads = 0;
+    for (size_t k = 0; k < quadAnchors.size(); k++) {
+        distinctQuads += k == 0 || quadAnchors[k].first != quadAnchors[k - 1].first;
+    }
+    quadSlots_.assign(distinctQuads == 0 ? 0 : std::bit_ceil(distinctQuads * 2), QuadSlot{});
+    quadShift_ = 32 - std::countr_zero(std::max<size_t>(quadSlots_.size(), 2));
+    size_t slot = 0;
+    for (size_t k = 0; k < quadAnchors.size(); k++) {
+        uint32_t quad = quadAnchors[k].first;
+        if (k == 0 || quad != quadAnchors[k - 1].first) {
+            slot = quadSlot(quad);
+            while (quadSlots_[slot].begin != quadSlots_[slot].end) {
+                slot = (slot + 1) & (quadSlots_.size() - 1);
+            }
+            quadSlots_[slot] = {quad, static_cast<uint32_t>(k), static_cast<uint32_t>(k)};
+        }
+        anchors_.push_back(quadAnchors[k].second);
+        quadSlots_[slot].end++;
+    }
+
+    pairBits_.assign(65536 / 64, 0);
+    pairRank_.assign(65536 / 64, 0);
+    pairStart_.clear();
+    for (size_t k = 0; k < pairs.size(); k++) {
+        uint32_t key = pairs[k].first;
+        if (k == 0 || key != pairs[k - 1].first) {
+            pairBits_[key / 64] |= uint64_t{1} << (key % 64);
+            pairStart_.push_back(static_cast<uint32_t>(anchors_.size()));
+        }
+        anchors_.push_back(pairs[k].second);
+    }
+    pairStart_.push_back(static_cast<uint32_t>(anchors_.size()));
+    for (size_t word = 1; word < pairRank_.size(); word++) {
+        pairRank_[word] = pairRank_[word - 1] + static_cast<uint32_t>(std::popcount(pairBits_[word - 1]));
+    }
+    looseStart_ = static_cast<uint32_t>(anchors_.size());
+    anchors_.insert(anchors_.end(), loose.begin(), loose.end());
+}
+
+void SignatureScanner::matchAnchors(std::span<const uint8_t> bytes, size_t pos, std::span<const Anchor> anchors,
+                                    uint32_t buckets, uint64_t baseAddress, uint32_t region,
+                                    std::vector<SignatureMatch>& matches) const {
+    for (const Anchor& anchor : anchors) {
+        if (!((buckets >> anchor.bucket) & 1) || pos < anchor.offset ||
+            pos - anchor.offset + anchor.length > bytes.size()) {
+            continue;
+        }
+        const uint8_t* start = bytes.data() + pos - anchor.offset;
+        std::array<uint64_t, 2> window{};
+        if (anchor.windowSize == 8) {
+            std::memcpy(&window[0], start + anchor.window[0], 8);
+            std::memcpy(&window[1], start + anchor.window[1], 8);
+        } else if (anchor.windowSize == 4) {
+            std::memcpy(&window[0], start + anchor.window[0], 4);
+            std::memcpy(&window[1], start + anchor.window[1], 4);
+        }
+        if ((((window[0] & anchor.windowMask[0]) ^ anchor.windowBytes[0]) |
+             ((window[1] & anchor.windowMask[1]) ^ anchor.windowBytes[1])) != 0) {
+            continue;
+        }
+        if (anchor.length <= 2 * anchor.windowSize) {
+            matches.push_back({baseAddress + (pos - anchor.offset), anchor.signature, region});
+            continue;
+        }
+        const Signature& signature = signatures_[anchor.signature];
+        bool match = true;
+        for (size_t k = 0; match && k < signature.bytes.size(); k++) {
+            match = (start[k] & signature.mask[k]) == signature.bytes[k];
+        }
+        if (match) {
+            matches.push_back({baseAddress + (pos - anchor.offset), anchor.signature, region});
+        }
+    }
+}
+
+void SignatureScanner::matchAt(std::span<const uint8_t> bytes, size_t pos, uint32_t buckets, uint64_t baseAddress,
+                               uint32_t region, std::vector<SignatureMatch>& matches) const {
+    if (!quadSlots_.empty() && pos + 4 <= bytes.size()) {
+        uint32_t quad;
+        std::memcpy(&quad, bytes.data() + pos, 4);
+        for (size_t slot = quadSlot(quad);; slot = (slot + 1) & (quadSlots_.size() - 1)) {
+            const QuadSlot& entry = quadSlots_[slot];
+            if (entry.quad == quad || entry.begin == entry.end) {
+                std::span<const Anchor> anchors(anchors_.data() + entry.begin, entry.end - entry.begin);
+                matchAnchors(bytes, pos, anchors, buckets, baseAddress, region, matches);
+                break;
+            }
+        }
+    }
+    if (pairStart_.size() > 1 && pos + 1 < bytes.size()) {
+        uint32_t key = bytes[pos] | bytes[pos + 1] << 8;
+        uint64_t bits = pairBits_[key / 64];
+        if ((bits >> (key % 64)) & 1) {
+            size_t rank = pairRank_[key / 64] + std::popcount(bits & ((uint64_t{1} << (key % 64)) - 1));
+            std::span<const Anchor> anchors(anchors_.data() + pairStart_[rank], pairStart_[rank + 1] - pairStart_[rank]);
+            matchAnchors(bytes, pos, anchors, buckets, baseAddress, region, matches);
+        }
+    }
+    if (looseStart_ != anchors_.size()) {
+        std::span<const Anchor> anchors(anchors_.data() + looseStart_, anchors_.size() - looseStart_);
+        matchAnchors(bytes, pos, anchors, buckets, baseAddress, region, matches);
+    }
+}
+
+#if BYTE_SET_SIMD
+
+// Positions among the 32 at bytes whose first byte is in first and whose
+// second is in second; 33 bytes must be readable.
+[[gnu::target("avx2")]] static uint32_t anchorCandidatesAvx2(const uint8_t* bytes, const ByteSet& first,
+                                                             const ByteSet& second) {
+    return matchByteSetAvx2(loadByteBlockAvx2(bytes), first) & matchByteSetAvx2(loadByteBlockAvx2(bytes + 1), second);
+}
+
+[[gnu::target("sse4.1")]] static uint32_t anchorCandidatesSse41(const uint8_t* bytes, const ByteSet& first,
+                                                                const ByteSet& second) {
+    uint32_t candidates = 0;
+    for (size_t half = 0; half < 32; half += 16) {
+        uint32_t hits = matchByteSetSse41(loadByteBlockSse41(bytes + half), first) &
+                        matchByteSetSse41(loadByteBlockSse41(bytes + half + 1), second);
+        candidates |= hits << half;
+    }
+    return candidates;
+}
+
+#endif
+
+void SignatureScanner::scan(std::span<const uint8_t> bytes, size_t begin, size_t end, uint64_t baseAddress,
+                            uint32_t region, std::vector<SignatureMatch>& matches) const {
+    if (signatures_.empty()) {
+        return;
+    }
+    end = std::min(end, bytes.size());
+    size_t pos = begin;
+
+    // Buckets of the pair at p, and of the anchors that may start at p: the
+    // pairs at p and p + 2 must agree. The latter needs four bytes at p.
+    const uint16_t* table = pairBuckets_.data();
+    const uint8_t* data = bytes.data();
+    auto pairBuckets = [table, data](size_t p) -> uint32_t {
+        uint16_t pair;
+        std::memcpy(&pair, data + p, 2);
+        return table[pair];
+    };
+    auto candidateBuckets = [&pairBuckets](size_t p) { return pairBuckets(p) & (pairBuckets(p + 2) >> 8) & 0xFF; };
+
+#if BYTE_SET_SIMD
+    // Gate 32 positions at a time while 33 bytes are left to read.
+    ByteClassifierKernel kernel = activeByteClassifierKernel();
+    if (byteGate_ && kernel != ByteClassifierKernel::Scalar) {
+        auto candidates = kernel == ByteClassifierKernel::Avx2 ? anchorCandidatesAvx2 : anchorCandidatesSse41;
+        for (; pos + 32 <= end && pos + 33 <= bytes.size(); pos += 32) {
+            uint32_t hits = candidates(data + pos, firstBytes_, secondBytes_);
+            while (hits != 0) {
+                size_t at = pos + static_cast<size_t>(std::countr_zero(hits));
+                uint32_t buckets = candidateBuckets(at);
+                if (buckets != 0) {
+                    matchAt(bytes, at, buckets, baseAddress, region, matches);
+                }
+                hits &= hits - 1;
+            }
+        }
+    }
+#endif
+
+    // Filter eight positions per step while the pairs up to pos + 9 can be
+    // read, carrying the last two pairs' buckets over to the next step.
+    if (pos + 8 <= end && pos + 11 <= bytes.size()) {
+        uint32_t b0 = pairBuckets(pos);
+        uint32_t b1 = pairBuckets(pos + 1);
+        for (; pos + 8 <= end && pos + 11 <= bytes.size(); pos += 8) {
+            uint32_t b2 = pairBuckets(pos + 2);
+            uint32_t b3 = pairBuckets(pos + 3);
+            uint32_t b4 = pairBuckets(pos + 4);
+            uint32_t b5 = pairBuckets(pos + 5);
+            uint32_t b6 = pairBuckets(pos + 6);
+            uint32_t b7 = pairBuckets(pos + 7);
+            uint32_t b8 = pairBuckets(pos + 8);
+            uint32_t b9 = pairBuckets(pos + 9);
+            std::array<uint32_t, 8> hits = {b0 & (b2 >> 8), b1 & (b3 >> 8), b2 & (b4 >> 8), b3 & (b5 >> 8),
+                                            b4 & (b6 >> 8), b5 & (b7 >> 8), b6 & (b8 >> 8), b7 & (b9 >> 8)};
+            if (((hits[0] | hits[1] | hits[2] | hits[3] | hits[4] | hits[5] | hits[6] | hits[7]) & 0xFF) != 0) {
+                for (size_t k = 0; k < 8; k++) {
+                    if ((hits[k] & 0xFF) != 0) {
+                        matchAt(bytes, pos + k, hits[k] & 0xFF, baseAddress, region, matches);
+                    }
+                }
+            }
+            b0 = b8;
+            b1 = b9;
+        }
+    }
+
+    // The rest position by position; within four bytes of the end, the
+    // anchors of short patterns may run past it, so every bucket is tried.
+    for (; pos < end; pos++) {
+        uint32_t buckets = pos + 4 <= bytes.size() ? candidateBuckets(pos) : 0xFF;
+        if (buckets != 0) {
+            matchAt(bytes, pos, buckets, baseAddress, region, matches);
+        }
+    }
+}
+
+void scanRegions(const SignatureScanner& scanner, std::span<const CodeRegion> regions, unsigned threads,
+                 std::vector<SignatureMatch>& matches) {
+    // One slice per megabyte; each slice collects into its own vector.
+    struct Slice {
+        uint32_t region;
+        size_t begin;
+        size_t end;
+        std::vector<SignatureMatch> matches;
+    };
+    std::vector<Slice> slices;
+    for (uint32_t k = 0; k < regions.size(); k++) {
+        size_t size = regions[k].bytes.size();
+        size_t step = threads == 1 ? std::max<size_t>(size, 1) : scanSliceSize;
+        for (size_t begin = 0; begin < size; begin += step) {
+            slices.push_back({k, begin, std::min(size, begin + step), {}});
+        }
+    }
+    auto scanSlice = [&scanner, regions](Slice& slice) {
+        const CodeRegion& region = regions[slice.region];
+        scanner.scan(region.bytes, slice.begin, slice.end, region.address, slice.region, slice.matches);
+    };
+    if (threads == 1 || slices.size() <= 1) {
+        for (Slice& slice : slices) {
+            scanSlice(slice);
+        }
+    } else {
+        WorkStealingPool pool(threads);
+        for (Slice& slice : slices) {
+            pool.submit([&scanSlice, &slice] { scanSlice(slice); });
+        }
+        pool.wait();
+    }
+
+    for (Slice& slice : slices) {
+        matches.insert(matches.end(), slice.matches.begin(), slice.matches.end());
+    }
+    std::sort(matches.begin(), matches.end(), [](const SignatureMatch& a, const SignatureMatch& b) {
+        return a.address != b.address ? a.address < b.address : a.signature < b.signature;
+    });
+}
+
+void printSignatureMatches(const SignatureScanner& scanner, std::span<const CodeRegion> regions,
+                           std::span<const SignatureMatch> matches, OutputWriter& out, const SymbolTable* symbols) {
+    size_t bytes = 0;
+    for (const CodeRegion& region : regions) {
+        bytes += region.bytes.size();
+    }
+    std::vector<bool> matched(scanner.size());
+    for (const SignatureMatch& match : matches) {
+        matched[match.signature] = true;
+    }
+    out << "Scanned ";
+    out.dec(static_cast<uint64_t>(bytes));
+    out << " bytes in ";
+    out.dec(static_cast<uint64_t>(regions.size()));
+    out << " regions for ";
+    out.dec(static_cast<uint64_t>(scanner.size()));
+    out << " signatures: ";
+    out.dec(static_cast<uint64_t>(matches.size()));
+    out << " matches of ";
+    out.dec(static_cast<uint64_t>(std::count(matched.begin(), matched.end(), true)));
+    out << " signatures\n";
+
+    for (const SignatureMatch& match : matches) {
+        out.reserveLine();
+        out << "  0x";
+        out.hex(match.address);
+        writeSymbolReference(out, symbols, match.address);
+        out << "  " << regions[match.region].name << "  ";
+        out << scanner.signature(match.signature).name << '\n';
+    }
+}
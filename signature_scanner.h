@@ -0,0 +1,139 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "byte_set.h"
+#include "elf.h"
+#include "output_writer.h"
+
+class SymbolTable;
+
+// One byte signature. Each pattern byte has a mask: 0xFF must match
+// exactly, 0x00 matches any byte ("??"), 0xF0 or 0x0F match one nibble
+// ("4?", "?8"). bytes holds the pattern already masked.
+struct Signature {
+    std::string name;
+    std::vector<uint8_t> bytes;
+    std::vector<uint8_t> mask;
+};
+
+// Parses signature rules, one per line:
+//     name: 48 8b 05 ?? ?? ?? ?? e8
+// The hex bytes may also be written without spaces. Blank lines and '#'
+// comments are skipped. Every signature needs at least one fully specified
+// byte. On error, prints the line number and reason to std::cerr and
+// returns false.
+bool parseSignatures(std::string_view text, std::vector<Signature>& signatures);
+
+// Reads the file at path and parses it with parseSignatures().
+bool loadSignatures(const char* path, std::vector<Signature>& signatures);
+
+// One occurrence of a signature.
+struct SignatureMatch {
+    uint64_t address;    // Virtual address of the first matched byte
+    uint32_t signature;  // Index into the scanner's signatures
+    uint32_t region;     // Index into the scanned regions
+};
+
+// Multi-pattern scanner. Every signature is anchored on four neighbouring
+// pattern bytes, fully specified where the pattern allows, and the anchors
+// are spread over eight buckets so that the pairs sharing a bucket stay rare
+// in code together. Scanning has three stages:
+//   - gate: while the anchors' first pairs use few byte values, their first
+//     and second bytes form two ByteSets tested 32 positions at a time
+//     (AVX2 or SSE4.1, whichever the byte classifier selected); larger sets
+//     skip this stage, as nearly every position would pass it
+//   - filter: one table maps each byte pair to the buckets with an anchor
+//     starting with it (low byte) or ending with it (high byte), so a
+//     position passes only if the pairs at it and two bytes on share a
+//     bucket; eight positions are tested per step
+//   - verify: surviving positions look their four bytes up in a hash of the
+//     fully specified anchors (and their first pair in an index of the
+//     others), and only real anchor hits compare the masked patterns of the
+//     signatures anchored there
+// A signature is only ever looked for at its own anchor, so every match is
+// found once, whichever slice of the bytes the anchor falls in.
+class SignatureScanner {
+public:
+    // Takes the signatures and builds the filters and anchor index. sample,
+    // if given, is code like the code to be scanned; anchors are then chosen
+    // by how often their bytes occur in it rather than by typical byte
+    // shares.
+    void build(std::vector<Signature> signatures, std::span<const uint8_t> sample = {});
+
+    size_t size() const { return signatures_.size(); }
+    const Signature& signature(size_t index) const { return signatures_[index]; }
+
+    // Appends the matches of every signature whose anchor lies in
+    // [begin, end) of bytes and that fits in bytes entirely; baseAddress is
+    // the address of bytes[0]. Matches come out ordered by anchor, not by
+    // address.
+    void scan(std::span<const uint8_t> bytes, size_t begin, size_t end, uint64_t baseAddress, uint32_t region,
+              std::vector<SignatureMatch>& matches) const;
+
+private:
+    // A signature anchored at offset within its pattern. Up to sixteen
+    // pattern bytes are kept here as two masked words, so most anchor hits
+    // are rejected without touching the signature, and patterns of up to
+    // sixteen bytes need nothing else.
+    struct Anchor {
+        uint32_t signature;
+        uint32_t offset;
+        uint32_t length;                      // Pattern length
+        uint32_t bucket;                      // Filter bucket, 0-7
+        uint32_t windowSize;                  // Bytes per window word: 8, or 4 for shorter patterns, 0 below that
+        std::array<uint32_t, 2> window;       // Start of each window word within the pattern
+        std::array<uint64_t, 2> windowBytes;  // The window words, masked, as loaded from memory
+        std::array<uint64_t, 2> windowMask;
+    };
+
+    static Anchor makeAnchor(const Signature& signature, uint32_t index, size_t offset, uint32_t bucket);
+
+    // Verifies the signatures anchored at bytes[pos] whose bucket is in
+    // buckets.
+    void matchAt(std::span<const uint8_t> bytes, size_t pos, uint32_t buckets, uint64_t baseAddress,
+                 uint32_t region, std::vector<SignatureMatch>& matches) const;
+    void matchAnchors(std::span<const uint8_t> bytes, size_t pos, std::span<const Anchor> anchors,
+                      uint32_t buckets, uint64_t baseAddress, uint32_t region,
+                      std::vector<SignatureMatch>& matches) const;
+
+    // Anchors of four fully specified bytes, by those bytes as loaded from
+    // memory: open-addressed, with empty slots holding no anchors.
+    struct QuadSlot {
+        uint32_t quad = 0;
+        uint32_t begin = 0;  // anchors_[begin, end)
+        uint32_t end = 0;
+    };
+
+    size_t quadSlot(uint32_t quad) const { return (quad * 0x9E3779B1u) >> quadShift_; }
+
+    std::vector<Signature> signatures_;
+    bool byteGate_ = false;  // Whether the ByteSet stage runs
+    ByteSet firstBytes_;     // First bytes of the anchors
+    ByteSet secondBytes_;    // Second bytes of the anchors
+    std::vector<uint16_t> pairBuckets_;  // Per pair b0 | b1 << 8: first-pair buckets | last-pair buckets << 8
+    std::vector<QuadSlot> quadSlots_;
+    uint32_t quadShift_ = 0;           // 32 - log2 of the number of slots
+    std::vector<uint64_t> pairBits_;   // Bit b0 | b1 << 8 set for the first pair of every other anchor that has one
+    std::vector<uint32_t> pairRank_;   // Pairs before each word of pairBits_
+    std::vector<uint32_t> pairStart_;  // Anchors of the pair of rank r: anchors_[pairStart_[r], pairStart_[r + 1])
+    uint32_t looseStart_ = 0;          // Anchors without a fully specified pair: anchors_[looseStart_, end)
+    std::vector<Anchor> anchors_;
+};
+
+// Scans every region for the scanner's signatures, spreading slices of at
+// least a megabyte over threads (0 = one per hardware thread). matches is
+// sorted by address, then by signature.
+void scanRegions(const SignatureScanner& scanner, std::span<const CodeRegion> regions, unsigned threads,
+                 std::vector<SignatureMatch>& matches);
+
+// Writes a summary line followed by one line per match: its address, the
+// symbol that encloses it and the signature name.
+void printSignatureMatches(const SignatureScanner& scanner, std::span<const CodeRegion> regions,
+                           std::span<const SignatureMatch> matches, OutputWriter& out, const SymbolTable* symbols);
@@ -0,0 +1,122 @@
+#include "symbol_table.h"
+
+#include <algorithm>
+#include <utility>
+
+// Orders symbols sharing an address from most to least descriptive.
+static int symbolRank(const Symbol& symbol) {
+    int rank = symbol.type == STT_FUNC ? 0 : 3;
+    switch (symbol.binding) {
+        case STB_GLOBAL: break;
+        case STB_WEAK: rank += 1; break;
+        default: rank += 2; break;
+    }
+    return rank;
+}
+
+// Appends the usable symbols of one symbol table section to out. Sym is
+// Elf64_Sym or Elf32_Sym, matching the class of the file.
+template <typename Sym>
+static void readSymbols(std::span<const uint8_t> file, const ElfSectionTable& sections,
+                        const ElfSection& symbolSection, std::vector<Symbol>& out) {
+    std::span<const ElfSection> all = sections.sections();
+    if (!symbolSection.inFile || symbolSection.link >= all.size() || !all[symbolSection.link].inFile) {
+        return;
+    }
+    std::span<const uint8_t> stringBytes = all[symbolSection.link].contents(file);
+    std::string_view strings(reinterpret_cast<const char*>(stringBytes.data()), stringBytes.size());
+
+    for (const Sym& sym : elfRecords<Sym>(symbolSection.contents(file))) {
+        uint8_t type = sym.st_info & 0x0F;
+        if (sym.st_shndx == SHN_UNDEF || sym.st_shndx >= SHN_LORESERVE ||
+            (type != STT_FUNC && type != STT_OBJECT && type != STT_NOTYPE) ||
+            sym.st_name == 0 || sym.st_name >= strings.size()) {
+            continue;
+        }
+        std::string_view name = strings.substr(sym.st_name);
+        size_t length = name.find('\0');
+        if (length == std::string_view::npos || length == 0) {
+            continue;
+        }
+        out.push_back({sym.st_value, sym.st_size, name.substr(0, length), type,
+                       static_cast<uint8_t>(sym.st_info >> 4)});
+    }
+}
+
+size_t SymbolTable::load(std::span<const uint8_t> file, const ElfSectionTable& sections) {
+    symbols_.clear();
+    addresses_.clear();
+    for (const ElfSection& section : sections.sections()) {
+        if (section.type == SHT_SYMTAB || section.type == SHT_DYNSYM) {
+            if (sections.is64()) {
+                readSymbols<Elf64_Sym>(file, sections, section, symbols_);
+            } else {
+                readSymbols<Elf32_Sym>(file, sections, section, symbols_);
+            }
+        }
+    }
+
+    // Sort by address, best name first, and keep one symbol per address.
+    // .dynsym mostly repeats .symtab, so this also removes the duplicates.
+    std::sort(symbols_.begin(), symbols_.end(), [](const Symbol& a, const Symbol& b) {
+        if (a.address != b.address) {
+            return a.address < b.address;
+        }
+        int rankA = symbolRank(a), rankB = symbolRank(b);
+        return rankA != rankB ? rankA < rankB : a.name < b.name;
+    });
+    symbols_.erase(std::unique(symbols_.begin(), symbols_.end(), [](const Symbol& a, const Symbol& b) {
+        return a.address == b.address;
+    }), symbols_.end());
+    symbols_.shrink_to_fit();
+
+    addresses_.reserve(symbols_.size());
+    for (const Symbol& symbol : symbols_) {
+        addresses_.push_back(symbol.address);
+    }
+    return symbols_.size();
+}
+
+void SymbolTable::assign(std::vector<Symbol> symbols) {
+    symbols_ = std::move(symbols);
+    addresses_.resize(symbols_.size());
+    for (size_t i = 0; i < symbols_.size(); i++) {
+        addresses_[i] = symbols_[i].address;
+    }
+}
+
+size_t SymbolTable::lowerBound(uint64_t address) const {
+    return std::lower_bound(addresses_.begin(), addresses_.end(), address) - addresses_.begin();
+}
+
+const Symbol* SymbolTable::lookup(uint64_t address) const {
+    size_t index = std::upper_bound(addresses_.begin(), addresses_.end(), address) - addresses_.begin();
+    if (index == 0) {
+        return nullptr;
+    }
+    const Symbol& symbol = symbols_[index - 1];
+    // A symbol of unknown size (typically an assembler label) extends to the
+    // next symbol, as in objdump.
+    if (symbol.size == 0 || address - symbol.address < symbol.size) {
+        return &symbol;
+    }
+    return nullptr;
+}
+
+const Symbol* SymbolTable::findByName(std::string_view name) const {
+    auto it = std::find_if(symbols_.begin(), symbols_.end(), [&](const Symbol& symbol) { return symbol.name == name; });
+    return it != symbols_.end() ? &*it : nullptr;
+}
+
+void writeSymbolReference(OutputWriter& out, const SymbolTable* symbols, uint64_t address) {
+    const Symbol* symbol = symbols != nullptr ? symbols->lookup(address) : nullptr;
+    if (symbol == nullptr) {
+        return;
+    }
+    out << " <" << symbol->name;
+    if (address != symbol->address) {
+        out << "+0x";
+        out.hex(address - symbol->address);
+    }
+    out << '>';
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#include "elf.h"
+
+// A defined function or data symbol from .symtab or .dynsym.
+struct Symbol {
+    uint64_t address = 0;
+    uint64_t size = 0;      // 0 when the symbol table does not say
+    std::string_view name;  // Points into the mapped string table
+    uint8_t type = 0;       // STT_FUNC, STT_OBJECT or STT_NOTYPE
+    uint8_t binding = 0;    // STB_LOCAL, STB_GLOBAL or STB_WEAK
+};
+
+// Address-sorted symbol index, one symbol per address. The addresses are
+// kept in their own dense array so that a lookup is a binary search over
+// 8-byte keys (a few cache lines even for hundreds of thousands of symbols)
+// and only the final hit touches the Symbol itself.
+class SymbolTable {
+public:
+    // Reads every SHT_SYMTAB and SHT_DYNSYM section of file. Undefined,
+    // absolute, section, file and TLS symbols are skipped, as are entries
+    // whose names do not fit in their string table. Where several symbols
+    // share an address the most descriptive one wins: functions over other
+    // types, then global over weak over local. Returns the number kept.
+    size_t load(std::span<const uint8_t> file, const ElfSectionTable& sections);
+
+    // Replaces the table with symbols, which must already be in the form
+    // symbols() returns: sorted by address, one per address.
+    void assign(std::vector<Symbol> symbols);
+
+    bool empty() const { return symbols_.empty(); }
+    size_t size() const { return symbols_.size(); }
+    std::span<const Symbol> symbols() const { return symbols_; }
+
+    // Returns the symbol that covers address: the closest one at or below
+    // it, if address lies within its size. Symbols of unknown size cover
+    // everything up to the next symbol. nullptr otherwise.
+    const Symbol* lookup(uint64_t address) const;
+
+    // Index of the first symbol at or above address. Lets a caller walking
+    // ascending addresses (like the printer) advance a cursor instead of
+    // searching per instruction.
+    size_t lowerBound(uint64_t address) const;
+
+    // Returns the symbol called name, or nullptr. A linear scan, meant for
+    // one-off lookups of names given on the command line.
+    const Symbol* findByName(std::string_view name) const;
+
+private:
+    std::vector<uint64_t> addresses_;  // addresses_[i] == symbols_[i].address
+    std::vector<Symbol> symbols_;
+};
+
+// Appends " <name>" or " <name+0x1f>" for the symbol covering address, or
+// nothing if symbols is nullptr or no symbol covers it.
+void writeSymbolReference(OutputWriter& out, const SymbolTable* symbols, uint64_t address);
@@ -0,0 +1,125 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <exception>
+#include <iostream>
+
+namespace {
+
+// The pool and deque index of the worker running on this thread, so that
+// tasks spawned by a task land in the spawning worker's own deque.
+thread_local WorkStealingPool* currentPool = nullptr;
+thread_local unsigned currentWorker = 0;
+
+} // namespace
+
+WorkStealingPool::WorkStealingPool(unsigned threads) {
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    queues_.reserve(threads);
+    for (unsigned index = 0; index < threads; index++) {
+        queues_.push_back(std::make_unique<Queue>());
+    }
+    workers_.reserve(threads);
+    for (unsigned index = 0; index < threads; index++) {
+        workers_.emplace_back(&WorkStealingPool::workerLoop, this, index);
+    }
+}
+
+WorkStealingPool::~WorkStealingPool() {
+    wait();
+    {
+        std::lock_guard<std::mutex> lock(stateMutex_);
+        stopping_ = true;
+    }
+    workAvailable_.notify_all();
+    for (std::thread& worker : workers_) {
+        worker.join();
+    }
+}
+
+void WorkStealingPool::submit(Task task) {
+    unsigned index = currentPool == this
+        ? currentWorker
+        : nextQueue_.fetch_add(1, std::memory_order_relaxed) % size();
+    // Count the task before it becomes visible so that a worker popping it
+    // straight away never drives the counters below zero.
+    pending_.fetch_add(1);
+    queued_.fetch_add(1);
+    {
+        Queue& queue = *queues_[index];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.tasks.push_back(std::move(task));
+    }
+    // Taking the state lock orders this notification after any worker that
+    // saw queued_ == 0 has gone to sleep, so the wake-up cannot be lost.
+    {
+        std::lock_guard<std::mutex> lock(stateMutex_);
+    }
+    workAvailable_.notify_one();
+}
+
+void WorkStealingPool::wait() {
+    std::unique_lock<std::mutex> lock(stateMutex_);
+    allDone_.wait(lock, [this] { return pending_.load() == 0; });
+}
+
+bool WorkStealingPool::popLocal(unsigned index, Task& task) {
+    Queue& queue = *queues_[index];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.tasks.empty()) {
+        return false;
+    }
+    task = std::move(queue.tasks.back());
+    queue.tasks.pop_back();
+    return true;
+}
+
+bool WorkStealingPool::steal(unsigned thief, Task& task) {
+    // Start with the next worker over so that thieves spread out instead of
+    // all hammering worker 0.
+    for (unsigned step = 1; step < size(); step++) {
+        Queue& queue = *queues_[(thief + step) % size()];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (!queue.tasks.empty()) {
+            task = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+void WorkStealingPool::finishTask() {
+    if (pending_.fetch_sub(1) == 1) {
+        std::lock_guard<std::mutex> lock(stateMutex_);
+        allDone_.notify_all();
+    }
+}
+
+void WorkStealingPool::workerLoop(unsigned index) {
+    currentPool = this;
+    currentWorker = index;
+    Task task;
+    for (;;) {
+        if (popLocal(index, task) || steal(index, task)) {
+            queued_.fetch_sub(1);
+            // A failing task must not take the worker (and with it the
+            // whole batch) down; report it and move on.
+            try {
+                task();
+            } catch (const std::exception& error) {
+                std::cerr << "Error: task failed: " << error.what() << '\n';
+            }
+            task = nullptr;
+            finishTask();
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(stateMutex_);
+        workAvailable_.wait(lock, [this] { return stopping_ || queued_.load() > 0; });
+        if (stopping_ && queued_.load() == 0) {
+            return;
+        }
+    }
+}
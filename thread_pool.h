@@ -0,0 +1,65 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Work-stealing thread pool. Every worker owns a deque of tasks: it pushes
+// and pops its own work at the back (most recently spawned first, which keeps
+// a file's sub-tasks close together in cache) and, when its deque runs dry,
+// steals the oldest task from the front of another worker's deque. Tasks
+// submitted from outside the pool are dealt round-robin across the deques;
+// tasks submitted from a worker go to that worker's own deque.
+//
+// The deques are short mutex-guarded critical sections rather than lock-free
+// structures: tasks here are whole files or megabyte-sized chunks, so the
+// queue operations are nowhere near the hot path.
+class WorkStealingPool {
+public:
+    using Task = std::function<void()>;
+
+    // Starts threads workers; 0 means one per hardware thread.
+    explicit WorkStealingPool(unsigned threads);
+    ~WorkStealingPool();
+
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    // Queues task. Safe to call from any thread, including from inside a task.
+    void submit(Task task);
+
+    // Blocks until every submitted task, including tasks submitted by other
+    // tasks while waiting, has finished. Must not be called from a worker.
+    void wait();
+
+    unsigned size() const { return static_cast<unsigned>(workers_.size()); }
+
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    void workerLoop(unsigned index);
+    bool popLocal(unsigned index, Task& task);
+    bool steal(unsigned thief, Task& task);
+    void finishTask();
+
+    std::vector<std::unique_ptr<Queue>> queues_;
+    std::vector<std::thread> workers_;
+
+    std::atomic<size_t> queued_{0};   // Tasks sitting in some deque
+    std::atomic<size_t> pending_{0};  // Tasks queued or running
+    std::atomic<unsigned> nextQueue_{0};
+
+    std::mutex stateMutex_;
+    std::condition_variable workAvailable_;
+    std::condition_variable allDone_;
+    bool stopping_ = false;
+};
@@ -0,0 +1,119 @@
+#include "xref.h"
+
+#include <algorithm>
+
+#include "control_flow.h"
+#include "parallel_sort.h"
+#include "symbol_table.h"
+
+namespace {
+
+bool bySourceLess(const Xref& a, const Xref& b) {
+    if (a.from != b.from) {
+        return a.from < b.from;
+    }
+    return a.to != b.to ? a.to < b.to : a.kind < b.kind;
+}
+
+bool byTargetLess(const Xref& a, const Xref& b) {
+    if (a.to != b.to) {
+        return a.to < b.to;
+    }
+    return a.from != b.from ? a.from < b.from : a.kind < b.kind;
+}
+
+bool sameXref(const Xref& a, const Xref& b) {
+    return a.from == b.from && a.to == b.to && a.kind == b.kind;
+}
+
+} // namespace
+
+void XrefTable::add(const CodeRegion& region, std::span<const DecodedInstruction> instructions) {
+    const uint8_t* code = region.bytes.data();
+    for (const DecodedInstruction& insn : instructions) {
+        uint64_t address = region.address + insn.offset;
+        FlowKind flow = classifyFlow(insn);
+        if (hasBranchTarget(flow)) {
+            XrefKind kind = flow == FlowKind::Call ? XrefKind::Call
+                          : flow == FlowKind::Jump ? XrefKind::Jump : XrefKind::ConditionalJump;
+            bySource_.push_back({address, branchTarget(code + insn.offset, insn, address), kind});
+        }
+        uint64_t target;
+        if (ripRelativeTarget(code + insn.offset, insn, address, target)) {
+            bySource_.push_back({address, target, XrefKind::Data});
+        }
+    }
+}
+
+void XrefTable::finish(unsigned threads) {
+    // Overlapping regions or repeated add() calls can record the same
+    // reference more than once.
+    parallelSort(bySource_, bySourceLess, threads);
+    bySource_.erase(std::unique(bySource_.begin(), bySource_.end(), sameXref), bySource_.end());
+    byTarget_ = bySource_;
+    parallelSort(byTarget_, byTargetLess, threads);
+}
+
+std::span<const Xref> XrefTable::referencesFrom(uint64_t begin, uint64_t end) const {
+    auto first = std::lower_bound(bySource_.begin(), bySource_.end(), begin,
+        [](const Xref& xref, uint64_t value) { return xref.from < value; });
+    auto last = std::lower_bound(first, bySource_.end(), end,
+        [](const Xref& xref, uint64_t value) { return xref.from < value; });
+    return {first, last};
+}
+
+std::span<const Xref> XrefTable::referencesTo(uint64_t address) const {
+    auto first = std::lower_bound(byTarget_.begin(), byTarget_.end(), address,
+        [](const Xref& xref, uint64_t value) { return xref.to < value; });
+    auto last = std::upper_bound(first, byTarget_.end(), address,
+        [](uint64_t value, const Xref& xref) { return value < xref.to; });
+    return {first, last};
+}
+
+const char* xrefKindName(XrefKind kind) {
+    switch (kind) {
+        case XrefKind::Call: return "call";
+        case XrefKind::Jump: return "jmp";
+        case XrefKind::ConditionalJump: return "jcc";
+        case XrefKind::Data: return "data";
+    }
+    return "?";
+}
+
+// One "  0x<from> <symbol> -> 0x<to> <symbol>  <kind>" line.
+static void writeXrefLine(OutputWriter& out, const Xref& xref, const SymbolTable* symbols) {
+    out.reserveLine();
+    out << "  0x";
+    out.hex(xref.from);
+    writeSymbolReference(out, symbols, xref.from);
+    out << " -> 0x";
+    out.hex(xref.to);
+    writeSymbolReference(out, symbols, xref.to);
+    out << "  " << xrefKindName(xref.kind) << '\n';
+}
+
+void printXrefs(const XrefTable& xrefs, uint64_t begin, uint64_t end, OutputWriter& out,
+                const SymbolTable* symbols) {
+    std::span<const Xref> to = xrefs.referencesTo(begin);
+    out << "References to 0x";
+    out.hex(begin);
+    writeSymbolReference(out, symbols, begin);
+    out << ": ";
+    out.dec(static_cast<uint64_t>(to.size()));
+    out << '\n';
+    for (const Xref& xref : to) {
+        writeXrefLine(out, xref, symbols);
+    }
+
+    std::span<const Xref> from = xrefs.referencesFrom(begin, end);
+    out << "References from 0x";
+    out.hex(begin);
+    out << "-0x";
+    out.hex(end);
+    out << ": ";
+    out.dec(static_cast<uint64_t>(from.size()));
+    out << '\n';
+    for (const Xref& xref : from) {
+        writeXrefLine(out, xref, symbols);
+    }
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "decoded_instruction.h"
+#include "elf.h"
+#include "output_writer.h"
+
+class SymbolTable;
+
+// How one instruction refers to another address.
+enum class XrefKind : uint8_t {
+    Call,             // Direct call
+    Jump,             // Direct unconditional jump
+    ConditionalJump,  // jcc, loop, jrcxz
+    Data,             // rip-relative memory operand (load, store, lea, call/jmp through memory)
+};
+
+// One reference: the instruction at from refers to to.
+struct Xref {
+    uint64_t from;
+    uint64_t to;
+    XrefKind kind;
+};
+
+// Cross-reference index over decoded code. References are collected from
+// the instruction records (direct branch targets and rip-relative operands)
+// and kept twice, once sorted by source and once by target, so that both
+// "what does this code refer to" and "who refers to this address" are a
+// binary search followed by a contiguous run of results.
+class XrefTable {
+public:
+    // Collects the references made by instructions, decoded from region.
+    void add(const CodeRegion& region, std::span<const DecodedInstruction> instructions);
+
+    // Sorts and deduplicates the collected references; threads (0 = one per
+    // hardware thread) sort in parallel. Queries are valid after this.
+    void finish(unsigned threads);
+
+    size_t size() const { return bySource_.size(); }
+
+    // References made by instructions starting in [begin, end), by source.
+    std::span<const Xref> referencesFrom(uint64_t begin, uint64_t end) const;
+    std::span<const Xref> referencesFrom(uint64_t address) const { return referencesFrom(address, address + 1); }
+
+    // References to address, by source.
+    std::span<const Xref> referencesTo(uint64_t address) const;
+
+private:
+    std::vector<Xref> bySource_;  // Sorted by (from, to, kind)
+    std::vector<Xref> byTarget_;  // Sorted by (to, from, kind)
+};
+
+// Name of an xref kind as printed: "call", "jmp", "jcc" or "data".
+const char* xrefKindName(XrefKind kind);
+
+// Writes "References to" and "References from" lists for [begin, end):
+// every reference into begin, and every reference made by code in the
+// range, one per line with symbol names where symbols are given.
+void printXrefs(const XrefTable& xrefs, uint64_t begin, uint64_t end, OutputWriter& out,
+                const SymbolTable* symbols = nullptr);